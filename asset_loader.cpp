@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <chrono>
+#include "asset_loader.h"
+
+namespace game {
+	// Seconds on a clock shared by all threads
+	static double now(void) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	AssetLoader::AssetLoader(ResourceManager *resman, int num_workers) {
+		resman_ = resman;
+		num_workers_ = num_workers;
+		if (num_workers_ <= 0) {
+			num_workers_ = std::max(1, (int)std::thread::hardware_concurrency());
+		}
+		wall_ms_ = 0.0;
+		next_job_ = 0;
+		abort_ = false;
+	}
+
+	AssetLoader::~AssetLoader() {
+		for (unsigned int i = 0; i < jobs_.size(); i++) {
+			delete jobs_[i];
+		}
+	}
+
+	void AssetLoader::Queue(ResourceType type, const std::string name, const std::string filename) {
+		Job *job = new Job(type, name);
+		job->type = type;
+		job->ground = false;
+		job->filename = filename;
+		job->decode_ms = job->queued_ms = job->upload_ms = job->decoded_at = 0.0;
+		jobs_.push_back(job);
+	}
+
+	void AssetLoader::QueueGround(const std::string name) {
+		Queue(Mesh, name, "");
+		jobs_.back()->ground = true;
+	}
+
+	void AssetLoader::Work(double start) {
+		while (true) {
+			Job *job;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (abort_ || next_job_ >= jobs_.size()) {
+					return;
+				}
+				job = jobs_[next_job_++];
+			}
+
+			double begin = now();
+			try {
+				if (job->ground) {
+					ResourceManager::DecodeGround(job->asset);
+				}
+				else {
+					ResourceManager::DecodeResource(job->filename.c_str(), job->asset);
+				}
+			}
+			catch (...) {
+				job->error = std::current_exception();
+			}
+			double end = now();
+			job->decode_ms = (end - begin) * 1000.0;
+			job->decoded_at = end - start;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				ready_.push_back(job);
+			}
+			ready_signal_.notify_one();
+		}
+	}
+
+	void AssetLoader::Run(void) {
+		double start = now();
+		next_job_ = 0;
+		abort_ = false;
+		ready_.clear();
+
+		// The workers take jobs in queue order, so larger assets should be queued first
+		std::vector<std::thread> workers;
+		int num_threads = std::min(num_workers_, (int)jobs_.size());
+		for (int i = 0; i < num_threads; i++) {
+			workers.push_back(std::thread(&AssetLoader::Work, this, start));
+		}
+
+		// Create the GL objects in the order the assets finish decoding
+		std::exception_ptr error;
+		for (size_t uploaded = 0; uploaded < jobs_.size() && !error; uploaded++) {
+			Job *job;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				while (ready_.empty()) {
+					ready_signal_.wait(lock);
+				}
+				job = ready_.front();
+				ready_.pop_front();
+			}
+			double begin = now();
+			job->queued_ms = std::max(0.0, (begin - start - job->decoded_at) * 1000.0);
+			if (job->error) {
+				error = job->error;
+				break;
+			}
+			try {
+				resman_->UploadResource(job->asset);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			job->upload_ms = (now() - begin) * 1000.0;
+		}
+
+		// Stop handing out jobs after an error, and wait for the ones being decoded
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			abort_ = true;
+		}
+		for (unsigned int i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+		wall_ms_ = (now() - start) * 1000.0;
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	void AssetLoader::PrintTimings(std::ostream &out) const {
+		static const char *type_names[] = { "materials", "point sets", "meshes", "textures", "texture arrays" };
+		const int num_types = sizeof(type_names) / sizeof(type_names[0]);
+		double decode[num_types] = { 0.0 }, queued[num_types] = { 0.0 }, upload[num_types] = { 0.0 };
+		int count[num_types] = { 0 };
+		double total_decode = 0.0, total_upload = 0.0;
+
+		for (unsigned int i = 0; i < jobs_.size(); i++) {
+			const Job *job = jobs_[i];
+			out << "  " << job->asset.name << ": decode " << job->decode_ms << " ms, queued " << job->queued_ms
+				<< " ms, upload " << job->upload_ms << " ms" << std::endl;
+			decode[job->type] += job->decode_ms;
+			queued[job->type] += job->queued_ms;
+			upload[job->type] += job->upload_ms;
+			count[job->type]++;
+			total_decode += job->decode_ms;
+			total_upload += job->upload_ms;
+		}
+		for (int t = 0; t < num_types; t++) {
+			if (count[t] > 0) {
+				out << "  " << count[t] << " " << type_names[t] << ": decode " << decode[t] << " ms, queued " << queued[t]
+					<< " ms, upload " << upload[t] << " ms" << std::endl;
+			}
+		}
+
+		// Decoding in parallel is what makes the wall time shorter than the sum of the stages
+		out << "Loaded " << jobs_.size() << " assets on " << num_workers_ << " workers in " << wall_ms_ << " ms (decode "
+			<< total_decode << " ms, upload " << total_upload << " ms)" << std::endl;
+	}
+
+	int AssetLoader::GetNumWorkers(void) const {
+		return num_workers_;
+	}
+} // namespace game
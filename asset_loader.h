@@ -0,0 +1,72 @@
+#ifndef ASSET_LOADER_H_
+#define ASSET_LOADER_H_
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "resource_manager.h"
+
+namespace game {
+	// Loads a batch of resources in parallel: files are read and decoded (images, OBJ
+	// parsing, terrain generation) on a pool of worker threads, and every decoded asset
+	// is handed back through a queue to the calling thread, which owns the GL context
+	// and creates the GL objects as soon as each one is ready
+	class AssetLoader {
+	public:
+		// num_workers <= 0 uses one worker per core
+		AssetLoader(ResourceManager *resman, int num_workers = 0);
+		~AssetLoader();
+
+		// Add a resource to load from filename, like ResourceManager::LoadResource
+		void Queue(ResourceType type, const std::string name, const std::string filename);
+		// Add the terrain mesh, like ResourceManager::CreateGround
+		void QueueGround(const std::string name);
+
+		// Load everything queued, returns when every resource was created. Errors of the
+		// workers are thrown here, after the remaining work was abandoned
+		void Run(void);
+
+		// Time spent in each stage, per asset and per type of resource
+		void PrintTimings(std::ostream &out) const;
+		int GetNumWorkers(void) const;
+
+	private:
+		// One resource going through the pipeline
+		struct Job {
+			ResourceType type;
+			bool ground;
+			std::string filename;
+			DecodedAsset asset;
+			double decode_ms; // On a worker
+			double queued_ms; // Decoded, waiting for the GL thread
+			double upload_ms; // On the GL thread
+			double decoded_at; // Seconds since Run started
+			std::exception_ptr error;
+
+			Job(ResourceType type, const std::string name) : asset(type, name) {}
+		};
+
+		ResourceManager *resman_;
+		int num_workers_;
+		std::vector<Job *> jobs_;
+		double wall_ms_;
+
+		// Shared with the workers
+		std::mutex mutex_;
+		std::condition_variable ready_signal_;
+		size_t next_job_; // Next job to decode
+		std::deque<Job *> ready_; // Decoded jobs waiting for the upload
+		bool abort_;
+
+		// Worker loop: decode jobs until none are left
+		void Work(double start);
+
+		AssetLoader(const AssetLoader &);
+		AssetLoader &operator=(const AssetLoader &);
+	}; // class AssetLoader
+} // namespace game
+#endif // ASSET_LOADER_H_
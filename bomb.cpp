@@ -1,4 +1,7 @@
 #include "bomb.h"
+#include "texture_streamer.h"
+#include "scene_snapshot.h"
+#include "gpu_counters.h"
 #include <stdexcept>
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/type_ptr.hpp>
@@ -16,6 +19,18 @@ namespace game {
 
 	Bomb::~Bomb() {}
 
+	void Bomb::SaveState(SnapshotNode &state) const {
+		SceneNode::SaveState(state);
+		state.extra[0] = rgb_col.x;
+		state.extra[1] = rgb_col.y;
+		state.extra[2] = rgb_col.z;
+	}
+
+	void Bomb::RestoreState(const SnapshotNode &state) {
+		SceneNode::RestoreState(state);
+		rgb_col = glm::vec3(state.extra[0], state.extra[1], state.extra[2]);
+	}
+
 	void Bomb::Update(double delta_time) {
 		time_to_live -= delta_time;
 		if (time_to_live <= 0.0 && time_to_live > -4000.0) {
@@ -23,7 +38,7 @@ namespace game {
 		}
 	}
 
-	glm::mat4 Bomb::Draw(Camera *camera, glm::mat4 parent_transf, bool sun) {
+	glm::mat4 Bomb::Draw(Camera *, glm::mat4 parent_transf, bool sun) {
 		parent_transf = glm::mat4(1.0);
 
 		// Disable z-buffer
@@ -41,9 +56,6 @@ namespace game {
 		glBindBuffer(GL_ARRAY_BUFFER, array_buffer_);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_array_buffer_);
 
-		// Set globals for camera
-		camera->SetupShader(material_);
-
 		// Set world matrix and other shader input variables
 		glm::mat4 transf = SetupShader(material_, parent_transf, sun);
 
@@ -54,10 +66,18 @@ namespace game {
 		else {
 			glDrawElements(mode_, size_, GL_UNSIGNED_INT, 0);
 		}
+		GpuCounters::CountDraw(mode_ == GL_TRIANGLES ? size_ / 3 : 0);
 
 		return transf;
 	}
 
+	glm::mat4 Bomb::GetTransform(glm::mat4) const {
+		glm::mat4 scaling = glm::scale(glm::mat4(1.0), scale_);
+		glm::mat4 rotation = glm::mat4_cast(orientation_);
+		glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
+		return translation * rotation * scaling;
+	}
+
 	glm::mat4 Bomb::SetupShader(GLuint program, glm::mat4 parent_transf, bool sun) {
 		// Set attributes for shaders
 		GLint vertex_att = glGetAttribLocation(program, "vertex");
@@ -96,14 +116,12 @@ namespace game {
 			glUniform1i(tex, 0); // Assign the first texture to the map
 			glActiveTexture(GL_TEXTURE0);
 			glBindTexture(GL_TEXTURE_2D, texture_); // First texture we bind
-													// Define texture interpolation
-			glGenerateMipmap(GL_TEXTURE_2D);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			TextureStreamer::MarkUsed(texture_);
+			// Mipmaps and interpolation are set up once, when the texture is loaded
 		}
 
-		// Timer
-		GLint timer_var = glGetUniformLocation(program, "timer");
+		// Time since the burst started
+		GLint timer_var = glGetUniformLocation(program, "burst_timer");
 		double current_time = (time_to_live - 4.0)*-1.0;
 		glUniform1f(timer_var, (float)current_time);
 
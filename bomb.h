@@ -19,7 +19,12 @@ namespace game {
 
 		void Update(double delta_time);
 		glm::mat4 Draw(Camera * camera, glm::mat4 parent_transf, bool sun);
+		// Bombs ignore their parent and keep their scale, as drawn
+		glm::mat4 GetTransform(glm::mat4 parent_transf) const;
 		glm::mat4 SetupShader(GLuint program, glm::mat4 parent_transf, bool sun);
+		// Also the color
+		void SaveState(SnapshotNode &state) const;
+		void RestoreState(const SnapshotNode &state);
 		glm::vec3 rgb_col;
 	}; // class
 } // namespace game
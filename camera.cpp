@@ -7,7 +7,7 @@
 #include "camera.h"
 
 namespace game {
-	Camera::Camera(void) {}
+	Camera::Camera(void) : interpolation_(1.0), projection_scale_(1.0) {}
 
 	Camera::~Camera() {}
 
@@ -21,10 +21,12 @@ namespace game {
 
 	void Camera::SetPosition(glm::vec3 position) {
 		position_ = position;
+		previous_position_ = position;
 	}
 
 	void Camera::SetOrientation(glm::quat orientation) {
 		orientation_ = orientation;
+		previous_orientation_ = orientation;
 	}
 
 	void Camera::Translate(glm::vec3 trans) {
@@ -68,10 +70,20 @@ namespace game {
 		orientation_ = rotation * orientation_;
 	}
 
-	void Camera::Update() { //keep momentum going
-		this->Translate(this->GetForward()*vel_z);
-		this->Translate(this->GetSide()*vel_x);
-		this->Translate(this->GetUp()*vel_y);
+	void Camera::Update(double delta_time) { //keep momentum going
+		float t = delta_time;
+		this->Translate(this->GetForward()*vel_z*t);
+		this->Translate(this->GetSide()*vel_x*t);
+		this->Translate(this->GetUp()*vel_y*t);
+	}
+
+	void Camera::StoreState(void) {
+		previous_position_ = position_;
+		previous_orientation_ = orientation_;
+	}
+
+	void Camera::SetInterpolation(float alpha) {
+		interpolation_ = alpha;
 	}
 
 	void Camera::SetView(glm::vec3 position, glm::vec3 look_at, glm::vec3 up) {
@@ -83,8 +95,8 @@ namespace game {
 		side_ = glm::normalize(side_);
 
 		// Reset orientation and position of camera
-		position_ = position;
-		orientation_ = glm::quat();
+		SetPosition(position);
+		SetOrientation(glm::quat());
 	}
 
 	void Camera::SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GLfloat h) {
@@ -92,27 +104,35 @@ namespace game {
 		float top = tan((fov / 2.0)*(glm::pi<float>() / 180.0))*near;
 		float right = top * w / h;
 		projection_matrix_ = glm::frustum(-right, right, -top, top, near, far);
+		projection_scale_ = h / (2.0 * top / near);
+	}
+
+	glm::mat4 Camera::GetViewMatrix(void) const {
+		return view_matrix_;
 	}
 
-	void Camera::SetupShader(GLuint program) {
-		// Update view matrix
-		SetupViewMatrix();
+	glm::mat4 Camera::GetProjectionMatrix(void) const {
+		return projection_matrix_;
+	}
 
-		// Set view matrix in shader
-		GLint view_mat = glGetUniformLocation(program, "view_mat");
-		glUniformMatrix4fv(view_mat, 1, GL_FALSE, glm::value_ptr(view_matrix_));
+	glm::vec3 Camera::GetViewPosition(void) const {
+		return view_position_;
+	}
 
-		// Set projection matrix in shader
-		GLint projection_mat = glGetUniformLocation(program, "projection_mat");
-		glUniformMatrix4fv(projection_mat, 1, GL_FALSE, glm::value_ptr(projection_matrix_));
+	float Camera::GetProjectionScale(void) const {
+		return projection_scale_;
 	}
 
 	void Camera::SetupViewMatrix(void) {
+		// View from between the last two simulation steps
+		glm::quat orientation = glm::slerp(previous_orientation_, orientation_, interpolation_);
+		view_position_ = glm::mix(previous_position_, position_, interpolation_);
+
 		// Get current vectors of coordinate system
 		// [side, up, forward]
 		// See slide in "Camera control" for details
-		glm::vec3 current_forward = orientation_ * forward_;
-		glm::vec3 current_side = orientation_ * side_;
+		glm::vec3 current_forward = orientation * forward_;
+		glm::vec3 current_side = orientation * side_;
 		glm::vec3 current_up = glm::cross(current_forward, current_side);
 		current_up = glm::normalize(current_up);
 
@@ -133,7 +153,7 @@ namespace game {
 		view_matrix_[2][2] = current_forward[2];
 
 		// Create translation to camera position
-		glm::mat4 trans = glm::translate(glm::mat4(1.0), -position_);
+		glm::mat4 trans = glm::translate(glm::mat4(1.0), -view_position_);
 
 		// Combine translation and view matrix in proper order
 		view_matrix_ *= trans;
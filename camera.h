@@ -24,9 +24,15 @@ namespace game {
 		void Translate(glm::vec3 trans);
 		void Rotate(glm::quat rot);
 
-		// here we go boys
+		// here we go boys, in units per second
 		float vel_x = 0, vel_y = 0, vel_z = 0;
-		void Update();
+		void Update(double delta_time);
+
+		// Keep the current position and orientation as the previous simulation step,
+		// call before every step. SetPosition and SetOrientation move the camera at once
+		void StoreState(void);
+		// Draw the camera this fraction of the way from the previous step to the current one
+		void SetInterpolation(float alpha);
 
 		// Get relative attributes of camera
 		glm::vec3 GetForward(void) const;
@@ -45,18 +51,29 @@ namespace game {
 		// Set projection from frustum parameters: field-of-view,
 		// near and far planes, and width and height of viewport
 		void SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GLfloat h);
-		// Set all camera-related variables in shader program
-		void SetupShader(GLuint program);
+		// Create view matrix from current camera parameters, done once per frame
+		// when the frame uniforms are uploaded
+		void SetupViewMatrix(void);
+
+		// Matrices and interpolated position as of the last call to SetupViewMatrix
+		glm::mat4 GetViewMatrix(void) const;
+		glm::vec3 GetViewPosition(void) const;
+		glm::mat4 GetProjectionMatrix(void) const;
+		// Pixels covered by one unit of length seen at a distance of one unit
+		float GetProjectionScale(void) const;
 
 	private:
 		glm::vec3 position_; // Position of camera
 		glm::quat orientation_; // Orientation of camera
+		glm::vec3 previous_position_; // Position and orientation at the previous simulation step
+		glm::quat previous_orientation_;
+		float interpolation_; // Fraction of the way from the previous step drawn
+		glm::vec3 view_position_; // Interpolated position the view matrix was built from
 		glm::vec3 forward_; // Initial forward vector
 		glm::vec3 side_; // Initial side vector
 		glm::mat4 view_matrix_; // View matrix
 		glm::mat4 projection_matrix_; // Projection matrix
-		// Create view matrix from current camera parameters
-		void SetupViewMatrix(void);
+		float projection_scale_; // Viewport height over the height of the view frustum at unit distance
 	}; // class Camera
 } // namespace game
 #endif // CAMERA_H_
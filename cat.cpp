@@ -12,10 +12,12 @@ namespace game {
 
 	Cat::~Cat() {}
 
-	void Cat::Update(double deltaTime) {
-		// The mole enemy rotates to face the target, but doesn't move
-		Enemy::Update(deltaTime);
+	SteeringType Cat::getSteeringType() {
+		return CatSteering;
+	}
 
+	void Cat::Steer(double deltaTime) {
+		// The cat rotates to face the target, and flies towards it until it is 100 units away
 		if (target == NULL)
 			return;
 
@@ -36,17 +38,19 @@ namespace game {
 		}
 	}
 
-	AttackNode* Cat::getAttack() {
+	bool Cat::getProjectile(ProjectileShot &shot) {
+		if (projectile_type < 0) {
+			return false;
+		}
 		resetCooldown();
 
 		glm::vec3 aim = GetOrientation() * SceneNode::default_forward;
-		/*Ray r = Ray(GetAbsolutePosition(), aim);
-		AttackNode* shot = new Hitscan(r);*/
-		AttackNode* shot = new Projectile(GetEntityName(), GetEntityPosition(), aim*10.0f, glm::vec3(0, -0.05, 0), 1.0,
-			projectile_geometry, projectile_material, projectile_texture);
-
-		shot->SetScale(0.3, 0.3, 0.3);
+		shot.position = GetEntityPosition();
+		shot.velocity = aim*10.0f;
+		shot.acceleration = glm::vec3(0, -0.05, 0);
+		shot.damage = 1.0;
+		shot.type = projectile_type;
 
-		return shot;
+		return true;
 	}
 }
\ No newline at end of file
@@ -8,8 +8,9 @@ namespace game {
 		Cat(const std::string name, SceneNode* targ, const Resource* geometry, const Resource* mat, const Resource *tex = NULL);
 		~Cat();
 
-		void Update(double t);
-		AttackNode* getAttack();
+		void Steer(double t);
+		SteeringType getSteeringType();
+		bool getProjectile(ProjectileShot &shot);
 
 	private:
 		static float damage;
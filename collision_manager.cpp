@@ -25,6 +25,10 @@ namespace game {
 		return false;
 	}
 
+	bool CollisionManager::isColliding(Collidable* a, Ray r, glm::vec2 &intersection) {
+		return isColliding(a->aabb, r) && isColliding(a->hb, r, intersection);
+	}
+
 	/* Return whether two axis-aligned bounding boxes intersect. */
 	bool CollisionManager::isColliding(AABB a, AABB b)
 	{
@@ -158,6 +162,16 @@ namespace game {
 		Output: Intersection Points: solutions to the function made by ray/hb intersection.
 	*/
 	bool CollisionManager::isColliding(Hitbox a, Ray r, glm::vec2** intersection) {
+		glm::vec2 points;
+		if (!isColliding(a, r, points))
+			return false;
+
+		(*intersection) = new glm::vec2(points);
+
+		return true;
+	}
+
+	bool CollisionManager::isColliding(Hitbox a, Ray r, glm::vec2 &intersection) {
 		// max = nearest far of all intersections 
 		// min = farthest near of ''
 		float max = NAN, min = NAN;
@@ -233,7 +247,7 @@ namespace game {
 		if (max < min)
 			return false;
 
-		(*intersection) = new glm::vec2(min, max);
+		intersection = glm::vec2(min, max);
 
 		return true;
 	}
@@ -10,6 +10,8 @@ namespace game {
 	public:
 		static bool isColliding(Collidable* a, Collidable* b);
 		static bool isColliding(Collidable* n, Ray r, glm::vec2** intersection);
+		// Same without allocating, intersection holds the distances along r where it enters and leaves n
+		static bool isColliding(Collidable* n, Ray r, glm::vec2 &intersection);
 		static bool checkHierarchicalCollision(SceneNode* a, SceneNode* b);
 		static bool checkHierarchicalCollision(SceneNode* n, Ray r, glm::vec2** PoI);
 
@@ -20,6 +22,7 @@ namespace game {
 		static bool isColliding(Hitbox a, Hitbox b);
 		static bool isColliding(AABB a, Ray r);
 		static bool isColliding(Hitbox a, Ray r, glm::vec2** intesection);
+		static bool isColliding(Hitbox a, Ray r, glm::vec2 &intersection);
 		static glm::vec3 rotateAxis(glm::vec3 v, glm::mat4 t);
 		static std::vector<SceneNode*> flattenTree(SceneNode* root);
 	};
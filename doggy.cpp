@@ -16,25 +16,33 @@ namespace game {
 		turret = t;
 	}
 
-	AttackNode* Doggy::getAttack() {
+	bool Doggy::getProjectile(ProjectileShot &shot) {
 		// Doggy attack is an arcing projectile (maybe)
+		if (projectile_type < 0) {
+			return false;
+		}
 		resetCooldown();
 
 		glm::vec3 aim = turret->GetOrientation() * SceneNode::default_forward;
-		/*Ray r = Ray(GetAbsolutePosition(), aim);
-		AttackNode* shot = new Hitscan(r);*/
-		AttackNode* shot = new Projectile(GetEntityName(), GetEntityPosition(), aim*10.0f, glm::vec3(0, -0.05, 0), 1.0,
-			projectile_geometry, projectile_material, projectile_texture);
+		shot.position = GetEntityPosition();
+		shot.velocity = aim*10.0f;
+		shot.acceleration = glm::vec3(0, -0.05, 0);
+		shot.damage = 1.0;
+		shot.type = projectile_type;
 
-		shot->SetScale(0.3, 0.3, 0.3);
+		return true;
+	}
 
-		return shot;
+	SteeringType Doggy::getSteeringType() {
+		return DogSteering;
 	}
 
-	void Doggy::Update(double time) {
-		float t = time;
-		Enemy::Update(t);
+	SceneNode* Doggy::getTurret() {
+		return turret;
+	}
 
+	void Doggy::Steer(double time) {
+		float t = time;
 		if (target == NULL)
 			return;
 
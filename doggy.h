@@ -8,10 +8,12 @@ namespace game {
 		Doggy(const std::string name, SceneNode* targ, const Resource* geometry, const Resource* mat, const Resource *tex = NULL);
 		~Doggy();
 
-		void Update(double t);
+		void Steer(double t);
+		SteeringType getSteeringType();
 		void setTurret(SceneNode* t);
+		SceneNode* getTurret();
 
-		AttackNode* getAttack();
+		bool getProjectile(ProjectileShot &shot);
 
 	private:
 		SceneNode* turret;
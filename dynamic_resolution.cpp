@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cmath>
+#include "dynamic_resolution.h"
+
+namespace game {
+	// Aim a bit under the frame budget so noise doesn't push us over it
+	const float dynamic_resolution_headroom_g = 0.9;
+	// Only grow back once the frame is this far under the budget
+	const float dynamic_resolution_grow_g = 0.75;
+	// Largest change of scale at once, and frames to wait between changes
+	const float dynamic_resolution_step_g = 0.1;
+	const int dynamic_resolution_wait_g = 10;
+
+	DynamicResolution::DynamicResolution(float target_fps, float min_scale, float max_scale) {
+		enabled_ = false;
+		target_ms_ = 1000.0 / target_fps;
+		min_scale_ = min_scale;
+		max_scale_ = max_scale;
+		scale_ = max_scale;
+		gpu_ms_ = 0.0;
+		frames_since_change_ = 0;
+	}
+
+	DynamicResolution::~DynamicResolution() {}
+
+	void DynamicResolution::AddFrameTime(float gpu_ms) {
+		Adjust(gpu_ms);
+	}
+
+	void DynamicResolution::SetEnabled(bool enabled) {
+		enabled_ = enabled;
+		if (!enabled_) {
+			scale_ = max_scale_;
+		}
+		frames_since_change_ = 0;
+	}
+
+	bool DynamicResolution::IsEnabled(void) const {
+		return enabled_;
+	}
+
+	void DynamicResolution::SetTargetFps(float fps) {
+		target_ms_ = 1000.0 / fps;
+	}
+
+	float DynamicResolution::GetTargetFps(void) const {
+		return 1000.0 / target_ms_;
+	}
+
+	float DynamicResolution::GetScale(void) const {
+		return scale_;
+	}
+
+	float DynamicResolution::GetGpuTime(void) const {
+		return gpu_ms_;
+	}
+
+	void DynamicResolution::Adjust(float frame_ms) {
+		// Smooth out single slow frames
+		gpu_ms_ = (gpu_ms_ == 0.0) ? frame_ms : gpu_ms_ * 0.8f + frame_ms * 0.2f;
+
+		frames_since_change_++;
+		if (!enabled_ || frames_since_change_ < dynamic_resolution_wait_g || gpu_ms_ <= 0.0) {
+			return;
+		}
+
+		float budget = target_ms_ * dynamic_resolution_headroom_g;
+		if (gpu_ms_ < budget && gpu_ms_ > target_ms_ * dynamic_resolution_grow_g) {
+			return;
+		}
+
+		// Fill cost grows with the pixel count, that is with the square of the scale
+		float wanted = scale_ * sqrt(budget / gpu_ms_);
+		wanted = std::min(std::max(wanted, scale_ - dynamic_resolution_step_g), scale_ + dynamic_resolution_step_g);
+		wanted = std::min(std::max(wanted, min_scale_), max_scale_);
+		if (wanted != scale_) {
+			scale_ = wanted;
+			frames_since_change_ = 0;
+		}
+	}
+} // namespace game
@@ -0,0 +1,40 @@
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+namespace game {
+	// Follows how long the GPU takes to draw each frame, as measured by the GpuProfiler, and picks
+	// the fraction of the window resolution to render at, so the frame time stays under the target
+	class DynamicResolution {
+	public:
+		DynamicResolution(float target_fps = 60.0, float min_scale = 0.5, float max_scale = 1.0);
+		~DynamicResolution();
+
+		// GPU time of the passes that draw at the render scale in a measured frame, in milliseconds
+		void AddFrameTime(float gpu_ms);
+
+		// Turn the scaling on or off, when off the scale stays at the maximum
+		void SetEnabled(bool enabled);
+		bool IsEnabled(void) const;
+
+		void SetTargetFps(float fps);
+		float GetTargetFps(void) const;
+
+		// Fraction of the window resolution to render at, in [min_scale, max_scale]
+		float GetScale(void) const;
+		// Smoothed GPU time of the last measured frames, in milliseconds
+		float GetGpuTime(void) const;
+
+	private:
+		bool enabled_;
+		float target_ms_;
+		float min_scale_;
+		float max_scale_;
+		float scale_;
+		float gpu_ms_;
+		int frames_since_change_;
+
+		// Move the scale towards the one that meets the target
+		void Adjust(float frame_ms);
+	}; // class DynamicResolution
+} // namespace game
+#endif // DYNAMIC_RESOLUTION_H_
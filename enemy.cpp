@@ -1,9 +1,11 @@
 #include "enemy.h"
+#include "scene_snapshot.h"
 #include <iostream>
 
 namespace game {
 	Enemy::Enemy(const std::string name, SceneNode* targ, const Resource *geometry, const Resource *material, const Resource *tex) : SceneNode(name, geometry, material, tex, true) {
 		target = targ;
+		threatRange = ENEMY_THREAT_RANGE;
 	}
 
 	Enemy::~Enemy() {}
@@ -16,10 +18,22 @@ namespace game {
 		return speed;
 	}
 
+	float Enemy::getThreatRange() {
+		return threatRange;
+	}
+
+	SceneNode* Enemy::getTarget() {
+		return target;
+	}
+
 	bool Enemy::isAttacking() {
 		return attack_flag;
 	}
 
+	SteeringType Enemy::getSteeringType() {
+		return NoSteering;
+	}
+
 	void Enemy::setRotateSpeed(float s) {
 		rotateSpeed = s;
 	}
@@ -32,19 +46,55 @@ namespace game {
 		firerate = f;
 	}
 
-	void Enemy::setProjectileGeometry(Resource* g) {
-		projectile_geometry = g;
+	void Enemy::setProjectileType(int type) {
+		projectile_type = type;
+	}
+
+	void Enemy::setTarget(SceneNode* targ) {
+		target = targ;
 	}
 
-	void Enemy::setProjectileMaterial(Resource* m) {
-		projectile_material = m;
+	void Enemy::SaveState(SnapshotNode &state) const {
+		SceneNode::SaveState(state);
+		state.rotate_speed = rotateSpeed;
+		state.speed = speed;
+		state.threat_range = threatRange;
+		state.firerate = firerate;
+		state.shot_cooldown = shot_CD;
+		state.attack_flag = attack_flag;
+		state.projectile_type = projectile_type;
 	}
 
-	void Enemy::setProjectileTexture(Resource* t) {
-		projectile_texture = t;
+	void Enemy::RestoreState(const SnapshotNode &state) {
+		SceneNode::RestoreState(state);
+		rotateSpeed = state.rotate_speed;
+		speed = state.speed;
+		threatRange = state.threat_range;
+		firerate = state.firerate;
+		shot_CD = state.shot_cooldown;
+		attack_flag = state.attack_flag != 0;
+		projectile_type = state.projectile_type;
+	}
+
+	AttackNode* Enemy::getAttack() {
+		resetCooldown();
+		return NULL;
+	}
+
+	bool Enemy::getProjectile(ProjectileShot &) {
+		return false;
 	}
 
 	void Enemy::Update(double t) {
+		UpdateAttack(t);
+		Steer(t);
+	}
+
+	void Enemy::Steer(double) {
+		// Enemies that don't move do nothing
+	}
+
+	void Enemy::UpdateAttack(double t) {
 		float deltaTime = t;
 
 		if (target && target->isDestroyed()) {
@@ -52,7 +102,7 @@ namespace game {
 		}
 
 		if (shot_CD <= 0) {
-			if (target) {
+			if (target && glm::length(target->GetPosition() - GetEntityPosition()) <= threatRange) {
 				attack_flag = true;
 			}
 		}
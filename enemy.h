@@ -4,9 +4,15 @@
 #include "collidable.h"
 #include "attack_node.h"
 #include "hitscan.h"
-#include "projectile.h"
+#include "projectile_system.h"
+
+// Enemies attack targets this close, unless they set their own range
+#define ENEMY_THREAT_RANGE 200.0f
 
 namespace game {
+	// How an enemy turns and moves towards its target, enemies of one type are steered together by EnemySteering
+	enum SteeringType { NoSteering, MoleSteering, CatSteering, DogSteering };
+
 	// Class that manages one object in a scene 
 	class Enemy : public SceneNode {
 	public:
@@ -18,21 +24,34 @@ namespace game {
 
 		float getRotateSpeed();
 		float getMovementSpeed();
+		float getThreatRange();
+		SceneNode* getTarget();
 		bool isAttacking();
-		virtual AttackNode* getAttack() = 0;
+		virtual SteeringType getSteeringType();
+		// Attack the scene resolves at once, such as a hitscan, or NULL
+		virtual AttackNode* getAttack();
+		// Fill in the projectile to fire, returns false for enemies without projectiles
+		virtual bool getProjectile(ProjectileShot &shot);
 
 		void setRotateSpeed(float s);
 		void setMovementSpeed(float s);
 		void setFirerate(float f);
-		void setProjectileGeometry(Resource* g);
-		void setProjectileMaterial(Resource* m);
-		void setProjectileTexture(Resource* t);
+		void setProjectileType(int type); // type of the scene's ProjectileSystem
+		void setTarget(SceneNode* targ);
 
 		// Update: move, attack etc
 		void Update(double deltaTime);
+		// Count down to the next attack, and raise the attack flag once the target is within threatRange
+		void UpdateAttack(double deltaTime);
+		// Turn and move towards the target, one enemy at a time. This is the reference EnemySteering matches
+		virtual void Steer(double deltaTime);
 
 		void collide(Collidable* other);
 
+		// Also the speeds, the range and the attack timer
+		void SaveState(SnapshotNode &state) const;
+		void RestoreState(const SnapshotNode &state);
+
 	protected:
 		SceneNode* target = NULL; // what this enemy is trying to destroy
 
@@ -47,9 +66,7 @@ namespace game {
 		float shot_CD = 0; // how long until this can shoot
 		bool attack_flag = false; // does this enemy want to attack
 
-		Resource* projectile_geometry = NULL;
-		Resource* projectile_material = NULL;
-		Resource* projectile_texture = NULL;
+		int projectile_type = -1; // what this enemy fires, -1 if it has no projectiles
 	};
 } // game
 #endif // SCENE_NODE_H_
\ No newline at end of file
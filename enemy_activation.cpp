@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <stack>
+#include "enemy_activation.h"
+
+namespace game {
+	EnemyActivation::EnemyActivation(float wake_range, double scan_interval) {
+		wake_range_ = wake_range;
+		scan_interval_ = scan_interval;
+		since_scan_ = 0.0;
+		invalid_ = true;
+		scanned_children_ = 0;
+		target_ = NULL;
+		for (int tier = SleepTier; tier <= ActiveTier; tier++) {
+			count_[tier] = 0;
+			steps_[tier] = 0;
+		}
+	}
+
+	void EnemyActivation::SetTarget(SceneNode *target) {
+		target_ = target;
+		invalid_ = true;
+	}
+
+	SceneNode *EnemyActivation::GetTarget(void) const {
+		return target_;
+	}
+
+	void EnemyActivation::Update(SceneNode *root, double delta_time) {
+		since_scan_ += delta_time;
+		settling_.clear();
+		if (invalid_ || since_scan_ >= scan_interval_ || root->children_.size() != scanned_children_) {
+			Scan(root);
+		}
+
+		awake_.assign(always_.begin(), always_.end());
+		count_[IdleTier] = count_[ActiveTier] = 0;
+		for (unsigned int i = 0; i < near_.size(); i++) {
+			Tracked &tracked = tracked_[near_[i]];
+			ActivationTier tier = Measure(tracked);
+			if (tier == SleepTier && tracked.tier != SleepTier) {
+				settling_.push_back(tracked.entity);
+			}
+			tracked.tier = tier;
+			if (tier != SleepTier) {
+				awake_.push_back(tracked.entity);
+				count_[tier]++;
+			}
+		}
+		count_[SleepTier] = (int)tracked_.size() - count_[IdleTier] - count_[ActiveTier];
+		for (int tier = SleepTier; tier <= ActiveTier; tier++) {
+			steps_[tier] += count_[tier];
+		}
+	}
+
+	void EnemyActivation::Invalidate(void) {
+		invalid_ = true;
+	}
+
+	const std::vector<SceneNode *> &EnemyActivation::GetAwake(void) const {
+		return awake_;
+	}
+
+	const std::vector<SceneNode *> &EnemyActivation::GetSettling(void) const {
+		return settling_;
+	}
+
+	int EnemyActivation::GetCount(ActivationTier tier) const {
+		return count_[tier];
+	}
+
+	void EnemyActivation::Report(std::ostream &out) {
+		const char *names[] = { "asleep", "idle", "active" };
+		long total = steps_[SleepTier] + steps_[IdleTier] + steps_[ActiveTier];
+		out << "Enemies:";
+		for (int tier = ActiveTier; tier >= SleepTier; tier--) {
+			out << " " << count_[tier] << " " << names[tier] << " ("
+				<< (total > 0 ? 100 * steps_[tier] / total : 0) << "%)";
+			steps_[tier] = 0;
+		}
+		out << " of the enemy steps since the last report" << std::endl;
+	}
+
+	void EnemyActivation::Scan(SceneNode *root) {
+		since_scan_ = 0.0;
+		invalid_ = false;
+		scanned_children_ = root->children_.size();
+
+		// Enemies awake until now fall asleep if the scan leaves them out, and the entities of the last
+		// scan tell which ones are new
+		std::vector<SceneNode *> was_awake, was_tracked;
+		for (unsigned int i = 0; i < near_.size(); i++) {
+			if (tracked_[near_[i]].tier != SleepTier) {
+				was_awake.push_back(tracked_[near_[i]].entity);
+			}
+		}
+		for (unsigned int i = 0; i < tracked_.size(); i++) {
+			was_tracked.push_back(tracked_[i].entity);
+		}
+		std::sort(was_awake.begin(), was_awake.end());
+		std::sort(was_tracked.begin(), was_tracked.end());
+
+		tracked_.clear();
+		always_.clear();
+		grid_.Clear();
+		for (std::vector<SceneNode *>::const_iterator entity = root->children_begin();
+			entity != root->children_end(); entity++) {
+			// Destroyed entities are updated so the scene removes them
+			Enemy *enemy = NULL;
+			if (!(*entity)->isDestroyed()) {
+				std::stack<SceneNode *> stck;
+				stck.push(*entity);
+				while (stck.size() > 0 && enemy == NULL) {
+					SceneNode *current = stck.top();
+					stck.pop();
+					enemy = dynamic_cast<Enemy *>(current);
+					for (SceneNode *c : current->children_) {
+						stck.push(c);
+					}
+				}
+			}
+			if (enemy == NULL) {
+				always_.push_back(*entity);
+				continue;
+			}
+
+			Tracked tracked = { *entity, enemy, SleepTier };
+			if (std::binary_search(was_awake.begin(), was_awake.end(), *entity)) {
+				tracked.tier = IdleTier;
+			}
+			else if (!std::binary_search(was_tracked.begin(), was_tracked.end(), *entity)) {
+				settling_.push_back(*entity);
+			}
+			glm::vec3 position = enemy->GetEntityPosition();
+			grid_.Insert(position, position, (int)tracked_.size());
+			tracked_.push_back(tracked);
+		}
+
+		// Only enemies that could come within range before the next scan are measured until then
+		near_.clear();
+		if (target_ == NULL) {
+			for (unsigned int i = 0; i < tracked_.size(); i++) {
+				near_.push_back(i);
+			}
+		}
+		else {
+			grid_.Build();
+			float range = wake_range_ + ENEMY_ACTIVATION_SCAN_MARGIN;
+			glm::vec3 center = target_->GetPosition();
+			grid_.QueryBox(center - glm::vec3(range), center + glm::vec3(range), candidates_);
+			for (unsigned int i = 0; i < candidates_.size(); i++) {
+				if (glm::length(tracked_[candidates_[i]].enemy->GetEntityPosition() - center) <= range) {
+					near_.push_back(candidates_[i]);
+				}
+			}
+		}
+
+		// Awake enemies left out moved away faster than the margin, they are not measured to notice
+		std::sort(near_.begin(), near_.end());
+		for (unsigned int i = 0; i < tracked_.size(); i++) {
+			if (tracked_[i].tier != SleepTier && !std::binary_search(near_.begin(), near_.end(), (int)i)) {
+				settling_.push_back(tracked_[i].entity);
+				tracked_[i].tier = SleepTier;
+			}
+		}
+	}
+
+	ActivationTier EnemyActivation::Measure(const Tracked &tracked) const {
+		if (target_ == NULL) {
+			return ActiveTier;
+		}
+		float distance = glm::length(tracked.enemy->GetEntityPosition() - target_->GetPosition());
+		if (distance > wake_range_) {
+			return SleepTier;
+		}
+		return (distance > tracked.enemy->getThreatRange()) ? IdleTier : ActiveTier;
+	}
+} // namespace game
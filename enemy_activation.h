@@ -0,0 +1,88 @@
+#ifndef ENEMY_ACTIVATION_H_
+#define ENEMY_ACTIVATION_H_
+#include <vector>
+#include <ostream>
+#include "enemy.h"
+#include "spatial_grid.h"
+
+// Enemies further than this from the player sleep
+#define ENEMY_ACTIVATION_WAKE_RANGE 250.0f
+// Seconds between two scans of the whole scene
+#define ENEMY_ACTIVATION_SCAN_INTERVAL 0.25
+// How much closer than the wake range the player and an enemy can get between two scans. Enemies
+// closing in faster wake up to a scan late
+#define ENEMY_ACTIVATION_SCAN_MARGIN 50.0f
+
+namespace game {
+	// How much of an enemy entity runs each step
+	enum ActivationTier {
+		SleepTier, // Not updated at all
+		IdleTier, // Updated and steered, but out of its threat range so it doesn't attack
+		ActiveTier // Updated and attacking
+	};
+
+	// Sorts the entities of the scene into tiers by distance to the player, so the scene only
+	// updates the ones near it. Every few steps a scan puts every enemy entity into a grid and
+	// keeps those that could come within the wake range before the next scan; each step only
+	// those are measured, and sleeping enemies further away are not touched until the next scan.
+	// Entities without an enemy are always updated
+	class EnemyActivation {
+	public:
+		EnemyActivation(float wake_range = ENEMY_ACTIVATION_WAKE_RANGE, double scan_interval = ENEMY_ACTIVATION_SCAN_INTERVAL);
+
+		// Enemies are measured from target, in the frame of the root. Without a target every entity is active
+		void SetTarget(SceneNode *target);
+		SceneNode *GetTarget(void) const;
+
+		// Tier the entities of root for this step, scanning them first if it is time or they changed
+		void Update(SceneNode *root, double delta_time);
+		// Scan again in the next Update, after entities are removed
+		void Invalidate(void);
+
+		// Entities to update this step: every awake enemy entity and every entity without an enemy
+		const std::vector<SceneNode *> &GetAwake(void) const;
+		// Entities that fell asleep this step or were first seen by this step's scan. They are not
+		// updated, so their transforms and collision boxes must be brought up to date once
+		const std::vector<SceneNode *> &GetSettling(void) const;
+
+		// Enemy entities in tier during the last Update
+		int GetCount(ActivationTier tier) const;
+		// Print the enemies in each tier, now and as a share of the steps since the last report
+		void Report(std::ostream &out);
+
+	private:
+		struct Tracked {
+			SceneNode *entity;
+			Enemy *enemy; // The enemy of the entity, whose range decides between idle and active
+			ActivationTier tier;
+		};
+
+		float wake_range_;
+		double scan_interval_;
+		double since_scan_;
+		bool invalid_;
+		size_t scanned_children_; // Entities of the root at the last scan
+		SceneNode *target_;
+
+		std::vector<Tracked> tracked_; // Every enemy entity at the last scan
+		std::vector<SceneNode *> always_; // Every other entity at the last scan
+		std::vector<int> near_; // Tracked entities that could wake before the next scan
+		SpatialGrid grid_;
+		std::vector<int> candidates_;
+
+		std::vector<SceneNode *> awake_;
+		std::vector<SceneNode *> settling_;
+
+		int count_[ActiveTier + 1];
+		// Enemy steps spent in each tier since the last report
+		long steps_[ActiveTier + 1];
+
+		void Scan(SceneNode *root);
+		// Tier of tracked by its distance to the target
+		ActivationTier Measure(const Tracked &tracked) const;
+
+		EnemyActivation(const EnemyActivation &);
+		EnemyActivation &operator=(const EnemyActivation &);
+	}; // class EnemyActivation
+} // namespace game
+#endif // ENEMY_ACTIVATION_H_
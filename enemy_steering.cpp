@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "enemy_steering.h"
+#include "doggy.h"
+
+namespace game {
+	// Rotation turning SceneNode::default_forward towards (x, y, z), like SceneNode::VectorToRotation:
+	// a yaw around y then a pitch around -x. The half angles come from the direction itself instead
+	// of asin, so it is the same rotation, though possibly as the negated quaternion. Written without
+	// branches so the loops calling it can be vectorized
+	static inline void facing_rotation(float x, float y, float z, float &w, float &qx, float &qy, float &qz) {
+		float flat = std::sqrt(x * x + z * z);
+		float length = std::sqrt(x * x + y * y + z * z);
+		float cos_yaw = z / (flat + FLT_MIN);
+		float cos_pitch = flat / (length + FLT_MIN);
+		// fabs keeps rounding from taking a square root of a tiny negative
+		float cy = std::sqrt(std::fabs(0.5f + 0.5f * cos_yaw));
+		float sy = std::copysign(std::sqrt(std::fabs(0.5f - 0.5f * cos_yaw)), x);
+		float cp = std::sqrt(std::fabs(0.5f + 0.5f * cos_pitch));
+		float sp = std::copysign(std::sqrt(std::fabs(0.5f - 0.5f * cos_pitch)), y);
+		w = cy * cp;
+		qx = -cy * sp;
+		qy = sy * cp;
+		qz = sy * sp;
+	}
+
+	// Slerp from a to b by t in [0, 1], as a normalized lerp with t corrected by a fitted cubic
+	// so the angle follows slerp closely. Takes the short way like glm::slerp
+	static inline void approximate_slerp(float aw, float ax, float ay, float az, float bw, float bx, float by, float bz,
+		float t, float &w, float &x, float &y, float &z) {
+		float ca = aw * bw + ax * bx + ay * by + az * bz;
+		float d = std::fabs(ca);
+		float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+		float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+		float k = a * (t - 0.5f) * (t - 0.5f) + b;
+		float ot = t + t * (t - 0.5f) * (t - 1.0f) * k;
+		float lt = 1.0f - ot;
+		float rt = std::copysign(ot, ca);
+		w = aw * lt + bw * rt;
+		x = ax * lt + bx * rt;
+		y = ay * lt + by * rt;
+		z = az * lt + bz * rt;
+		float inverse = 1.0f / std::sqrt(w * w + x * x + y * y + z * z);
+		w *= inverse;
+		x *= inverse;
+		y *= inverse;
+		z *= inverse;
+	}
+
+	// Turn every enemy rate of the way towards its target, moles and cats
+	static void steer_facing(int count, const float *__restrict dx, const float *__restrict dy, const float *__restrict dz,
+		float *__restrict qw, float *__restrict qx, float *__restrict qy, float *__restrict qz, const float *__restrict rate) {
+		for (int i = 0; i < count; i++) {
+			// Enemies on top of their target keep their orientation, a slerp by 0
+			float t = rate[i];
+			t = (dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i] != 0.0f) ? t : 0.0f;
+			float fw, fx, fy, fz;
+			facing_rotation(dx[i], dy[i], dz[i], fw, fx, fy, fz);
+			approximate_slerp(qw[i], qx[i], qy[i], qz[i], fw, fx, fy, fz, t, qw[i], qx[i], qy[i], qz[i]);
+		}
+	}
+
+	// Move every enemy step towards its target while it is further than range, cats
+	static void steer_approach(int count, const float *__restrict dx, const float *__restrict dy, const float *__restrict dz, const float *__restrict step,
+		float range, float *__restrict mx, float *__restrict my, float *__restrict mz) {
+		for (int i = 0; i < count; i++) {
+			float length = std::sqrt(dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i]);
+			bool move = (length > range) & (length > step[i]);
+			float scale = move ? step[i] / (length + FLT_MIN) : 0.0f;
+			mx[i] = dx[i] * scale;
+			my[i] = dy[i] * scale;
+			mz[i] = dz[i] * scale;
+		}
+	}
+
+	// Dogs turn their body towards the target on the ground and their turret straight at it,
+	// then drive forward
+	static void steer_dogs(int count, const float *__restrict dx, const float *__restrict dy, const float *__restrict dz,
+		float *__restrict qw, float *__restrict qx, float *__restrict qy, float *__restrict qz, float *__restrict tw, float *__restrict tx, float *__restrict ty, float *__restrict tz,
+		float body_rate, float turret_rate, const float *__restrict step, float *__restrict mx, float *__restrict my, float *__restrict mz) {
+		for (int i = 0; i < count; i++) {
+			// Dogs right under their target don't turn
+			float flat = std::sqrt(dx[i] * dx[i] + dz[i] * dz[i]);
+			bool turn = flat != 0.0f;
+
+			float fw, fx, fy, fz;
+			facing_rotation(dx[i], 0.0f, dz[i], fw, fx, fy, fz);
+			float w, x, y, z;
+			approximate_slerp(qw[i], qx[i], qy[i], qz[i], fw, fx, fy, fz, turn ? body_rate : 0.0f, w, x, y, z);
+			qw[i] = w;
+			qx[i] = x;
+			qy[i] = y;
+			qz[i] = z;
+
+			facing_rotation(dx[i], dy[i], dz[i], fw, fx, fy, fz);
+			approximate_slerp(tw[i], tx[i], ty[i], tz[i], fw, fx, fy, fz, turn ? turret_rate : 0.0f, tw[i], tx[i], ty[i], tz[i]);
+
+			// Forward is default_forward, (0, 0, 1), turned by the new orientation
+			float distance = (flat > step[i]) ? step[i] : 0.0f;
+			mx[i] = 2.0f * (x * z + w * y) * distance;
+			my[i] = 2.0f * (y * z - w * x) * distance;
+			mz[i] = (1.0f - 2.0f * (x * x + y * y)) * distance;
+		}
+	}
+
+	EnemySteering::EnemySteering(void) {
+	}
+
+	void EnemySteering::Add(Enemy *enemy) {
+		SteeringType type = enemy->getSteeringType();
+		if (type == NoSteering || enemy->getTarget() == NULL) {
+			return;
+		}
+		if (type == DogSteering && ((Doggy *)enemy)->getTurret() == NULL) {
+			return;
+		}
+		batches_[type].enemies.push_back(enemy);
+	}
+
+	void EnemySteering::Run(double delta_time) {
+		for (int type = MoleSteering; type <= DogSteering; type++) {
+			Batch &batch = batches_[type];
+			int count = (int)batch.enemies.size();
+			if (count == 0) {
+				continue;
+			}
+			Gather(batch, (SteeringType)type, delta_time);
+			if (type == DogSteering) {
+				float t = delta_time;
+				steer_dogs(count, &batch.dx[0], &batch.dy[0], &batch.dz[0],
+					&batch.qw[0], &batch.qx[0], &batch.qy[0], &batch.qz[0], &batch.tw[0], &batch.tx[0], &batch.ty[0], &batch.tz[0],
+					std::min(t, 1.0f), std::min(10.0f * t, 1.0f), &batch.step[0], &batch.mx[0], &batch.my[0], &batch.mz[0]);
+			}
+			else {
+				steer_facing(count, &batch.dx[0], &batch.dy[0], &batch.dz[0],
+					&batch.qw[0], &batch.qx[0], &batch.qy[0], &batch.qz[0], &batch.rate[0]);
+				if (type == CatSteering) {
+					steer_approach(count, &batch.dx[0], &batch.dy[0], &batch.dz[0], &batch.step[0],
+						ENEMY_STEERING_CAT_RANGE, &batch.mx[0], &batch.my[0], &batch.mz[0]);
+				}
+			}
+			Scatter(batch, (SteeringType)type);
+			batch.enemies.clear();
+		}
+	}
+
+	int EnemySteering::GetCount(void) const {
+		int count = 0;
+		for (int type = MoleSteering; type <= DogSteering; type++) {
+			count += (int)batches_[type].enemies.size();
+		}
+		return count;
+	}
+
+	void EnemySteering::Gather(Batch &batch, SteeringType type, double delta_time) {
+		// The arrays only grow, so steady numbers of enemies don't allocate
+		size_t count = batch.enemies.size();
+		std::vector<float> *arrays[] = { &batch.dx, &batch.dy, &batch.dz, &batch.qw, &batch.qx, &batch.qy, &batch.qz,
+			&batch.tw, &batch.tx, &batch.ty, &batch.tz, &batch.rate, &batch.step, &batch.mx, &batch.my, &batch.mz };
+		for (unsigned int i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+			if (arrays[i]->size() < count) {
+				arrays[i]->resize(count);
+			}
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			Enemy *enemy = batch.enemies[i];
+			glm::vec3 to_target = enemy->getTarget()->GetPosition() - enemy->GetEntityPosition();
+			batch.dx[i] = to_target.x;
+			batch.dy[i] = to_target.y;
+			batch.dz[i] = to_target.z;
+			glm::quat q = enemy->GetOrientation();
+			batch.qw[i] = q.w;
+			batch.qx[i] = q.x;
+			batch.qy[i] = q.y;
+			batch.qz[i] = q.z;
+			if (type == DogSteering) {
+				glm::quat t = ((Doggy *)enemy)->getTurret()->GetOrientation();
+				batch.tw[i] = t.w;
+				batch.tx[i] = t.x;
+				batch.ty[i] = t.y;
+				batch.tz[i] = t.z;
+			}
+			if (type != DogSteering) {
+				batch.rate[i] = std::max(0.0f, std::min(enemy->getRotateSpeed(), 1.0f));
+			}
+			batch.step[i] = (float)(enemy->getMovementSpeed() * delta_time);
+		}
+	}
+
+	void EnemySteering::Scatter(Batch &batch, SteeringType type) {
+		for (size_t i = 0; i < batch.enemies.size(); i++) {
+			Enemy *enemy = batch.enemies[i];
+			enemy->SetOrientation(glm::quat(batch.qw[i], batch.qx[i], batch.qy[i], batch.qz[i]));
+			if (type == CatSteering) {
+				enemy->Translate(glm::vec3(batch.mx[i], batch.my[i], batch.mz[i]));
+			}
+			else if (type == DogSteering) {
+				((Doggy *)enemy)->getTurret()->SetOrientation(glm::quat(batch.tw[i], batch.tx[i], batch.ty[i], batch.tz[i]));
+				// The dog has a dummy parent to keep the turret separate, that is what moves
+				enemy->parent_->Translate(glm::vec3(batch.mx[i], batch.my[i], batch.mz[i]));
+			}
+		}
+	}
+} // namespace game
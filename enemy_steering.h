@@ -0,0 +1,45 @@
+#ifndef ENEMY_STEERING_H_
+#define ENEMY_STEERING_H_
+#include <vector>
+#include "enemy.h"
+
+// Cats stop flying towards their target this close to it
+#define ENEMY_STEERING_CAT_RANGE 100.0f
+
+namespace game {
+	// Steers every enemy of a type at once. Enemies are gathered into one array per
+	// component, a kernel without branches or virtual calls turns and moves them all,
+	// and the results are written back to the nodes. Matches Enemy::Steer, except that
+	// slerp is approximated to about 1e-3 radians and slerp factors are clamped to [0, 1]
+	class EnemySteering {
+	public:
+		EnemySteering(void);
+
+		// Steer enemy in the next Run, enemies without a target or a steering type are skipped
+		void Add(Enemy *enemy);
+		// Steer every enemy added since the last Run
+		void Run(double delta_time);
+		// Enemies added since the last Run
+		int GetCount(void) const;
+
+	private:
+		// Enemies of one steering type and their state, one array per component
+		struct Batch {
+			std::vector<Enemy *> enemies;
+			std::vector<float> dx, dy, dz; // From the enemy to its target
+			std::vector<float> qw, qx, qy, qz; // Orientation of the enemy
+			std::vector<float> tw, tx, ty, tz; // Orientation of the turret, dogs only
+			std::vector<float> rate; // Slerp factor of this step
+			std::vector<float> step; // Distance the enemy may move this step
+			std::vector<float> mx, my, mz; // Movement of this step
+		};
+		Batch batches_[DogSteering + 1];
+
+		void Gather(Batch &batch, SteeringType type, double delta_time);
+		void Scatter(Batch &batch, SteeringType type);
+
+		EnemySteering(const EnemySteering &);
+		EnemySteering &operator=(const EnemySteering &);
+	}; // class EnemySteering
+} // namespace game
+#endif // ENEMY_STEERING_H_
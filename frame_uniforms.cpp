@@ -0,0 +1,86 @@
+#include <string.h>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/type_ptr.hpp>
+#include "frame_uniforms.h"
+#include "gpu_counters.h"
+
+// Offsets of the members of the block in std140 layout, in floats
+#define FRAME_VIEW_OFFSET 0
+#define FRAME_PROJECTION_OFFSET 16
+#define FRAME_POSITION_OFFSET 32
+#define FRAME_TIMER_OFFSET 36
+#define FRAME_LIGHT_OFFSET 37
+// Size of the block, rounded up to a vec4
+#define FRAME_UNIFORM_FLOATS 40
+
+namespace game {
+	FrameUniforms::FrameUniforms(void) {
+		buffer_ = 0;
+	}
+
+	FrameUniforms::~FrameUniforms() {
+		Clear();
+	}
+
+	void FrameUniforms::Clear(void) {
+		if (buffer_) {
+			glDeleteBuffers(1, &buffer_);
+			buffer_ = 0;
+		}
+	}
+
+	void FrameUniforms::Init(void) {
+		glGenBuffers(1, &buffer_);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+		glBufferData(GL_UNIFORM_BUFFER, FRAME_UNIFORM_FLOATS * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, buffer_);
+	}
+
+	void FrameUniforms::Upload(Camera *camera, float timer, bool sun) {
+		// The view matrix is rebuilt once here instead of for every drawn node
+		camera->SetupViewMatrix();
+		glm::mat4 view = camera->GetViewMatrix();
+		glm::mat4 projection = camera->GetProjectionMatrix();
+		glm::vec3 position = camera->GetViewPosition();
+
+		GLfloat data[FRAME_UNIFORM_FLOATS];
+		memset(data, 0, sizeof(data));
+		memcpy(&data[FRAME_VIEW_OFFSET], glm::value_ptr(view), 16 * sizeof(GLfloat));
+		memcpy(&data[FRAME_PROJECTION_OFFSET], glm::value_ptr(projection), 16 * sizeof(GLfloat));
+		data[FRAME_POSITION_OFFSET] = position.x;
+		data[FRAME_POSITION_OFFSET + 1] = position.y;
+		data[FRAME_POSITION_OFFSET + 2] = position.z;
+		data[FRAME_POSITION_OFFSET + 3] = 1.0;
+		data[FRAME_TIMER_OFFSET] = timer;
+		data[FRAME_LIGHT_OFFSET] = sun ? 0.9 : 0.0;
+
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		GpuCounters::CountStreamedUpload();
+	}
+
+	void FrameUniforms::UploadView(const glm::mat4 &view, const glm::mat4 &projection, glm::vec3 position) {
+		GLfloat data[FRAME_TIMER_OFFSET];
+		memcpy(&data[FRAME_VIEW_OFFSET], glm::value_ptr(view), 16 * sizeof(GLfloat));
+		memcpy(&data[FRAME_PROJECTION_OFFSET], glm::value_ptr(projection), 16 * sizeof(GLfloat));
+		data[FRAME_POSITION_OFFSET] = position.x;
+		data[FRAME_POSITION_OFFSET + 1] = position.y;
+		data[FRAME_POSITION_OFFSET + 2] = position.z;
+		data[FRAME_POSITION_OFFSET + 3] = 1.0;
+
+		// Timer and light keep the values of the frame
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		GpuCounters::CountStreamedUpload();
+	}
+
+	void FrameUniforms::BindProgram(GLuint program) {
+		GLuint index = glGetUniformBlockIndex(program, FRAME_UNIFORM_BLOCK);
+		if (index != GL_INVALID_INDEX) {
+			glUniformBlockBinding(program, index, FRAME_UNIFORM_BINDING);
+		}
+	}
+} // namespace game
@@ -0,0 +1,48 @@
+#ifndef FRAME_UNIFORMS_H_
+#define FRAME_UNIFORMS_H_
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+#include "camera.h"
+
+// Binding point of the per-frame uniform block, shared by every program
+#define FRAME_UNIFORM_BINDING 0
+// Name of the block in the shaders
+#define FRAME_UNIFORM_BLOCK "PerFrame"
+
+namespace game {
+	// Uniform buffer with the data that is the same for every draw of a frame.
+	// Shaders declare it as:
+	//   layout(std140) uniform PerFrame {
+	//       mat4 view_mat;
+	//       mat4 projection_mat;
+	//       vec4 camera_position;
+	//       float timer;
+	//       float light;
+	//   };
+	class FrameUniforms {
+	public:
+		FrameUniforms(void);
+		~FrameUniforms();
+
+		// Create the buffer and bind it to FRAME_UNIFORM_BINDING
+		void Init(void);
+		// Delete the buffer, call while the GL context still exists
+		void Clear(void);
+
+		// Upload the data of a new frame, seen from camera
+		void Upload(Camera *camera, float timer, bool sun);
+		// Replace only the view for the draws that follow, e.g. for an overlay with its own camera
+		void UploadView(const glm::mat4 &view, const glm::mat4 &projection, glm::vec3 position);
+
+		// Connect the block of program, if it declares one, to FRAME_UNIFORM_BINDING
+		static void BindProgram(GLuint program);
+
+	private:
+		GLuint buffer_;
+	}; // class FrameUniforms
+} // namespace game
+#endif // FRAME_UNIFORMS_H_
@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <time.h>
 #include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <chrono>
 #include "game.h"
 #include "bin/path_config.h"
 
@@ -26,10 +29,54 @@ namespace game {
 	glm::vec3 camera_look_at_g(0.0, 0.0, 0.0);
 	glm::vec3 camera_up_g(0.0, 1.0, 0.0);
 
+	// Simulation steps per second, and steps run at most per frame to catch up after a slow one
+	const double tick_rate_g = 60.0;
+	const int max_catch_up_steps_g = 5;
+	// Player movement: thrusters in units per second, turning in radians per second
+	const float move_speed_g = 60.0;
+	const float turn_speed_g = glm::pi<float>() / 2.0f;
+
+	// Particle system limits: particles alive at once, and particles in one explosion
+	const int particle_capacity_g = 131072;
+	const int particle_burst_cap_g = 4096;
+	// Projectiles alive at once
+	const int projectile_capacity_g = 131072;
+
+	// Frame telemetry written on exit, and the frame time at the top of the overlay graph
+	const char *telemetry_file_g = "telemetry.csv";
+	const float telemetry_graph_ms_g = 50.0;
+
+	// Snapshot the K key saves, and the nodes and projectiles of the snapshot benchmark
+	const char *snapshot_file_g = "snapshot.hsnp";
+	const char *snapshot_bench_file_g = "snapshot_bench.hsnp";
+	const int snapshot_bench_nodes_g = 10000;
+	const int snapshot_bench_projectiles_g = 10000;
+
+	// Meshes loaded from the mesh directory
+	struct MeshAsset {
+		const char *name;
+		const char *file;
+		bool level; // Part of the level resources, released when the level changes
+	};
+	const MeshAsset mesh_assets_g[] = {
+		{ "BunnyBodMesh", "/mesh/bunny_body.obj", false },
+		{ "CarrotMesh", "/mesh/carrotMesh.obj", false },
+		{ "BunnyEarMesh", "/mesh/bunny_ears.obj", false },
+		{ "CatMesh", "/mesh/catMesh.obj", true },
+		{ "FireworkMesh", "/mesh/fireworkMesh.obj", true },
+		{ "FurrBallMesh", "/mesh/furrBallMesh.obj", true },
+		{ "GunMesh", "/mesh/gunMesh.obj", true },
+		{ "MoleMesh", "/mesh/moleMesh.obj", true },
+		{ "PropellerMesh", "/mesh/propMesh.obj", true },
+		{ "DogMesh", "/mesh/pupperMesh.obj", true },
+		{ "TennisBallMesh", "/mesh/tennisBallMesh.obj", true }
+	};
+	const int num_mesh_assets_g = sizeof(mesh_assets_g) / sizeof(mesh_assets_g[0]);
+
 	// Materials 
 	const std::string material_directory_g = MATERIAL_DIRECTORY;
 
-	Game::Game(void) {
+	Game::Game(void) : level_resources_(&resman_), tick_rate_(tick_rate_g), max_catch_up_steps_(max_catch_up_steps_g) {
 		// Don't do work in the constructor, leave it for the Init() function
 	}
 
@@ -42,6 +89,7 @@ namespace game {
 		// Set variables
 		player_vel = glm::vec3(0, 0, 0);
 		animating_ = true;
+		cat_projectile_ = dog_projectile_ = player_projectile_ = -1;
 		game_state = TITLE; //start on title screen
 		hp = 100.0;
 		sun = true; //the sun rises
@@ -55,8 +103,11 @@ namespace game {
 			throw(GameException(std::string("Could not initialize the GLFW library")));
 		}
 
-		// Create a window and its OpenGL context
-		if (window_full_screen_g) {
+		// Create a window and its OpenGL context, replays only need the context
+		if (headless_) {
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		}
+		if (window_full_screen_g && !headless_) {
 			window_ = glfwCreateWindow(window_width_g, window_height_g, window_title_g.c_str(), glfwGetPrimaryMonitor(), NULL);
 		}
 		else {
@@ -108,115 +159,153 @@ namespace game {
 	}
 
 	void Game::SetupResources(void) {
+		double start_time = glfwGetTime();
+
+		// Per-frame uniform block, programs are connected to it as they are loaded
+		frame_uniforms_.Init();
+
 		// Create our meshes
 		resman_.CreateSphere("SimpleSphereMesh", 1.0, 10, 10);
 		resman_.CreateCube("CubePointSet"); //set up cube for the laser
 		resman_.CreateTorus("TorusMesh");
 		resman_.CreateCylinder("CylinderMesh");
-		resman_.CreateGround("Terrain"); // load terrain
 
-		// Load non textured materials
-		std::string filename = std::string(MATERIAL_DIRECTORY) + std::string("/material");
-		resman_.LoadResource(Material, "ObjectMaterial", filename.c_str());
+		// Textures stream in while the game runs, placeholders stand in for them until then
+		texture_streamer_.Init(&resman_);
+
+		// Everything else read from files is decoded on worker threads and uploaded here
+		AssetLoader loader(&resman_);
+
+		// Resources of the level, loaded and released as a unit: the terrain (the slowest to
+		// build, so it starts first), the enemies and their texture array
+		level_resources_.AddGround("Terrain");
+		for (int i = 0; i < num_mesh_assets_g; i++) {
+			if (mesh_assets_g[i].level) {
+				level_resources_.Add(Mesh, mesh_assets_g[i].name, std::string(MATERIAL_DIRECTORY) + std::string(mesh_assets_g[i].file));
+			}
+		}
+		// Enemies and projectiles are packed into one texture array, so drawing them never switches textures
+		level_resources_.Add(TextureArray, "EnemyTextures", std::string(MATERIAL_DIRECTORY) + std::string("/texture/enemies.array"));
+		level_resources_.Queue(loader);
 
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/dark");
-		resman_.LoadResource(Material, "DarkMaterial", filename.c_str());
+		// Load Meshes
+		for (int i = 0; i < num_mesh_assets_g; i++) {
+			if (!mesh_assets_g[i].level) {
+				loader.Queue(Mesh, mesh_assets_g[i].name, std::string(MATERIAL_DIRECTORY) + std::string(mesh_assets_g[i].file));
+			}
+		}
+
+		// Load non textured materials
+		loader.Queue(Material, "ObjectMaterial", std::string(MATERIAL_DIRECTORY) + std::string("/material"));
+		loader.Queue(Material, "DarkMaterial", std::string(MATERIAL_DIRECTORY) + std::string("/dark"));
 
 		//load texture materials
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/shiny_texture");
-		resman_.LoadResource(Material, "ShinyTextureMaterial", filename.c_str());
+		loader.Queue(Material, "ShinyTextureMaterial", std::string(MATERIAL_DIRECTORY) + std::string("/shiny_texture"));
+		loader.Queue(Material, "ShinyTextureArrayMaterial", std::string(MATERIAL_DIRECTORY) + std::string("/shiny_texture_array"));
+		// Every projectile of a type is drawn with one instanced call
+		loader.Queue(Material, "ProjectileMaterial", std::string(MATERIAL_DIRECTORY) + std::string("/projectile"));
+
+		texture_streamer_.Request("GameTitle", std::string(MATERIAL_DIRECTORY) + std::string("/gametitle.jpg"));
 
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/gametitle.jpg");
-		resman_.LoadResource(Texture, "GameTitle", filename.c_str());
-		
 		// load textures for models
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/bunBodTex.png");
-		resman_.LoadResource(Texture, "BunnyBodTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/bunEarTex.png");
-		resman_.LoadResource(Texture, "BunnyEarTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/catTex.png");
-		resman_.LoadResource(Texture, "CatTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/pupperTex.png");
-		resman_.LoadResource(Texture, "DogTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/fireworkTex.png");
-		resman_.LoadResource(Texture, "FireworkTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/furrTex.png");
-		resman_.LoadResource(Texture, "FurrBallTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/gunTex.png");
-		resman_.LoadResource(Texture, "GunTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/moleTex.png");
-		resman_.LoadResource(Texture, "MoleTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/propTex.png");
-		resman_.LoadResource(Texture, "PropellerTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/tennisTex.png");
-		resman_.LoadResource(Texture, "TennisBallTex", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/texture/carrotTex.png");
-		resman_.LoadResource(Texture, "CarrotTex", filename.c_str());
-		
-		// Load Meshes
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/bunny_body.obj");
-		resman_.LoadResource(Mesh, "BunnyBodMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/carrotMesh.obj");
-		resman_.LoadResource(Mesh, "CarrotMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/bunny_ears.obj");
-		resman_.LoadResource(Mesh, "BunnyEarMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/catMesh.obj");
-		resman_.LoadResource(Mesh, "CatMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/fireworkMesh.obj");
-		resman_.LoadResource(Mesh, "FireworkMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/furrBallMesh.obj");
-		resman_.LoadResource(Mesh, "FurrBallMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/gunMesh.obj");
-		resman_.LoadResource(Mesh, "GunMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/moleMesh.obj");
-		resman_.LoadResource(Mesh, "MoleMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/propMesh.obj");
-		resman_.LoadResource(Mesh, "PropellerMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/pupperMesh.obj");
-		resman_.LoadResource(Mesh, "DogMesh", filename.c_str());
-		
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/mesh/tennisBallMesh.obj");
-		resman_.LoadResource(Mesh, "TennisBallMesh", filename.c_str());
+		texture_streamer_.Request("BunnyBodTex", std::string(MATERIAL_DIRECTORY) + std::string("/texture/bunBodTex.png"));
+		texture_streamer_.Request("BunnyEarTex", std::string(MATERIAL_DIRECTORY) + std::string("/texture/bunEarTex.png"));
+		texture_streamer_.Request("CarrotTex", std::string(MATERIAL_DIRECTORY) + std::string("/texture/carrotTex.png"));
 
 		//screen space effect
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/screen_hp");
-		resman_.LoadResource(Material, "BlueMaterial", filename.c_str());
+		loader.Queue(Material, "BlueMaterial", std::string(MATERIAL_DIRECTORY) + std::string("/screen_hp"));
+
+		// Particle system shared by the firework weapon and tracers: a point sprite program
+		// to draw them, and the texture applied to particles
+		loader.Queue(Material, "ParticleSystemMaterial", std::string(MATERIAL_DIRECTORY) + std::string("/particle_system"));
+		texture_streamer_.Request("Firework", std::string(MATERIAL_DIRECTORY) + std::string("/firework.png"));
+
+		// Mesh buffers share one staging buffer, copied to the GPU once everything is decoded
+		resman_.BeginUploadBatch();
+		loader.Run();
+		resman_.EndUploadBatch();
+		level_resources_.Acquire();
+
+		// Transform feedback program to advance the particles
+		std::string filename = std::string(MATERIAL_DIRECTORY) + std::string("/particle_update");
+		const char *particle_varyings[] = { "out_position", "out_velocity", "out_color", "out_age", "out_life" };
+		resman_.LoadTransformFeedbackMaterial("ParticleUpdateMaterial", filename.c_str(), particle_varyings, 5);
 
-		//particle effect material for bomb
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/particle");
-		resman_.LoadResource(Material, "ParticleMaterial", filename.c_str());
-		//material for tracer
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/line");
-		resman_.LoadResource(Material, "LineMaterial", filename.c_str());
+		// Render target for the first person view, as large as the window
+		int width, height;
+		glfwGetFramebufferSize(window_, &width, &height);
+		scene_.SetupDrawToTexture(width, height);
+		gpu_profiler_.Init();
+		telemetry_.Init(&gpu_profiler_);
+		scene_.SetGpuProfiler(&gpu_profiler_);
+
+		ResolveHandles();
+
+		// Startup cost, the first start also builds the binary meshes
+		loader.PrintTimings(std::cout);
+		const std::vector<AssetLoadTime> &load_times = resman_.GetLoadTimes();
+		for (unsigned int i = 0; i < load_times.size(); i++) {
+			std::cout << "  " << load_times[i].name << ": " << load_times[i].milliseconds << " ms" << std::endl;
+		}
+		// Programs from the program cache skip compiling and linking, delete the *.progbin files to compile them again
+		const std::vector<ProgramLoadTime> &program_times = resman_.GetProgramTimes();
+		int cached_programs = 0;
+		for (unsigned int i = 0; i < program_times.size(); i++) {
+			std::cout << "  " << program_times[i].name << ": " << (program_times[i].cached ? "cached program " : "compiled ")
+				<< program_times[i].milliseconds << " ms" << std::endl;
+			cached_programs += program_times[i].cached ? 1 : 0;
+		}
+		std::cout << "Resources loaded in " << (glfwGetTime() - start_time) * 1000.0 << " ms ("
+			<< resman_.GetMeshCacheHits() << " binary meshes, " << resman_.GetMeshCacheMisses() << " parsed, "
+			<< cached_programs << " cached programs, " << program_times.size() - cached_programs << " compiled)" << std::endl;
+		resman_.PrintMemory(std::cout);
+	}
 
-		// Create particles for firework weapon and tracer
-		resman_.CreateSphereParticles("SphereParticles");
-		resman_.CreateLineParticles("LineParticles");
+	// Resolve a handle, the game can't run without its resource
+	template <typename Handle>
+	static Handle require_handle(Handle handle, const std::string &name) {
+		if (!handle.IsValid()) {
+			throw(GameException(std::string("Could not find resource \"") + name + std::string("\"")));
+		}
+		return handle;
+	}
 
-		// Load texture to be applied to particles
-		filename = std::string(MATERIAL_DIRECTORY) + std::string("/firework.png");
-		resman_.LoadResource(Texture, "Firework", filename.c_str());
+	// Layer of a texture array, the game can't run without it either
+	static int require_layer(int layer, const std::string &name) {
+		if (layer < 0) {
+			throw(GameException(std::string("Could not find texture layer \"") + name + std::string("\"")));
+		}
+		return layer;
+	}
 
-		scene_.SetupDrawToTexture();
+	void Game::ResolveHandles(void) {
+		handles_.cube = require_handle(resman_.GetMeshHandle("CubePointSet"), "CubePointSet");
+		handles_.sphere = require_handle(resman_.GetMeshHandle("SimpleSphereMesh"), "SimpleSphereMesh");
+		handles_.cylinder = require_handle(resman_.GetMeshHandle("CylinderMesh"), "CylinderMesh");
+		handles_.firework_mesh = require_handle(resman_.GetMeshHandle("FireworkMesh"), "FireworkMesh");
+		handles_.mole_mesh = require_handle(resman_.GetMeshHandle("MoleMesh"), "MoleMesh");
+		handles_.gun_mesh = require_handle(resman_.GetMeshHandle("GunMesh"), "GunMesh");
+		handles_.dog_mesh = require_handle(resman_.GetMeshHandle("DogMesh"), "DogMesh");
+		handles_.tennis_ball_mesh = require_handle(resman_.GetMeshHandle("TennisBallMesh"), "TennisBallMesh");
+		handles_.cat_mesh = require_handle(resman_.GetMeshHandle("CatMesh"), "CatMesh");
+		handles_.furr_ball_mesh = require_handle(resman_.GetMeshHandle("FurrBallMesh"), "FurrBallMesh");
+		handles_.propeller_mesh = require_handle(resman_.GetMeshHandle("PropellerMesh"), "PropellerMesh");
+
+		handles_.object_material = require_handle(resman_.GetMaterialHandle("ObjectMaterial"), "ObjectMaterial");
+		handles_.shiny_texture_material = require_handle(resman_.GetMaterialHandle("ShinyTextureMaterial"), "ShinyTextureMaterial");
+		handles_.shiny_texture_array_material = require_handle(resman_.GetMaterialHandle("ShinyTextureArrayMaterial"), "ShinyTextureArrayMaterial");
+		handles_.blue_material = require_handle(resman_.GetMaterialHandle("BlueMaterial"), "BlueMaterial");
+
+		handles_.game_title = require_handle(resman_.GetTextureHandle("GameTitle"), "GameTitle");
+		handles_.enemy_textures = require_handle(resman_.GetTextureArrayHandle("EnemyTextures"), "EnemyTextures");
+		handles_.firework_layer = require_layer(resman_.GetTextureLayer("FireworkTex"), "FireworkTex");
+		handles_.mole_layer = require_layer(resman_.GetTextureLayer("MoleTex"), "MoleTex");
+		handles_.gun_layer = require_layer(resman_.GetTextureLayer("GunTex"), "GunTex");
+		handles_.dog_layer = require_layer(resman_.GetTextureLayer("DogTex"), "DogTex");
+		handles_.tennis_ball_layer = require_layer(resman_.GetTextureLayer("TennisBallTex"), "TennisBallTex");
+		handles_.cat_layer = require_layer(resman_.GetTextureLayer("CatTex"), "CatTex");
+		handles_.furr_ball_layer = require_layer(resman_.GetTextureLayer("FurrBallTex"), "FurrBallTex");
+		handles_.propeller_layer = require_layer(resman_.GetTextureLayer("PropellerTex"), "PropellerTex");
 	}
 
 	void Game::SetupScene(void) {
@@ -224,6 +313,14 @@ namespace game {
 		scene_.world_tr_corner = glm::vec3(700, 200, 700);
 
 		scene_.SetResourceManager(&resman_);
+		scene_.SetupParticles(particle_capacity_g, particle_burst_cap_g);
+		scene_.SetupProjectiles(projectile_capacity_g);
+
+		// Cats and dogs throw balls from the enemy texture array, the player fires untextured cubes
+		ProjectileSystem *projectiles = scene_.GetProjectiles();
+		cat_projectile_ = projectiles->AddType(resman_.GetResource(handles_.furr_ball_mesh), glm::vec3(0.3, 0.3, 0.3), handles_.furr_ball_layer);
+		dog_projectile_ = projectiles->AddType(resman_.GetResource(handles_.tennis_ball_mesh), glm::vec3(0.3, 0.3, 0.3), handles_.tennis_ball_layer);
+		player_projectile_ = projectiles->AddType(resman_.GetResource(handles_.cube), glm::vec3(0.5, 0.5, 2), -1);
 
 		// Set background color for the scene
 		scene_.SetBackgroundColor(viewport_background_color_g);
@@ -246,7 +343,7 @@ namespace game {
 			throw(GameException(std::string("Could not find resource \"") + "DarkMaterial" + std::string("\"")));
 		}
 
-		SceneNode* ground = new SceneNode("Ground", geom, dark);
+		Terrain* ground = new Terrain("Ground", geom, dark);
 		scene_.SetRoot(ground);
 		ground->SetPosition(glm::vec3(0, -100, 200));
 
@@ -263,24 +360,17 @@ namespace game {
 		target->SetPosition(190, 30.5, 200);
 		target->SetScale(1, 1, 1);
 		ground->AddChild(target);
-
-		scene_.root_->AddChild(SpawnCat());
-		scene_.root_->AddChild(SpawnMole());
-		scene_.root_->AddChild(SpawnDog());
-
-		for (int i = 0; i < 3; i++)
-		{
-			float v = (double)rand() / (double)RAND_MAX;
-			if (v > 0.6) { 
-				scene_.root_->AddChild(SpawnMole());
-			}
-			else if (v > 0.3) {
-				scene_.root_->AddChild(SpawnCat());
-			}
-			else {
-				scene_.root_->AddChild(SpawnDog());
-			}
-		}
+		target_ = target;
+		// Enemies far from the player sleep until it comes closer
+		scene_.SetActivationTarget(target);
+
+		// The first enemies arrive over the first steps, like every wave after them
+		spawn_director_.Init(ground, this);
+		spawn_director_.SetBounds(scene_.world_bl_corner, scene_.world_tr_corner);
+		spawn_director_.Queue(CatSpawn, 1);
+		spawn_director_.Queue(MoleSpawn, 1);
+		spawn_director_.Queue(DogSpawn, 1);
+		spawn_director_.QueueRandom(3);
 
 		SceneNode* ground_bound = new SceneNode("Ground_Box", cube, NULL);
 		ground_bound->setCollidable(true);
@@ -305,83 +395,274 @@ namespace game {
 		ground->AddChild(test_sun);
 
 		//draw our title screen text on a square (cause i have no idea how to draw text on the screen)
-		title = Cube(UI, "TitleScreen", "CubePointSet", "ShinyTextureMaterial", glm::vec3(0.0, 0.0, 0.0), 0.0, "GameTitle");
+		title = Cube(UI, "TitleScreen", handles_.cube, handles_.shiny_texture_material, glm::vec3(0.0, 0.0, 0.0), 0.0, handles_.game_title);
 		title->SetPosition(0, 0, 765);
 		title->Scale(17.3, 13.0, 0.01);
 	}
 
 	void Game::MainLoop(void) {
 		temp = true;
+		// Uploads made while loading don't count against the first frame
+		GpuCounters::Reset();
+		// Resources are reached through handles from now on
+		resman_.SetFrameLoop(true);
+		// Simulation time not yet run as steps
+		double last_time = glfwGetTime();
+		double accumulator = 0.0;
 		// Loop while the user did not close the window
 		while (!glfwWindowShouldClose(window_)) {
+			double current_time = glfwGetTime();
+			double frame_time = current_time - last_time;
+			last_time = current_time;
+			telemetry_.BeginFrame();
+
+			// Mips decoded since the last frame, and room made for them
+			telemetry_.BeginPhase(StreamPhase);
+			texture_streamer_.Update();
+			telemetry_.EndPhase(StreamPhase);
+			static bool textures_reported = false;
+			if (!textures_reported && texture_streamer_.GetPending() == 0) {
+				std::cout << "Textures streamed in: " << texture_streamer_.GetResidentBytes() / (1024 * 1024) << " MB of "
+					<< texture_streamer_.GetBudget() / (1024 * 1024) << " MB budget, "
+					<< texture_streamer_.GetCpuBytes() / (1024 * 1024) << " MB of decoded mips in memory" << std::endl;
+				textures_reported = true;
+			}
+
 			if (game_state == TITLE) { //on title screen we do nothing but display the UI
+				frame_uniforms_.Upload(&camera_, (float)glfwGetTime(), true);
 				glClearColor(0.3, 0.1, 0.2, 0.0);
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 				title->Draw(&camera_, glm::mat4(1.0), true);
 			}
 			else if (game_state == GAME) { //gameplay screen updates and draws the scene
 				if (animating_) {
-					static double last_time = 0;
-					double current_time = glfwGetTime();
-					double deltaTime = current_time - last_time;
-					//time_since_spawn += deltaTime;
-
-					if (deltaTime > 0.01) {
-						scene_.Update(deltaTime);
-						camera_.Update(); //update our camera to keep momentum going with thrusters
-
-						heli_.Update(deltaTime);
-						last_time = current_time;
-
-						//handle turning here
-						float rot_factor(1.5 * glm::pi<float>() / 180);
-						if (turning == LEFT) {
-							camera_.Yaw(rot_factor);
-						}
-						else if (turning == RIGHT) {
-							camera_.Yaw(-rot_factor);
-						}
-						else if (turning == UP) {
-							camera_.Pitch(rot_factor);
-						}
-						else if (turning == DOWN) {
-							camera_.Pitch(-rot_factor);
-						}
-
-						if (time_since_spawn > 20) {
-							if (rand() > RAND_MAX / 2) {
-								scene_.root_->AddChild(SpawnMole());
-							}
-							else {
-								scene_.root_->AddChild(SpawnDog());
-							}
-
-							time_since_spawn = 0;
-						}
-
-						SceneNode* targ = scene_.GetNode("Target");
-						if (temp && targ != NULL) {
-							targ->SetPosition(camera_.GetPosition() - scene_.GetNode("Ground")->GetPosition() - camera_.GetForward());
-						}
+					telemetry_.BeginPhase(UpdatePhase);
+					// Run as many fixed steps as the time since the last frame holds, and draw
+					// between the last two of them so motion stays smooth whatever the frame rate
+					double step = 1.0 / tick_rate_;
+					accumulator += frame_time;
+					int steps = 0;
+					while (accumulator >= step && steps < max_catch_up_steps_) {
+						Tick(step);
+						accumulator -= step;
+						steps++;
 					}
+					// Give up on the time we could not catch up with rather than fall further behind
+					if (accumulator >= step) {
+						accumulator = fmod(accumulator, step);
+					}
+					float alpha = (float)(accumulator / step);
+					SceneNode::SetInterpolation(alpha);
+					camera_.SetInterpolation(alpha);
+					telemetry_.EndPhase(UpdatePhase);
 				} //end if animating_
 
 				// Draw the scene
+				telemetry_.BeginPhase(DrawPhase);
 				if (tpCam) { //third person
+					frame_uniforms_.Upload(&camera_, (float)glfwGetTime(), true);
+					gpu_profiler_.Begin(ScenePass);
 					scene_.Draw(&camera_);
-					heli_.DrawHelicopter(prgm, &camera_); //helicopter is just drawn as UI for now
+					gpu_profiler_.End(ScenePass);
+					gpu_profiler_.Begin(HelicopterPass);
+					heli_.DrawHelicopter(prgm, &frame_uniforms_); //helicopter is just drawn as UI for now
+					gpu_profiler_.End(HelicopterPass);
 				}
 				else { //first person
+					frame_uniforms_.Upload(&camera_, (float)glfwGetTime(), sun);
+					gpu_profiler_.Begin(SceneTexturePass);
 					scene_.DrawToTexture(&camera_, sun);
-					scene_.DisplayTexture(resman_.GetResource("BlueMaterial")->GetResource(), hp);
+					gpu_profiler_.End(SceneTexturePass);
+					// The red line is the frame time the dynamic resolution aims for
+					telemetry_.GetGraph(telemetry_graph_, telemetry_graph_ms_g);
+					scene_.SetOverlayGraph(telemetry_graph_, 1000.0f / dynamic_resolution_.GetTargetFps() / telemetry_graph_ms_g);
+					gpu_profiler_.Begin(DisplayTexturePass);
+					scene_.DisplayTexture(resman_.GetResource(handles_.blue_material)->GetResource(), hp);
+					gpu_profiler_.End(DisplayTexturePass);
+					scene_.SetRenderScale(dynamic_resolution_.GetScale());
 				}
-				scene_.CheckCollisions();
+				telemetry_.EndPhase(DrawPhase);
 			} //end of GAME gamestate
+			telemetry_.BeginPhase(PresentPhase);
 			glfwSwapBuffers(window_); // Push buffer drawn in the background onto the display
 			glfwPollEvents(); // Update other events like input handling
+
+			// Free unloaded resources once the last node drawing them is gone
+			resman_.Collect();
+			telemetry_.EndPhase(PresentPhase);
+
+			// Drawing a loaded scene should not upload anything, the telemetry records frames that do
+			GpuCounters::EndFrame();
+			telemetry_.EndFrame();
+
+			// Frames drawn at the render scale, measured a few frames ago
+			if (gpu_profiler_.HasNewResults() && gpu_profiler_.GetRuns(SceneTexturePass) > 0) {
+				dynamic_resolution_.AddFrameTime(gpu_profiler_.GetTime(SceneTexturePass) + gpu_profiler_.GetTime(DisplayTexturePass));
+			}
+
+			// A profiling run draws half its frames in each view, the key is pressed like any other so a
+			// recording of the run switches too
+			if (frame_limit_ > 0) {
+				if (telemetry_.GetFrameCount() == frame_limit_ / 2) {
+					KeyEvent event = { GLFW_KEY_TAB, GLFW_PRESS, 0 };
+					pending_keys_.push_back(event);
+				}
+				if (telemetry_.GetFrameCount() >= frame_limit_) {
+					glfwSetWindowShouldClose(window_, true);
+				}
+			}
+		}
+		resman_.SetFrameLoop(false);
+		input_log_.Close(StateChecksum());
+		try {
+			telemetry_.WriteCsv(telemetry_file_g);
+			std::cout << "Telemetry of the last " << std::min(telemetry_.GetFrameCount(), (long)TELEMETRY_FRAMES)
+				<< " frames written to " << telemetry_file_g << std::endl;
+		}
+		catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
 		}
 	}
 
+	void Game::Profile(int frames) {
+		if (frames < 2) {
+			throw(std::invalid_argument(std::string("Invalid number of frames to profile")));
+		}
+		game_state = GAME;
+		frame_limit_ = frames;
+		telemetry_.SetOverlay(true);
+		MainLoop();
+		if (!gpu_profiler_.IsSupported()) {
+			std::cout << "No timer queries, GPU passes not measured" << std::endl;
+		}
+		telemetry_.Report(std::cout);
+	}
+
+	void Game::Record(const std::string &filename, unsigned int seed) {
+		input_log_.Record(filename, seed, 1.0 / tick_rate_);
+	}
+
+	void Game::LoadReplay(const std::string &filename) {
+		input_log_.Load(filename);
+		srand(input_log_.GetSeed());
+		tick_rate_ = 1.0 / input_log_.GetDeltaTime();
+		headless_ = true;
+	}
+
+	void Game::Replay(void) {
+		temp = true;
+		game_state = GAME;
+		resman_.SetFrameLoop(true);
+		unsigned int ticks = input_log_.GetTicks();
+		double step = input_log_.GetDeltaTime();
+		std::vector<double> times(ticks);
+		double start_time = glfwGetTime();
+		for (unsigned int t = 0; t < ticks; t++) {
+			input_log_.GetTick(t, pending_keys_);
+			double start = glfwGetTime();
+			Tick(step);
+			times[t] = (glfwGetTime() - start) * 1000.0;
+			// Nothing is drawn, but removed nodes still let go of their resources
+			resman_.Collect();
+		}
+		double total = (glfwGetTime() - start_time) * 1000.0;
+		resman_.SetFrameLoop(false);
+
+		std::sort(times.begin(), times.end());
+		std::cout << "Replayed " << ticks << " steps in " << total << " ms";
+		if (ticks > 0) {
+			double sum = 0.0;
+			for (unsigned int t = 0; t < ticks; t++) {
+				sum += times[t];
+			}
+			std::cout << ": " << sum / ticks << " ms per step on average, median " << times[ticks / 2]
+				<< " ms, 99th percentile " << times[std::min(ticks - 1, ticks * 99 / 100)] << " ms, slowest " << times[ticks - 1] << " ms";
+		}
+		std::cout << std::endl;
+
+		// A recording cut short has no checksum
+		unsigned long long checksum = StateChecksum();
+		if (input_log_.GetChecksum() != 0) {
+			std::cout << "Final state " << (checksum == input_log_.GetChecksum() ? "matches" : "differs from") << " the recording" << std::endl;
+		}
+	}
+
+	unsigned long long Game::StateChecksum(void) {
+		// FNV-1a over the bits of every node's position, orientation and health
+		unsigned long long hash = 14695981039346656037ULL;
+		std::vector<float> values;
+		glm::vec3 camera = camera_.GetPosition();
+		values.push_back(camera.x);
+		values.push_back(camera.y);
+		values.push_back(camera.z);
+		values.push_back(hp);
+		std::vector<SceneNode *> stck(1, scene_.root_);
+		while (!stck.empty()) {
+			SceneNode *current = stck.back();
+			stck.pop_back();
+			glm::vec3 p = current->GetPosition();
+			glm::quat q = current->GetOrientation();
+			float node_values[] = { p.x, p.y, p.z, q.w, q.x, q.y, q.z, current->GetHealth() };
+			values.insert(values.end(), node_values, node_values + 8);
+			stck.insert(stck.end(), current->children_.begin(), current->children_.end());
+		}
+		const unsigned char *bytes = (const unsigned char *)values.data();
+		for (size_t i = 0; i < values.size() * sizeof(float); i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	void Game::Tick(double delta_time) {
+		// Keys first, so a step sees the same keys live and replayed
+		if (input_log_.IsRecording()) {
+			input_log_.RecordTick(pending_keys_);
+		}
+		for (unsigned int i = 0; i < pending_keys_.size(); i++) {
+			ApplyKey(this, pending_keys_[i].key, pending_keys_[i].action, pending_keys_[i].mods);
+		}
+		pending_keys_.clear();
+
+		camera_.StoreState();
+		spawn_director_.Update(delta_time);
+		scene_.Update(delta_time);
+		camera_.Update(delta_time); //update our camera to keep momentum going with thrusters
+		heli_.Update(delta_time);
+
+		//handle turning here
+		float rot_factor = turn_speed_g * delta_time;
+		if (turning == LEFT) {
+			camera_.Yaw(rot_factor);
+		}
+		else if (turning == RIGHT) {
+			camera_.Yaw(-rot_factor);
+		}
+		else if (turning == UP) {
+			camera_.Pitch(rot_factor);
+		}
+		else if (turning == DOWN) {
+			camera_.Pitch(-rot_factor);
+		}
+
+		if (temp && target_ != NULL) {
+			target_->SetPosition(camera_.GetPosition() - scene_.GetNode("Ground")->GetPosition() - camera_.GetForward());
+		}
+
+		scene_.CheckCollisions();
+	}
+
+	void Game::SetTickRate(double rate, int max_catch_up_steps) {
+		if (rate <= 0.0 || max_catch_up_steps < 1) {
+			throw(std::invalid_argument(std::string("Invalid tick rate")));
+		}
+		tick_rate_ = rate;
+		max_catch_up_steps_ = max_catch_up_steps;
+	}
+
+	void Game::SetTextureBudget(int megabytes) {
+		texture_streamer_.SetBudget((size_t)megabytes * 1024 * 1024);
+	}
+
 	void Game::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 		// Get user data with a pointer to the game class
 		void* ptr = glfwGetWindowUserPointer(window);
@@ -392,214 +673,562 @@ namespace game {
 				game->game_state = GAME;
 			}
 		}
-		else if (game->game_state == GAME) { //keybinds for gameplay
-			float trans_factor = 1.0;
-			if (key == GLFW_KEY_KP_9 && action == GLFW_PRESS) {
-				Enemy* enemy = ((Enemy*)(game->scene_.GetNode("Enemy0")));
+		else if (game->game_state == GAME) { //keybinds for gameplay, applied on the next step so a recording can too
+			KeyEvent event = { key, action, mods };
+			game->pending_keys_.push_back(event);
+		}
+	}
+
+	void Game::ApplyKey(Game *game, int key, int action, int) {
+		GLFWwindow *window = game->window_;
+		float trans_factor = move_speed_g;
+		// The spawn director deletes enemies the scene removed, the key does nothing once the first one is gone
+		if (key == GLFW_KEY_KP_9 && action == GLFW_PRESS) {
+			Enemy* enemy = dynamic_cast<Enemy*>(game->scene_.GetNode("Enemy0_body"));
+			if (enemy) {
 				enemy->setRotateSpeed(std::max(0.0f, std::min(enemy->getRotateSpeed() + 0.1f, 1.0f)));
-				std::cout << enemy->getRotateSpeed() << std::endl;
 			}
-			if (key == GLFW_KEY_KP_7 && action == GLFW_PRESS) {
-				Enemy* enemy = ((Enemy*)(game->scene_.GetNode("Enemy0")));
+		}
+		if (key == GLFW_KEY_KP_7 && action == GLFW_PRESS) {
+			Enemy* enemy = dynamic_cast<Enemy*>(game->scene_.GetNode("Enemy0_body"));
+			if (enemy) {
 				enemy->setRotateSpeed(std::max(0.0f, std::min(enemy->getRotateSpeed() - 0.1f, 1.0f)));
-				std::cout << enemy->getRotateSpeed() << std::endl;
-			}
-			if (key == GLFW_KEY_KP_1 && action == GLFW_PRESS) {
-				game->scene_.GetNode("Target")->Translate(0, 0.1, 0);
-				vel = glm::vec3(0, 1, 0);
-			}
-			if (key == GLFW_KEY_KP_3 && action == GLFW_PRESS) {
-				game->scene_.GetNode("Target")->Translate(0, -1, 0);
-				vel = glm::vec3(0, -1, 0);
-			}
-			if (key == GLFW_KEY_KP_6 && action == GLFW_PRESS) {
-				game->scene_.GetNode("Target")->Translate(1, 0, 0);
-				vel = glm::vec3(1, 0, 0);
-			}
-			if (key == GLFW_KEY_KP_4 && action == GLFW_PRESS) {
-				game->scene_.GetNode("Target")->Translate(-1, 0, 0);
-				vel = glm::vec3(-1, 0, 0);
-			}
-			if (key == GLFW_KEY_KP_8 && action == GLFW_PRESS) {
-				game->scene_.GetNode("Target")->Translate(0, 0, -1);
-				vel = glm::vec3(0, 0, -1);
-			}
-			if (key == GLFW_KEY_KP_2 && action == GLFW_PRESS) {
-				game->scene_.GetNode("Target")->Translate(0, 0, 1);
-				vel = glm::vec3(0, 0, 1);
-			}
-			if (key == GLFW_KEY_KP_5 && action == GLFW_PRESS) {
-				//game->animating_ = !game->animating_;
-			}
-			if (key == GLFW_KEY_T && action == GLFW_PRESS) {
-				glm::vec3 forward = game->camera_.GetForward();
-				glm::vec3 origin = game->camera_.GetPosition();
-
-				Resource *cube = game->resman_.GetResource("CubePointSet");
-				Resource *mat = game->resman_.GetResource("ObjectMaterial");
-				if (!mat) {
-					throw(GameException(std::string("Could not find resource \"") + "ObjectMaterial" + std::string("\"")));
-				}
-
-				Projectile* p = new Projectile("Player", game->camera_.GetPosition() - game->scene_.GetNode("Ground")->GetAbsolutePosition() + game->camera_.GetUp()*-1.0f, forward*5.0f, glm::vec3(0, -0.05, 0), 5, cube, mat);
-				p->SetScale(0.5, 0.5, 2);
-				game->scene_.AddProjectile(p);
 			}
+		}
+		if (key == GLFW_KEY_KP_1 && action == GLFW_PRESS) {
+			game->scene_.GetNode("Target")->Translate(0, 0.1, 0);
+			vel = glm::vec3(0, 1, 0);
+		}
+		if (key == GLFW_KEY_KP_3 && action == GLFW_PRESS) {
+			game->scene_.GetNode("Target")->Translate(0, -1, 0);
+			vel = glm::vec3(0, -1, 0);
+		}
+		if (key == GLFW_KEY_KP_6 && action == GLFW_PRESS) {
+			game->scene_.GetNode("Target")->Translate(1, 0, 0);
+			vel = glm::vec3(1, 0, 0);
+		}
+		if (key == GLFW_KEY_KP_4 && action == GLFW_PRESS) {
+			game->scene_.GetNode("Target")->Translate(-1, 0, 0);
+			vel = glm::vec3(-1, 0, 0);
+		}
+		if (key == GLFW_KEY_KP_8 && action == GLFW_PRESS) {
+			game->scene_.GetNode("Target")->Translate(0, 0, -1);
+			vel = glm::vec3(0, 0, -1);
+		}
+		if (key == GLFW_KEY_KP_2 && action == GLFW_PRESS) {
+			game->scene_.GetNode("Target")->Translate(0, 0, 1);
+			vel = glm::vec3(0, 0, 1);
+		}
+		if (key == GLFW_KEY_KP_5 && action == GLFW_PRESS) {
+			//game->animating_ = !game->animating_;
+		}
+		if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+			glm::vec3 forward = game->camera_.GetForward();
+			glm::vec3 origin = game->camera_.GetPosition();
+
+			ProjectileShot shot;
+			shot.position = game->camera_.GetPosition() - game->scene_.GetNode("Ground")->GetAbsolutePosition() + game->camera_.GetUp()*-1.0f;
+			shot.velocity = forward*5.0f;
+			shot.acceleration = glm::vec3(0, -0.05, 0);
+			shot.damage = 5;
+			shot.type = game->player_projectile_;
+			game->scene_.GetProjectiles()->Spawn(shot, -1);
+		}
 
-			if (key == GLFW_KEY_Y && action == GLFW_PRESS) { //tell me target position
-				glm::vec3 forward = game->camera_.GetForward();
-				glm::vec3 origin = game->camera_.GetPosition();
+		if (key == GLFW_KEY_Y && action == GLFW_PRESS) { //tell me target position
+			glm::vec3 forward = game->camera_.GetForward();
+			glm::vec3 origin = game->camera_.GetPosition();
 
-				game->FireTracer();
-				std::vector<std::pair<SceneNode*, glm::vec2*>> hit = game->scene_.CheckRayCollisions(Ray(origin, forward));
+			game->FireTracer();
+			std::vector<std::pair<SceneNode*, glm::vec2*>> hit = game->scene_.CheckRayCollisions(Ray(origin, forward));
 
-				for (int i = 0; i < hit.size(); i++) {
-					if (hit[i].first->GetName() != "Target" && hit[i].first->GetName() != "Ground_Box") {
-						hit[i].first->takeDamage(INFINITY);
-					}
+			for (int i = 0; i < hit.size(); i++) {
+				if (hit[i].first->GetName() != "Target" && hit[i].first->GetName() != "Ground_Box") {
+					hit[i].first->takeDamage(INFINITY);
 				}
 			}
+		}
 
-			if (key == GLFW_KEY_V && action == GLFW_PRESS) { //change polygon display modes
-				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			}
-			if (key == GLFW_KEY_B && action == GLFW_PRESS) {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			}
-			if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) { // Quit game if 'ESC' is pressed
-				glfwSetWindowShouldClose(window, true);
+		if (key == GLFW_KEY_V && action == GLFW_PRESS) { //change polygon display modes
+			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		}
+		if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		}
+		if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) { // Quit game if 'ESC' is pressed
+			glfwSetWindowShouldClose(window, true);
+		}
+		if (key == GLFW_KEY_TAB && action == GLFW_PRESS) { // switch camera if TAB is pressed
+			if (game->tpCam) { //when entering first person, position the camera forward
+				game->camera_.SetPosition(game->camera_.GetPosition() + game->camera_.GetForward() * 10.0f);
 			}
-			if (key == GLFW_KEY_TAB && action == GLFW_PRESS) { // switch camera if TAB is pressed
-				if (game->tpCam) { //when entering first person, position the camera forward
-					game->camera_.SetPosition(game->camera_.GetPosition() + game->camera_.GetForward() * 10.0f);
-				}
-				else { //when entering third person, position the camera behind the player
-					game->camera_.SetPosition(game->camera_.GetPosition() - game->camera_.GetForward() * 10.0f);
-				}
-				game->tpCam = !game->tpCam;
+			else { //when entering third person, position the camera behind the player
+				game->camera_.SetPosition(game->camera_.GetPosition() - game->camera_.GetForward() * 10.0f);
 			}
+			game->tpCam = !game->tpCam;
+		}
 
-			//MOVEMENT HERE
-			if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) { // spacebar hovers upwards
-				game->camera_.vel_y = trans_factor;
-			}
-			if (key == GLFW_KEY_SPACE && action == GLFW_RELEASE) {
-				game->camera_.vel_y = 0.0;
-			}
-			if (key == GLFW_KEY_X && action == GLFW_PRESS) { // x hovers downwards
-				game->camera_.vel_y = -trans_factor;
-			}
-			if (key == GLFW_KEY_X && action == GLFW_RELEASE) {
-				game->camera_.vel_y = 0;
-			}
-			if (key == GLFW_KEY_S && action == GLFW_PRESS) { // s moves backwards
-				game->camera_.vel_z = -trans_factor;
-			}
-			if (key == GLFW_KEY_S && action == GLFW_RELEASE) {
-				game->camera_.vel_z = 0;
-			}
-			if (key == GLFW_KEY_W && action == GLFW_PRESS) { // w moves forwards
-				game->camera_.vel_z = trans_factor;
+		//MOVEMENT HERE
+		if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) { // spacebar hovers upwards
+			game->camera_.vel_y = trans_factor;
+		}
+		if (key == GLFW_KEY_SPACE && action == GLFW_RELEASE) {
+			game->camera_.vel_y = 0.0;
+		}
+		if (key == GLFW_KEY_X && action == GLFW_PRESS) { // x hovers downwards
+			game->camera_.vel_y = -trans_factor;
+		}
+		if (key == GLFW_KEY_X && action == GLFW_RELEASE) {
+			game->camera_.vel_y = 0;
+		}
+		if (key == GLFW_KEY_S && action == GLFW_PRESS) { // s moves backwards
+			game->camera_.vel_z = -trans_factor;
+		}
+		if (key == GLFW_KEY_S && action == GLFW_RELEASE) {
+			game->camera_.vel_z = 0;
+		}
+		if (key == GLFW_KEY_W && action == GLFW_PRESS) { // w moves forwards
+			game->camera_.vel_z = trans_factor;
+		}
+		if (key == GLFW_KEY_W && action == GLFW_RELEASE) {
+			game->camera_.vel_z = 0;
+		}
+		if (key == GLFW_KEY_Q && action == GLFW_PRESS) { // Q strafes left
+			game->camera_.vel_x = -trans_factor;
+		}
+		if (key == GLFW_KEY_Q && action == GLFW_RELEASE) {
+			game->camera_.vel_x = 0;
+		}
+		if (key == GLFW_KEY_E && action == GLFW_PRESS) { // E strafes right
+			game->camera_.vel_x = trans_factor;
+		}
+		if (key == GLFW_KEY_E && action == GLFW_RELEASE) {
+			game->camera_.vel_x = 0;
+		}
+
+		//TURNING HERE
+		float rot_factor(1.5 * glm::pi<float>() / 180);
+		if (key == GLFW_KEY_A && action == GLFW_PRESS) { // a turns left
+			game->turning = LEFT;
+			if (game->tpCam) { game->camera_.vel_x = trans_factor; } //third person turning L
+		}
+		if (key == GLFW_KEY_A && action == GLFW_RELEASE) {
+			game->turning = NONE;
+			if (game->tpCam) { game->camera_.vel_x = 0.0; }
+		}
+		if (key == GLFW_KEY_D && action == GLFW_PRESS) { // d turns right
+			game->turning = RIGHT;
+			if (game->tpCam) { game->camera_.vel_x = -trans_factor; } //third person turning R
+		}
+		if (key == GLFW_KEY_D && action == GLFW_RELEASE) {
+			game->turning = NONE;
+			if (game->tpCam) { game->camera_.vel_x = 0.0; }
+		}
+		if (key == GLFW_KEY_UP && action == GLFW_PRESS) {
+			game->turning = UP;
+		}
+		if (key == GLFW_KEY_UP && action == GLFW_RELEASE) {
+			game->turning = NONE;
+		}
+		if (key == GLFW_KEY_DOWN && action == GLFW_PRESS) {
+			game->turning = DOWN;
+		}
+		if (key == GLFW_KEY_DOWN && action == GLFW_RELEASE) {
+			game->turning = NONE;
+		}
+		if (key == GLFW_KEY_LEFT) {
+			game->camera_.Roll(-rot_factor);
+		}
+		if (key == GLFW_KEY_RIGHT) {
+			game->camera_.Roll(rot_factor);
+		}
+
+		if (key == GLFW_KEY_R && action == GLFW_PRESS) { //fires a bomb with particle effects
+			game->FireBomb();
+		}
+		if (key == GLFW_KEY_F && action == GLFW_PRESS) { //fire a laser
+			game->FireLaser();
+		}
+		if (key == GLFW_KEY_I && action == GLFW_PRESS) { // I prints how many enemies sleep, idle and attack
+			game->scene_.GetActivation().Report(std::cout);
+			std::cout << "Spawned " << game->spawn_director_.GetSpawned() << " enemies, " << game->spawn_director_.GetDespawned()
+				<< " destroyed, " << game->spawn_director_.GetAlive() << " alive and " << game->spawn_director_.GetQueued() << " on the way" << std::endl;
+		}
+		if (key == GLFW_KEY_K && action == GLFW_PRESS) { // K saves a snapshot of the scene, written in the background
+			// The game never waits for the disk, a press while the last snapshot is being written is dropped
+			if (game->snapshot_writer_.IsBusy()) {
+				std::cout << "Still writing the last snapshot, K ignored" << std::endl;
 			}
-			if (key == GLFW_KEY_W && action == GLFW_RELEASE) {
-				game->camera_.vel_z = 0;
+			else {
+				clock_t start = clock();
+				std::shared_ptr<SceneSnapshot> snapshot(new SceneSnapshot());
+				snapshot->Capture(game->scene_.root_, game->scene_.GetProjectiles());
+				double capture_ms = 1000.0 * (clock() - start) / CLOCKS_PER_SEC;
+				game->snapshot_writer_.Write(snapshot, snapshot_file_g);
+				std::cout << "Snapshot of " << snapshot->GetNodeCount() << " nodes and " << snapshot->GetProjectileCount() << " projectiles captured in "
+					<< capture_ms << " ms, writing " << snapshot_file_g << std::endl;
 			}
-			if (key == GLFW_KEY_Q && action == GLFW_PRESS) { // Q strafes left
-				game->camera_.vel_x = -trans_factor;
+		}
+		if (key == GLFW_KEY_P && action == GLFW_PRESS) { // P toggles the frame time graph
+			game->telemetry_.SetOverlay(!game->telemetry_.IsOverlay());
+		}
+		if (key == GLFW_KEY_N && action == GLFW_PRESS) { // N toggles dynamic resolution
+			game->dynamic_resolution_.SetEnabled(!game->dynamic_resolution_.IsEnabled());
+			std::cout << "Dynamic resolution " << (game->dynamic_resolution_.IsEnabled() ? "on" : "off")
+				<< ", GPU frame time " << game->dynamic_resolution_.GetGpuTime() << " ms" << std::endl;
+		}
+		if (key == GLFW_KEY_H && action == GLFW_PRESS) { // H increases hp
+			game->hp += 5;
+		}
+		if (key == GLFW_KEY_G && action == GLFW_PRESS) { // G lowers hp
+			game->hp -= 5;
+		}
+	}
+
+	void Game::ResizeCallback(GLFWwindow* window, int width, int height) {
+		// Set up viewport and camera projection based on new window size
+		glViewport(0, 0, width, height);
+		void* ptr = glfwGetWindowUserPointer(window);
+		Game *game = (Game *)ptr;
+		game->camera_.SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
+		game->heli_.SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
+		game->scene_.ResizeDrawToTexture(width, height);
+	}
+
+	void Game::BenchmarkObjParser(int iterations) {
+		// Read every mesh once, only parsing is timed
+		std::vector<std::vector<char> > text(num_mesh_assets_g);
+		size_t total_bytes = 0;
+		for (int i = 0; i < num_mesh_assets_g; i++) {
+			std::string filename = std::string(MATERIAL_DIRECTORY) + std::string(mesh_assets_g[i].file);
+			read_file(filename.c_str(), text[i]);
+			total_bytes += text[i].size();
+		}
+
+		double total_time = 0.0;
+		for (int i = 0; i < num_mesh_assets_g; i++) {
+			const char *begin = text[i].empty() ? NULL : &text[i][0];
+			size_t faces = 0;
+			clock_t start = clock();
+			for (int k = 0; k < iterations; k++) {
+				TriMesh mesh;
+				parse_obj(begin, begin + text[i].size(), mesh);
+				faces = mesh.face.size();
 			}
-			if (key == GLFW_KEY_Q && action == GLFW_RELEASE) {
-				game->camera_.vel_x = 0;
+			double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+			total_time += seconds;
+			double mb = text[i].size() * (double)iterations / (1024.0 * 1024.0);
+			std::cout << mesh_assets_g[i].file << ": " << text[i].size() << " bytes, " << faces << " triangles, "
+				<< (seconds > 0.0 ? mb / seconds : 0.0) << " MB/s" << std::endl;
+		}
+
+		double total_mb = total_bytes * (double)iterations / (1024.0 * 1024.0);
+		std::cout << "OBJ parsing: " << total_mb << " MB in " << total_time << " s, "
+			<< (total_time > 0.0 ? total_mb / total_time : 0.0) << " MB/s" << std::endl;
+	}
+
+	// Enemies for the steering benchmark, without resources: moles, cats and dogs in turn, spread
+	// around target. The same seed gives the same enemies
+	static void create_steering_bench(int count, unsigned int seed, SceneNode *root, SceneNode *target,
+		std::vector<Enemy *> &enemies, std::vector<SceneNode *> &nodes) {
+		srand(seed);
+		for (int i = 0; i < count; i++) {
+			std::string name = "Enemy" + std::to_string(i);
+			SceneNode *entity = new SceneNode(name, NULL, NULL, NULL);
+			entity->SetPosition(rand() % 1000 - 500.0f, 0.0f, rand() % 1000 - 500.0f);
+			root->AddChild(entity);
+			nodes.push_back(entity);
+
+			Enemy *enemy;
+			if (i % 3 == 0) {
+				enemy = new Mole(name + "_body", target, NULL, NULL);
 			}
-			if (key == GLFW_KEY_E && action == GLFW_PRESS) { // E strafes right
-				game->camera_.vel_x = trans_factor;
+			else if (i % 3 == 1) {
+				enemy = new Cat(name + "_body", target, NULL, NULL);
 			}
-			if (key == GLFW_KEY_E && action == GLFW_RELEASE) {
-				game->camera_.vel_x = 0;
+			else {
+				Doggy *dog = new Doggy(name + "_body", target, NULL, NULL);
+				SceneNode *turret = new SceneNode(name + "_turret", NULL, NULL, NULL);
+				entity->AddChild(turret);
+				nodes.push_back(turret);
+				dog->setTurret(turret);
+				enemy = dog;
 			}
+			enemy->SetOrientation(glm::angleAxis((rand() % 360) * glm::pi<float>() / 180.0f, glm::vec3(0.0, 1.0, 0.0)));
+			entity->AddChild(enemy);
+			nodes.push_back(enemy);
+			enemies.push_back(enemy);
+		}
+	}
 
-			//TURNING HERE
-			float rot_factor(1.5 * glm::pi<float>() / 180);
-			if (key == GLFW_KEY_A && action == GLFW_PRESS) { // a turns left
-				game->turning = LEFT;
-				if (game->tpCam) { game->camera_.vel_x = trans_factor; } //third person turning L
-			}
-			if (key == GLFW_KEY_A && action == GLFW_RELEASE) {
-				game->turning = NONE;
-				if (game->tpCam) { game->camera_.vel_x = 0.0; }
-			}
-			if (key == GLFW_KEY_D && action == GLFW_PRESS) { // d turns right
-				game->turning = RIGHT;
-				if (game->tpCam) { game->camera_.vel_x = -trans_factor; } //third person turning R
+	void Game::BenchmarkSteering(void) {
+		const int counts[] = { 100, 1000, 10000, 100000 };
+		const double delta_time = 1.0 / tick_rate_g;
+		for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+			int count = counts[c];
+			int steps = std::max(1000000 / count, 10);
+
+			// The same enemies twice, one set steered one at a time and the other in batches
+			SceneNode root("Root", NULL, NULL, NULL);
+			SceneNode target("Target", NULL, NULL, NULL);
+			target.SetPosition(0.0, 20.0, 0.0);
+			std::vector<Enemy *> scalar, batched;
+			std::vector<SceneNode *> nodes;
+			create_steering_bench(count, 1, &root, &target, scalar, nodes);
+			create_steering_bench(count, 1, &root, &target, batched, nodes);
+
+			clock_t start = clock();
+			for (int s = 0; s < steps; s++) {
+				for (int i = 0; i < count; i++) {
+					scalar[i]->Steer(delta_time);
+				}
 			}
-			if (key == GLFW_KEY_D && action == GLFW_RELEASE) {
-				game->turning = NONE;
-				if (game->tpCam) { game->camera_.vel_x = 0.0; }
+			double scalar_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+			EnemySteering steering;
+			start = clock();
+			for (int s = 0; s < steps; s++) {
+				for (int i = 0; i < count; i++) {
+					steering.Add(batched[i]);
+				}
+				steering.Run(delta_time);
 			}
-			if (key == GLFW_KEY_UP && action == GLFW_PRESS) {
-				game->turning = UP;
+			double batched_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+			// How far the batched enemies drifted from the reference
+			float max_angle = 0.0f, max_distance = 0.0f;
+			for (int i = 0; i < count; i++) {
+				float d = std::min(1.0f, std::fabs(glm::dot(scalar[i]->GetOrientation(), batched[i]->GetOrientation())));
+				max_angle = std::max(max_angle, 2.0f * std::acos(d));
+				max_distance = std::max(max_distance, glm::length(scalar[i]->GetEntityPosition() - batched[i]->GetEntityPosition()));
 			}
-			if (key == GLFW_KEY_UP && action == GLFW_RELEASE) {
-				game->turning = NONE;
+
+			double enemy_steps = (double)count * steps;
+			std::cout << "Steering " << count << " enemies, " << steps << " steps: scalar " << scalar_seconds * 1e9 / enemy_steps
+				<< " ns, batched " << batched_seconds * 1e9 / enemy_steps << " ns per enemy ("
+				<< (batched_seconds > 0.0 ? scalar_seconds / batched_seconds : 0.0) << "x), largest difference "
+				<< max_angle << " radians, " << max_distance << " units" << std::endl;
+
+			for (unsigned int i = 0; i < nodes.size(); i++) {
+				delete nodes[i];
 			}
-			if (key == GLFW_KEY_DOWN && action == GLFW_PRESS) {
-				game->turning = DOWN;
+		}
+	}
+
+	void Game::BenchmarkProjectiles(void) {
+		const int live = 100000;
+		const double delta_time = 1.0 / tick_rate_g;
+		// Each step replaces the projectiles that expired, so about live of them keep flying
+		const int spawn_per_step = (int)std::ceil(live * delta_time / PROJECTILE_LIFESPAN);
+		const int warm_up = (int)std::ceil(PROJECTILE_LIFESPAN / delta_time);
+		const int steps = 600;
+
+		ProjectileSystem projectiles(projectile_capacity_g);
+		ProjectileShot shot;
+		shot.acceleration = glm::vec3(0, -0.05, 0);
+		shot.damage = 1.0;
+		shot.type = projectiles.AddType(NULL, glm::vec3(0.3, 0.3, 0.3), 0);
+
+		srand(1);
+		double update_seconds = 0.0, select_seconds = 0.0;
+		long live_total = 0;
+		int selected = 0;
+		for (int s = 0; s < warm_up + steps; s++) {
+			for (int i = 0; i < spawn_per_step; i++) {
+				shot.position = glm::vec3(rand() % 1000, rand() % 200, rand() % 1000);
+				shot.velocity = glm::vec3(rand() % 21 - 10, rand() % 11 - 5, rand() % 21 - 10);
+				projectiles.Spawn(shot, i % 8);
 			}
-			if (key == GLFW_KEY_DOWN && action == GLFW_RELEASE) {
-				game->turning = NONE;
+
+			clock_t start = clock();
+			projectiles.Update(delta_time);
+			clock_t updated = clock();
+			// One entity's worth of collision culling
+			selected = projectiles.Select(glm::vec3(450, 50, 450), glm::vec3(550, 150, 550), 0);
+			clock_t end = clock();
+
+			if (s >= warm_up) {
+				update_seconds += (double)(updated - start) / CLOCKS_PER_SEC;
+				select_seconds += (double)(end - updated) / CLOCKS_PER_SEC;
+				live_total += projectiles.GetCount();
 			}
-			if (key == GLFW_KEY_LEFT) {
-				game->camera_.Roll(-rot_factor);
+		}
+
+		double budget_ms = 1000.0 * delta_time;
+		std::cout << "Projectiles: " << live_total / steps << " alive on average over " << steps << " steps of " << budget_ms
+			<< " ms, update " << 1000.0 * update_seconds / steps << " ms, select " << 1000.0 * select_seconds / steps
+			<< " ms per step (" << selected << " near one entity), " << projectiles.GetDropped() << " dropped" << std::endl;
+	}
+
+	// Seconds on a clock that counts while other threads run, unlike clock()
+	static double wall_seconds(void) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Game::BenchmarkSnapshot(const char *fixture) {
+		const double mb = 1024.0 * 1024.0;
+		const double delta_time = 1.0 / tick_rate_g;
+		const int runs = 10;
+
+		// The scene, from the fixture or built like the steering benchmark
+		SceneNode *root;
+		ProjectileSystem projectiles(projectile_capacity_g);
+		if (fixture) {
+			SceneSnapshot snapshot;
+			snapshot.Load(fixture);
+			for (int t = 0; t < snapshot.GetProjectileTypes(); t++) {
+				projectiles.AddType(NULL, glm::vec3(0.3, 0.3, 0.3), 0);
 			}
-			if (key == GLFW_KEY_RIGHT) {
-				game->camera_.Roll(rot_factor);
+			root = snapshot.Restore(NULL, &projectiles);
+			std::cout << "Fixture " << fixture << ": ";
+		}
+		else {
+			root = new Terrain("Ground", NULL, NULL);
+			SceneNode *target = new SceneNode("Target", NULL, NULL, NULL);
+			target->SetPosition(0.0, 20.0, 0.0);
+			root->AddChild(target);
+			// Moles and cats take two nodes and dogs three
+			std::vector<Enemy *> enemies;
+			std::vector<SceneNode *> nodes;
+			create_steering_bench(snapshot_bench_nodes_g * 3 / 7, 1, root, target, enemies, nodes);
+			ProjectileShot shot;
+			shot.acceleration = glm::vec3(0, -0.05, 0);
+			shot.damage = 1.0;
+			shot.type = projectiles.AddType(NULL, glm::vec3(0.3, 0.3, 0.3), 0);
+			for (int i = 0; i < snapshot_bench_projectiles_g; i++) {
+				shot.position = glm::vec3(rand() % 1000, rand() % 200, rand() % 1000);
+				shot.velocity = glm::vec3(rand() % 21 - 10, rand() % 11 - 5, rand() % 21 - 10);
+				projectiles.Spawn(shot, enemies[i % enemies.size()]->GetEntity()->GetId());
 			}
+			std::cout << "Generated scene: ";
+		}
 
-			if (key == GLFW_KEY_R && action == GLFW_PRESS) { //fires a bomb with particle effects
-				game->FireBomb();
-			}
-			if (key == GLFW_KEY_F && action == GLFW_PRESS) { //fire a laser
-				game->FireLaser();
+		double capture_seconds = 0.0, save_seconds = 0.0, load_seconds = 0.0, restore_seconds = 0.0, stall_seconds = 0.0;
+		std::shared_ptr<SceneSnapshot> snapshot(new SceneSnapshot());
+		for (int r = 0; r < runs; r++) {
+			double start = wall_seconds();
+			snapshot->Capture(root, &projectiles);
+			double captured = wall_seconds();
+			snapshot->Save(snapshot_bench_file_g);
+			double saved = wall_seconds();
+			SceneSnapshot loaded;
+			loaded.Load(snapshot_bench_file_g);
+			double read = wall_seconds();
+			ProjectileSystem restored_projectiles(projectile_capacity_g);
+			for (int t = 0; t < loaded.GetProjectileTypes(); t++) {
+				restored_projectiles.AddType(NULL, glm::vec3(0.3, 0.3, 0.3), 0);
 			}
-			if (key == GLFW_KEY_H && action == GLFW_PRESS) { // H increases hp
-				game->hp += 5;
+			SceneNode *restored = loaded.Restore(NULL, &restored_projectiles);
+			double end = wall_seconds();
+			SceneNode::DeleteTree(restored);
+
+			capture_seconds += captured - start;
+			save_seconds += saved - captured;
+			load_seconds += read - saved;
+			restore_seconds += end - read;
+		}
+
+		// What the game waits for when saving in the background: the capture, and starting the writer
+		SnapshotWriter writer;
+		for (int r = 0; r < runs; r++) {
+			double start = wall_seconds();
+			std::shared_ptr<SceneSnapshot> copy(new SceneSnapshot());
+			copy->Capture(root, &projectiles);
+			writer.Write(copy, snapshot_bench_file_g);
+			stall_seconds += wall_seconds() - start;
+			writer.Wait();
+		}
+
+		double file_mb = snapshot->GetBytes() / mb;
+		std::cout << snapshot->GetNodeCount() << " nodes, " << snapshot->GetProjectileCount() << " projectiles, " << file_mb << " MB" << std::endl;
+		std::cout << "Capture " << 1000.0 * capture_seconds / runs << " ms, save " << 1000.0 * save_seconds / runs << " ms ("
+			<< file_mb * runs / save_seconds << " MB/s), load " << 1000.0 * load_seconds / runs << " ms (" << file_mb * runs / load_seconds
+			<< " MB/s), restore " << 1000.0 * restore_seconds / runs << " ms" << std::endl;
+		std::cout << "Saving in the background holds the game up " << 1000.0 * stall_seconds / runs << " ms, the write takes "
+			<< writer.GetLastTime() << " ms on its own thread" << std::endl;
+
+		// The restored scene is a fixture: steer its enemies as the game would
+		std::vector<Enemy *> enemies;
+		std::vector<SceneNode *> stck(1, root);
+		while (!stck.empty()) {
+			SceneNode *current = stck.back();
+			stck.pop_back();
+			stck.insert(stck.end(), current->children_.begin(), current->children_.end());
+			Enemy *enemy = dynamic_cast<Enemy *>(current);
+			if (enemy && enemy->getTarget()) {
+				enemies.push_back(enemy);
 			}
-			if (key == GLFW_KEY_G && action == GLFW_PRESS) { // G lowers hp
-				game->hp -= 5;
+		}
+		const int steps = 100;
+		EnemySteering steering;
+		double start = wall_seconds();
+		for (int s = 0; s < steps; s++) {
+			for (unsigned int i = 0; i < enemies.size(); i++) {
+				steering.Add(enemies[i]);
 			}
-		} //end elseif game_state
+			steering.Run(delta_time);
+			projectiles.Update(delta_time);
+		}
+		double fixture_seconds = wall_seconds() - start;
+		std::cout << "Fixture: " << enemies.size() << " enemies and " << projectiles.GetCount() << " projectiles after " << steps << " steps, "
+			<< 1000.0 * fixture_seconds / steps << " ms per step" << std::endl;
+		if (!fixture) {
+			std::cout << "Wrote " << snapshot_bench_file_g << ", run again with it as the fixture" << std::endl;
+		}
+
+		SceneNode::DeleteTree(root);
 	}
 
-	void Game::ResizeCallback(GLFWwindow* window, int width, int height) {
-		// Set up viewport and camera projection based on new window size
-		glViewport(0, 0, width, height);
-		void* ptr = glfwGetWindowUserPointer(window);
-		Game *game = (Game *)ptr;
-		game->camera_.SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
-		game->heli_.SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
+	void Game::ReportMeshOptimization(void) {
+		for (int i = 0; i < num_mesh_assets_g; i++) {
+			std::string filename = std::string(MATERIAL_DIRECTORY) + std::string(mesh_assets_g[i].file);
+			std::vector<char> text;
+			read_file(filename.c_str(), text);
+			TriMesh mesh;
+			bool has_normals = text.empty() ? false : parse_obj(&text[0], &text[0] + text.size(), mesh);
+			std::vector<GLfloat> expanded, vertices;
+			std::vector<GLuint> indices;
+			expand_obj_mesh(mesh, has_normals, expanded);
+			MeshOptimizerStats stats;
+			optimize_mesh(expanded, vertices, indices, &stats);
+
+			// ACMR with a FIFO cache of MESH_OPTIMIZER_CACHE_SIZE vertices, unindexed -> indexed -> vertex cache -> overdraw
+			std::cout << mesh_assets_g[i].file << ": " << stats.triangles << " triangles, vertices " << stats.input_vertices
+				<< " -> " << stats.output_vertices << " (-" << (stats.input_vertices ? 100 * (stats.input_vertices - stats.output_vertices) / stats.input_vertices : 0)
+				<< "%), ACMR " << stats.input_acmr << " -> " << stats.indexed_acmr << " -> " << stats.vertex_cache_acmr
+				<< " -> " << stats.optimized_acmr << " (" << stats.clusters << " clusters)" << std::endl;
+		}
 	}
 
 	Game::~Game() {
+		// GL objects have to be deleted while the context exists, and whatever holds a resource
+		// before the resources
+		spawn_director_.Clear();
+		scene_.Clear();
+		texture_streamer_.Clear();
+		resman_.Clear();
+		frame_uniforms_.Clear();
+		gpu_profiler_.Clear();
 		glfwTerminate();
 	}
 
-	SceneNode *Game::Cube(int type, std::string entity_name, std::string object_name, std::string material_name,
-		glm::vec3 rgb, double ttl, std::string tex_name) {
-		// Get resources
-		Resource *geom = resman_.GetResource(object_name);
-		if (!geom) {
-			throw(GameException(std::string("Could not find resource \"") + object_name + std::string("\"")));
-		}
-		Resource *mat = resman_.GetResource(material_name);
-		if (!mat) {
-			throw(GameException(std::string("Could not find resource \"") + material_name + std::string("\"")));
-		}
-		Resource *tex = NULL;
-		if (!tex_name.empty()) {
-			tex = resman_.GetResource(tex_name);
-			if (!tex) {
-				throw(GameException(std::string("Could not find resource \"") + tex_name + std::string("\"")));
-			}
+	void Game::CycleLevels(int cycles) {
+		const double mb = 1024.0 * 1024.0;
+		for (int i = 1; i <= cycles; i++) {
+			level_resources_.Release();
+			level_resources_.Load();
+			ResolveHandles();
+			std::cout << "Level cycle " << i << ": level resources " << level_resources_.GetGpuBytes() / mb << " MB GPU" << std::endl;
+			resman_.PrintMemory(std::cout);
 		}
+	}
+
+	SceneNode *Game::Cube(int type, std::string entity_name, MeshHandle object, MaterialHandle material,
+		glm::vec3 rgb, double ttl, TextureHandle texture) {
+		// Get resources, the handles were checked by ResolveHandles
+		Resource *geom = resman_.GetResource(object);
+		Resource *mat = resman_.GetResource(material);
+		Resource *tex = resman_.GetResource(texture);
 
 		SceneNode* cube; //generate a cube based on whichever type was passed in
 		if (type == LaserBeam) {
@@ -618,7 +1247,7 @@ namespace game {
 
 	void Game::FireLaser() {
 		scene_.Remove("Laser1"); //only one laser can exist at once
-		Laser *cube = (Laser*)Cube(LaserBeam, "Laser1", "CubePointSet", "ObjectMaterial");
+		Laser *cube = (Laser*)Cube(LaserBeam, "Laser1", handles_.cube, handles_.object_material);
 		cube->SetPosition(camera_.GetPosition() + (camera_.GetForward() * 8.0f) + (camera_.GetUp() * -0.5f)); //fires outward from the heli's position
 		cube->SetOrientation(camera_.GetOrientation());
 		cube->SetDir(camera_.GetForward());
@@ -641,10 +1270,8 @@ namespace game {
 		float g = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 		float b = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 
-		game::Bomb *particles = (Bomb*)Cube(BombType, "ParticleInstance" + std::to_string(scene_.exploCount++), "SphereParticles", "ParticleMaterial",
-			glm::vec3(r, g, b), 4.0, "Firework");
-		particles->SetPosition(camera_.GetPosition() + (camera_.GetForward() * 12.0f) + (camera_.GetUp() * -0.5f));
-		particles->SetScale(glm::vec3(0.4, 0.4, 0.4)); //increasing the scale makes the explosion more dense
+		glm::vec3 pos = camera_.GetPosition() + (camera_.GetForward() * 12.0f) + (camera_.GetUp() * -0.5f);
+		scene_.GetParticles()->SpawnBurst(pos, glm::vec3(r, g, b), 2000, 3.0, ttlr);
 	}
 
 	void Game::FireTracer() {
@@ -653,11 +1280,8 @@ namespace game {
 		float g = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 		float b = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 
-		game::Bomb *particles = (Bomb*)Cube(BombType, "TracerInstance" + scene_.exploCount++, "LineParticles", "LineMaterial",
-			glm::vec3(r, g, b), 2.5, "Firework");
-		particles->SetScale(glm::vec3(0.02, 0.02, 1000.0)); //1000 is ~far away~
-		particles->SetPosition(camera_.GetPosition() + (camera_.GetForward() * 200.0f) + (camera_.GetUp() * -0.3f)); //200.0f starts the line on the playerish
-		particles->SetOrientation(camera_.GetOrientation());
+		glm::vec3 pos = camera_.GetPosition() + (camera_.GetUp() * -0.3f); //starts the line on the playerish
+		scene_.GetParticles()->SpawnTracer(pos, camera_.GetForward(), 400.0, glm::vec3(r, g, b), 1500, 2.5); //400 is ~far away~
 	}
 
 	std::string Game::RaySphere(glm::vec3 raydir, glm::vec3 raypos) {
@@ -680,18 +1304,12 @@ namespace game {
 	SceneNode* Game::CreateMole() {
 		// Create a Mole SceneNode tree
 
-		Resource *fireworkMesh = resman_.GetResource("FireworkMesh");
-		Resource *fireworkTex = resman_.GetResource("FireworkTex");
-		Resource *cube = resman_.GetResource("CubePointSet");
-		Resource *moleMesh = resman_.GetResource("MoleMesh");
-		Resource *moleTex = resman_.GetResource("MoleTex");
+		Resource *moleMesh = resman_.GetResource(handles_.mole_mesh);
+		Resource *gunMesh = resman_.GetResource(handles_.gun_mesh);
 
-		Resource *mat = resman_.GetResource("ShinyTextureMaterial");
-		Resource *gunMesh = resman_.GetResource("GunMesh");
-		Resource *gunTex = resman_.GetResource("GunTex");
-		if (!mat) {
-			throw(GameException(std::string("Could not find resource \"") + "TextureMat" + std::string("\"")));
-		}
+		// Every part is textured from the enemy texture array
+		Resource *tex = resman_.GetResource(handles_.enemy_textures);
+		Resource *mat = resman_.GetResource(handles_.shiny_texture_array_material);
 
 		std::string name = "Enemy" + std::to_string(EnemyID++);
 		numEnemies++;
@@ -701,19 +1319,17 @@ namespace game {
 		//n->setMovementSpeed(0);
 		//n->setRotateSpeed(0);
 
-		Mole* body = new Mole(name + "_body", scene_.GetNode("Target"), moleMesh, mat, moleTex);
+		Mole* body = new Mole(name + "_body", target_, moleMesh, mat, tex);
+		body->SetTextureLayer(handles_.mole_layer);
 		body->setCollidable(true);
 		body->SetPosition(0, 0.5, 0);
 	
-		SceneNode* gun = new SceneNode(name + "_gun", gunMesh, mat, gunTex);
+		SceneNode* gun = new SceneNode(name + "_gun", gunMesh, mat, tex);
+		gun->SetTextureLayer(handles_.gun_layer);
 		gun->SetPosition(1.0, 0.5, 1.5);
 		gun->setCollidable(true);
 		gun->SetScale(0.5, 0.5, 5.0);
 
-		body->setProjectileGeometry(fireworkMesh);
-		body->setProjectileTexture(fireworkTex);
-		body->setProjectileMaterial(mat);
-
 		n->AddChild(body);
 		body->AddChild(gun);
 
@@ -722,41 +1338,30 @@ namespace game {
 
 	SceneNode* Game::CreateDog() {
 		
-		Resource *cube = resman_.GetResource("CubePointSet");
-		Resource *dogMesh = resman_.GetResource("DogMesh");
-		Resource *dogTex = resman_.GetResource("DogTex");
+		Resource *dogMesh = resman_.GetResource(handles_.dog_mesh);
+		Resource *gunMesh = resman_.GetResource(handles_.gun_mesh);
 
-		Resource *ballMesh = resman_.GetResource("TennisBallMesh");
-		Resource *ballTex = resman_.GetResource("TennisBallTex");
-
-		Resource *mat = resman_.GetResource("ShinyTextureMaterial");
-		Resource *ob = resman_.GetResource("ObjectMaterial");
-		
-		Resource *gunMesh = resman_.GetResource("GunMesh");
-		Resource *gunTex = resman_.GetResource("GunTex");
-
-		if (!mat) {
-			throw(GameException(std::string("Could not find resource \"") + "ObjectMaterial" + std::string("\"")));
-		}
+		Resource *tex = resman_.GetResource(handles_.enemy_textures);
+		Resource *mat = resman_.GetResource(handles_.shiny_texture_array_material);
 
 		std::string name = "Enemy" + std::to_string(EnemyID++);
 		numEnemies++;
 		SceneNode* n = new SceneNode(name, NULL, NULL, NULL);
 
-		SceneNode* turret = new SceneNode(name + "_turret", gunMesh, mat, gunTex);
+		SceneNode* turret = new SceneNode(name + "_turret", gunMesh, mat, tex);
+		turret->SetTextureLayer(handles_.gun_layer);
 		turret->setCollidable(true);
 		turret->SetScale(0.5, 0.5, 4.0);
 		turret->SetPosition(0, 0.75, 0);
 		//turret->setMovementSpeed(0);
 
-		Doggy* dog = new Doggy(name + "_body", scene_.GetNode("Target"), dogMesh, mat, dogTex);
+		Doggy* dog = new Doggy(name + "_body", target_, dogMesh, mat, tex);
+		dog->SetTextureLayer(handles_.dog_layer);
 		dog->SetScale(2.0, 1.0, 6.0);
 		dog->Translate(0, 1, 0);
 		dog->setCollidable(true);
 		dog->setTurret(turret);
-		dog->setProjectileGeometry(ballMesh);
-		dog->setProjectileTexture(ballTex);
-		dog->setProjectileMaterial(mat);
+		dog->setProjectileType(dog_projectile_);
 
 		n->AddChild(turret);
 		n->AddChild(dog);
@@ -767,39 +1372,29 @@ namespace game {
 
 	SceneNode* Game::CreateCat() {
 		
-		Resource *cube = resman_.GetResource("CubePointSet");
-		Resource *catMesh = resman_.GetResource("CatMesh");
-		Resource *catTex = resman_.GetResource("CatTex");
-
-		Resource *ballMesh = resman_.GetResource("FurrBallMesh");
-		Resource *ballTex = resman_.GetResource("FurrBallTex");
-		
-		Resource *propMesh = resman_.GetResource("PropellerMesh");
-		Resource *propTex = resman_.GetResource("PropellerTex");
+		Resource *catMesh = resman_.GetResource(handles_.cat_mesh);
+		Resource *propMesh = resman_.GetResource(handles_.propeller_mesh);
 
-		Resource *mat = resman_.GetResource("ShinyTextureMaterial");
-		
-		if (!mat) {
-			throw(GameException(std::string("Could not find resource \"") + "ObjectMaterial" + std::string("\"")));
-		}
+		Resource *tex = resman_.GetResource(handles_.enemy_textures);
+		Resource *mat = resman_.GetResource(handles_.shiny_texture_array_material);
 
 		std::string name = "Enemy" + std::to_string(EnemyID++);
 		numEnemies++;
 		SceneNode* n = new SceneNode(name, NULL, NULL, NULL);
 
-		SceneNode* prop = new SceneNode(name + "_prop", propMesh, mat, propTex);
+		SceneNode* prop = new SceneNode(name + "_prop", propMesh, mat, tex);
+		prop->SetTextureLayer(handles_.propeller_layer);
 		prop->setCollidable(true);
 		prop->SetScale(0.5, 0.5, 4.0);
 		prop->SetPosition(0, 0.75, 0);
 		//turret->setMovementSpeed(0);
 
-		Cat* cat = new Cat(name + "_body", scene_.GetNode("Target"), catMesh, mat, catTex);
+		Cat* cat = new Cat(name + "_body", target_, catMesh, mat, tex);
+		cat->SetTextureLayer(handles_.cat_layer);
 		cat->SetScale(2.0, 1.0, 6.0);
 		cat->setCollidable(true);
 
-		cat->setProjectileGeometry(ballMesh);
-		cat->setProjectileTexture(ballTex);
-		cat->setProjectileMaterial(mat);
+		cat->setProjectileType(cat_projectile_);
 
 		cat->AddChild(prop);
 		n->AddChild(cat);
@@ -809,13 +1404,10 @@ namespace game {
 	}
 	
 	SceneNode* Game::CreateTree() {
-		Resource *cyl = resman_.GetResource("CylinderMesh");
-		Resource *sphere = resman_.GetResource("SimpleSphereMesh");
+		Resource *cyl = resman_.GetResource(handles_.cylinder);
+		Resource *sphere = resman_.GetResource(handles_.sphere);
 
-		Resource *mat = resman_.GetResource("ObjectMaterial");
-		if (!mat) {
-			throw(GameException(std::string("Could not find resource \"") + "ObjectMaterial" + std::string("\"")));
-		}
+		Resource *mat = resman_.GetResource(handles_.object_material);
 
 		std::string name = "Tree" + std::to_string(TreeID++);
 
@@ -836,27 +1428,15 @@ namespace game {
 
 		return trunk;
 	}
-	
-	SceneNode* Game::SpawnMole() {
-		// create a mole
-		SceneNode* m = CreateMole();
-
-		// spawn it somewhere in the world
-		glm::vec3 v = scene_.GetRandomBoundedPosition();
-
-		m->SetPosition(v.x, 0, v.z);
 
-		return m;
-	}
-
-	SceneNode* Game::SpawnDog() {
-		SceneNode* d = CreateDog();
-
-		glm::vec3 v = scene_.GetRandomBoundedPosition();
-
-		d->SetPosition(v.x, 0, v.z);
-
-		return d;
+	SceneNode* Game::CreateEnemy(SpawnKind kind) {
+		if (kind == MoleSpawn) {
+			return CreateMole();
+		}
+		else if (kind == CatSpawn) {
+			return CreateCat();
+		}
+		return CreateDog();
 	}
 	
 	SceneNode* Game::SpawnTree() {
@@ -870,12 +1450,4 @@ namespace game {
 
 		return t;
 	}
-
-	SceneNode* Game::SpawnCat() {
-		SceneNode* cat = CreateCat();
-		cat->SetPosition(scene_.GetRandomBoundedPosition());
-
-		return cat;
-	}
-
 } // namespace game
@@ -7,6 +7,9 @@
 #include <GLFW/glfw3.h>
 #include "scene_graph.h"
 #include "resource_manager.h"
+#include "asset_loader.h"
+#include "resource_set.h"
+#include "texture_streamer.h"
 #include "camera.h"
 #include "laser.h"
 #include "bomb.h"
@@ -15,6 +18,17 @@
 #include "doggy.h"
 #include "mole.h"
 #include "cat.h"
+#include "terrain.h"
+#include "gpu_counters.h"
+#include "frame_uniforms.h"
+#include "obj_parser.h"
+#include "mesh_optimizer.h"
+#include "dynamic_resolution.h"
+#include "spawn_director.h"
+#include "input_log.h"
+#include "scene_snapshot.h"
+#include "gpu_profiler.h"
+#include "telemetry.h"
 #include "defs.h"
 
 namespace game {
@@ -30,7 +44,7 @@ namespace game {
 	};
 
 	// Game application
-	class Game {
+	class Game : public EnemyFactory {
 	public:
 		// Constructor and destructor
 		Game(void);
@@ -43,6 +57,36 @@ namespace game {
 		void SetupScene(void);
 		// Run the game: keep the application active
 		void MainLoop(void);
+		// Simulation steps per second, and steps run at most in one frame before the game slows down
+		void SetTickRate(double rate, int max_catch_up_steps);
+		// Memory streamed textures may take, in MB, call before SetupResources
+		void SetTextureBudget(int megabytes);
+		// Release and load the level resources cycles times, printing the resource memory after
+		// each, to check that changing levels doesn't leak. Call after SetupResources
+		void CycleLevels(int cycles);
+		// Record the keys of every step into filename, with the seed rand() was given, so the session
+		// can be replayed. Call after SetTickRate
+		void Record(const std::string &filename, unsigned int seed);
+		// Replay the session recorded in filename instead of playing: seeds rand(), takes the step
+		// length and hides the window. Call before Init, and Replay instead of MainLoop
+		void LoadReplay(const std::string &filename);
+		// Run every recorded step as fast as possible without drawing, and print how long they took
+		void Replay(void);
+		// Play frames frames from the start of the game instead of the title screen, half in first
+		// person and half in third, then print the CPU time of every phase and the GPU time of every pass
+		void Profile(int frames);
+
+		// Parse every bundled mesh iterations times and print the throughput, needs no window
+		static void BenchmarkObjParser(int iterations);
+		// Time steering 100 to 100k enemies one at a time and with EnemySteering, needs no window
+		static void BenchmarkSteering(void);
+		// Time 100k projectiles flying at the tick rate, needs no window
+		static void BenchmarkProjectiles(void);
+		// Time capturing, saving, loading and restoring a snapshot of a 10k node scene, then steer
+		// its enemies. The scene is loaded from fixture if it isn't NULL, needs no window
+		static void BenchmarkSnapshot(const char *fixture);
+		// Print the vertex count and ACMR of every mesh before and after each optimization pass
+		static void ReportMeshOptimization(void);
 
 		GLuint prgm; //need this to cheesily draw the heli for now
 		int game_state;
@@ -61,27 +105,75 @@ namespace game {
 
 		// Scene graph containing all nodes to render
 		SceneGraph scene_;
-		SceneNode* projectiles;
+		// Brings enemies into the scene a few per step, from enemies built ahead of time
+		SpawnDirector spawn_director_;
+		// Node every enemy targets
+		SceneNode *target_ = NULL;
+
+		// Keys pressed since the last step, applied at the start of the next one
+		std::vector<KeyEvent> pending_keys_;
+		// Keys of every step, being recorded or replayed
+		InputLog input_log_;
+		// Replaying, the window stays hidden
+		bool headless_ = false;
+		// Saves snapshots of the scene without holding up the game
+		SnapshotWriter snapshot_writer_;
 
 		// Resources available to the game
 		ResourceManager resman_;
+		// Decodes textures in the background and uploads their mips over several frames
+		TextureStreamer texture_streamer_;
+		// Resources of the level, released together when the level changes
+		ResourceSet level_resources_;
 
 		// Camera abstraction
 		Camera camera_;
 		Helicopter heli_;
 
+		// Camera, timer and light shared by every program, uploaded once per frame
+		FrameUniforms frame_uniforms_;
+
+		// Lowers the first person render resolution when the GPU can't keep up
+		DynamicResolution dynamic_resolution_;
+		// Times the render passes on the GPU, for the telemetry and the dynamic resolution
+		GpuProfiler gpu_profiler_;
+		// Frames MainLoop draws before it stops, 0 to play until the window closes
+		int frame_limit_ = 0;
+		// Cost of every frame, graphed over the first person view and written out on exit
+		Telemetry telemetry_;
+		// Columns of the graph, kept so drawing it doesn't allocate
+		std::vector<glm::vec2> telemetry_graph_;
+
+		// Resources used while the game runs, resolved once after loading
+		struct Handles {
+			MeshHandle cube, sphere, cylinder;
+			MeshHandle firework_mesh, mole_mesh, gun_mesh, dog_mesh, tennis_ball_mesh, cat_mesh, furr_ball_mesh, propeller_mesh;
+			MaterialHandle object_material, shiny_texture_material, shiny_texture_array_material, blue_material;
+			TextureHandle game_title;
+			// Enemies and their projectiles share one texture array, and one program to draw it
+			TextureArrayHandle enemy_textures;
+			int firework_layer, mole_layer, gun_layer, dog_layer, tennis_ball_layer, cat_layer, furr_ball_layer, propeller_layer;
+		} handles_;
+		// Projectile types fired by cats, dogs and the player, in the scene's projectile system
+		int cat_projectile_, dog_projectile_, player_projectile_;
+
 		// Flag to turn animation on/off
 		bool animating_;
+		// Fixed simulation step rate, in steps per second, and steps run at most per frame
+		double tick_rate_;
+		int max_catch_up_steps_;
 		int EnemyID = 0;
 		int numEnemies = 0;
 		int TreeID = 0;
 
-		float time_since_spawn = 0;
-
 		// Methods to initialize the game
 		void InitWindow(void);
 		void InitView(void);
 		void InitEventHandlers(void);
+		// Advance the simulation by one fixed step
+		void Tick(double delta_time);
+		// Look up every resource in handles_, throws if one is missing
+		void ResolveHandles(void);
 
 		void FireLaser();
 		void FireBomb();
@@ -91,19 +183,22 @@ namespace game {
 
 		// Methods to handle events
 		static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+		// Act on a key during gameplay, at the start of a step
+		static void ApplyKey(Game *game, int key, int action, int mods);
+		// Hash of the camera and every entity, equal after equal sessions
+		unsigned long long StateChecksum(void);
 		static void ResizeCallback(GLFWwindow* window, int width, int height);
 
 		//creates an instance of a 3d cube
-		SceneNode *Cube(int type, std::string entity_name, std::string object_name, std::string material_name,
-			glm::vec3 rgb = glm::vec3(0.8, 0.8, 0.8), double ttl = 4.0, std::string tex_name = "");
+		SceneNode *Cube(int type, std::string entity_name, MeshHandle object, MaterialHandle material,
+			glm::vec3 rgb = glm::vec3(0.8, 0.8, 0.8), double ttl = 4.0, TextureHandle texture = TextureHandle());
 		SceneNode* CreateMole();
 		SceneNode* CreateDog();
 		SceneNode* CreateTree();
 		SceneNode* CreateCat();
-		SceneNode* SpawnMole();
-		SceneNode* SpawnDog();
+		// Build an enemy for the spawn director
+		SceneNode* CreateEnemy(SpawnKind kind);
 		SceneNode* SpawnTree();
-		SceneNode* SpawnCat();
 
 
 	}; // class Game
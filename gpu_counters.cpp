@@ -0,0 +1,53 @@
+#include "gpu_counters.h"
+
+namespace game {
+	GpuUploads GpuCounters::current_ = { 0, 0, 0, 0 };
+	GpuUploads GpuCounters::last_ = { 0, 0, 0, 0 };
+	GpuDraws GpuCounters::current_draws_ = { 0, 0 };
+	GpuDraws GpuCounters::last_draws_ = { 0, 0 };
+
+	void GpuCounters::CountBufferUpload(void) {
+		current_.buffer_uploads++;
+	}
+
+	void GpuCounters::CountTextureUpload(void) {
+		current_.texture_uploads++;
+	}
+
+	void GpuCounters::CountMipmapGeneration(void) {
+		current_.mipmap_generations++;
+	}
+
+	void GpuCounters::CountStreamedUpload(void) {
+		current_.streamed_uploads++;
+	}
+
+	void GpuCounters::CountDraw(long triangles) {
+		current_draws_.draw_calls++;
+		current_draws_.triangles += triangles;
+	}
+
+	void GpuCounters::EndFrame(void) {
+		last_draws_ = current_draws_;
+		current_draws_.draw_calls = 0;
+		current_draws_.triangles = 0;
+		last_ = current_;
+		current_.buffer_uploads = 0;
+		current_.texture_uploads = 0;
+		current_.mipmap_generations = 0;
+		current_.streamed_uploads = 0;
+	}
+
+	void GpuCounters::Reset(void) {
+		EndFrame();
+		EndFrame();
+	}
+
+	GpuUploads GpuCounters::GetLastFrame(void) {
+		return last_;
+	}
+
+	GpuDraws GpuCounters::GetLastFrameDraws(void) {
+		return last_draws_;
+	}
+} // namespace game
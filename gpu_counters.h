@@ -0,0 +1,48 @@
+#ifndef GPU_COUNTERS_H_
+#define GPU_COUNTERS_H_
+
+namespace game {
+	// Uploads made to the GPU over one frame
+	struct GpuUploads {
+		int buffer_uploads; // glBufferData/glBufferSubData calls
+		int texture_uploads; // glTexImage/glTexSubImage calls
+		int mipmap_generations; // glGenerateMipmap calls
+		int streamed_uploads; // Expected per-frame writes to streaming buffers, e.g. particle spawns
+
+		// Uploads that a frame which only draws should never make
+		int Total(void) const { return buffer_uploads + texture_uploads + mipmap_generations; }
+	};
+
+	// Draw calls made over one frame
+	struct GpuDraws {
+		int draw_calls;
+		long triangles; // Triangles submitted, points and lines not counted
+	};
+
+	// Counts GPU uploads per frame, so frames that should only draw can be checked to upload nothing
+	class GpuCounters {
+	public:
+		static void CountBufferUpload(void);
+		static void CountTextureUpload(void);
+		static void CountMipmapGeneration(void);
+		static void CountStreamedUpload(void);
+		static void CountDraw(long triangles);
+
+		// Close the current frame and start counting the next one
+		static void EndFrame(void);
+		// Forget everything counted so far, e.g. uploads made while loading
+		static void Reset(void);
+
+		// Uploads of the last completed frame
+		static GpuUploads GetLastFrame(void);
+		// Draw calls of the last completed frame
+		static GpuDraws GetLastFrameDraws(void);
+
+	private:
+		static GpuUploads current_;
+		static GpuUploads last_;
+		static GpuDraws current_draws_;
+		static GpuDraws last_draws_;
+	}; // class GpuCounters
+} // namespace game
+#endif // GPU_COUNTERS_H_
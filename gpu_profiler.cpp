@@ -0,0 +1,148 @@
+#include <iostream>
+#include "gpu_profiler.h"
+
+namespace game {
+	// Names of the passes, in the order of GpuPass
+	static const char *pass_names_g[HelicopterPass + 1] = { "frame", "scene_texture", "display_texture", "scene", "particles", "helicopter" };
+
+	GpuProfiler::GpuProfiler(void) {
+		initialized_ = false;
+		frame_ = 0;
+		for (int s = 0; s < GPU_PROFILER_FRAMES; s++) {
+			used_[s] = 0;
+		}
+		fresh_ = false;
+		measured_frame_ = -1;
+		for (int p = 0; p <= HelicopterPass; p++) {
+			open_[p] = -1;
+			times_[p] = 0.0;
+			runs_[p] = 0;
+		}
+	}
+
+	GpuProfiler::~GpuProfiler() {
+		Clear();
+	}
+
+	void GpuProfiler::Clear(void) {
+		if (initialized_) {
+			glDeleteQueries(GPU_PROFILER_FRAMES * GPU_PROFILER_QUERIES, &queries_[0][0]);
+			initialized_ = false;
+		}
+	}
+
+	void GpuProfiler::Init(void) {
+		// Core since 3.3, and exposed by software renderers such as llvmpipe
+		if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query) {
+			std::cout << "Timer queries are not supported, GPU times will not be measured" << std::endl;
+			return;
+		}
+		glGenQueries(GPU_PROFILER_FRAMES * GPU_PROFILER_QUERIES, &queries_[0][0]);
+		initialized_ = true;
+	}
+
+	bool GpuProfiler::IsSupported(void) const {
+		return initialized_;
+	}
+
+	void GpuProfiler::BeginFrame(void) {
+		int slot = frame_ % GPU_PROFILER_FRAMES;
+		used_[slot] = 0;
+		ranges_[slot].clear();
+		for (int p = 0; p <= HelicopterPass; p++) {
+			open_[p] = -1;
+		}
+		Begin(FramePass);
+	}
+
+	void GpuProfiler::EndFrame(void) {
+		End(FramePass);
+		frame_++;
+
+		// The slot the next frame takes was used GPU_PROFILER_FRAMES - 1 frames before the one that just ended
+		fresh_ = false;
+		if (initialized_ && frame_ >= GPU_PROFILER_FRAMES) {
+			fresh_ = Read(frame_ % GPU_PROFILER_FRAMES);
+			if (fresh_) {
+				measured_frame_ = frame_ - GPU_PROFILER_FRAMES;
+			}
+		}
+	}
+
+	void GpuProfiler::Begin(GpuPass pass) {
+		int slot = frame_ % GPU_PROFILER_FRAMES;
+		if (!initialized_ || open_[pass] >= 0 || used_[slot] + 2 > GPU_PROFILER_QUERIES) {
+			return;
+		}
+		Range range;
+		range.pass = pass;
+		range.begin = used_[slot]++;
+		range.end = -1;
+		// The end of the pass has its query kept for it
+		used_[slot]++;
+		glQueryCounter(queries_[slot][range.begin], GL_TIMESTAMP);
+		open_[pass] = (int)ranges_[slot].size();
+		ranges_[slot].push_back(range);
+	}
+
+	void GpuProfiler::End(GpuPass pass) {
+		if (!initialized_ || open_[pass] < 0) {
+			return;
+		}
+		int slot = frame_ % GPU_PROFILER_FRAMES;
+		Range &range = ranges_[slot][open_[pass]];
+		range.end = range.begin + 1;
+		glQueryCounter(queries_[slot][range.end], GL_TIMESTAMP);
+		open_[pass] = -1;
+	}
+
+	bool GpuProfiler::HasNewResults(void) const {
+		return fresh_;
+	}
+
+	long GpuProfiler::GetMeasuredFrame(void) const {
+		return measured_frame_;
+	}
+
+	float GpuProfiler::GetTime(GpuPass pass) const {
+		return times_[pass];
+	}
+
+	int GpuProfiler::GetRuns(GpuPass pass) const {
+		return runs_[pass];
+	}
+
+	const char *GpuProfiler::GetName(GpuPass pass) {
+		return pass_names_g[pass];
+	}
+
+	bool GpuProfiler::Read(int slot) {
+		const std::vector<Range> &ranges = ranges_[slot];
+		if (ranges.empty()) {
+			return false;
+		}
+
+		// The frame ends with the end of FramePass, once that is done every timestamp before it is too
+		GLint available = 0;
+		glGetQueryObjectiv(queries_[slot][ranges[0].begin + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			return false;
+		}
+
+		for (int p = 0; p <= HelicopterPass; p++) {
+			times_[p] = 0.0;
+			runs_[p] = 0;
+		}
+		for (unsigned int i = 0; i < ranges.size(); i++) {
+			if (ranges[i].end < 0) {
+				continue;
+			}
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(queries_[slot][ranges[i].begin], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(queries_[slot][ranges[i].end], GL_QUERY_RESULT, &end);
+			times_[ranges[i].pass] += (float)((end - begin) / 1.0e6);
+			runs_[ranges[i].pass]++;
+		}
+		return true;
+	}
+} // namespace game
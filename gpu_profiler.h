@@ -0,0 +1,78 @@
+#ifndef GPU_PROFILER_H_
+#define GPU_PROFILER_H_
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// Frames of queries in flight. The queries of a frame are read GPU_PROFILER_FRAMES - 1 frames
+// later, when the GPU is done with them, so reading never stalls
+#define GPU_PROFILER_FRAMES 3
+// Timestamps one frame may take, passes begun past that are not measured
+#define GPU_PROFILER_QUERIES 64
+
+namespace game {
+	// Render passes timed on the GPU. FramePass spans the whole frame
+	enum GpuPass { FramePass, SceneTexturePass, DisplayTexturePass, ScenePass, ParticlePass, HelicopterPass };
+
+	// Times render passes on the GPU with a timestamp query at the start and at the end of each.
+	// Timestamps, unlike GL_TIME_ELAPSED queries, can nest and overlap, so passes can be timed
+	// inside the frame and inside each other. A pass run several times in a frame adds up
+	class GpuProfiler {
+	public:
+		GpuProfiler(void);
+		~GpuProfiler();
+
+		// Create the queries, needs a GL context. Without timer queries nothing is measured
+		void Init(void);
+		bool IsSupported(void) const;
+		// Delete the queries, call while the GL context still exists
+		void Clear(void);
+
+		// Bracket a frame, which is also FramePass. EndFrame reads back the oldest frame in flight
+		void BeginFrame(void);
+		void EndFrame(void);
+		// Bracket a pass
+		void Begin(GpuPass pass);
+		void End(GpuPass pass);
+
+		// Whether the last EndFrame read back a frame
+		bool HasNewResults(void) const;
+		// Frame the results are of, counted from the first BeginFrame, -1 before the first results
+		long GetMeasuredFrame(void) const;
+		// Milliseconds pass took on the GPU in that frame, 0 if it didn't run
+		float GetTime(GpuPass pass) const;
+		// Times pass ran in that frame
+		int GetRuns(GpuPass pass) const;
+
+		// Name of pass, for reports
+		static const char *GetName(GpuPass pass);
+
+	private:
+		// A pass and its two timestamps, indices into the queries of the frame
+		struct Range {
+			GpuPass pass;
+			int begin;
+			int end; // -1 while the pass runs
+		};
+
+		bool initialized_;
+		long frame_; // Frames begun so far
+		GLuint queries_[GPU_PROFILER_FRAMES][GPU_PROFILER_QUERIES];
+		int used_[GPU_PROFILER_FRAMES]; // Queries issued by the frame using the slot
+		std::vector<Range> ranges_[GPU_PROFILER_FRAMES];
+		int open_[HelicopterPass + 1]; // Range of the pass running, or -1
+
+		bool fresh_;
+		long measured_frame_;
+		float times_[HelicopterPass + 1];
+		int runs_[HelicopterPass + 1];
+
+		// Read the queries of slot, if the GPU is done with them
+		bool Read(int slot);
+
+		GpuProfiler(const GpuProfiler &);
+		GpuProfiler &operator=(const GpuProfiler &);
+	}; // class GpuProfiler
+} // namespace game
+#endif // GPU_PROFILER_H_
@@ -5,6 +5,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include "helicopter.h"
+#include "gpu_counters.h"
 
 namespace game {
 	Helicopter::Helicopter(void) {}
@@ -49,18 +50,18 @@ namespace game {
 		position_ += trans;
 	}
 
-	void Helicopter::Update(double timer) { //keep momentum going
-		this->Translate(this->GetForward()*vel_z);
-		this->Translate(this->GetSide()*vel_x);
-		this->Translate(this->GetUp()*vel_y);
-
-		// spin the helicopter's blades over time
-		if (timer > 0.001) { // 1 miliseconds interval
-			glm::quat topRotation = glm::angleAxis(2.0f * glm::pi<float>() / 180.0f, glm::vec3(0.0, 1.0, 0.0));
-			glm::quat backRotation = glm::angleAxis(2.0f * glm::pi<float>() / 180.0f, glm::vec3(1.0, 0.0, 0.0));
-			topOrientation *= topRotation;
-			backOrientation *= backRotation;
-		}
+	void Helicopter::Update(double delta_time) { //keep momentum going
+		float t = delta_time;
+		this->Translate(this->GetForward()*vel_z*t);
+		this->Translate(this->GetSide()*vel_x*t);
+		this->Translate(this->GetUp()*vel_y*t);
+
+		// spin the helicopter's blades over time, 120 degrees per second
+		float blade_angle = 120.0f * glm::pi<float>() / 180.0f * t;
+		glm::quat topRotation = glm::angleAxis(blade_angle, glm::vec3(0.0, 1.0, 0.0));
+		glm::quat backRotation = glm::angleAxis(blade_angle, glm::vec3(1.0, 0.0, 0.0));
+		topOrientation *= topRotation;
+		backOrientation *= backRotation;
 	}
 
 	void Helicopter::SetView(glm::vec3 position, glm::vec3 look_at, glm::vec3 up) {
@@ -177,6 +178,7 @@ namespace game {
 		glGenBuffers(1, &cubeVertexBuffer);
 		glBindBuffer(GL_ARRAY_BUFFER, cubeVertexBuffer);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(vertex), vertex, GL_STATIC_DRAW);
+		GpuCounters::CountBufferUpload();
 
 		// Return number of elements in array buffer
 		return sizeof(vertex) / (sizeof(GLfloat) * 9);
@@ -328,11 +330,13 @@ namespace game {
 		glGenBuffers(1, &cylVertexBuffer);
 		glBindBuffer(GL_ARRAY_BUFFER, cylVertexBuffer);
 		glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
+		GpuCounters::CountBufferUpload();
 
 		// Create buffer for faces
 		glGenBuffers(1, &cylFaceBuffer);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylFaceBuffer);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+		GpuCounters::CountBufferUpload();
 
 		// Free data buffers
 		delete[] vertex;
@@ -399,7 +403,7 @@ namespace game {
 		return scn;
 	}
 
-	void Helicopter::DrawHelicopter(GLuint program, Camera *camera) {
+	void Helicopter::DrawHelicopter(GLuint program, FrameUniforms *frame_uniforms) {
 		if (first) { //only generate the meshes on the first run
 			cyl_size = CreateCylinder();
 			size = CreateCube();
@@ -408,18 +412,12 @@ namespace game {
 
 		glUseProgram(program); //we steal this program from another resource
 		switchBuffer(cubeVertexBuffer, cubeFaceBuffer, program, 9);
-		camera->SetupShader(program);
 		SetupShader(program);
 
 		GLint world_mat = glGetUniformLocation(program, "world_mat");
 
-		// Set view matrix in shader
-		GLint view_mat = glGetUniformLocation(program, "view_mat");
-		glUniformMatrix4fv(view_mat, 1, GL_FALSE, glm::value_ptr(view_matrix_));
-
-		// Set projection matrix in shader
-		GLint projection_mat = glGetUniformLocation(program, "projection_mat");
-		glUniformMatrix4fv(projection_mat, 1, GL_FALSE, glm::value_ptr(projection_matrix_));
+		// Set view and projection matrices for the rest of the frame
+		frame_uniforms->UploadView(view_matrix_, projection_matrix_, position_);
 
 		glm::mat4 base = glm::translate(glm::mat4(1.0), glm::vec3(0, -5.5, 740)) * glm::rotate(glm::mat4(1.0), glm::pi<float>(), glm::vec3(0.0, 1.0, 0.0));
 
@@ -430,11 +428,13 @@ namespace game {
 		glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(local));
 		switchBuffer(cubeVertexBuffer, cubeFaceBuffer, program, 9);
 		glDrawArrays(GL_TRIANGLES, 0, size);
+		GpuCounters::CountDraw(size / 3);
 
 		// cockpit
 		local = base * glm::translate(glm::mat4(1.0), glm::vec3(0, -0.5, 3.5)) * glm::scale(glm::mat4(1.0), glm::vec3(2.0, 1.0, 1.0));
 		glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(local));
 		glDrawArrays(GL_TRIANGLES, 0, size);
+		GpuCounters::CountDraw(size / 3);
 
 		glm::mat4 parent;
 
@@ -444,22 +444,26 @@ namespace game {
 		glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(local));
 		switchBuffer(cylVertexBuffer, cylFaceBuffer, program, 11);
 		glDrawElements(GL_TRIANGLES, cyl_size, GL_UNSIGNED_INT, 0);
+		GpuCounters::CountDraw(cyl_size / 3);
 
 		// top rotor blade
 		local = parent * glm::mat4_cast(topOrientation) * glm::rotate(glm::mat4(1.0), glm::pi<float>() / 2, glm::vec3(0.0, 0.0, 1.0)) * glm::scale(glm::mat4(1.0), glm::vec3(0.2, 12.0, 0.2));
 		glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(local));
 		glDrawElements(GL_TRIANGLES, cyl_size, GL_UNSIGNED_INT, 0);
+		GpuCounters::CountDraw(cyl_size / 3);
 
 		// back rotor base
 		parent = base * glm::translate(glm::mat4(1.0), glm::vec3(0, 0, -5));
 		local = parent * glm::rotate(glm::mat4(1.0), glm::pi<float>() / 2, glm::vec3(1.0, 0.0, 0.0)) * glm::scale(glm::mat4(1.0), glm::vec3(0.75, 4.0, 0.75));
 		glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(local));
 		glDrawElements(GL_TRIANGLES, cyl_size, GL_UNSIGNED_INT, 0);
+		GpuCounters::CountDraw(cyl_size / 3);
 
 		// back rotor
 		local = parent * glm::translate(glm::mat4(1.0), glm::vec3(0.5, 0, -1.5)) * glm::mat4_cast(backOrientation) * glm::scale(glm::mat4(1.0), glm::vec3(0.1, 3.0, 0.1));
 		glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(local));
 		glDrawElements(GL_TRIANGLES, cyl_size, GL_UNSIGNED_INT, 0);
+		GpuCounters::CountDraw(cyl_size / 3);
 	}
 
 } // namespace game
@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 #include "resource_manager.h"
 #include "camera.h"
+#include "frame_uniforms.h"
 #include "scene_graph.h"
 
 namespace game {
@@ -24,9 +25,9 @@ namespace game {
 		void SetOrientation(glm::quat orientation);
 		void Translate(glm::vec3 trans);
 
-		// here we go boys
+		// here we go boys, in units per second
 		float vel_x = 0, vel_y = 0, vel_z = 0;
-		void Update(double timer);
+		void Update(double delta_time);
 
 		// Get relative attributes of camera
 		glm::vec3 GetForward(void) const;
@@ -58,7 +59,8 @@ namespace game {
 		SceneNode* initHeli(ResourceManager *resman, SceneGraph *scene);
 		SceneNode* CreateInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name, ResourceManager *resman_, SceneGraph *scene_);
 		
-		void DrawHelicopter(GLuint program, Camera *camera);
+		// Draw with the helicopter's own view, replacing the one in the per-frame block
+		void DrawHelicopter(GLuint program, FrameUniforms *frame_uniforms);
 
 	private:
 		glm::vec3 position_; // Position of camera
@@ -0,0 +1,106 @@
+#include <stdexcept>
+#include <iostream>
+#include "input_log.h"
+
+namespace game {
+	InputLog::InputLog(void) {
+		header_.magic = INPUT_LOG_MAGIC;
+		header_.version = INPUT_LOG_VERSION;
+		header_.seed = 0;
+		header_.ticks = 0;
+		header_.delta_time = 0.0;
+		header_.checksum = 0;
+		next_event_ = 0;
+	}
+
+	InputLog::~InputLog() {
+		// A session that ended without Close still replays, it just has nothing to compare against
+		if (out_.is_open()) {
+			Close(0);
+		}
+	}
+
+	void InputLog::Record(const std::string &filename, unsigned int seed, double delta_time) {
+		out_.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out_) {
+			throw(std::ios_base::failure(std::string("Error opening input log ") + filename));
+		}
+		filename_ = filename;
+		header_.seed = seed;
+		header_.ticks = 0;
+		header_.delta_time = delta_time;
+		header_.checksum = 0;
+		// Rewritten with the step count when the log is closed
+		out_.write((const char *)&header_, sizeof(header_));
+	}
+
+	void InputLog::Load(const std::string &filename) {
+		std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary);
+		if (!f) {
+			throw(std::ios_base::failure(std::string("Error opening input log ") + filename));
+		}
+		InputLogHeader header;
+		if (!f.read((char *)&header, sizeof(header)) || header.magic != INPUT_LOG_MAGIC || header.version != INPUT_LOG_VERSION) {
+			throw(std::ios_base::failure(std::string("Not an input log: ") + filename));
+		}
+		header_ = header;
+		events_.clear();
+		InputLogEvent event;
+		while (f.read((char *)&event, sizeof(event))) {
+			events_.push_back(event);
+		}
+		next_event_ = 0;
+	}
+
+	bool InputLog::IsRecording(void) const {
+		return out_.is_open();
+	}
+
+	void InputLog::RecordTick(const std::vector<KeyEvent> &keys) {
+		for (unsigned int i = 0; i < keys.size(); i++) {
+			InputLogEvent event = { header_.ticks, (short)keys[i].key, (unsigned char)keys[i].action, (unsigned char)keys[i].mods };
+			out_.write((const char *)&event, sizeof(event));
+		}
+		header_.ticks++;
+	}
+
+	void InputLog::Close(unsigned long long checksum) {
+		if (!out_.is_open()) {
+			return;
+		}
+		header_.checksum = checksum;
+		out_.seekp(0);
+		out_.write((const char *)&header_, sizeof(header_));
+		out_.close();
+		if (!out_) {
+			std::cerr << "Error writing input log " << filename_ << std::endl;
+		}
+	}
+
+	unsigned int InputLog::GetSeed(void) const {
+		return header_.seed;
+	}
+
+	double InputLog::GetDeltaTime(void) const {
+		return header_.delta_time;
+	}
+
+	unsigned int InputLog::GetTicks(void) const {
+		return header_.ticks;
+	}
+
+	unsigned long long InputLog::GetChecksum(void) const {
+		return header_.checksum;
+	}
+
+	void InputLog::GetTick(unsigned int tick, std::vector<KeyEvent> &keys) {
+		keys.clear();
+		while (next_event_ < events_.size() && events_[next_event_].tick <= tick) {
+			const InputLogEvent &event = events_[next_event_++];
+			if (event.tick == tick) {
+				KeyEvent key = { event.key, event.action, event.mods };
+				keys.push_back(key);
+			}
+		}
+	}
+} // namespace game
@@ -0,0 +1,73 @@
+#ifndef INPUT_LOG_H_
+#define INPUT_LOG_H_
+#include <string>
+#include <vector>
+#include <fstream>
+
+#define INPUT_LOG_MAGIC 0x4c525048 // "HPRL"
+#define INPUT_LOG_VERSION 1
+
+namespace game {
+	// A key pressed, released or repeated, as GLFW reports it
+	struct KeyEvent {
+		int key;
+		int action;
+		int mods;
+	};
+
+	// Start of an input log. It is followed by one InputLogEvent per key event, in step order
+	struct InputLogHeader {
+		unsigned int magic;
+		unsigned int version;
+		unsigned int seed; // rand() was seeded with this before loading
+		unsigned int ticks; // Steps recorded
+		double delta_time; // Length of every step
+		unsigned long long checksum; // State of the scene after the last step, see Game::StateChecksum
+	};
+
+	// One key event and the step it was applied on
+	struct InputLogEvent {
+		unsigned int tick;
+		short key;
+		unsigned char action;
+		unsigned char mods;
+	};
+
+	// Records the keys applied on each simulation step so the session can be run again exactly:
+	// with the same seed and step length, the same keys on the same steps give the same game.
+	// Steps without keys take no space
+	class InputLog {
+	public:
+		InputLog(void);
+		~InputLog();
+
+		// Start recording into filename, throws if it can't be written
+		void Record(const std::string &filename, unsigned int seed, double delta_time);
+		// Read the whole log in filename, throws if it is missing or not an input log
+		void Load(const std::string &filename);
+
+		bool IsRecording(void) const;
+		// Write the keys applied on the next step
+		void RecordTick(const std::vector<KeyEvent> &keys);
+		// Finish the file with the step count and the final checksum
+		void Close(unsigned long long checksum);
+
+		unsigned int GetSeed(void) const;
+		double GetDeltaTime(void) const;
+		unsigned int GetTicks(void) const;
+		unsigned long long GetChecksum(void) const;
+		// Keys applied on step tick of a loaded log, steps must be asked for in order
+		void GetTick(unsigned int tick, std::vector<KeyEvent> &keys);
+
+	private:
+		InputLogHeader header_;
+		std::ofstream out_;
+		std::string filename_;
+		std::vector<InputLogEvent> events_; // Of a loaded log
+		size_t next_event_;
+
+		InputLog(const InputLog &);
+		InputLog &operator=(const InputLog &);
+	}; // class InputLog
+} // namespace game
+#endif // INPUT_LOG_H_
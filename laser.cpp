@@ -1,4 +1,5 @@
 #include "laser.h"
+#include "scene_snapshot.h"
 
 namespace game {
 	Laser::Laser(const std::string name, const Resource *geometry,
@@ -6,6 +7,18 @@ namespace game {
 
 	Laser::~Laser() {}
 
+	void Laser::SaveState(SnapshotNode &state) const {
+		SceneNode::SaveState(state);
+		state.extra[0] = direction.x;
+		state.extra[1] = direction.y;
+		state.extra[2] = direction.z;
+	}
+
+	void Laser::RestoreState(const SnapshotNode &state) {
+		SceneNode::RestoreState(state);
+		direction = glm::vec3(state.extra[0], state.extra[1], state.extra[2]);
+	}
+
 	glm::vec3 Laser::GetDir(void) const {
 		return direction;
 	}
@@ -15,9 +28,10 @@ namespace game {
 	}
 
 	void Laser::Update(double delta_time) {
-		glm::quat rotation = glm::angleAxis(glm::pi<float>() / 180.0f, glm::vec3(0.0, 0.0, 1.0));
+		float t = delta_time;
+		glm::quat rotation = glm::angleAxis(spin_speed * t, glm::vec3(0.0, 0.0, 1.0));
 		this->SetOrientation(this->GetOrientation() * rotation); //laser cube spins as it flies away to give more of a "lasery" impression
 
-		this->Translate(direction); //the shot keeps moving in the direction we originally fired it from
+		this->Translate(direction * speed * t); //the shot keeps moving in the direction we originally fired it from
 	}
 } // namespace game
\ No newline at end of file
@@ -20,10 +20,14 @@ namespace game {
 		void SetDir(glm::vec3 dir);
 
 		void Update(double delta_time);
+		// Also the direction
+		void SaveState(SnapshotNode &state) const;
+		void RestoreState(const SnapshotNode &state);
 
 	private:
 		glm::vec3 direction;
-		float speed = 5.0;
+		float speed = 60.0; // Units per second
+		float spin_speed = glm::pi<float>() / 3.0f; // Radians per second
 	}; // class
 } // namespace game
 #endif // LASER_H_
@@ -5,11 +5,19 @@ in vec3 vertex;
 in vec3 normal;
 in vec3 color;
 
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
+
 // Uniform (global) buffer
 uniform mat4 world_mat;
-uniform mat4 view_mat;
 uniform mat4 normal_mat;
-uniform float timer;
+uniform float burst_timer;
 uniform float red;
 uniform float green;
 uniform float blue;
@@ -39,7 +47,7 @@ void main()
 
     // Define time in a cyclic manner
     float phase = two_pi*particle_id; // Start the sin wave later depending on the particle_id
-    float param = timer / 10.0 + phase; // The constant that divides "timer" also helps to adjust the "speed" of the fire
+    float param = burst_timer / 10.0 + phase; // The constant that divides "burst_timer" also helps to adjust the "speed" of the fire
     float rem = mod(param, pi_over_two); // Use the remainder of dividing by pi/2 so that we are always in the range [0..pi/2] where sin() gives values in [0..1]
     float circtime = sin(rem); // Get time value in [0..1], according to a sinusoidal wave
                                     
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <exception>
 #include <time.h>
+#include <string.h>
+#include <stdlib.h>
 #include "game.h"
 
 // Macro for printing exceptions
@@ -9,17 +11,112 @@
 	std::cerr << exception_object.what() << std::endl
 
 // Main function that builds and runs the game
-int main(void) {
+// --bench-obj [iterations] measures mesh parsing instead of running the game
+// --bench-steering times enemy steering one enemy at a time against the batched kernel
+// --bench-projectiles times 100k projectiles flying at the tick rate
+// --bench-snapshot [file] times saving and loading snapshots of a 10k node scene, or of the one in file
+// --mesh-stats reports what the mesh optimization passes do to each mesh
+// --texture-budget <MB> limits the memory taken by texture mips while the game runs
+// --tick-rate <Hz> [max steps] sets the simulation rate, and the steps run at most per frame to catch up
+// --cycle-levels [count] releases and loads the level resources count times instead of playing
+// --record <file> saves the seed and the keys of every simulation step while playing
+// --replay <file> runs a recorded session again without drawing and prints the time each step took
+// --profile-frames <count> plays count frames and prints the CPU time of every phase and the GPU time of every render pass
+int main(int argc, char **argv) {
+	if (argc > 1 && strcmp(argv[1], "--bench-obj") == 0) {
+		try {
+			game::Game::BenchmarkObjParser(argc > 2 ? atoi(argv[2]) : 100);
+		}
+		catch (std::exception &e) {
+			PrintException(e);
+		}
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-steering") == 0) {
+		try {
+			game::Game::BenchmarkSteering();
+		}
+		catch (std::exception &e) {
+			PrintException(e);
+		}
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-projectiles") == 0) {
+		try {
+			game::Game::BenchmarkProjectiles();
+		}
+		catch (std::exception &e) {
+			PrintException(e);
+		}
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-snapshot") == 0) {
+		try {
+			game::Game::BenchmarkSnapshot(argc > 2 ? argv[2] : NULL);
+		}
+		catch (std::exception &e) {
+			PrintException(e);
+		}
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--mesh-stats") == 0) {
+		try {
+			game::Game::ReportMeshOptimization();
+		}
+		catch (std::exception &e) {
+			PrintException(e);
+		}
+		return 0;
+	}
+
 	game::Game app; // Game application
-	srand(time(NULL));
+	// Recorded with the session, a replay seeds rand() from the recording instead
+	unsigned int seed = (unsigned int)time(NULL);
+	srand(seed);
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--texture-budget") == 0) {
+			app.SetTextureBudget(atoi(argv[i + 1]));
+		}
+	}
 	try {
+		for (int i = 1; i + 1 < argc; i++) {
+			if (strcmp(argv[i], "--tick-rate") == 0) {
+				app.SetTickRate(atof(argv[i + 1]), (i + 2 < argc && argv[i + 2][0] != '-') ? atoi(argv[i + 2]) : 5);
+			}
+		}
+		bool replaying = false;
+		int profile_frames = 0;
+		for (int i = 1; i + 1 < argc; i++) {
+			if (strcmp(argv[i], "--profile-frames") == 0) {
+				profile_frames = atoi(argv[i + 1]);
+			}
+			if (strcmp(argv[i], "--record") == 0) {
+				app.Record(argv[i + 1], seed);
+			}
+			if (strcmp(argv[i], "--replay") == 0) {
+				app.LoadReplay(argv[i + 1]);
+				replaying = true;
+			}
+		}
 		// Initialize game
 		app.Init();
 		// Setup the main resources and scene in the game
 		app.SetupResources();
+		if (argc > 1 && strcmp(argv[1], "--cycle-levels") == 0) {
+			app.CycleLevels(argc > 2 ? atoi(argv[2]) : 10);
+			return 0;
+		}
 		app.SetupScene();
 		// Run game
-		app.MainLoop();
+		if (replaying) {
+			app.Replay();
+		}
+		else if (profile_frames > 0) {
+			app.Profile(profile_frames);
+		}
+		else {
+			app.MainLoop();
+		}
 	}
 	catch (std::exception &e) {
 		PrintException(e);
@@ -1,4 +1,5 @@
 #version 130
+#extension GL_ARB_uniform_buffer_object : require
 
 // Attributes passed from the vertex shader
 in vec4 color_interp;
@@ -6,7 +7,14 @@ in vec3 position_interp;
 in vec3 normal_interp;
 in vec3 light_pos;
 
-uniform float light;
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
 
 vec4 ambient_color = vec4(0.0, 0.1, 0.1, 1.0);
 vec4 diffuse_color = vec4(0.2, 0.2, 0.4, 1.0);
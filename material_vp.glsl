@@ -1,14 +1,22 @@
 #version 130
+#extension GL_ARB_uniform_buffer_object : require
 
 // Vertex buffer
 in vec3 vertex;
 in vec3 color;
 in vec3 normal;
 
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
+
 // Uniform (global) buffer
 uniform mat4 world_mat;
-uniform mat4 view_mat;
-uniform mat4 projection_mat;
 uniform mat4 normal_mat;
 
 // Attributes forwarded to the fragment shader
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "mesh_cache.h"
+#include "obj_parser.h"
+
+namespace game {
+	unsigned long long fnv1a_hash(const char *data, size_t size, unsigned long long hash) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= (unsigned char)data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	// Modification time and size of filename, returns false if it doesn't exist
+	static bool source_stat(const char *filename, long long &mtime, unsigned long long &size) {
+		struct stat info;
+		if (stat(filename, &info) != 0) {
+			return false;
+		}
+		mtime = (long long)info.st_mtime;
+		size = (unsigned long long)info.st_size;
+		return true;
+	}
+
+	static std::string cache_filename(const char *source) {
+		return std::string(source) + std::string(MESH_CACHE_EXTENSION);
+	}
+
+	MappedFile::MappedFile(void) {
+		data_ = NULL;
+		size_ = 0;
+#ifdef _WIN32
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = NULL;
+#else
+		file_ = -1;
+#endif
+	}
+
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+	bool MappedFile::Open(const char *filename) {
+		Close();
+#ifdef _WIN32
+		file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file_ == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+			Close();
+			return false;
+		}
+		mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping_) {
+			Close();
+			return false;
+		}
+		data_ = (const char *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+		size_ = (size_t)size.QuadPart;
+#else
+		file_ = open(filename, O_RDONLY);
+		if (file_ < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(file_, &info) != 0 || info.st_size == 0) {
+			Close();
+			return false;
+		}
+		void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file_, 0);
+		data_ = (data == MAP_FAILED) ? NULL : (const char *)data;
+		size_ = (size_t)info.st_size;
+#endif
+		if (!data_) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::Close(void) {
+#ifdef _WIN32
+		if (data_) {
+			UnmapViewOfFile(data_);
+		}
+		if (mapping_) {
+			CloseHandle(mapping_);
+		}
+		if (file_ != INVALID_HANDLE_VALUE) {
+			CloseHandle(file_);
+		}
+		file_ = INVALID_HANDLE_VALUE;
+		mapping_ = NULL;
+#else
+		if (data_) {
+			munmap((void *)data_, size_);
+		}
+		if (file_ >= 0) {
+			close(file_);
+		}
+		file_ = -1;
+#endif
+		data_ = NULL;
+		size_ = 0;
+	}
+
+	const char *MappedFile::GetData(void) const {
+		return data_;
+	}
+
+	size_t MappedFile::GetSize(void) const {
+		return size_;
+	}
+
+	MeshCache::MeshCache(void) {
+		header_ = NULL;
+	}
+
+	bool MeshCache::Open(const char *source) {
+		header_ = NULL;
+		long long mtime;
+		unsigned long long size;
+		if (!source_stat(source, mtime, size)) {
+			return false;
+		}
+
+		std::string filename = cache_filename(source);
+		if (!file_.Open(filename.c_str()) || file_.GetSize() < sizeof(MeshCacheHeader)) {
+			file_.Close();
+			return false;
+		}
+
+		// Check that the file was written by this version for this source, and is complete
+		const MeshCacheHeader *header = (const MeshCacheHeader *)file_.GetData();
+		size_t expected = sizeof(MeshCacheHeader) + (size_t)header->vertex_floats * sizeof(GLfloat) + (size_t)header->index_count * sizeof(GLuint);
+		if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION ||
+			header->source_path_hash != fnv1a_hash(source, strlen(source)) ||
+			header->source_size != size || file_.GetSize() != expected) {
+			file_.Close();
+			return false;
+		}
+
+		if (header->source_mtime != mtime) {
+			// The source was touched (e.g. by a checkout), keep the binary file if the contents are the same
+			std::vector<char> text;
+			try {
+				read_file(source, text);
+			}
+			catch (std::exception &) {
+				file_.Close();
+				return false;
+			}
+			unsigned long long hash = fnv1a_hash(text.empty() ? NULL : &text[0], text.size());
+			if (hash != header->source_hash) {
+				file_.Close();
+				return false;
+			}
+
+			// Store the new time so the next start doesn't hash the source again
+			file_.Close();
+			std::fstream f(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+			f.seekp(offsetof(MeshCacheHeader, source_mtime));
+			f.write((const char *)&mtime, sizeof(mtime));
+			f.close();
+			if (!file_.Open(filename.c_str()) || file_.GetSize() != expected) {
+				file_.Close();
+				return false;
+			}
+			header = (const MeshCacheHeader *)file_.GetData();
+		}
+
+		header_ = header;
+		return true;
+	}
+
+	const MeshCacheHeader &MeshCache::GetHeader(void) const {
+		return *header_;
+	}
+
+	const GLfloat *MeshCache::GetVertices(void) const {
+		return (const GLfloat *)(file_.GetData() + sizeof(MeshCacheHeader));
+	}
+
+	const GLuint *MeshCache::GetIndices(void) const {
+		return (const GLuint *)(GetVertices() + header_->vertex_floats);
+	}
+
+	void MeshCache::Write(const char *source, const std::vector<char> &text, const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices) {
+		MeshCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		if (!source_stat(source, header.source_mtime, header.source_size)) {
+			return;
+		}
+		header.magic = MESH_CACHE_MAGIC;
+		header.version = MESH_CACHE_VERSION;
+		header.source_path_hash = fnv1a_hash(source, strlen(source));
+		header.source_hash = fnv1a_hash(text.empty() ? NULL : &text[0], text.size());
+		header.vertex_floats = (unsigned int)vertices.size();
+		header.index_count = (unsigned int)indices.size();
+
+		// Bounds of the positions, the first three floats of every vertex
+		for (int k = 0; k < 3; k++) {
+			header.min_corner[k] = header.max_corner[k] = vertices.empty() ? 0.0f : vertices[k];
+		}
+		for (size_t i = 0; i + 11 <= vertices.size(); i += 11) {
+			for (int k = 0; k < 3; k++) {
+				header.min_corner[k] = std::min(header.min_corner[k], vertices[i + k]);
+				header.max_corner[k] = std::max(header.max_corner[k], vertices[i + k]);
+			}
+		}
+
+		// Write to a temporary file first so a crash never leaves a truncated mesh behind
+		std::string filename = cache_filename(source);
+		std::string temp = filename + std::string(".tmp");
+		std::ofstream f(temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (f.fail()) {
+			return;
+		}
+		f.write((const char *)&header, sizeof(header));
+		if (!vertices.empty()) {
+			f.write((const char *)&vertices[0], vertices.size() * sizeof(GLfloat));
+		}
+		if (!indices.empty()) {
+			f.write((const char *)&indices[0], indices.size() * sizeof(GLuint));
+		}
+		f.close();
+		if (f.fail()) {
+			remove(temp.c_str());
+			return;
+		}
+		remove(filename.c_str());
+		if (rename(temp.c_str(), filename.c_str()) != 0) {
+			remove(temp.c_str());
+		}
+	}
+} // namespace game
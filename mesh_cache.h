@@ -0,0 +1,80 @@
+#ifndef MESH_CACHE_H_
+#define MESH_CACHE_H_
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Binary mesh files are written next to their source, with this extension appended
+#define MESH_CACHE_EXTENSION ".meshbin"
+#define MESH_CACHE_MAGIC 0x48534d48 // "HMSH"
+#define MESH_CACHE_VERSION 3
+
+namespace game {
+	// Start of a binary mesh file. It is followed by vertex_floats floats
+	// (11 per vertex, as in the vertex buffers) and index_count indices
+	struct MeshCacheHeader {
+		unsigned int magic;
+		unsigned int version;
+		unsigned long long source_path_hash; // Hash of the path the mesh was built from
+		long long source_mtime; // Modification time and size of the source when the mesh was built
+		unsigned long long source_size;
+		unsigned long long source_hash; // Hash of the source contents, checked when the time changes
+		unsigned int vertex_floats;
+		unsigned int index_count;
+		float min_corner[3]; // Bounds of the positions
+		float max_corner[3];
+	};
+
+	// Read-only view of a whole file mapped in memory
+	class MappedFile {
+	public:
+		MappedFile(void);
+		~MappedFile();
+
+		// Map filename, returns false if it can't be opened
+		bool Open(const char *filename);
+		void Close(void);
+
+		const char *GetData(void) const;
+		size_t GetSize(void) const;
+
+	private:
+		const char *data_;
+		size_t size_;
+#ifdef _WIN32
+		void *file_;
+		void *mapping_;
+#else
+		int file_;
+#endif
+		MappedFile(const MappedFile &);
+		MappedFile &operator=(const MappedFile &);
+	}; // class MappedFile
+
+	// Binary version of a mesh file, mapped when it is still valid for its source
+	class MeshCache {
+	public:
+		MeshCache(void);
+
+		// Map the binary file of source, returns false if it is missing, corrupt or older than the source
+		bool Open(const char *source);
+
+		const MeshCacheHeader &GetHeader(void) const;
+		const GLfloat *GetVertices(void) const;
+		const GLuint *GetIndices(void) const;
+
+		// Write the binary file of source, whose contents are text. Failures are ignored
+		// since the source can always be parsed again
+		static void Write(const char *source, const std::vector<char> &text, const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices);
+
+	private:
+		MappedFile file_;
+		const MeshCacheHeader *header_;
+	}; // class MeshCache
+
+	// 64-bit FNV-1a hash of size bytes
+	unsigned long long fnv1a_hash(const char *data, size_t size, unsigned long long hash = 14695981039346656037ULL);
+} // namespace game
+#endif // MESH_CACHE_H_
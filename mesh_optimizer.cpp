@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include "mesh_optimizer.h"
+#include "mesh_cache.h"
+
+namespace game {
+	void optimize_mesh(const std::vector<GLfloat> &expanded, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices, MeshOptimizerStats *stats, int vertex_att) {
+		const int cache_size = MESH_OPTIMIZER_CACHE_SIZE;
+		size_t input_vertices = expanded.size() / vertex_att;
+
+		deduplicate_vertices(expanded, vertex_att, vertices, indices);
+		size_t vertex_count = vertices.size() / vertex_att;
+		float indexed_acmr = compute_acmr(indices, vertex_count, cache_size);
+
+		std::vector<GLuint> clusters;
+		optimize_vertex_cache(indices, vertex_count, cache_size, &clusters);
+		float vertex_cache_acmr = compute_acmr(indices, vertex_count, cache_size);
+
+		int num_clusters = 0;
+		optimize_overdraw(indices, vertices, vertex_att, clusters, cache_size, MESH_OPTIMIZER_OVERDRAW_THRESHOLD, &num_clusters);
+		optimize_vertex_fetch(vertices, vertex_att, indices);
+
+		if (stats) {
+			stats->input_vertices = (int)input_vertices;
+			stats->output_vertices = (int)(vertices.size() / vertex_att);
+			stats->triangles = (int)(indices.size() / 3);
+			stats->clusters = num_clusters;
+			// Every corner of the unindexed mesh is a distinct vertex, so each triangle misses three times
+			stats->input_acmr = input_vertices ? 3.0f : 0.0f;
+			stats->indexed_acmr = indexed_acmr;
+			stats->vertex_cache_acmr = vertex_cache_acmr;
+			stats->optimized_acmr = compute_acmr(indices, vertices.size() / vertex_att, cache_size);
+		}
+	}
+
+	void deduplicate_vertices(const std::vector<GLfloat> &expanded, int vertex_att, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices) {
+		size_t count = expanded.size() / vertex_att;
+		size_t stride = vertex_att * sizeof(GLfloat);
+		vertices.clear();
+		vertices.reserve(expanded.size());
+		indices.resize(count);
+
+		// Open addressing table of vertex numbers, at most half full
+		size_t table_size = 1;
+		while (table_size < count * 2) {
+			table_size *= 2;
+		}
+		const GLuint empty = (GLuint)-1;
+		std::vector<GLuint> table(table_size, empty);
+
+		for (size_t i = 0; i < count; i++) {
+			const GLfloat *vertex = &expanded[i * vertex_att];
+			size_t slot = (size_t)fnv1a_hash((const char *)vertex, stride) & (table_size - 1);
+			while (table[slot] != empty && memcmp(&vertices[table[slot] * vertex_att], vertex, stride) != 0) {
+				slot = (slot + 1) & (table_size - 1);
+			}
+			if (table[slot] == empty) {
+				table[slot] = (GLuint)(vertices.size() / vertex_att);
+				vertices.insert(vertices.end(), vertex, vertex + vertex_att);
+			}
+			indices[i] = table[slot];
+		}
+	}
+
+	void optimize_vertex_cache(std::vector<GLuint> &indices, size_t vertex_count, int cache_size, std::vector<GLuint> *clusters) {
+		size_t triangle_count = indices.size() / 3;
+		if (clusters) {
+			clusters->clear();
+		}
+		if (triangle_count == 0) {
+			return;
+		}
+
+		// Triangles using each vertex
+		std::vector<GLuint> live(vertex_count, 0);
+		for (size_t i = 0; i < triangle_count * 3; i++) {
+			live[indices[i]]++;
+		}
+		std::vector<GLuint> offset(vertex_count + 1, 0);
+		for (size_t v = 0; v < vertex_count; v++) {
+			offset[v + 1] = offset[v] + live[v];
+		}
+		std::vector<GLuint> adjacency(triangle_count * 3);
+		std::vector<GLuint> fill(offset.begin(), offset.end() - 1);
+		for (size_t i = 0; i < triangle_count * 3; i++) {
+			adjacency[fill[indices[i]]++] = (GLuint)(i / 3);
+		}
+
+		// A vertex is in the cache while fewer than cache_size misses happened since it was loaded
+		std::vector<int> cache_time(vertex_count, 0);
+		int time = cache_size + 1;
+		std::vector<bool> emitted(triangle_count, false);
+		std::vector<GLuint> dead_end;
+		std::vector<GLuint> candidates;
+		std::vector<GLuint> output;
+		output.reserve(indices.size());
+
+		size_t cursor = 0;
+		while (cursor < vertex_count && live[cursor] == 0) {
+			cursor++;
+		}
+		long fanning = (cursor < vertex_count) ? (long)cursor : -1;
+		if (clusters && fanning >= 0) {
+			clusters->push_back(0);
+		}
+
+		while (fanning >= 0) {
+			// Emit every remaining triangle around the fanning vertex
+			candidates.clear();
+			for (GLuint a = offset[fanning]; a < offset[fanning + 1]; a++) {
+				GLuint t = adjacency[a];
+				if (emitted[t]) {
+					continue;
+				}
+				for (int k = 0; k < 3; k++) {
+					GLuint v = indices[t * 3 + k];
+					output.push_back(v);
+					dead_end.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (time - cache_time[v] > cache_size) {
+						cache_time[v] = time;
+						time++;
+					}
+				}
+				emitted[t] = true;
+			}
+
+			// Next fanning vertex: the oldest candidate that will still be cached after its
+			// remaining triangles are emitted, or any candidate with triangles left
+			long next = -1;
+			int best = -1;
+			for (size_t c = 0; c < candidates.size(); c++) {
+				GLuint v = candidates[c];
+				if (live[v] == 0) {
+					continue;
+				}
+				int priority = 0;
+				if (time - cache_time[v] + 2 * (int)live[v] <= cache_size) {
+					priority = time - cache_time[v];
+				}
+				if (priority > best) {
+					best = priority;
+					next = v;
+				}
+			}
+
+			// Dead end: go back to recently used vertices, then scan for a new start
+			while (next < 0 && !dead_end.empty()) {
+				GLuint v = dead_end.back();
+				dead_end.pop_back();
+				if (live[v] > 0) {
+					next = v;
+				}
+			}
+			if (next < 0) {
+				while (cursor < vertex_count && live[cursor] == 0) {
+					cursor++;
+				}
+				if (cursor < vertex_count) {
+					next = (long)cursor;
+					if (clusters) {
+						clusters->push_back((GLuint)(output.size() / 3));
+					}
+				}
+			}
+			fanning = next;
+		}
+
+		indices.swap(output);
+	}
+
+	// Triangles in [first, last) that form a cluster, and the value they are sorted by
+	struct OverdrawCluster {
+		GLuint first;
+		GLuint last;
+		float sort_key;
+	};
+
+	static bool draw_before(const OverdrawCluster &a, const OverdrawCluster &b) {
+		return a.sort_key > b.sort_key;
+	}
+
+	// Cache misses of the triangles in [first, last) starting with a cold cache
+	static int count_misses(const std::vector<GLuint> &indices, GLuint first, GLuint last, std::vector<int> &cache_time, int &time, int cache_size) {
+		int misses = 0;
+		for (GLuint i = first * 3; i < last * 3; i++) {
+			GLuint v = indices[i];
+			if (time - cache_time[v] > cache_size) {
+				cache_time[v] = time;
+				time++;
+				misses++;
+			}
+		}
+		return misses;
+	}
+
+	// Sort the clusters of indices by how likely they are to hide the rest of the mesh
+	static void sort_clusters(const std::vector<GLuint> &indices, const std::vector<GLfloat> &vertices, int vertex_att, std::vector<OverdrawCluster> &clusters, std::vector<GLuint> &output) {
+		size_t triangle_count = indices.size() / 3;
+
+		// Centroid of the mesh, every triangle weighted by its area
+		std::vector<glm::vec3> centroid(triangle_count);
+		std::vector<glm::vec3> area_normal(triangle_count);
+		glm::vec3 mesh_centroid(0.0f);
+		float mesh_area = 0.0f;
+		for (size_t t = 0; t < triangle_count; t++) {
+			glm::vec3 p[3];
+			for (int k = 0; k < 3; k++) {
+				const GLfloat *v = &vertices[indices[t * 3 + k] * vertex_att];
+				p[k] = glm::vec3(v[0], v[1], v[2]);
+			}
+			centroid[t] = (p[0] + p[1] + p[2]) / 3.0f;
+			area_normal[t] = glm::cross(p[1] - p[0], p[2] - p[0]);
+			float area = glm::length(area_normal[t]);
+			mesh_centroid += centroid[t] * area;
+			mesh_area += area;
+		}
+		if (mesh_area > 0.0f) {
+			mesh_centroid /= mesh_area;
+		}
+
+		// Clusters far out along their own normal are likely to hide the others
+		for (size_t c = 0; c < clusters.size(); c++) {
+			glm::vec3 cluster_centroid(0.0f);
+			glm::vec3 cluster_normal(0.0f);
+			float cluster_area = 0.0f;
+			for (GLuint t = clusters[c].first; t < clusters[c].last; t++) {
+				float area = glm::length(area_normal[t]);
+				cluster_centroid += centroid[t] * area;
+				cluster_normal += area_normal[t];
+				cluster_area += area;
+			}
+			float normal_length = glm::length(cluster_normal);
+			clusters[c].sort_key = 0.0f;
+			if (cluster_area > 0.0f && normal_length > 0.0f) {
+				clusters[c].sort_key = glm::dot(cluster_centroid / cluster_area - mesh_centroid, cluster_normal / normal_length);
+			}
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), draw_before);
+
+		output.clear();
+		output.reserve(indices.size());
+		for (size_t c = 0; c < clusters.size(); c++) {
+			output.insert(output.end(), indices.begin() + clusters[c].first * 3, indices.begin() + clusters[c].last * 3);
+		}
+	}
+
+	void optimize_overdraw(std::vector<GLuint> &indices, const std::vector<GLfloat> &vertices, int vertex_att, const std::vector<GLuint> &clusters, int cache_size, float threshold, int *num_clusters) {
+		size_t triangle_count = indices.size() / 3;
+		size_t vertex_count = vertices.size() / vertex_att;
+		if (num_clusters) {
+			*num_clusters = 0;
+		}
+		if (triangle_count == 0) {
+			return;
+		}
+
+		// Split each cluster of the cache pass again wherever the triangles so far already
+		// reach its ACMR (within threshold), so moving them around costs few extra misses
+		std::vector<int> cache_time(vertex_count, 0);
+		int time = cache_size + 1;
+		std::vector<OverdrawCluster> hard, soft;
+		for (size_t c = 0; c < clusters.size(); c++) {
+			GLuint first = clusters[c];
+			GLuint last = (c + 1 < clusters.size()) ? clusters[c + 1] : (GLuint)triangle_count;
+			OverdrawCluster cluster = { first, last, 0.0f };
+			hard.push_back(cluster);
+
+			time += cache_size + 1;
+			float limit = threshold * count_misses(indices, first, last, cache_time, time, cache_size) / (float)(last - first);
+
+			time += cache_size + 1;
+			cluster.last = first;
+			int misses = 0;
+			for (GLuint t = first; t < last; t++) {
+				misses += count_misses(indices, t, t + 1, cache_time, time, cache_size);
+				if (misses <= limit * (t + 1 - cluster.first) && t + 1 < last) {
+					cluster.last = t + 1;
+					soft.push_back(cluster);
+					cluster.first = t + 1;
+					misses = 0;
+					time += cache_size + 1;
+				}
+			}
+			cluster.last = last;
+			soft.push_back(cluster);
+		}
+
+		// The last triangles of a split cluster may miss more than the whole did, fall back
+		// to the clusters of the cache pass, or to its order, when the sort costs too much
+		float limit = threshold * compute_acmr(indices, vertex_count, cache_size);
+		std::vector<GLuint> output;
+		std::vector<OverdrawCluster> *candidates[2] = { &soft, &hard };
+		for (int i = 0; i < 2; i++) {
+			sort_clusters(indices, vertices, vertex_att, *candidates[i], output);
+			if (compute_acmr(output, vertex_count, cache_size) <= limit) {
+				indices.swap(output);
+				if (num_clusters) {
+					*num_clusters = (int)candidates[i]->size();
+				}
+				return;
+			}
+		}
+		if (num_clusters) {
+			*num_clusters = 1;
+		}
+	}
+
+	void optimize_vertex_fetch(std::vector<GLfloat> &vertices, int vertex_att, std::vector<GLuint> &indices) {
+		size_t vertex_count = vertices.size() / vertex_att;
+		const GLuint unused = (GLuint)-1;
+		std::vector<GLuint> remap(vertex_count, unused);
+		std::vector<GLfloat> output;
+		output.reserve(vertices.size());
+		for (size_t i = 0; i < indices.size(); i++) {
+			GLuint v = indices[i];
+			if (remap[v] == unused) {
+				remap[v] = (GLuint)(output.size() / vertex_att);
+				output.insert(output.end(), vertices.begin() + v * vertex_att, vertices.begin() + (v + 1) * vertex_att);
+			}
+			indices[i] = remap[v];
+		}
+		vertices.swap(output);
+	}
+
+	float compute_acmr(const std::vector<GLuint> &indices, size_t vertex_count, int cache_size) {
+		size_t triangle_count = indices.size() / 3;
+		if (triangle_count == 0) {
+			return 0.0f;
+		}
+		std::vector<int> cache_time(vertex_count, 0);
+		int time = cache_size + 1;
+		int misses = count_misses(indices, 0, (GLuint)triangle_count, cache_time, time, cache_size);
+		return misses / (float)triangle_count;
+	}
+} // namespace game
@@ -0,0 +1,46 @@
+#ifndef MESH_OPTIMIZER_H_
+#define MESH_OPTIMIZER_H_
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// Entries of the post-transform vertex cache the triangle order is tuned for
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+// How much worse than the cache-optimal order the overdraw pass may make the ACMR
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD 1.05f
+
+namespace game {
+	// Effect of optimize_mesh on one mesh
+	struct MeshOptimizerStats {
+		int input_vertices; // Vertices before merging, three per triangle
+		int output_vertices;
+		int triangles;
+		int clusters; // Groups of triangles the overdraw pass sorted
+		float input_acmr; // Average cache misses per triangle of each index order
+		float indexed_acmr;
+		float vertex_cache_acmr;
+		float optimized_acmr;
+	};
+
+	// Turn an unindexed triangle list of vertex_att floats per vertex into an indexed mesh:
+	// identical vertices are merged, triangles are reordered for the vertex cache and then
+	// for overdraw, and vertices are stored in the order the triangles first use them
+	void optimize_mesh(const std::vector<GLfloat> &expanded, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices, MeshOptimizerStats *stats = 0, int vertex_att = 11);
+
+	// The individual passes of optimize_mesh
+
+	// Merge vertices whose attributes are bitwise identical
+	void deduplicate_vertices(const std::vector<GLfloat> &expanded, int vertex_att, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices);
+	// Tipsify: reorder triangles so consecutive ones share cached vertices. The first
+	// triangle of every cluster that starts with a cold cache is written to clusters
+	void optimize_vertex_cache(std::vector<GLuint> &indices, size_t vertex_count, int cache_size, std::vector<GLuint> *clusters = 0);
+	// Sort the clusters so triangles facing out of the mesh are drawn first and hide
+	// the rest. Clusters are split further wherever that costs at most threshold in ACMR
+	void optimize_overdraw(std::vector<GLuint> &indices, const std::vector<GLfloat> &vertices, int vertex_att, const std::vector<GLuint> &clusters, int cache_size, float threshold, int *num_clusters = 0);
+	// Renumber vertices in the order the indices first reference them
+	void optimize_vertex_fetch(std::vector<GLfloat> &vertices, int vertex_att, std::vector<GLuint> &indices);
+
+	// Average cache misses per triangle of the indices with a FIFO cache of cache_size entries
+	float compute_acmr(const std::vector<GLuint> &indices, size_t vertex_count, int cache_size);
+} // namespace game
+#endif // MESH_OPTIMIZER_H_
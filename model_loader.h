@@ -38,7 +38,7 @@ struct TriMesh {
 
 // Helper functions 
 // Trim any character in to_trim from the beginning and end of str
-void string_trim(std::string str, std::string to_trim);
+void string_trim(std::string &str, const std::string &to_trim);
 // Split string into substrings according to characters in separator
 std::vector<std::string> string_split(std::string str, std::string separator);
 // Split string into substrings according to characters in separator. A
@@ -13,10 +13,12 @@ namespace game {
 
 	Mole::~Mole() {}
 
-	void Mole::Update(double deltaTime) {
-		// The mole enemy rotates to face the target, but doesn't move
-		Enemy::Update(deltaTime);
+	SteeringType Mole::getSteeringType() {
+		return MoleSteering;
+	}
 
+	void Mole::Steer(double) {
+		// The mole enemy rotates to face the target, but doesn't move
 		if (target == NULL)
 			return;
 
@@ -8,7 +8,8 @@ namespace game {
 		Mole(const std::string name, SceneNode* targ, const Resource* geometry, const Resource* mat, const Resource *tex = NULL);
 		~Mole();
 
-		void Update(double t);
+		void Steer(double t);
+		SteeringType getSteeringType();
 		AttackNode* getAttack();
 
 	private:
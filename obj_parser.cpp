@@ -0,0 +1,355 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "obj_parser.h"
+
+namespace game {
+	// Powers of ten that are exact in a double
+	static const double obj_pow10_g[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	static inline bool is_blank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	static inline bool is_digit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	static inline const char *skip_blanks(const char *p, const char *end) {
+		while (p < end && is_blank(*p)) {
+			p++;
+		}
+		return p;
+	}
+
+	// Text of the line number, for error messages
+	static std::string line_suffix(int line) {
+		char text[32];
+		sprintf(text, " (line %d)", line);
+		return std::string(text);
+	}
+
+	// Turn an OBJ index (1-based, or negative to count back from the last element) into a 0-based one
+	static inline int obj_index(int index, size_t count) {
+		return (index < 0) ? (int)count + index : index - 1;
+	}
+
+	void read_file(const char *filename, std::vector<char> &buffer) {
+		std::ifstream f(filename, std::ios::in | std::ios::binary);
+		if (f.fail()) {
+			throw(std::ios_base::failure(std::string("Error opening file ") + std::string(filename)));
+		}
+		f.seekg(0, std::ios::end);
+		std::streamoff size = f.tellg();
+		f.seekg(0, std::ios::beg);
+		buffer.resize((size_t)size);
+		if (size > 0) {
+			f.read(&buffer[0], size);
+		}
+		if (f.fail()) {
+			throw(std::ios_base::failure(std::string("Error reading file ") + std::string(filename)));
+		}
+	}
+
+	const char *parse_float(const char *str, const char *end, float &value) {
+		const char *p = str;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = (*p == '-');
+			p++;
+		}
+
+		// Up to 19 significant digits fit in the mantissa, further ones only move the exponent
+		unsigned long long mantissa = 0;
+		int significant = 0;
+		int exponent = 0;
+		bool digits = false;
+		for (; p < end && is_digit(*p); p++) {
+			digits = true;
+			if (significant < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				significant += (mantissa > 0);
+			}
+			else {
+				exponent++;
+			}
+		}
+		if (p < end && *p == '.') {
+			p++;
+			for (; p < end && is_digit(*p); p++) {
+				digits = true;
+				if (significant < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					significant += (mantissa > 0);
+					exponent--;
+				}
+			}
+		}
+		if (!digits) {
+			return str;
+		}
+
+		// Exponent, only taken if it has digits
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char *q = p + 1;
+			bool negative_exponent = false;
+			if (q < end && (*q == '-' || *q == '+')) {
+				negative_exponent = (*q == '-');
+				q++;
+			}
+			if (q < end && is_digit(*q)) {
+				int e = 0;
+				for (; q < end && is_digit(*q); q++) {
+					if (e < 10000) {
+						e = e * 10 + (*q - '0');
+					}
+				}
+				exponent += negative_exponent ? -e : e;
+				p = q;
+			}
+		}
+
+		// Exact when the mantissa fits in a double and the power of ten is exact
+		double result = (double)mantissa;
+		if (exponent < 0 && exponent >= -22) {
+			result /= obj_pow10_g[-exponent];
+		}
+		else if (exponent > 0 && exponent <= 22) {
+			result *= obj_pow10_g[exponent];
+		}
+		else if (exponent != 0) {
+			result *= pow(10.0, exponent);
+		}
+		value = (float)(negative ? -result : result);
+		return p;
+	}
+
+	const char *parse_int(const char *str, const char *end, int &value) {
+		const char *p = str;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = (*p == '-');
+			p++;
+		}
+		if (p >= end || !is_digit(*p)) {
+			return str;
+		}
+		int result = 0;
+		for (; p < end && is_digit(*p); p++) {
+			result = result * 10 + (*p - '0');
+		}
+		value = negative ? -result : result;
+		return p;
+	}
+
+	// Parse up to count floats separated by blanks, returns how many were read
+	static int parse_floats(const char *&p, const char *end, float *values, int count) {
+		int read = 0;
+		while (read < count) {
+			p = skip_blanks(p, end);
+			const char *next = parse_float(p, end, values[read]);
+			if (next == p) {
+				break;
+			}
+			p = next;
+			read++;
+		}
+		return read;
+	}
+
+	bool parse_obj(const char *begin, const char *end, TriMesh &mesh) {
+		bool added_normal = false;
+		int line = 0;
+		const char *p = begin;
+		while (p < end) {
+			line++;
+			const char *line_end = (const char *)memchr(p, '\n', end - p);
+			if (!line_end) {
+				line_end = end;
+			}
+
+			// Command name, skip empty lines and comments
+			p = skip_blanks(p, line_end);
+			const char *command = p;
+			while (p < line_end && !is_blank(*p)) {
+				p++;
+			}
+			size_t length = p - command;
+			if (length == 0 || command[0] == '#') {
+				p = line_end + 1;
+				continue;
+			}
+
+			if (length == 1 && command[0] == 'v') {
+				float v[3];
+				if (parse_floats(p, line_end, v, 3) < 3) {
+					throw(std::ios_base::failure(std::string("Error: v command should have exactly 3 parameters") + line_suffix(line)));
+				}
+				mesh.position.push_back(glm::vec3(v[0], v[1], v[2]));
+			}
+			else if (length == 2 && command[0] == 'v' && command[1] == 'n') {
+				float v[3];
+				if (parse_floats(p, line_end, v, 3) < 3) {
+					throw(std::ios_base::failure(std::string("Error: vn command should have exactly 3 parameters") + line_suffix(line)));
+				}
+				mesh.normal.push_back(glm::vec3(v[0], v[1], v[2]));
+				added_normal = true;
+			}
+			else if (length == 2 && command[0] == 'v' && command[1] == 't') {
+				float v[2];
+				if (parse_floats(p, line_end, v, 2) < 2) {
+					throw(std::ios_base::failure(std::string("Error: vt command should have exactly 2 parameters") + line_suffix(line)));
+				}
+				mesh.tex_coord.push_back(glm::vec2(v[0], v[1]));
+			}
+			else if (length == 1 && command[0] == 'f') {
+				// Vertices of the face as position/texture/normal, texture and normal are optional
+				Quad quad;
+				int vertices = 0;
+				while (true) {
+					p = skip_blanks(p, line_end);
+					if (p >= line_end) {
+						break;
+					}
+					if (vertices == 4) {
+						throw(std::ios_base::failure(std::string("Error: f commands with more than 4 vertices not supported") + line_suffix(line)));
+					}
+					int index;
+					const char *next = parse_int(p, line_end, index);
+					if (next == p) {
+						throw(std::ios_base::failure(std::string("Error: invalid f parameter") + line_suffix(line)));
+					}
+					p = next;
+					quad.i[vertices] = obj_index(index, mesh.position.size());
+					quad.t[vertices] = -1;
+					quad.n[vertices] = -1;
+					if (p < line_end && *p == '/') {
+						p++;
+						next = parse_int(p, line_end, index);
+						if (next != p) {
+							quad.t[vertices] = obj_index(index, mesh.tex_coord.size());
+							p = next;
+						}
+						if (p < line_end && *p == '/') {
+							p++;
+							next = parse_int(p, line_end, index);
+							if (next == p) {
+								throw(std::ios_base::failure(std::string("Error: f parameter should have 1, 2, or 3 parameters separated by '/'") + line_suffix(line)));
+							}
+							quad.n[vertices] = obj_index(index, mesh.normal.size());
+							p = next;
+						}
+					}
+					if (p < line_end && !is_blank(*p)) {
+						throw(std::ios_base::failure(std::string("Error: f parameter should have 1, 2, or 3 parameters separated by '/'") + line_suffix(line)));
+					}
+					vertices++;
+				}
+				if (vertices < 3) {
+					throw(std::ios_base::failure(std::string("Error: f command should have 3 or 4 parameters") + line_suffix(line)));
+				}
+
+				// Break a quad into two triangles
+				Face face;
+				for (int k = 0; k < 3; k++) {
+					face.i[k] = quad.i[k]; face.n[k] = quad.n[k]; face.t[k] = quad.t[k];
+				}
+				mesh.face.push_back(face);
+				if (vertices == 4) {
+					const int second[3] = { 0, 2, 3 };
+					for (int k = 0; k < 3; k++) {
+						face.i[k] = quad.i[second[k]]; face.n[k] = quad.n[second[k]]; face.t[k] = quad.t[second[k]];
+					}
+					mesh.face.push_back(face);
+				}
+			}
+			// Ignore other commands
+
+			p = line_end + 1;
+		}
+		return added_normal;
+	}
+
+	void expand_obj_mesh(TriMesh &mesh, bool has_normals, std::vector<float> &vertices) {
+		// Check if vertex references are correct
+		for (unsigned int i = 0; i < mesh.face.size(); i++) {
+			for (int j = 0; j < 3; j++) {
+				if (mesh.face[i].i[j] < 0 || mesh.face[i].i[j] >= (int)mesh.position.size()) {
+					char text[64];
+					sprintf(text, "%d", mesh.face[i].i[j]);
+					throw(std::ios_base::failure(std::string("Error: index for triangle ") + std::string(text) + std::string(" is out of bounds")));
+				}
+			}
+		}
+
+		// Compute degree of each vertex
+		std::vector<int> degree(mesh.position.size(), 0);
+		for (unsigned int i = 0; i < mesh.face.size(); i++) {
+			for (int j = 0; j < 3; j++) {
+				degree[mesh.face[i].i[j]]++;
+			}
+		}
+
+		// Compute vertex normals if no normals were ever added
+		if (!has_normals) {
+			mesh.normal = std::vector<glm::vec3>(mesh.position.size(), glm::vec3(0.0, 0.0, 0.0));
+			for (unsigned int i = 0; i < mesh.face.size(); i++) {
+				// Compute face normal
+				glm::vec3 vec1, vec2;
+				vec1 = mesh.position[mesh.face[i].i[0]] -
+					mesh.position[mesh.face[i].i[1]];
+				vec2 = mesh.position[mesh.face[i].i[0]] -
+					mesh.position[mesh.face[i].i[2]];
+				glm::vec3 norm = glm::cross(vec1, vec2);
+				norm = glm::normalize(norm);
+				// Add face normal to vertices
+				mesh.normal[mesh.face[i].i[0]] += norm;
+				mesh.normal[mesh.face[i].i[1]] += norm;
+				mesh.normal[mesh.face[i].i[2]] += norm;
+			}
+			for (unsigned int i = 0; i < mesh.normal.size(); i++) {
+				if (degree[i] > 0) {
+					mesh.normal[i] /= degree[i];
+				}
+			}
+		}
+
+		// Create three new vertices for each face
+		const int vertex_att = OBJ_VERTEX_ATTRIBUTES;
+		vertices.assign(mesh.face.size() * 3 * vertex_att, 0.0f);
+		for (unsigned int i = 0; i < mesh.face.size(); i++) {
+			// Add three vertices and their attributes
+			float *att = &vertices[i * 3 * vertex_att];
+			for (int j = 0; j < 3; j++) {
+				// Position
+				att[j*vertex_att + 0] = mesh.position[mesh.face[i].i[j]][0];
+				att[j*vertex_att + 1] = mesh.position[mesh.face[i].i[j]][1];
+				att[j*vertex_att + 2] = mesh.position[mesh.face[i].i[j]][2];
+				// Normal
+				if (!has_normals) {
+					att[j*vertex_att + 3] = mesh.normal[mesh.face[i].i[j]][0];
+					att[j*vertex_att + 4] = mesh.normal[mesh.face[i].i[j]][1];
+					att[j*vertex_att + 5] = mesh.normal[mesh.face[i].i[j]][2];
+				}
+				else {
+					if (mesh.face[i].n[j] >= 0) {
+						att[j*vertex_att + 3] = mesh.normal[mesh.face[i].n[j]][0];
+						att[j*vertex_att + 4] = mesh.normal[mesh.face[i].n[j]][1];
+						att[j*vertex_att + 5] = mesh.normal[mesh.face[i].n[j]][2];
+					}
+				}
+				// No color in (6, 7, 8)
+				// Texture coordinates
+				if (mesh.face[i].t[j] >= 0) {
+					att[j*vertex_att + 9] = mesh.tex_coord[mesh.face[i].t[j]][0];
+					att[j*vertex_att + 10] = mesh.tex_coord[mesh.face[i].t[j]][1];
+				}
+			}
+		}
+	}
+} // namespace game
@@ -0,0 +1,28 @@
+#ifndef OBJ_PARSER_H_
+#define OBJ_PARSER_H_
+#include <vector>
+#include "model_loader.h"
+
+// Floats per vertex in the buffers built from OBJ files
+#define OBJ_VERTEX_ATTRIBUTES 11
+
+namespace game {
+	// Read a whole file into buffer
+	void read_file(const char *filename, std::vector<char> &buffer);
+
+	// Parse the OBJ text in [begin, end) into mesh in a single pass, without allocating
+	// anything per line or token. Supports v, vn, vt and triangle or quad f commands,
+	// other commands are ignored. Returns true if the file had its own vertex normals
+	bool parse_obj(const char *begin, const char *end, TriMesh &mesh);
+
+	// Build the vertex array of a parsed mesh, three vertices per face with
+	// OBJ_VERTEX_ATTRIBUTES floats each: position, normal, color (left at 0) and texture
+	// coordinates. Vertex normals are averaged from the faces when the file had none
+	void expand_obj_mesh(TriMesh &mesh, bool has_normals, std::vector<float> &vertices);
+
+	// Parse a number at the start of [str, end), like std::from_chars: returns the first
+	// character after the number, or str if there was none
+	const char *parse_float(const char *str, const char *end, float &value);
+	const char *parse_int(const char *str, const char *end, int &value);
+} // namespace game
+#endif // OBJ_PARSER_H_
@@ -9,8 +9,14 @@ in vec3 vertex_color[];
 in float timestep[];
 in float particle_id[];
 
-// Uniform (global) buffer
-uniform mat4 projection_mat;
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
 
 // Simulation parameters (constants)
 uniform float particle_size = 0.01;
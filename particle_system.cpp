@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/constants.hpp>
+#include "particle_system.h"
+#include "gpu_counters.h"
+#include "texture_streamer.h"
+
+namespace game {
+	// Random number in [0, 1]
+	static float particle_random(void) {
+		return (float)rand() / (float)RAND_MAX;
+	}
+
+	// Random direction scaled by up to 1, denser towards the center like the old sphere particles
+	static glm::vec3 particle_spray(void) {
+		float theta = particle_random() * 2.0f * glm::pi<float>();
+		float phi = acos(2.0f * particle_random() - 1.0f);
+		float spray = pow(particle_random(), 1.0f / 3.0f);
+		return glm::vec3(spray * cos(theta) * sin(phi), spray * sin(theta) * sin(phi), spray * cos(phi));
+	}
+
+	ParticleSystem::ParticleSystem(int capacity, int max_burst) {
+		capacity_ = std::max(capacity, 1);
+		max_burst_ = std::max(std::min(max_burst, capacity_), 1);
+		head_ = 0;
+		live_particles_ = 0;
+		dropped_particles_ = 0;
+		gravity_ = 2.2f;
+
+		initialized_ = false;
+		buffers_[0] = buffers_[1] = 0;
+		current_ = 0;
+		update_program_ = 0;
+		draw_program_ = 0;
+		texture_ = 0;
+	}
+
+	ParticleSystem::~ParticleSystem() {
+		if (initialized_) {
+			glDeleteBuffers(2, buffers_);
+		}
+	}
+
+	void ParticleSystem::Init(GLuint update_program, GLuint draw_program, GLuint texture) {
+		update_program_ = update_program;
+		draw_program_ = draw_program;
+		texture_ = texture;
+
+		// Both buffers hold the whole ring, the update reads one and writes the other
+		glGenBuffers(2, buffers_);
+		for (int i = 0; i < 2; i++) {
+			glBindBuffer(GL_ARRAY_BUFFER, buffers_[i]);
+			glBufferData(GL_ARRAY_BUFFER, capacity_ * PARTICLE_ATTRIBUTES * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+			GpuCounters::CountBufferUpload();
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		initialized_ = true;
+	}
+
+	void ParticleSystem::SpawnBurst(glm::vec3 position, glm::vec3 color, int count, float speed, float life) {
+		count = std::min(std::max(count, 0), max_burst_);
+		if (count == 0) {
+			return;
+		}
+
+		staging_.resize(count * PARTICLE_ATTRIBUTES);
+		for (int i = 0; i < count; i++) {
+			GLfloat *p = &staging_[i * PARTICLE_ATTRIBUTES];
+			glm::vec3 velocity = particle_spray() * speed;
+			for (int k = 0; k < 3; k++) {
+				p[k] = position[k];
+				p[k + 3] = velocity[k];
+				p[k + 6] = color[k];
+			}
+			p[9] = 0.0f;
+			p[10] = life * (0.75f + 0.25f * particle_random());
+		}
+
+		int first = Allocate(count);
+		Store(first, count);
+		ParticleBurst burst = { first, count, life };
+		bursts_.push_back(burst);
+		live_particles_ += count;
+	}
+
+	void ParticleSystem::SpawnTracer(glm::vec3 origin, glm::vec3 direction, float length, glm::vec3 color, int count, float life) {
+		count = std::min(std::max(count, 0), max_burst_);
+		if (count == 0) {
+			return;
+		}
+
+		ParticleTracer tracer = { origin, direction, length };
+		staging_.resize(count * PARTICLE_ATTRIBUTES);
+		StageTracer(0, tracer, color, count, life);
+
+		int first = Allocate(count);
+		Store(first, count);
+		ParticleBurst burst = { first, count, life };
+		bursts_.push_back(burst);
+		live_particles_ += count;
+	}
+
+	void ParticleSystem::SpawnTracers(const std::vector<ParticleTracer> &tracers, glm::vec3 color, int count, float life) {
+		count = std::min(std::max(count, 0), max_burst_);
+		if (count == 0) {
+			return;
+		}
+
+		// One upload and one draw range for every burst instead of every tracer
+		int per_burst = max_burst_ / count;
+		for (unsigned int t = 0; t < tracers.size(); t += per_burst) {
+			int in_burst = std::min(per_burst, (int)(tracers.size() - t));
+			int particles = in_burst * count;
+			staging_.resize(particles * PARTICLE_ATTRIBUTES);
+			for (int i = 0; i < in_burst; i++) {
+				StageTracer(i * count, tracers[t + i], color, count, life);
+			}
+
+			int first = Allocate(particles);
+			Store(first, particles);
+			ParticleBurst burst = { first, particles, life };
+			bursts_.push_back(burst);
+			live_particles_ += particles;
+		}
+	}
+
+	void ParticleSystem::Update(double delta_time) {
+		// Forget the bursts whose particles are all dead
+		for (std::deque<ParticleBurst>::iterator it = bursts_.begin(); it != bursts_.end();) {
+			it->time_left -= delta_time;
+			if (it->time_left <= 0.0) {
+				live_particles_ -= it->count;
+				it = bursts_.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		if (bursts_.empty()) {
+			return;
+		}
+
+		if (initialized_ && update_program_) {
+			UpdateGpu((float)delta_time);
+		}
+		else {
+			UpdateCpu((float)delta_time);
+		}
+	}
+
+	void ParticleSystem::Draw(Camera *) {
+		if (!initialized_ || bursts_.empty()) {
+			return;
+		}
+
+		// One range per burst, two for a burst that wraps around the ring
+		draw_first_.clear();
+		draw_count_.clear();
+		for (unsigned int i = 0; i < bursts_.size(); i++) {
+			GLint range_first[2];
+			GLsizei range_count[2];
+			int ranges = Ranges(bursts_[i].first, bursts_[i].count, range_first, range_count);
+			for (int r = 0; r < ranges; r++) {
+				draw_first_.push_back(range_first[r]);
+				draw_count_.push_back(range_count[r]);
+			}
+		}
+
+		// Particles are tested against the scene but don't hide each other
+		glEnable(GL_DEPTH_TEST);
+		glDepthMask(GL_FALSE);
+		glEnable(GL_BLEND);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+
+		glUseProgram(draw_program_);
+		SetupAttributes(draw_program_, buffers_[current_], true);
+
+		GLint tex = glGetUniformLocation(draw_program_, "tex_samp");
+		glUniform1i(tex, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture_);
+		TextureStreamer::MarkUsed(texture_);
+
+		glMultiDrawArrays(GL_POINTS, &draw_first_[0], &draw_count_[0], (GLsizei)draw_first_.size());
+		GpuCounters::CountDraw(0);
+
+		// Back to the state the scene nodes expect
+		SetupAttributes(draw_program_, buffers_[current_], false);
+		glDepthMask(GL_TRUE);
+		glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+		glDisable(GL_BLEND);
+	}
+
+	void ParticleSystem::SetGravity(float gravity) {
+		gravity_ = gravity;
+	}
+
+	int ParticleSystem::GetCapacity(void) const {
+		return capacity_;
+	}
+
+	int ParticleSystem::GetMaxBurst(void) const {
+		return max_burst_;
+	}
+
+	int ParticleSystem::GetLiveParticles(void) const {
+		return live_particles_;
+	}
+
+	int ParticleSystem::GetLiveBursts(void) const {
+		return (int)bursts_.size();
+	}
+
+	long ParticleSystem::GetDroppedParticles(void) const {
+		return dropped_particles_;
+	}
+
+	bool ParticleSystem::IsSimulatedOnGpu(void) const {
+		return initialized_ && update_program_;
+	}
+
+	void ParticleSystem::StageTracer(int first, const ParticleTracer &tracer, glm::vec3 color, int count, float life) {
+		for (int i = 0; i < count; i++) {
+			GLfloat *p = &staging_[(first + i) * PARTICLE_ATTRIBUTES];
+			// Spread along the line, drifting slowly away from it
+			glm::vec3 position = tracer.origin + tracer.direction * (tracer.length * particle_random());
+			glm::vec3 velocity = particle_spray() * 0.5f;
+			for (int k = 0; k < 3; k++) {
+				p[k] = position[k];
+				p[k + 3] = velocity[k];
+				p[k + 6] = color[k];
+			}
+			p[9] = 0.0f;
+			p[10] = life * (0.5f + 0.5f * particle_random());
+		}
+	}
+
+	int ParticleSystem::Allocate(int count) {
+		int first = head_;
+
+		// Everything between the head and the oldest burst is free, drop the oldest bursts
+		// until the new one fits
+		while (!bursts_.empty()) {
+			const ParticleBurst &oldest = bursts_.front();
+			int offset = (oldest.first - first + capacity_) % capacity_;
+			if (offset >= count) {
+				break;
+			}
+			live_particles_ -= oldest.count;
+			dropped_particles_ += oldest.count;
+			bursts_.pop_front();
+		}
+
+		head_ = (first + count) % capacity_;
+		return first;
+	}
+
+	void ParticleSystem::Store(int first, int count) {
+		GLint range_first[2];
+		GLsizei range_count[2];
+		int ranges = Ranges(first, count, range_first, range_count);
+
+		if (initialized_) {
+			glBindBuffer(GL_ARRAY_BUFFER, buffers_[current_]);
+			for (int r = 0, offset = 0; r < ranges; offset += range_count[r], r++) {
+				glBufferSubData(GL_ARRAY_BUFFER, range_first[r] * PARTICLE_ATTRIBUTES * sizeof(GLfloat),
+					range_count[r] * PARTICLE_ATTRIBUTES * sizeof(GLfloat), &staging_[offset * PARTICLE_ATTRIBUTES]);
+				GpuCounters::CountStreamedUpload();
+			}
+		}
+
+		if (IsSimulatedOnGpu()) {
+			return;
+		}
+
+		// Keep a copy to simulate on the CPU
+		if (pos_x_.empty()) {
+			std::vector<float> *arrays[PARTICLE_ATTRIBUTES] = { &pos_x_, &pos_y_, &pos_z_, &vel_x_, &vel_y_, &vel_z_, &col_r_, &col_g_, &col_b_, &age_, &life_ };
+			for (int k = 0; k < PARTICLE_ATTRIBUTES; k++) {
+				arrays[k]->resize(capacity_);
+			}
+		}
+		for (int i = 0; i < count; i++) {
+			int p = (first + i) % capacity_;
+			const GLfloat *src = &staging_[i * PARTICLE_ATTRIBUTES];
+			pos_x_[p] = src[0]; pos_y_[p] = src[1]; pos_z_[p] = src[2];
+			vel_x_[p] = src[3]; vel_y_[p] = src[4]; vel_z_[p] = src[5];
+			col_r_[p] = src[6]; col_g_[p] = src[7]; col_b_[p] = src[8];
+			age_[p] = src[9]; life_[p] = src[10];
+		}
+	}
+
+	int ParticleSystem::Ranges(int first, int count, GLint *range_first, GLsizei *range_count) const {
+		range_first[0] = first;
+		if (first + count <= capacity_) {
+			range_count[0] = count;
+			return 1;
+		}
+		range_count[0] = capacity_ - first;
+		range_first[1] = 0;
+		range_count[1] = count - range_count[0];
+		return 2;
+	}
+
+	int ParticleSystem::LiveSpan(GLint *range_first, GLsizei *range_count) const {
+		if (bursts_.empty()) {
+			return 0;
+		}
+		int first = bursts_.front().first;
+		int count = (head_ - first + capacity_) % capacity_;
+		if (count == 0) {
+			// The head caught up with the oldest burst, the whole ring is in use
+			count = capacity_;
+		}
+		return Ranges(first, count, range_first, range_count);
+	}
+
+	void ParticleSystem::SetupAttributes(GLuint program, GLuint buffer, bool enable) const {
+		static const char *names[] = { "position", "velocity", "color", "age", "life" };
+		static const int sizes[] = { 3, 3, 3, 1, 1 };
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		for (int a = 0, offset = 0; a < 5; offset += sizes[a], a++) {
+			GLint att = glGetAttribLocation(program, names[a]);
+			if (att < 0) {
+				continue;
+			}
+			if (enable) {
+				glVertexAttribPointer(att, sizes[a], GL_FLOAT, GL_FALSE, PARTICLE_ATTRIBUTES * sizeof(GLfloat), (void *)(offset * sizeof(GLfloat)));
+				glEnableVertexAttribArray(att);
+			}
+			else {
+				glDisableVertexAttribArray(att);
+			}
+		}
+	}
+
+	void ParticleSystem::UpdateGpu(float delta_time) {
+		GLint range_first[2];
+		GLsizei range_count[2];
+		int ranges = LiveSpan(range_first, range_count);
+
+		glUseProgram(update_program_);
+		GLint delta_var = glGetUniformLocation(update_program_, "delta_time");
+		glUniform1f(delta_var, delta_time);
+		GLint gravity_var = glGetUniformLocation(update_program_, "gravity");
+		glUniform1f(gravity_var, gravity_);
+
+		// Run the live span through the update shader into the same place of the other buffer
+		SetupAttributes(update_program_, buffers_[current_], true);
+		glEnable(GL_RASTERIZER_DISCARD);
+		for (int r = 0; r < ranges; r++) {
+			glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers_[1 - current_],
+				range_first[r] * PARTICLE_ATTRIBUTES * sizeof(GLfloat), range_count[r] * PARTICLE_ATTRIBUTES * sizeof(GLfloat));
+			glBeginTransformFeedback(GL_POINTS);
+			glDrawArrays(GL_POINTS, range_first[r], range_count[r]);
+			glEndTransformFeedback();
+		}
+		glDisable(GL_RASTERIZER_DISCARD);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		SetupAttributes(update_program_, buffers_[current_], false);
+
+		current_ = 1 - current_;
+	}
+
+	void ParticleSystem::UpdateCpu(float delta_time) {
+		GLint range_first[2];
+		GLsizei range_count[2];
+		int ranges = LiveSpan(range_first, range_count);
+
+		for (int r = 0; r < ranges; r++) {
+			int begin = range_first[r];
+			int end = begin + range_count[r];
+
+			// Same integration as particle_update_vp.glsl, dead particles just keep moving
+			// unseen since they are never drawn
+			float fall = gravity_ * delta_time;
+			float *px = &pos_x_[0], *py = &pos_y_[0], *pz = &pos_z_[0];
+			float *vx = &vel_x_[0], *vy = &vel_y_[0], *vz = &vel_z_[0];
+			float *age = &age_[0];
+			for (int i = begin; i < end; i++) {
+				vy[i] -= fall;
+				px[i] += vx[i] * delta_time;
+				py[i] += vy[i] * delta_time;
+				pz[i] += vz[i] * delta_time;
+				age[i] += delta_time;
+			}
+
+			if (!initialized_) {
+				continue;
+			}
+
+			// Interleave the range again for drawing
+			staging_.resize(range_count[r] * PARTICLE_ATTRIBUTES);
+			for (int i = begin; i < end; i++) {
+				GLfloat *dst = &staging_[(i - begin) * PARTICLE_ATTRIBUTES];
+				dst[0] = px[i]; dst[1] = py[i]; dst[2] = pz[i];
+				dst[3] = vx[i]; dst[4] = vy[i]; dst[5] = vz[i];
+				dst[6] = col_r_[i]; dst[7] = col_g_[i]; dst[8] = col_b_[i];
+				dst[9] = age[i]; dst[10] = life_[i];
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, buffers_[current_]);
+			glBufferSubData(GL_ARRAY_BUFFER, begin * PARTICLE_ATTRIBUTES * sizeof(GLfloat),
+				range_count[r] * PARTICLE_ATTRIBUTES * sizeof(GLfloat), &staging_[0]);
+			GpuCounters::CountStreamedUpload();
+		}
+	}
+} // namespace game
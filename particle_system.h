@@ -0,0 +1,114 @@
+#ifndef PARTICLE_SYSTEM_H_
+#define PARTICLE_SYSTEM_H_
+#include <deque>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+#include "camera.h"
+
+// Floats per particle: position (3), velocity (3), color (3), age (1), life (1)
+#define PARTICLE_ATTRIBUTES 11
+
+namespace game {
+	// A group of particles spawned together, stored contiguously in the ring buffer
+	struct ParticleBurst {
+		int first; // First particle in the ring, the burst may wrap around its end
+		int count;
+		double time_left; // Seconds until every particle of the burst is dead
+	};
+
+	// Line a tracer is drawn along, see ParticleSystem::SpawnTracers
+	struct ParticleTracer {
+		glm::vec3 origin;
+		glm::vec3 direction;
+		float length;
+	};
+
+	// Owns every explosion and tracer particle of the scene in one ring buffer.
+	// Bursts are appended at the head of the ring, overwriting the oldest ones when it is full.
+	// Particles are advanced with transform feedback between two buffers, or on the CPU
+	// when there is no update program (e.g. when running without a window), and all live
+	// bursts are drawn with a single call.
+	class ParticleSystem {
+	public:
+		// capacity is the size of the ring, max_burst caps the particles of a single burst
+		ParticleSystem(int capacity = 131072, int max_burst = 4096);
+		~ParticleSystem();
+
+		// Create the GPU buffers, update_program may be 0 to simulate on the CPU
+		void Init(GLuint update_program, GLuint draw_program, GLuint texture);
+
+		// Spherical explosion at position
+		void SpawnBurst(glm::vec3 position, glm::vec3 color, int count, float speed, float life);
+		// Streak of particles from origin along direction
+		void SpawnTracer(glm::vec3 origin, glm::vec3 direction, float length, glm::vec3 color, int count, float life);
+		// Many tracers of count particles each, packed into as few bursts as fit
+		void SpawnTracers(const std::vector<ParticleTracer> &tracers, glm::vec3 color, int count, float life);
+
+		// Advance all live particles
+		void Update(double delta_time);
+		// Draw all live bursts, the view comes from the per-frame uniform block
+		void Draw(Camera *camera);
+
+		// Gravity applied to every particle, in units per second squared
+		void SetGravity(float gravity);
+
+		int GetCapacity(void) const;
+		int GetMaxBurst(void) const;
+		// Particles of the bursts still alive
+		int GetLiveParticles(void) const;
+		int GetLiveBursts(void) const;
+		// Particles overwritten before they died because the ring was full
+		long GetDroppedParticles(void) const;
+		bool IsSimulatedOnGpu(void) const;
+
+	private:
+		int capacity_;
+		int max_burst_;
+		int head_; // Where the next burst is written
+		int live_particles_;
+		long dropped_particles_;
+		float gravity_;
+		std::deque<ParticleBurst> bursts_; // Oldest first
+
+		// GPU state, buffers_[current_] holds the particles to draw and to read on the next update
+		bool initialized_;
+		GLuint buffers_[2];
+		int current_;
+		GLuint update_program_;
+		GLuint draw_program_;
+		GLuint texture_;
+
+		// CPU simulation, one array per attribute so the update loop vectorizes
+		std::vector<float> pos_x_, pos_y_, pos_z_;
+		std::vector<float> vel_x_, vel_y_, vel_z_;
+		std::vector<float> col_r_, col_g_, col_b_;
+		std::vector<float> age_, life_;
+		std::vector<GLfloat> staging_; // Interleaved particles waiting to be uploaded
+
+		// Ranges handed to glMultiDrawArrays, kept to avoid allocating every frame
+		std::vector<GLint> draw_first_;
+		std::vector<GLsizei> draw_count_;
+
+		// Write the count particles of a tracer to staging_ from particle first on
+		void StageTracer(int first, const ParticleTracer &tracer, glm::vec3 color, int count, float life);
+		// Reserve count particles at the head of the ring, returns the first one
+		int Allocate(int count);
+		// Write the interleaved particles in staging_ to the ring from first on
+		void Store(int first, int count);
+		// Split the ring span starting at first into at most two ranges that don't wrap
+		int Ranges(int first, int count, GLint *range_first, GLsizei *range_count) const;
+		// Span of the ring covering every live particle
+		int LiveSpan(GLint *range_first, GLsizei *range_count) const;
+		// Point the attributes of program at buffer
+		void SetupAttributes(GLuint program, GLuint buffer, bool enable) const;
+
+		void UpdateGpu(float delta_time);
+		void UpdateCpu(float delta_time);
+	}; // class ParticleSystem
+} // namespace game
+#endif // PARTICLE_SYSTEM_H_
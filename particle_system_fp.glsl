@@ -0,0 +1,19 @@
+#version 400
+
+// Attributes passed from the geometry shader
+in vec4 frag_color;
+in vec2 tex_coord;
+
+// Uniform (global) buffer
+uniform sampler2D tex_samp;
+
+void main (void)
+{
+    // Get pixel from texture
+    vec4 outval = texture(tex_samp, tex_coord);
+
+    // Tint the grayscale texture with the particle color, fading out with age
+    outval = vec4(outval.r*frag_color.r, outval.g*frag_color.g, outval.b*frag_color.b, sqrt(sqrt(outval.r))*frag_color.a);
+
+    gl_FragColor = outval;
+}
@@ -0,0 +1,54 @@
+#version 400
+
+// Definition of the geometry shader
+layout (points) in;
+layout (triangle_strip, max_vertices = 4) out;
+
+// Attributes passed from the vertex shader
+in vec3 vertex_color[];
+in float fade[];
+in float particle_id[];
+
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
+
+// Simulation parameters (constants)
+uniform float particle_size = 0.3;
+
+// Attributes passed to the fragment shader
+out vec4 frag_color;
+out vec2 tex_coord;
+
+void main(void){
+
+    // Dead particles produce no geometry
+    if (fade[0] <= 0.0) {
+        return;
+    }
+
+    // Get the position of the particle, already in camera space
+    vec4 position = gl_in[0].gl_Position;
+    float p_size = particle_size;
+
+    vec4 v[4];
+    v[0] = vec4(position.x - 0.5*p_size, position.y - 0.5*p_size, position.z, 1.0);
+    v[1] = vec4(position.x + 0.5*p_size, position.y - 0.5*p_size, position.z, 1.0);
+    v[2] = vec4(position.x - 0.5*p_size, position.y + 0.5*p_size, position.z, 1.0);
+    v[3] = vec4(position.x + 0.5*p_size, position.y + 0.5*p_size, position.z, 1.0);
+
+    // Create the quad, picking a sector from the flame 2x2 drawing
+    int fid = int(floor(particle_id[0] * 4.0));
+    for (int i = 0; i < 4; i++){
+        gl_Position = projection_mat * v[i];
+        tex_coord = vec2(floor(i / 2)*0.5 + 0.5*(fid / 2), (i % 2)*0.5 + 0.5*(fid % 2));
+        frag_color = vec4(vertex_color[0], fade[0]);
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,35 @@
+#version 400
+
+// Particle from the ring buffer
+in vec3 position;
+in vec3 color;
+in float age;
+in float life;
+
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
+
+// Attributes forwarded to the geometry shader
+out vec3 vertex_color;
+out float fade;
+out float particle_id;
+
+void main()
+{
+    // Pseudo-random id in [0..1] used to pick a sector of the flame texture
+    particle_id = fract(float(gl_VertexID)*0.618034);
+
+    // 1 when the particle is born, 0 when it dies
+    fade = clamp(1.0 - age/life, 0.0, 1.0);
+
+    // Work in camera space, the geometry shader builds the quad
+    gl_Position = view_mat * vec4(position, 1.0);
+
+    vertex_color = color;
+}
@@ -0,0 +1,38 @@
+#version 400
+
+// Particle read from the ring buffer
+in vec3 position;
+in vec3 velocity;
+in vec3 color;
+in float age;
+in float life;
+
+// Uniform (global) buffer
+uniform float delta_time;
+uniform float gravity;
+
+// Particle written back through transform feedback, in the same layout
+out vec3 out_position;
+out vec3 out_velocity;
+out vec3 out_color;
+out float out_age;
+out float out_life;
+
+void main()
+{
+    // Dead particles are copied unchanged
+    vec3 vel = velocity;
+    vec3 pos = position;
+    float a = age;
+    if (age < life) {
+        vel.y -= gravity*delta_time;
+        pos += vel*delta_time;
+        a += delta_time;
+    }
+
+    out_position = pos;
+    out_velocity = vel;
+    out_color = color;
+    out_age = a;
+    out_life = life;
+}
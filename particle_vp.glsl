@@ -5,11 +5,19 @@ in vec3 vertex;
 in vec3 normal;
 in vec3 color;
 
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
+
 // Uniform (global) buffer
 uniform mat4 world_mat;
-uniform mat4 view_mat;
 uniform mat4 normal_mat;
-uniform float timer;
+uniform float burst_timer;
 uniform float red;
 uniform float green;
 uniform float blue;
@@ -30,7 +38,7 @@ void main()
 	particle_id = color.r;
 
     // Let time cycle every four seconds
-    float circtime = timer;
+    float circtime = burst_timer;
     float t = circtime; // Our time parameter
     
     // Let's first work in model space (apply only world matrix)
@@ -0,0 +1,131 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "program_cache.h"
+#include "mesh_cache.h"
+
+namespace game {
+	static std::string cache_filename(const std::string &prefix) {
+		return prefix + std::string(PROGRAM_CACHE_EXTENSION);
+	}
+
+	// Binaries of one driver are rejected by others, and by later versions of the same one
+	static unsigned long long driver_hash(void) {
+		const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		unsigned long long hash = fnv1a_hash(NULL, 0);
+		for (int i = 0; i < 3; i++) {
+			const char *value = (const char *)glGetString(names[i]);
+			if (value) {
+				hash = fnv1a_hash(value, strlen(value), hash);
+			}
+		}
+		return hash;
+	}
+
+	bool ProgramCache::Read(const std::string &prefix, unsigned long long source_hash, std::vector<char> &file) {
+		file.clear();
+		std::ifstream f(cache_filename(prefix).c_str(), std::ios::in | std::ios::binary);
+		if (f.fail()) {
+			return false;
+		}
+		file.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+
+		// Check that the file was written by this version for these sources, and is complete
+		ProgramCacheHeader header;
+		if (file.size() < sizeof(header)) {
+			file.clear();
+			return false;
+		}
+		memcpy(&header, &file[0], sizeof(header));
+		if (header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION ||
+			header.source_hash != source_hash || file.size() != sizeof(header) + header.binary_size) {
+			file.clear();
+			return false;
+		}
+		return true;
+	}
+
+	GLuint ProgramCache::Load(const std::vector<char> &file) {
+		if (file.size() < sizeof(ProgramCacheHeader) || !IsSupported()) {
+			return 0;
+		}
+		ProgramCacheHeader header;
+		memcpy(&header, &file[0], sizeof(header));
+		if (header.driver_hash != driver_hash()) {
+			return 0;
+		}
+
+		// The driver may still refuse it, e.g. after an update that kept the version string
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, header.binary_format, &file[sizeof(header)], header.binary_size);
+		GLint status;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE) {
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	void ProgramCache::PrepareLink(GLuint program) {
+		if (IsSupported()) {
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+	}
+
+	void ProgramCache::Write(const std::string &prefix, unsigned long long source_hash, GLuint program) {
+		if (!IsSupported()) {
+			return;
+		}
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+		std::vector<char> binary(length);
+		GLsizei written = 0;
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &written, &format, &binary[0]);
+		if (written <= 0) {
+			return;
+		}
+
+		ProgramCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = PROGRAM_CACHE_MAGIC;
+		header.version = PROGRAM_CACHE_VERSION;
+		header.source_hash = source_hash;
+		header.driver_hash = driver_hash();
+		header.binary_format = format;
+		header.binary_size = (unsigned int)written;
+
+		// Write to a temporary file first so a crash never leaves a truncated binary behind
+		std::string filename = cache_filename(prefix);
+		std::string temp = filename + std::string(".tmp");
+		std::ofstream f(temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (f.fail()) {
+			return;
+		}
+		f.write((const char *)&header, sizeof(header));
+		f.write(&binary[0], written);
+		f.close();
+		if (f.fail()) {
+			remove(temp.c_str());
+			return;
+		}
+		remove(filename.c_str());
+		if (rename(temp.c_str(), filename.c_str()) != 0) {
+			remove(temp.c_str());
+		}
+	}
+
+	bool ProgramCache::IsSupported(void) {
+		if (!GLEW_ARB_get_program_binary) {
+			return false;
+		}
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+} // namespace game
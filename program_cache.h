@@ -0,0 +1,43 @@
+#ifndef PROGRAM_CACHE_H_
+#define PROGRAM_CACHE_H_
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// Program binaries are written next to the shader sources, with this extension appended to their prefix
+#define PROGRAM_CACHE_EXTENSION ".progbin"
+#define PROGRAM_CACHE_MAGIC 0x47525048 // "HPRG"
+#define PROGRAM_CACHE_VERSION 1
+
+namespace game {
+	// Start of a program binary file, followed by binary_size bytes of the binary
+	struct ProgramCacheHeader {
+		unsigned int magic;
+		unsigned int version;
+		unsigned long long source_hash; // Hash of every source (and setting) the program was built from
+		unsigned long long driver_hash; // Hash of the vendor, renderer and version strings of the driver
+		unsigned int binary_format; // Format glGetProgramBinary returned
+		unsigned int binary_size;
+	};
+
+	// Linked programs saved with glGetProgramBinary and loaded back with glProgramBinary, so
+	// later starts skip compiling and linking. Binaries only work with the driver that made
+	// them, a rejected binary is ignored and the program is compiled again
+	class ProgramCache {
+	public:
+		// Read the binary file of prefix if it was built from sources hashing to source_hash.
+		// Only reads the file, so it may run on any thread. Returns false if it is missing or stale
+		static bool Read(const std::string &prefix, unsigned long long source_hash, std::vector<char> &file);
+		// Create a program from a file returned by Read, 0 if this driver can't use it
+		static GLuint Load(const std::vector<char> &file);
+		// Call before linking a program that will be written
+		static void PrepareLink(GLuint program);
+		// Write the binary of a linked program. Failures are ignored since the sources can always be compiled again
+		static void Write(const std::string &prefix, unsigned long long source_hash, GLuint program);
+
+		// Whether the driver can save and load program binaries
+		static bool IsSupported(void);
+	}; // class ProgramCache
+} // namespace game
+#endif // PROGRAM_CACHE_H_
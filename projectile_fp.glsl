@@ -0,0 +1,24 @@
+#version 130
+
+// Attributes passed from the vertex shader
+in vec4 color_interp;
+in vec2 uv_interp;
+
+// Uniform (global) buffer
+uniform sampler2DArray texture_map;
+uniform float texture_layer; // Layer of the array holding the texture of the projectiles, -1 for none
+
+void main() 
+{
+    // Untextured projectiles keep the colors of their geometry
+    if (texture_layer < 0.0) {
+        gl_FragColor = color_interp;
+        return;
+    }
+
+    // Retrieve texture value
+    vec4 pixel = texture(texture_map, vec3(uv_interp, texture_layer));
+
+    // Use texture in determining fragment colour
+	gl_FragColor = pixel;
+}
\ No newline at end of file
@@ -0,0 +1,448 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/type_ptr.hpp>
+#include "projectile_system.h"
+#include "gpu_counters.h"
+#include "scene_node.h"
+#include "texture_streamer.h"
+
+namespace game {
+	// Advance every projectile by t seconds, keeping where it was to draw between the two
+	static void integrate(int count, float t, float *__restrict px, float *__restrict py, float *__restrict pz,
+		float *__restrict lx, float *__restrict ly, float *__restrict lz, float *__restrict vx, float *__restrict vy, float *__restrict vz,
+		const float *__restrict ax, const float *__restrict ay, const float *__restrict az, float *__restrict life) {
+		float step = PROJECTILE_SPEED_SCALE * t;
+		for (int i = 0; i < count; i++) {
+			lx[i] = px[i];
+			ly[i] = py[i];
+			lz[i] = pz[i];
+			vx[i] += ax[i] * t;
+			vy[i] += ay[i] * t;
+			vz[i] += az[i] * t;
+			px[i] += vx[i] * step;
+			py[i] += vy[i] * step;
+			pz[i] += vz[i] * step;
+			life[i] -= t;
+		}
+	}
+
+	// Flag the live projectiles inside the box that owner didn't fire
+	static void select_inside(int count, const float *__restrict px, const float *__restrict py, const float *__restrict pz,
+		const float *__restrict life, const int *__restrict owners, glm::vec3 min, glm::vec3 max, int owner, unsigned char *__restrict inside) {
+		for (int i = 0; i < count; i++) {
+			inside[i] = (px[i] >= min.x) & (px[i] <= max.x) & (py[i] >= min.y) & (py[i] <= max.y)
+				& (pz[i] >= min.z) & (pz[i] <= max.z) & (life[i] > 0.0f) & (owners[i] != owner);
+		}
+	}
+
+	// Box around the world box at center with half extents half, in the frame inverse takes it to
+	static void box_to_frame(const glm::mat4 &inverse, glm::vec3 center, glm::vec3 half, glm::vec3 &frame_center, glm::vec3 &frame_half) {
+		frame_center = glm::vec3(inverse * glm::vec4(center, 1.0f));
+		glm::mat3 rotation = glm::mat3(inverse);
+		for (int k = 0; k < 3; k++) {
+			frame_half[k] = std::fabs(rotation[0][k]) * half.x + std::fabs(rotation[1][k]) * half.y + std::fabs(rotation[2][k]) * half.z;
+		}
+	}
+
+	ProjectileSystem::ProjectileSystem(int capacity) {
+		capacity_ = std::max(capacity, 1);
+		count_ = 0;
+		dropped_ = 0;
+		max_radius_ = 0.0f;
+		frame_ = glm::mat4(1.0);
+		inverse_frame_ = glm::mat4(1.0);
+
+		std::vector<float> *arrays[] = { &pos_x_, &pos_y_, &pos_z_, &last_x_, &last_y_, &last_z_,
+			&vel_x_, &vel_y_, &vel_z_, &acc_x_, &acc_y_, &acc_z_, &life_, &damage_ };
+		for (unsigned int i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+			arrays[i]->resize(capacity_);
+		}
+		owner_.resize(capacity_);
+		type_.resize(capacity_);
+		inside_.resize(capacity_);
+
+		initialized_ = false;
+		instance_buffer_ = 0;
+		material_ = NULL;
+		texture_ = NULL;
+	}
+
+	ProjectileSystem::~ProjectileSystem() {
+		if (initialized_) {
+			glDeleteBuffers(1, &instance_buffer_);
+		}
+		for (unsigned int i = 0; i < types_.size(); i++) {
+			if (types_[i].geometry) {
+				types_[i].geometry->Release();
+			}
+		}
+		if (material_) {
+			material_->Release();
+		}
+		if (texture_) {
+			texture_->Release();
+		}
+	}
+
+	void ProjectileSystem::Init(const Resource *material, const Resource *texture) {
+		if (!material || material->GetType() != Material) {
+			throw(std::invalid_argument(std::string("Invalid type of material")));
+		}
+		if (!texture || texture->GetType() != TextureArray) {
+			throw(std::invalid_argument(std::string("Projectiles need a texture array")));
+		}
+		// Held like a scene node holds its resources, so changing levels doesn't free them
+		material_ = material;
+		texture_ = texture;
+		material_->Acquire();
+		texture_->Acquire();
+
+		glGenBuffers(1, &instance_buffer_);
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+		glBufferData(GL_ARRAY_BUFFER, capacity_ * PROJECTILE_INSTANCE_ATTRIBUTES * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+		GpuCounters::CountBufferUpload();
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		initialized_ = true;
+	}
+
+	int ProjectileSystem::AddType(const Resource *geometry, glm::vec3 scale, int layer) {
+		// Unit cube point sets span [-1, 1]
+		glm::vec3 extent = glm::vec3(2.0f);
+		if (geometry) {
+			if (geometry->GetType() == Mesh) {
+				extent = geometry->GetHitbox().getDimensions();
+			}
+			else if (geometry->GetType() != PointSet) {
+				throw(std::invalid_argument(std::string("Invalid type of geometry")));
+			}
+			geometry->Acquire();
+		}
+		extent = extent * scale;
+
+		Type type = { geometry, scale, layer, 0.5f * std::max(extent.x, std::max(extent.y, extent.z)) };
+		types_.push_back(type);
+		max_radius_ = std::max(max_radius_, type.radius);
+		return (int)types_.size() - 1;
+	}
+
+	bool ProjectileSystem::Spawn(const ProjectileShot &shot, int owner) {
+		if (shot.type < 0 || shot.type >= (int)types_.size()) {
+			throw(std::invalid_argument(std::string("Invalid projectile type")));
+		}
+		if (count_ == capacity_) {
+			dropped_++;
+			return false;
+		}
+
+		int i = count_++;
+		pos_x_[i] = last_x_[i] = shot.position.x;
+		pos_y_[i] = last_y_[i] = shot.position.y;
+		pos_z_[i] = last_z_[i] = shot.position.z;
+		vel_x_[i] = shot.velocity.x;
+		vel_y_[i] = shot.velocity.y;
+		vel_z_[i] = shot.velocity.z;
+		acc_x_[i] = shot.acceleration.x;
+		acc_y_[i] = shot.acceleration.y;
+		acc_z_[i] = shot.acceleration.z;
+		life_[i] = PROJECTILE_LIFESPAN;
+		damage_[i] = shot.damage;
+		owner_[i] = owner;
+		type_[i] = shot.type;
+		return true;
+	}
+
+	void ProjectileSystem::Update(double delta_time) {
+		if (count_ == 0) {
+			return;
+		}
+
+		integrate(count_, (float)delta_time, &pos_x_[0], &pos_y_[0], &pos_z_[0], &last_x_[0], &last_y_[0], &last_z_[0],
+			&vel_x_[0], &vel_y_[0], &vel_z_[0], &acc_x_[0], &acc_y_[0], &acc_z_[0], &life_[0]);
+
+		// Fill each expired projectile with the last one. Going backwards, the last one was already kept
+		for (int i = count_ - 1; i >= 0; i--) {
+			if (life_[i] <= 0.0f) {
+				Move(count_ - 1, i);
+				count_--;
+			}
+		}
+	}
+
+	void ProjectileSystem::SetFrame(glm::mat4 transf) {
+		frame_ = transf;
+		inverse_frame_ = glm::inverse(transf);
+	}
+
+	int ProjectileSystem::Select(glm::vec3 min, glm::vec3 max, int owner) {
+		candidates_.clear();
+		if (count_ == 0) {
+			return 0;
+		}
+
+		// Grown so projectiles touching the box from outside are kept
+		glm::vec3 center, half;
+		box_to_frame(inverse_frame_, (min + max) * 0.5f, (max - min) * 0.5f, center, half);
+		half += glm::vec3(max_radius_);
+		select_inside(count_, &pos_x_[0], &pos_y_[0], &pos_z_[0], &life_[0], &owner_[0], center - half, center + half, owner, &inside_[0]);
+		// Written whether it is kept or not, so there is no branch to mispredict
+		candidates_.resize(count_);
+		int kept = 0;
+		for (int i = 0; i < count_; i++) {
+			candidates_[kept] = i;
+			kept += inside_[i];
+		}
+		candidates_.resize(kept);
+		return kept;
+	}
+
+	int ProjectileSystem::Hit(Collidable *target, float &damage) {
+		if (candidates_.empty()) {
+			return 0;
+		}
+
+		// Both boxes of target are in world space, moved into the frame of the projectiles
+		glm::vec3 box_center, box_half;
+		box_to_frame(inverse_frame_, target->aabb.getPos(), target->aabb.getScale() * 0.5f, box_center, box_half);
+
+		// The projectile as a sphere against the hitbox, along the axes of the hitbox
+		glm::vec3 center = glm::vec3(inverse_frame_ * glm::vec4(target->hb.getPos(), 1.0f));
+		glm::vec3 half = target->hb.getDimensions() * 0.5f;
+		glm::mat4 trans = inverse_frame_ * target->hb.getTrans();
+		glm::vec3 axes[3];
+		for (int k = 0; k < 3; k++) {
+			axes[k] = glm::vec3(trans[k]);
+		}
+
+		int hits = 0;
+		for (unsigned int c = 0; c < candidates_.size(); c++) {
+			int i = candidates_[c];
+			if (life_[i] <= 0.0f) {
+				continue;
+			}
+			float radius = types_[type_[i]].radius;
+			glm::vec3 p = glm::vec3(pos_x_[i], pos_y_[i], pos_z_[i]);
+
+			glm::vec3 offset = glm::abs(p - box_center);
+			if (offset.x > box_half.x + radius || offset.y > box_half.y + radius || offset.z > box_half.z + radius) {
+				continue;
+			}
+			glm::vec3 d = p - center;
+			if (std::fabs(glm::dot(d, axes[0])) > half.x + radius || std::fabs(glm::dot(d, axes[1])) > half.y + radius
+				|| std::fabs(glm::dot(d, axes[2])) > half.z + radius) {
+				continue;
+			}
+
+			// Removed on the next update
+			life_[i] = 0.0f;
+			damage += damage_[i];
+			hits++;
+		}
+		return hits;
+	}
+
+	void ProjectileSystem::Draw(Camera *) {
+		if (!initialized_ || count_ == 0) {
+			return;
+		}
+
+		// Group the instances by type, each type reads its own range of the buffer
+		int num_types = (int)types_.size();
+		type_first_.assign(num_types + 1, 0);
+		for (int i = 0; i < count_; i++) {
+			if (life_[i] > 0.0f) {
+				type_first_[type_[i] + 1]++;
+			}
+		}
+		for (int t = 0; t < num_types; t++) {
+			type_first_[t + 1] += type_first_[t];
+		}
+		int total = type_first_[num_types];
+		if (total == 0) {
+			return;
+		}
+
+		float alpha = SceneNode::GetInterpolation();
+		staging_.resize(total * PROJECTILE_INSTANCE_ATTRIBUTES);
+		// Kept between frames like type_first_, so drawing doesn't allocate
+		type_next_.resize(num_types);
+		std::copy(type_first_.begin(), type_first_.end() - 1, type_next_.begin());
+		for (int i = 0; i < count_; i++) {
+			if (life_[i] <= 0.0f) {
+				continue;
+			}
+			GLfloat *instance = &staging_[type_next_[type_[i]]++ * PROJECTILE_INSTANCE_ATTRIBUTES];
+			instance[0] = last_x_[i] + (pos_x_[i] - last_x_[i]) * alpha;
+			instance[1] = last_y_[i] + (pos_y_[i] - last_y_[i]) * alpha;
+			instance[2] = last_z_[i] + (pos_z_[i] - last_z_[i]) * alpha;
+			instance[3] = vel_x_[i];
+			instance[4] = vel_y_[i];
+			instance[5] = vel_z_[i];
+		}
+
+		// Orphan the buffer so the upload doesn't wait for the last frame's draws
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+		glBufferData(GL_ARRAY_BUFFER, capacity_ * PROJECTILE_INSTANCE_ATTRIBUTES * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, total * PROJECTILE_INSTANCE_ATTRIBUTES * sizeof(GLfloat), &staging_[0]);
+		GpuCounters::CountStreamedUpload();
+
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+
+		GLuint program = material_->GetResource();
+		glUseProgram(program);
+
+		GLint world_mat = glGetUniformLocation(program, "world_mat");
+		glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(frame_));
+
+		GLint tex = glGetUniformLocation(program, "texture_map");
+		glUniform1i(tex, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture_->GetResource());
+		TextureStreamer::MarkUsed(texture_->GetResource());
+
+		GLint scale_var = glGetUniformLocation(program, "scale");
+		GLint layer_var = glGetUniformLocation(program, "texture_layer");
+		for (int t = 0; t < num_types; t++) {
+			const Type &type = types_[t];
+			int instances = type_first_[t + 1] - type_first_[t];
+			if (!type.geometry || instances == 0) {
+				continue;
+			}
+
+			glUniform3f(scale_var, type.scale.x, type.scale.y, type.scale.z);
+			glUniform1f(layer_var, (float)type.layer);
+			SetupAttributes(program, type, type_first_[t], true);
+			if (type.geometry->GetType() == PointSet) {
+				glDrawArraysInstanced(GL_POINTS, 0, type.geometry->GetSize(), instances);
+			}
+			else {
+				glDrawElementsInstanced(GL_TRIANGLES, type.geometry->GetSize(), GL_UNSIGNED_INT, 0, instances);
+			}
+			GpuCounters::CountDraw(type.geometry->GetType() == PointSet ? 0 : (long)type.geometry->GetSize() / 3 * instances);
+			SetupAttributes(program, type, type_first_[t], false);
+		}
+	}
+
+	void ProjectileSystem::Clear(void) {
+		count_ = 0;
+		candidates_.clear();
+	}
+
+	void ProjectileSystem::GetState(int i, ProjectileState &state) const {
+		if (i < 0 || i >= count_) {
+			throw(std::invalid_argument(std::string("Invalid projectile index")));
+		}
+		state.position = glm::vec3(pos_x_[i], pos_y_[i], pos_z_[i]);
+		state.last_position = glm::vec3(last_x_[i], last_y_[i], last_z_[i]);
+		state.velocity = glm::vec3(vel_x_[i], vel_y_[i], vel_z_[i]);
+		state.acceleration = glm::vec3(acc_x_[i], acc_y_[i], acc_z_[i]);
+		state.life = life_[i];
+		state.damage = damage_[i];
+		state.owner = owner_[i];
+		state.type = type_[i];
+	}
+
+	bool ProjectileSystem::Restore(const ProjectileState &state) {
+		if (state.type < 0 || state.type >= (int)types_.size()) {
+			throw(std::invalid_argument(std::string("Invalid projectile type")));
+		}
+		if (count_ == capacity_) {
+			dropped_++;
+			return false;
+		}
+
+		int i = count_++;
+		pos_x_[i] = state.position.x;
+		pos_y_[i] = state.position.y;
+		pos_z_[i] = state.position.z;
+		last_x_[i] = state.last_position.x;
+		last_y_[i] = state.last_position.y;
+		last_z_[i] = state.last_position.z;
+		vel_x_[i] = state.velocity.x;
+		vel_y_[i] = state.velocity.y;
+		vel_z_[i] = state.velocity.z;
+		acc_x_[i] = state.acceleration.x;
+		acc_y_[i] = state.acceleration.y;
+		acc_z_[i] = state.acceleration.z;
+		life_[i] = state.life;
+		damage_[i] = state.damage;
+		owner_[i] = state.owner;
+		type_[i] = state.type;
+		return true;
+	}
+
+	int ProjectileSystem::GetCapacity(void) const {
+		return capacity_;
+	}
+
+	int ProjectileSystem::GetCount(void) const {
+		return count_;
+	}
+
+	long ProjectileSystem::GetDropped(void) const {
+		return dropped_;
+	}
+
+	void ProjectileSystem::Move(int from, int to) {
+		pos_x_[to] = pos_x_[from];
+		pos_y_[to] = pos_y_[from];
+		pos_z_[to] = pos_z_[from];
+		last_x_[to] = last_x_[from];
+		last_y_[to] = last_y_[from];
+		last_z_[to] = last_z_[from];
+		vel_x_[to] = vel_x_[from];
+		vel_y_[to] = vel_y_[from];
+		vel_z_[to] = vel_z_[from];
+		acc_x_[to] = acc_x_[from];
+		acc_y_[to] = acc_y_[from];
+		acc_z_[to] = acc_z_[from];
+		life_[to] = life_[from];
+		damage_[to] = damage_[from];
+		owner_[to] = owner_[from];
+		type_[to] = type_[from];
+	}
+
+	void ProjectileSystem::SetupAttributes(GLuint program, const Type &type, int first, bool enable) const {
+		static const char *instance_names[] = { "instance_position", "instance_direction" };
+
+		if (enable) {
+			// Mesh attributes, laid out like SceneNode::SetupShader expects
+			static const char *names[] = { "vertex", "color", "uv" };
+			static const int sizes[] = { 3, 3, 2 };
+			static const int offsets[] = { 0, 6, 9 };
+			glBindBuffer(GL_ARRAY_BUFFER, type.geometry->GetArrayBuffer());
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, type.geometry->GetElementArrayBuffer());
+			for (int a = 0; a < 3; a++) {
+				GLint att = glGetAttribLocation(program, names[a]);
+				if (att < 0) {
+					continue;
+				}
+				glVertexAttribPointer(att, sizes[a], GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (void *)(offsets[a] * sizeof(GLfloat)));
+				glEnableVertexAttribArray(att);
+			}
+		}
+
+		// One entry of the instance buffer per projectile, from the first of the type on
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+		for (int a = 0; a < 2; a++) {
+			GLint att = glGetAttribLocation(program, instance_names[a]);
+			if (att < 0) {
+				continue;
+			}
+			if (enable) {
+				glVertexAttribPointer(att, 3, GL_FLOAT, GL_FALSE, PROJECTILE_INSTANCE_ATTRIBUTES * sizeof(GLfloat),
+					(void *)((first * PROJECTILE_INSTANCE_ATTRIBUTES + a * 3) * sizeof(GLfloat)));
+				glVertexAttribDivisor(att, 1);
+				glEnableVertexAttribArray(att);
+			}
+			else {
+				// Scene nodes read every attribute per vertex
+				glVertexAttribDivisor(att, 0);
+				glDisableVertexAttribArray(att);
+			}
+		}
+	}
+} // namespace game
@@ -0,0 +1,139 @@
+#ifndef PROJECTILE_SYSTEM_H_
+#define PROJECTILE_SYSTEM_H_
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+#include "camera.h"
+#include "collidable.h"
+#include "resource.h"
+
+// Seconds a projectile flies before it expires
+#define PROJECTILE_LIFESPAN 5.0f
+// Units a projectile moves per second for each unit of velocity
+#define PROJECTILE_SPEED_SCALE 10.0f
+// Floats per projectile in the instance buffer: position (3), direction (3)
+#define PROJECTILE_INSTANCE_ATTRIBUTES 6
+
+namespace game {
+	// A projectile about to be fired, see ProjectileSystem::Spawn
+	struct ProjectileShot {
+		glm::vec3 position;
+		glm::vec3 velocity;
+		glm::vec3 acceleration;
+		float damage;
+		int type; // From ProjectileSystem::AddType
+	};
+
+	// Everything about one projectile in flight, to save it and restore it
+	struct ProjectileState {
+		glm::vec3 position;
+		glm::vec3 last_position;
+		glm::vec3 velocity;
+		glm::vec3 acceleration;
+		float life;
+		float damage;
+		int owner;
+		int type;
+	};
+
+	// Owns every projectile of the scene. Projectiles are not scene nodes: each attribute is
+	// one dense array, advanced by a single loop the compiler vectorizes, and expired projectiles
+	// are swapped with the last one so the arrays stay packed. All projectiles of a type are
+	// drawn with one instanced call, facing the way they fly
+	class ProjectileSystem {
+	public:
+		// capacity caps the projectiles alive at once, spawning more fails
+		ProjectileSystem(int capacity = 131072);
+		~ProjectileSystem();
+
+		// Create the instance buffer, texture is the texture array of every type
+		void Init(const Resource *material, const Resource *texture);
+
+		// Register what a kind of projectile looks like, returns its type. geometry may be NULL
+		// for projectiles that are never drawn, and layer -1 draws the vertex colors
+		int AddType(const Resource *geometry, glm::vec3 scale, int layer);
+
+		// Fire shot, owner is the id of the entity it can't hit or -1. Returns false when full
+		bool Spawn(const ProjectileShot &shot, int owner);
+
+		// Advance every projectile and drop the expired ones
+		void Update(double delta_time);
+
+		// Projectiles move in the frame of the root node, transf takes them to world space
+		void SetFrame(glm::mat4 transf);
+
+		// Keep the projectiles inside the world box from min to max not fired by owner as candidates
+		// for Hit, returns how many there are. Cheap enough to run before every entity
+		int Select(glm::vec3 min, glm::vec3 max, int owner);
+		// Expire the candidates hitting target, returns how many did and adds their damage
+		int Hit(Collidable *target, float &damage);
+
+		// Draw every projectile, between its last two steps. The view comes from the per-frame uniform block
+		void Draw(Camera *camera);
+
+		// Drop every projectile
+		void Clear(void);
+
+		// State of projectile i, from 0 to GetCount() - 1
+		void GetState(int i, ProjectileState &state) const;
+		// Add a projectile where state left it, returns false when full
+		bool Restore(const ProjectileState &state);
+
+		int GetCapacity(void) const;
+		int GetCount(void) const;
+		// Projectiles that could not be spawned because the system was full
+		long GetDropped(void) const;
+
+	private:
+		struct Type {
+			const Resource *geometry;
+			glm::vec3 scale;
+			int layer;
+			float radius; // Half the largest extent of the scaled geometry
+		};
+
+		int capacity_;
+		int count_;
+		long dropped_;
+		std::vector<Type> types_;
+		float max_radius_;
+		glm::mat4 frame_;
+		glm::mat4 inverse_frame_;
+
+		// One array per attribute, the first count_ entries are alive
+		std::vector<float> pos_x_, pos_y_, pos_z_;
+		std::vector<float> last_x_, last_y_, last_z_; // Position at the previous step, to draw between
+		std::vector<float> vel_x_, vel_y_, vel_z_;
+		std::vector<float> acc_x_, acc_y_, acc_z_;
+		std::vector<float> life_; // Seconds left, expired at 0
+		std::vector<float> damage_;
+		std::vector<int> owner_;
+		std::vector<int> type_;
+
+		// Indices chosen by Select, and the flags the selection loop writes first
+		std::vector<int> candidates_;
+		std::vector<unsigned char> inside_;
+
+		// GPU state
+		bool initialized_;
+		GLuint instance_buffer_;
+		const Resource *material_;
+		const Resource *texture_;
+		std::vector<GLfloat> staging_; // Instances sorted by type, waiting to be uploaded
+		std::vector<int> type_first_; // First instance of each type in staging_, and the total last
+		std::vector<int> type_next_; // Where the next instance of each type goes while staging
+
+		// Copy projectile from over projectile to
+		void Move(int from, int to);
+		// Point the mesh and instance attributes of program at the buffers of type
+		void SetupAttributes(GLuint program, const Type &type, int first, bool enable) const;
+
+		ProjectileSystem(const ProjectileSystem &);
+		ProjectileSystem &operator=(const ProjectileSystem &);
+	}; // class ProjectileSystem
+} // namespace game
+#endif // PROJECTILE_SYSTEM_H_
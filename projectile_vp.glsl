@@ -0,0 +1,44 @@
+#version 130
+#extension GL_ARB_uniform_buffer_object : require
+
+// Vertex buffer
+in vec3 vertex;
+in vec3 color;
+in vec2 uv;
+
+// Instance buffer, one entry per projectile
+in vec3 instance_position;
+in vec3 instance_direction; // Velocity, the projectile faces along it
+
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
+
+// Uniform (global) buffer
+uniform mat4 world_mat; // Frame the projectiles move in
+uniform vec3 scale; // Scale of every projectile of the draw
+
+// Attributes forwarded to the fragment shader
+out vec4 color_interp;
+out vec2 uv_interp;
+
+void main()
+{
+    // Turn the forward axis (z) towards the direction without rolling, like SceneNode::VectorToRotation
+    vec3 forward = normalize(instance_direction);
+    vec3 side = cross(vec3(0.0, 1.0, 0.0), forward);
+    side = (dot(side, side) > 1e-6) ? normalize(side) : vec3(1.0, 0.0, 0.0);
+    vec3 up = cross(forward, side);
+
+    vec3 position = instance_position + mat3(side, up, forward) * (vertex * scale);
+    gl_Position = projection_mat * view_mat * world_mat * vec4(position, 1.0);
+
+    color_interp = vec4(color, 1.0);
+
+    uv_interp = uv;
+}
\ No newline at end of file
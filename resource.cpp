@@ -1,5 +1,7 @@
 #include <exception>
+#include <iostream>
 #include "resource.h"
+#include "terrain.h"
 
 namespace game {
 	Resource::Resource(ResourceType type, std::string name, GLuint resource, GLsizei size) {
@@ -7,6 +9,10 @@ namespace game {
 		name_ = name;
 		resource_ = resource;
 		size_ = size;
+		terrain_ = NULL;
+		refs_ = 0;
+		gpu_bytes_ = 0;
+		owned_ = true;
 	}
 
 	Resource::Resource(ResourceType type, std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size, Hitbox _hb) {
@@ -16,6 +22,10 @@ namespace game {
 		element_array_buffer_ = element_array_buffer;
 		size_ = size;
 		hb = _hb;
+		terrain_ = NULL;
+		refs_ = 0;
+		gpu_bytes_ = 0;
+		owned_ = true;
 	}
 
 	Resource::Resource(ResourceType type, std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size) {
@@ -24,9 +34,27 @@ namespace game {
 		array_buffer_ = array_buffer;
 		element_array_buffer_ = element_array_buffer;
 		size_ = size;
+		terrain_ = NULL;
+		refs_ = 0;
+		gpu_bytes_ = 0;
+		owned_ = true;
+	}
+
+	Resource::Resource(ResourceType type, std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size, TerrainData *terrain) {
+		type_ = type;
+		name_ = name;
+		array_buffer_ = array_buffer;
+		element_array_buffer_ = element_array_buffer;
+		size_ = size;
+		terrain_ = terrain;
+		refs_ = 0;
+		gpu_bytes_ = 0;
+		owned_ = true;
 	}
 	
-	Resource::~Resource() {}
+	Resource::~Resource() {
+		delete terrain_;
+	}
 
 	ResourceType Resource::GetType(void) const {
 		return type_;
@@ -55,4 +83,49 @@ namespace game {
 	Hitbox Resource::GetHitbox(void) const {
 		return hb;
 	}
+
+	const TerrainData *Resource::GetTerrain(void) const {
+		return terrain_;
+	}
+
+	void Resource::Acquire(void) const {
+		refs_++;
+	}
+
+	void Resource::Release(void) const {
+		// A release without an acquire is a bug in whoever holds the resource
+		if (refs_ <= 0) {
+			std::cerr << "Resource " << name_ << " released more often than acquired" << std::endl;
+			return;
+		}
+		refs_--;
+	}
+
+	int Resource::GetRefs(void) const {
+		return refs_;
+	}
+
+	void Resource::SetGpuBytes(size_t bytes) {
+		gpu_bytes_ = bytes;
+	}
+
+	size_t Resource::GetGpuBytes(void) const {
+		return gpu_bytes_;
+	}
+
+	size_t Resource::GetCpuBytes(void) const {
+		size_t bytes = sizeof(Resource) + name_.capacity();
+		if (terrain_) {
+			bytes += sizeof(TerrainData) + terrain_->heights.capacity() * sizeof(float) + terrain_->tiles.capacity() * sizeof(TerrainTile);
+		}
+		return bytes;
+	}
+
+	void Resource::SetOwned(bool owned) {
+		owned_ = owned;
+	}
+
+	bool Resource::IsOwned(void) const {
+		return owned_;
+	}
 } // namespace game
@@ -7,8 +7,10 @@
 #include "hitbox.h"
 
 namespace game {
+	struct TerrainData;
+
 	// Possible resource types
-	typedef enum Type { Material, PointSet, Mesh, Texture } ResourceType;
+	typedef enum Type { Material, PointSet, Mesh, Texture, TextureArray } ResourceType;
 
 	// Class that holds one resource
 	class Resource {
@@ -26,11 +28,16 @@ namespace game {
 		};
 		GLsizei size_; // Number of primitives in geometry
 		Hitbox hb;
+		TerrainData *terrain_; // Heightfield and tiles, for terrain meshes only
+		mutable int refs_; // Scene nodes and resource sets using the resource
+		size_t gpu_bytes_; // Estimated GPU memory of the buffers or texture
+		bool owned_; // Whether unloading deletes the GL objects, false if something else manages them
 
 	public:
 		Resource(ResourceType type, std::string name, GLuint resource, GLsizei size);
 		Resource(ResourceType type, std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size, Hitbox _hb);
 		Resource(ResourceType type, std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size);
+		Resource(ResourceType type, std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size, TerrainData *terrain);
 		~Resource();
 		ResourceType GetType(void) const;
 		const std::string GetName(void) const;
@@ -39,6 +46,19 @@ namespace game {
 		GLuint GetElementArrayBuffer(void) const;
 		GLsizei GetSize(void) const;
 		Hitbox GetHitbox(void) const;
+		const TerrainData *GetTerrain(void) const;
+
+		// Reference counting: an unloaded resource is only freed once nothing uses it
+		void Acquire(void) const;
+		void Release(void) const;
+		int GetRefs(void) const;
+
+		void SetGpuBytes(size_t bytes);
+		size_t GetGpuBytes(void) const;
+		// Memory of the object itself and of the terrain data it owns
+		size_t GetCpuBytes(void) const;
+		void SetOwned(bool owned);
+		bool IsOwned(void) const;
 
 	}; // class Resource
 } // namespace game
@@ -9,20 +9,41 @@
 #include <array>
 #include <vector>
 #include <iterator>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include "resource_manager.h"
+#include "obj_parser.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "program_cache.h"
+#include "gpu_counters.h"
+#include "frame_uniforms.h"
 #include "bin/path_config.h"
 
 namespace game {
-	ResourceManager::ResourceManager(void) {}
+	ResourceManager::ResourceManager(void) {
+		texture_sampler_ = 0;
+		mesh_cache_hits_ = 0;
+		mesh_cache_misses_ = 0;
+		upload_batch_ = false;
+		frame_loop_ = false;
+		frame_lookups_ = 0;
+	}
 
-	ResourceManager::~ResourceManager() {}
+	ResourceManager::~ResourceManager() {
+		// GL objects are deleted by Clear, the context is usually gone by now
+		for (unsigned int i = 0; i < resource_.size(); i++) {
+			delete resource_[i];
+		}
+	}
 
 	void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size) {
 		Resource *res;
 
 		res = new Resource(type, name, resource, size);
 
-		resource_.push_back(res);
+		Insert(res);
 	}
 
 	void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size, Hitbox _hb) {
@@ -30,58 +51,598 @@ namespace game {
 
 		res = new Resource(type, name, array_buffer, element_array_buffer, size, _hb);
 
-		resource_.push_back(res);
+		Insert(res);
+	}
+
+	void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size, TerrainData *terrain) {
+		Resource *res;
+
+		res = new Resource(type, name, array_buffer, element_array_buffer, size, terrain);
+
+		Insert(res);
 	}
 
 	void ResourceManager::LoadResource(ResourceType type, const std::string name, const char *filename) {
+		double start = glfwGetTime();
+
 		// Call appropriate method depending on type of resource
-		if (type == Material) {
-			LoadMaterial(name, filename);
+		DecodedAsset asset(type, name);
+		DecodeResource(filename, asset);
+		UploadResource(asset);
+
+		AssetLoadTime time = { name, (glfwGetTime() - start) * 1000.0 };
+		load_times_.push_back(time);
+	}
+
+	void ResourceManager::DecodeResource(const char *filename, DecodedAsset &asset) {
+		if (asset.type == Material) {
+			DecodeMaterial(filename, asset);
 		}
-		else if (type == Texture) {
-			LoadTexture(name, filename);
-		} else if (type == Mesh) {
-			LoadMesh(name, filename);
+		else if (asset.type == Texture) {
+			DecodeTexture(filename, asset);
+		}
+		else if (asset.type == TextureArray) {
+			DecodeTextureArray(filename, asset);
+		}
+		else if (asset.type == Mesh) {
+			DecodeMesh(filename, asset);
+		}
+		else {
+			throw(std::invalid_argument(std::string("Invalid type of resource")));
+		}
+	}
+
+	void ResourceManager::UploadResource(DecodedAsset &asset) {
+		if (asset.type == Material) {
+			UploadMaterial(asset);
+		}
+		else if (asset.type == Texture) {
+			UploadTexture(asset);
+		}
+		else if (asset.type == TextureArray) {
+			UploadTextureArray(asset);
+		}
+		else if (asset.type == Mesh) {
+			UploadMesh(asset);
 		}
 		else {
 			throw(std::invalid_argument(std::string("Invalid type of resource")));
 		}
 	}
 
+	DecodedAsset::DecodedAsset(ResourceType type, const std::string name) {
+		this->type = type;
+		this->name = name;
+		source_hash = 0;
+		pixels = NULL;
+		width = height = channels = 0;
+		cache = NULL;
+		vertex_data = NULL;
+		num_vertex_floats = 0;
+		index_data = NULL;
+		num_indices = 0;
+		terrain = NULL;
+	}
+
+	DecodedAsset::~DecodedAsset() {
+		Release();
+		delete terrain;
+	}
+
+	void DecodedAsset::Release(void) {
+		if (pixels) {
+			SOIL_free_image_data(pixels);
+			pixels = NULL;
+		}
+		delete cache;
+		cache = NULL;
+		std::vector<char>().swap(program_binary);
+		std::vector<unsigned char>().swap(layer_pixels);
+		std::vector<GLfloat>().swap(vertices);
+		std::vector<GLuint>().swap(indices);
+		vertex_data = NULL;
+		index_data = NULL;
+	}
+
 	void ResourceManager::LoadTexture(const std::string name, const char *filename) {
-		// Load texture from file
-		GLuint texture = SOIL_load_OGL_texture(filename, SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, SOIL_FLAG_INVERT_Y);
-		if (!texture) {
+		DecodedAsset asset(Texture, name);
+		DecodeTexture(filename, asset);
+		UploadTexture(asset);
+	}
+
+	void ResourceManager::DecodeTexture(const char *filename, DecodedAsset &asset) {
+		// Decode the image file, without touching the GL
+		asset.pixels = SOIL_load_image(filename, &asset.width, &asset.height, &asset.channels, SOIL_LOAD_AUTO);
+		if (!asset.pixels) {
 			throw(std::ios_base::failure(std::string("Error loading texture ") + std::string(filename) + std::string(": ") + std::string(SOIL_last_result())));
 		}
 
-		// Create resource
-		AddResource(Texture, name, texture, 0);
+		// Images are stored top row first, textures bottom row first
+		int row_size = asset.width * asset.channels;
+		std::vector<unsigned char> row(row_size);
+		for (int top = 0, bottom = asset.height - 1; top < bottom; top++, bottom--) {
+			memcpy(&row[0], asset.pixels + top * row_size, row_size);
+			memcpy(asset.pixels + top * row_size, asset.pixels + bottom * row_size, row_size);
+			memcpy(asset.pixels + bottom * row_size, &row[0], row_size);
+		}
+	}
+
+	void ResourceManager::UploadTexture(DecodedAsset &asset) {
+		static const GLenum formats[5] = { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+		if (asset.channels < 1 || asset.channels > 4) {
+			throw(std::ios_base::failure(std::string("Error loading texture ") + asset.name + std::string(": unsupported number of channels")));
+		}
+
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, formats[asset.channels], asset.width, asset.height, 0, formats[asset.channels], GL_UNSIGNED_BYTE, asset.pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		SOIL_free_image_data(asset.pixels);
+		asset.pixels = NULL;
+
+		GpuCounters::CountTextureUpload();
+
+		// Build the mip chain once, drawing only binds the texture from now on
+		glGenerateMipmap(GL_TEXTURE_2D);
+		GpuCounters::CountMipmapGeneration();
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// Create resource, a third more for the mips
+		AddTexture(asset.name, texture, (size_t)asset.width * asset.height * asset.channels * 4 / 3);
+	}
+
+	void ResourceManager::AddTexture(const std::string name, GLuint texture, size_t gpu_bytes, bool owned) {
+		// Same filtering as a sampler object, so it overrides whatever state a texture was left in
+		if (!texture_sampler_) {
+			glGenSamplers(1, &texture_sampler_);
+			glSamplerParameteri(texture_sampler_, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glSamplerParameteri(texture_sampler_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glSamplerParameteri(texture_sampler_, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glSamplerParameteri(texture_sampler_, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		}
+
+		Resource *res = new Resource(Texture, name, texture, 0);
+		res->SetGpuBytes(gpu_bytes);
+		res->SetOwned(owned);
+		Insert(res);
+	}
+
+	// Scale an RGBA image to the size of a layer, flipping it to bottom row first. Sampling
+	// between texels averages 2x2 of them when the image is halved
+	static void resample_layer(const unsigned char *src, int src_width, int src_height, unsigned char *dst, int width, int height) {
+		for (int y = 0; y < height; y++) {
+			float sy = (float)src_height - ((float)y + 0.5f) * (float)src_height / (float)height - 0.5f;
+			sy = std::min(std::max(sy, 0.0f), (float)(src_height - 1));
+			int y0 = (int)sy;
+			int y1 = std::min(y0 + 1, src_height - 1);
+			float fy = sy - (float)y0;
+			for (int x = 0; x < width; x++) {
+				float sx = ((float)x + 0.5f) * (float)src_width / (float)width - 0.5f;
+				sx = std::min(std::max(sx, 0.0f), (float)(src_width - 1));
+				int x0 = (int)sx;
+				int x1 = std::min(x0 + 1, src_width - 1);
+				float fx = sx - (float)x0;
+				for (int c = 0; c < 4; c++) {
+					float top = src[(y0 * src_width + x0) * 4 + c] * (1.0f - fx) + src[(y0 * src_width + x1) * 4 + c] * fx;
+					float bottom = src[(y1 * src_width + x0) * 4 + c] * (1.0f - fx) + src[(y1 * src_width + x1) * 4 + c] * fx;
+					dst[(y * width + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+				}
+			}
+		}
+	}
+
+	void ResourceManager::DecodeTextureArray(const char *filename, DecodedAsset &asset) {
+		// One layer per line: the name it is looked up by and its image, relative to the list
+		std::string list = LoadTextFile(filename);
+		std::string directory(filename);
+		size_t slash = directory.find_last_of("/\\");
+		directory = (slash == std::string::npos) ? std::string("") : directory.substr(0, slash + 1);
+
+		std::vector<std::string> images;
+		std::istringstream lines(list);
+		std::string line;
+		while (std::getline(lines, line)) {
+			std::istringstream words(line);
+			std::string layer, image;
+			if (!(words >> layer) || layer[0] == '#') {
+				continue;
+			}
+			if (!(words >> image)) {
+				throw(std::ios_base::failure(std::string("Error loading texture array ") + std::string(filename) + std::string(": no image for layer ") + layer));
+			}
+			asset.layer_names.push_back(layer);
+			images.push_back(directory + image);
+		}
+		if (images.empty()) {
+			throw(std::ios_base::failure(std::string("Error loading texture array ") + std::string(filename) + std::string(": no layers")));
+		}
+
+		// Every layer has the size of the largest image, within TEXTURE_ARRAY_LAYER_SIZE
+		std::vector<unsigned char *> pixels(images.size(), (unsigned char *)NULL);
+		std::vector<int> widths(images.size()), heights(images.size());
+		asset.width = asset.height = 1;
+		asset.channels = 4;
+		for (unsigned int i = 0; i < images.size(); i++) {
+			int channels;
+			pixels[i] = SOIL_load_image(images[i].c_str(), &widths[i], &heights[i], &channels, SOIL_LOAD_RGBA);
+			if (!pixels[i]) {
+				std::string error = std::string("Error loading texture ") + images[i] + std::string(": ") + std::string(SOIL_last_result());
+				for (unsigned int j = 0; j < i; j++) {
+					SOIL_free_image_data(pixels[j]);
+				}
+				throw(std::ios_base::failure(error));
+			}
+			asset.width = std::max(asset.width, std::min(widths[i], TEXTURE_ARRAY_LAYER_SIZE));
+			asset.height = std::max(asset.height, std::min(heights[i], TEXTURE_ARRAY_LAYER_SIZE));
+		}
+
+		size_t layer_size = (size_t)asset.width * asset.height * 4;
+		asset.layer_pixels.resize(layer_size * images.size());
+		for (unsigned int i = 0; i < images.size(); i++) {
+			resample_layer(pixels[i], widths[i], heights[i], &asset.layer_pixels[layer_size * i], asset.width, asset.height);
+			SOIL_free_image_data(pixels[i]);
+		}
+	}
+
+	void ResourceManager::UploadTextureArray(DecodedAsset &asset) {
+		GLsizei layers = (GLsizei)asset.layer_names.size();
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, asset.width, asset.height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, &asset.layer_pixels[0]);
+		GpuCounters::CountTextureUpload();
+		size_t bytes = asset.layer_pixels.size() * 4 / 3; // With the mips
+		std::vector<unsigned char>().swap(asset.layer_pixels);
+
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		GpuCounters::CountMipmapGeneration();
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		Resource *res = new Resource(TextureArray, asset.name, texture, layers);
+		res->SetGpuBytes(bytes);
+		int index = Insert(res);
+
+		// The first array listing a name keeps it
+		for (GLsizei i = 0; i < layers; i++) {
+			texture_layers_.insert(std::make_pair(asset.layer_names[i], std::make_pair(index, (int)i)));
+		}
+	}
+
+	int ResourceManager::GetTextureLayer(const std::string layer) const {
+		std::unordered_map<std::string, std::pair<int, int> >::const_iterator it = texture_layers_.find(layer);
+		return (it == texture_layers_.end()) ? -1 : it->second.second;
+	}
+
+	GLuint ResourceManager::GetTextureSampler(void) const {
+		return texture_sampler_;
+	}
+
+	int ResourceManager::GetMeshCacheHits(void) const {
+		return mesh_cache_hits_;
+	}
+
+	int ResourceManager::GetMeshCacheMisses(void) const {
+		return mesh_cache_misses_;
+	}
+
+	// Size of the storage of a buffer object
+	static size_t buffer_bytes(GLuint buffer) {
+		if (!buffer) {
+			return 0;
+		}
+		GLint size = 0;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return (size_t)size;
+	}
+
+	int ResourceManager::Insert(Resource *res) {
+		// Geometry is created in many places, ask the GL how large its buffers are
+		if ((res->GetType() == Mesh || res->GetType() == PointSet) && res->GetGpuBytes() == 0) {
+			res->SetGpuBytes(buffer_bytes(res->GetArrayBuffer()) + buffer_bytes(res->GetElementArrayBuffer()));
+		}
+
+		// Reuse the position of a freed resource, its handles see another generation
+		int index;
+		if (!free_slots_.empty()) {
+			index = free_slots_.back();
+			free_slots_.pop_back();
+			resource_[index] = res;
+		}
+		else {
+			index = (int)resource_.size();
+			resource_.push_back(res);
+			generation_.push_back(0);
+		}
+
+		// The first resource added with a name keeps it
+		index_.insert(std::make_pair(res->GetName(), index));
+		return index;
+	}
+
+	int ResourceManager::Find(const std::string &name) const {
+		std::unordered_map<std::string, int>::const_iterator it = index_.find(name);
+		return (it == index_.end()) ? -1 : it->second;
 	}
 
 	Resource *ResourceManager::GetResource(const std::string name) const {
+		// Flag lookups by name while the game runs, those should use handles
+		if (frame_loop_) {
+			frame_lookups_++;
+			if (flagged_lookups_.insert(name).second) {
+				std::cout << "Resource \"" << name << "\" looked up by name inside the frame loop" << std::endl;
+			}
+		}
+
 		// Find resource with the specified name
-		for (int i = 0; i < resource_.size(); i++) {
-			if (resource_[i]->GetName() == name) {
-				return resource_[i];
+		int index = Find(name);
+		return (index < 0) ? NULL : resource_[index];
+	}
+
+	MeshHandle ResourceManager::GetMeshHandle(const std::string name) const {
+		int index = Find(name);
+		if (index < 0 || (resource_[index]->GetType() != Mesh && resource_[index]->GetType() != PointSet)) {
+			return MeshHandle();
+		}
+		return MeshHandle(index, generation_[index]);
+	}
+
+	MaterialHandle ResourceManager::GetMaterialHandle(const std::string name) const {
+		int index = Find(name);
+		if (index < 0 || resource_[index]->GetType() != Material) {
+			return MaterialHandle();
+		}
+		return MaterialHandle(index, generation_[index]);
+	}
+
+	TextureHandle ResourceManager::GetTextureHandle(const std::string name) const {
+		int index = Find(name);
+		if (index < 0 || resource_[index]->GetType() != Texture) {
+			return TextureHandle();
+		}
+		return TextureHandle(index, generation_[index]);
+	}
+
+	TextureArrayHandle ResourceManager::GetTextureArrayHandle(const std::string name) const {
+		int index = Find(name);
+		if (index < 0 || resource_[index]->GetType() != TextureArray) {
+			return TextureArrayHandle();
+		}
+		return TextureArrayHandle(index, generation_[index]);
+	}
+
+	Resource *ResourceManager::GetResource(MeshHandle handle) const {
+		return Resolve(handle.index, handle.generation);
+	}
+
+	Resource *ResourceManager::GetResource(MaterialHandle handle) const {
+		return Resolve(handle.index, handle.generation);
+	}
+
+	Resource *ResourceManager::GetResource(TextureHandle handle) const {
+		return Resolve(handle.index, handle.generation);
+	}
+
+	Resource *ResourceManager::GetResource(TextureArrayHandle handle) const {
+		return Resolve(handle.index, handle.generation);
+	}
+
+	Resource *ResourceManager::Resolve(int index, unsigned int generation) const {
+		if (index < 0 || index >= (int)resource_.size() || generation_[index] != generation) {
+			return NULL;
+		}
+		return resource_[index];
+	}
+
+	bool ResourceManager::IsLoaded(const std::string name) const {
+		return Find(name) >= 0;
+	}
+
+	Resource *ResourceManager::Acquire(const std::string name) {
+		int index = Find(name);
+		if (index < 0) {
+			return NULL;
+		}
+		resource_[index]->Acquire();
+		return resource_[index];
+	}
+
+	void ResourceManager::Unload(const std::string name) {
+		int index = Find(name);
+		if (index >= 0) {
+			Unload(resource_[index]);
+		}
+	}
+
+	void ResourceManager::Unload(const Resource *res) {
+		std::vector<Resource *>::iterator it = std::find(resource_.begin(), resource_.end(), res);
+		if (!res || it == resource_.end()) {
+			return;
+		}
+		int index = (int)(it - resource_.begin());
+		if (std::find(unloading_.begin(), unloading_.end(), index) != unloading_.end()) {
+			return;
+		}
+
+		// The name can be loaded again right away, nodes still drawing the old resource keep it
+		if (Find(res->GetName()) == index) {
+			index_.erase(res->GetName());
+		}
+		for (std::unordered_map<std::string, std::pair<int, int> >::iterator layer = texture_layers_.begin(); layer != texture_layers_.end();) {
+			if (layer->second.first == index) {
+				layer = texture_layers_.erase(layer);
+			}
+			else {
+				layer++;
+			}
+		}
+		unloading_.push_back(index);
+		Collect();
+	}
+
+	void ResourceManager::Collect(void) {
+		for (unsigned int i = 0; i < unloading_.size();) {
+			if (resource_[unloading_[i]]->GetRefs() == 0) {
+				Free(unloading_[i]);
+				unloading_[i] = unloading_.back();
+				unloading_.pop_back();
+			}
+			else {
+				i++;
+			}
+		}
+	}
+
+	void ResourceManager::Free(int index) {
+		Resource *res = resource_[index];
+		if (res->IsOwned()) {
+			if (res->GetType() == Material) {
+				glDeleteProgram(res->GetResource());
+			}
+			else if (res->GetType() == Mesh || res->GetType() == PointSet) {
+				GLuint buffers[2] = { res->GetArrayBuffer(), res->GetElementArrayBuffer() };
+				glDeleteBuffers(2, buffers);
+			}
+			else {
+				GLuint texture = res->GetResource();
+				glDeleteTextures(1, &texture);
+			}
+		}
+		delete res;
+		resource_[index] = NULL;
+		generation_[index]++;
+		free_slots_.push_back(index);
+	}
+
+	void ResourceManager::Clear(void) {
+		for (unsigned int i = 0; i < resource_.size(); i++) {
+			if (resource_[i]) {
+				Free(i);
 			}
 		}
-		return NULL;
+		index_.clear();
+		texture_layers_.clear();
+		unloading_.clear();
+		mesh_staging_.Clear();
+	}
+
+	size_t ResourceManager::GetGpuBytes(void) const {
+		size_t bytes = 0;
+		for (unsigned int i = 0; i < resource_.size(); i++) {
+			if (resource_[i] && resource_[i]->IsOwned()) {
+				bytes += resource_[i]->GetGpuBytes();
+			}
+		}
+		return bytes;
+	}
+
+	size_t ResourceManager::GetCpuBytes(void) const {
+		size_t bytes = resource_.capacity() * sizeof(Resource *) + generation_.capacity() * sizeof(unsigned int);
+		for (unsigned int i = 0; i < resource_.size(); i++) {
+			if (resource_[i]) {
+				bytes += resource_[i]->GetCpuBytes();
+			}
+		}
+		return bytes;
+	}
+
+	void ResourceManager::PrintMemory(std::ostream &out) const {
+		static const char *type_names[] = { "materials", "point sets", "meshes", "textures", "texture arrays" };
+		const int num_types = sizeof(type_names) / sizeof(type_names[0]);
+		int count[num_types] = { 0 };
+		size_t gpu[num_types] = { 0 };
+		for (unsigned int i = 0; i < resource_.size(); i++) {
+			if (resource_[i]) {
+				count[resource_[i]->GetType()]++;
+				gpu[resource_[i]->GetType()] += resource_[i]->IsOwned() ? resource_[i]->GetGpuBytes() : 0;
+			}
+		}
+
+		const double mb = 1024.0 * 1024.0;
+		out << "Resource memory: " << GetGpuBytes() / mb << " MB GPU, " << GetCpuBytes() / mb << " MB CPU, "
+			<< unloading_.size() << " unloaded resources still in use" << std::endl;
+		for (int t = 0; t < num_types; t++) {
+			if (count[t] > 0) {
+				out << "  " << count[t] << " " << type_names[t] << ": " << gpu[t] / mb << " MB GPU" << std::endl;
+			}
+		}
+	}
+
+	void ResourceManager::SetFrameLoop(bool frame_loop) {
+		frame_loop_ = frame_loop;
+	}
+
+	int ResourceManager::GetFrameLookups(void) const {
+		return frame_lookups_;
 	}
 
 	void ResourceManager::LoadMaterial(const std::string name, const char *prefix) {
+		DecodedAsset asset(Material, name);
+		DecodeMaterial(prefix, asset);
+		UploadMaterial(asset);
+	}
 
+	void ResourceManager::DecodeMaterial(const char *prefix, DecodedAsset &asset) {
 		// Load vertex program source code
 		std::string filename = std::string(prefix) + std::string(VERTEX_PROGRAM_EXTENSION);
-		std::string vp = LoadTextFile(filename.c_str());
+		asset.vertex_program = LoadTextFile(filename.c_str());
 
 		// Load fragment program source code
 		filename = std::string(prefix) + std::string(FRAGMENT_PROGRAM_EXTENSION);
-		std::string fp = LoadTextFile(filename.c_str());
+		asset.fragment_program = LoadTextFile(filename.c_str());
 
+		// Try to also load a geometry shader
+		filename = std::string(prefix) + std::string(GEOMETRY_PROGRAM_EXTENSION);
+		asset.geometry_program = "";
+		try {
+			asset.geometry_program = LoadTextFile(filename.c_str());
+		}
+		catch (std::exception &e) {
+		}
+
+		// Binary of the program from an earlier start, if it was built from the same sources
+		asset.program_prefix = prefix;
+		asset.source_hash = fnv1a_hash(asset.vertex_program.data(), asset.vertex_program.size());
+		asset.source_hash = fnv1a_hash(asset.fragment_program.data(), asset.fragment_program.size(), asset.source_hash);
+		asset.source_hash = fnv1a_hash(asset.geometry_program.data(), asset.geometry_program.size(), asset.source_hash);
+		ProgramCache::Read(asset.program_prefix, asset.source_hash, asset.program_binary);
+	}
+
+	void ResourceManager::UploadMaterial(DecodedAsset &asset) {
+		double start = glfwGetTime();
+
+		// Compile only when there is no binary this driver accepts
+		GLuint sp = ProgramCache::Load(asset.program_binary);
+		bool cached = (sp != 0);
+		std::vector<char>().swap(asset.program_binary);
+		if (!cached) {
+			sp = CompileMaterial(asset);
+			ProgramCache::Write(asset.program_prefix, asset.source_hash, sp);
+		}
+
+		ProgramLoadTime time = { asset.name, cached, (glfwGetTime() - start) * 1000.0 };
+		program_times_.push_back(time);
+
+		// Read camera, timer and light from the shared per-frame block
+		FrameUniforms::BindProgram(sp);
+
+		// Add a resource for the shader program
+		AddResource(Material, asset.name, sp, 0);
+	}
+
+	GLuint ResourceManager::CompileMaterial(const DecodedAsset &asset) {
 		// Create a shader from the vertex program source code
 		GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-		const char *source_vp = vp.c_str();
+		const char *source_vp = asset.vertex_program.c_str();
 		glShaderSource(vs, 1, &source_vp, NULL);
 		glCompileShader(vs);
 
@@ -96,7 +657,7 @@ namespace game {
 
 		// Create a shader from the fragment program source code
 		GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-		const char *source_fp = fp.c_str();
+		const char *source_fp = asset.fragment_program.c_str();
 		glShaderSource(fs, 1, &source_fp, NULL);
 		glCompileShader(fs);
 
@@ -108,22 +669,13 @@ namespace game {
 			throw(std::ios_base::failure(std::string("Error compiling fragment shader: ") + std::string(buffer)));
 		}
 
-		// Try to also load a geometry shader
-		filename = std::string(prefix) + std::string(GEOMETRY_PROGRAM_EXTENSION);
-		bool geometry_program = false;
-		std::string gp = "";
+		// Geometry shader, if the material has one
+		bool geometry_program = !asset.geometry_program.empty();
 		GLuint gs;
-		try {
-			gp = LoadTextFile(filename.c_str());
-			geometry_program = true;
-		}
-		catch (std::exception &e) {
-		}
-
 		if (geometry_program) {
 			// Create a shader from the geometry program source code
 			gs = glCreateShader(GL_GEOMETRY_SHADER);
-			const char *source_gp = gp.c_str();
+			const char *source_gp = asset.geometry_program.c_str();
 			glShaderSource(gs, 1, &source_gp, NULL);
 			glCompileShader(gs);
 
@@ -144,6 +696,7 @@ namespace game {
 		if (geometry_program) {
 			glAttachShader(sp, gs);
 		}
+		ProgramCache::PrepareLink(sp);
 		glLinkProgram(sp);
 
 		// Check if shaders were linked successfully
@@ -161,6 +714,67 @@ namespace game {
 			glDeleteShader(gs);
 		}
 
+		return sp;
+	}
+
+	void ResourceManager::LoadTransformFeedbackMaterial(const std::string name, const char *prefix, const char **varyings, int num_varyings) {
+		double start = glfwGetTime();
+
+		// Load vertex program source code
+		std::string filename = std::string(prefix) + std::string(VERTEX_PROGRAM_EXTENSION);
+		std::string vp = LoadTextFile(filename.c_str());
+
+		// The captured outputs are part of the binary too
+		unsigned long long source_hash = fnv1a_hash(vp.data(), vp.size());
+		for (int i = 0; i < num_varyings; i++) {
+			source_hash = fnv1a_hash(varyings[i], strlen(varyings[i]) + 1, source_hash);
+		}
+		std::vector<char> binary;
+		ProgramCache::Read(prefix, source_hash, binary);
+		GLuint cached = ProgramCache::Load(binary);
+		if (cached) {
+			ProgramLoadTime time = { name, true, (glfwGetTime() - start) * 1000.0 };
+			program_times_.push_back(time);
+			AddResource(Material, name, cached, 0);
+			return;
+		}
+
+		// Create a shader from the vertex program source code
+		GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+		const char *source_vp = vp.c_str();
+		glShaderSource(vs, 1, &source_vp, NULL);
+		glCompileShader(vs);
+
+		// Check if shader compiled successfully
+		GLint status;
+		glGetShaderiv(vs, GL_COMPILE_STATUS, &status);
+		if (status != GL_TRUE) {
+			char buffer[512];
+			glGetShaderInfoLog(vs, 512, NULL, buffer);
+			throw(std::ios_base::failure(std::string("Error compiling vertex shader: ") + std::string(buffer)));
+		}
+
+		// The captured outputs have to be declared before linking
+		GLuint sp = glCreateProgram();
+		glAttachShader(sp, vs);
+		glTransformFeedbackVaryings(sp, num_varyings, varyings, GL_INTERLEAVED_ATTRIBS);
+		ProgramCache::PrepareLink(sp);
+		glLinkProgram(sp);
+
+		// Check if shaders were linked successfully
+		glGetProgramiv(sp, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE) {
+			char buffer[512];
+			glGetProgramInfoLog(sp, 512, NULL, buffer);
+			throw(std::ios_base::failure(std::string("Error linking shaders: ") + std::string(buffer)));
+		}
+
+		glDeleteShader(vs);
+		ProgramCache::Write(prefix, source_hash, sp);
+
+		ProgramLoadTime time = { name, false, (glfwGetTime() - start) * 1000.0 };
+		program_times_.push_back(time);
+
 		// Add a resource for the shader program
 		AddResource(Material, name, sp, 0);
 	}
@@ -505,142 +1119,216 @@ namespace game {
 		AddResource(Mesh, object_name, vbo, ebo, sizeof(face) / sizeof(GLfloat), genHitbox(positions));
 	}
 
+	// Texel indices kept between first and last when sampling every step texels
+	static void terrain_samples(std::vector<int> &out, int first, int last, int step) {
+		out.clear();
+		for (int k = first; k < last; k += step) {
+			out.push_back(k);
+		}
+		out.push_back(last);
+	}
+
 	void ResourceManager::CreateGround(std::string object_name) {
-		struct Vertex {
-			glm::vec3 vertex_position;
-			glm::vec3 vertex_normal;
-			glm::vec3 vertex_color;
-			glm::vec2 vertex_coord;
-		};
+		DecodedAsset asset(Mesh, object_name);
+		DecodeGround(asset);
+		UploadMesh(asset);
+	}
 
+	void ResourceManager::DecodeGround(DecodedAsset &asset) {
 		std::string filename = std::string(MATERIAL_DIRECTORY) + std::string("/heightmap.bmp");
 		const char *const file = filename.c_str();
 		cimg_library::CImg<> img;
 		img.assign(file);
 
-		// Number of vertices and faces to be created
-		const GLuint vertex_num = img.width() * img.height();
-		const GLuint face_num = vertex_num * 2;
-
-		std::vector<std::vector<Vertex>> vertices = std::vector<std::vector<Vertex>>();
-
-		// Number of attributes for vertices and faces
-		const int vertex_att = 11; // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
-		const int face_att = 3; // 3 indices per face
-
-		// Data buffers 
-		GLfloat *vertex = NULL;
-		GLuint *face = NULL;
-
-		// Allocate memory for buffers
-		try {
-			vertex = new GLfloat[vertex_num * vertex_att];
-			face = new GLuint[face_num * face_att];
-		}
-		catch (std::exception &e) {
-			throw e;
+		// The heightmap becomes a grid of rows * cols vertices, one per texel
+		TerrainData *terrain = new TerrainData();
+		terrain->rows = img.height();
+		terrain->cols = img.width();
+		terrain->spacing = 2.0;
+		const int rows = terrain->rows;
+		const int cols = terrain->cols;
+
+		terrain->heights.resize(rows * cols);
+		for (int i = 0; i < rows; i++) {
+			for (int j = 0; j < cols; j++) {
+				terrain->heights[i * cols + j] = img.atXY(i, j) / 5;
+			}
 		}
 
-		Vertex v;
-		for (float i = 0; i < img.height(); i++) {
-			vertices.push_back(std::vector<Vertex>());
-			for (float j = 0; j < img.width(); j++) {
-
-				v.vertex_position = glm::vec3(i * 2, (img.atXY(i, j)) / 5, j * 2);
-				v.vertex_normal = glm::vec3(0, 0, 0);
-				v.vertex_color = glm::vec3(0, 1.0 - (img.atXY(i, j) / 255), 0);
-
-				// fix texture coords :(
-				v.vertex_coord = glm::vec2(i / img.height(), j / img.width());
-
-				vertices[i].push_back(v);
+		// Accumulate the normals of the two full-detail triangles of every quad
+		std::vector<glm::vec3> normals(rows * cols, glm::vec3(0, 0, 0));
+		glm::vec3 p00, p01, p10, p11, face_normal;
+		for (int i = 0; i < rows - 1; i++) {
+			for (int j = 0; j < cols - 1; j++) {
+				p00 = glm::vec3(i * terrain->spacing, terrain->heights[i * cols + j], j * terrain->spacing);
+				p01 = glm::vec3(i * terrain->spacing, terrain->heights[i * cols + j + 1], (j + 1) * terrain->spacing);
+				p10 = glm::vec3((i + 1) * terrain->spacing, terrain->heights[(i + 1) * cols + j], j * terrain->spacing);
+				p11 = glm::vec3((i + 1) * terrain->spacing, terrain->heights[(i + 1) * cols + j + 1], (j + 1) * terrain->spacing);
+
+				face_normal = glm::normalize(glm::cross(p01 - p00, p10 - p00));
+				normals[i * cols + j] += face_normal;
+				normals[i * cols + j + 1] += face_normal;
+				normals[(i + 1) * cols + j] += face_normal;
+
+				face_normal = glm::normalize(glm::cross(p10 - p11, p01 - p11));
+				normals[(i + 1) * cols + j + 1] += face_normal;
+				normals[i * cols + j + 1] += face_normal;
+				normals[(i + 1) * cols + j] += face_normal;
 			}
 		}
 
-		// Create faces
-		glm::vec3 t1, t2;
-		glm::vec3 face_normal;
-		int index1, index2, index3;
-		Vertex *v1, *v2, *v3;
-		glm::vec3 e1, e2;
-		for (int i = 0; i < img.height() - 1; i++) {
-			for (int j = 0; j < (img.width() - 1); j++) {
-				// get each vertex of triangle
-				v1 = &vertices[i][j];
-				v2 = &vertices[i][j + 1];
-				v3 = &vertices[i + 1][j];
-
-				// calculate the normal
-				e1 = v2->vertex_position - v1->vertex_position;
-				e2 = v3->vertex_position - v1->vertex_position;
-				face_normal = glm::cross(e1, e2);
-				face_normal = glm::normalize(face_normal);
-
-				// apply the normals to the vertices
-				v1->vertex_normal += face_normal;
-				v2->vertex_normal += face_normal;
-				v3->vertex_normal += face_normal;
-
-				// and now do it for the second triangle
-				// get each vertex of triangle
-				v1 = &vertices[i + 1][j + 1];
-				v2 = &vertices[i][j + 1];
-				v3 = &vertices[i + 1][j];
-
-				// calculate the normal
-				e1 = v2->vertex_position - v1->vertex_position;
-				e2 = v3->vertex_position - v1->vertex_position;
-				face_normal = glm::cross(e2, e1);
-				face_normal = glm::normalize(face_normal);
-
-				v1->vertex_normal += face_normal;
-				v2->vertex_normal += face_normal;
-				v3->vertex_normal += face_normal;
-
-				// Two triangles per quad
-				t1 = glm::vec3(i*img.width() + j, i*img.width() + j + 1, (i + 1)*img.width() + j);
-				t2 = glm::vec3(i*img.width() + j + 1, (i + 1)*img.width() + j + 1, (i + 1)*img.width() + j);
-
-				// Add two triangles to the data buffer
-				for (int k = 0; k < 3; k++) {
-					face[(i*(img.width() - 1) + j)*face_att * 2 + k] = (GLuint)t1[k];
-					face[(i*(img.width() - 1) + j)*face_att * 2 + k + face_att] = (GLuint)t2[k];
+		// Sample positions of every tile at every level of detail: each level keeps every
+		// 2^l-th texel of the tile, plus its last row/column so neighbouring tiles meet
+		const int tiles_i = (rows - 2) / TERRAIN_TILE_SIZE + 1;
+		const int tiles_j = (cols - 2) / TERRAIN_TILE_SIZE + 1;
+		std::vector<int> samples_i, samples_j;
+
+		// Geometric error of each level: largest gap between a texel and the coarse triangle above it
+		terrain->tiles.resize(tiles_i * tiles_j);
+		float max_error = 0;
+		for (int ti = 0; ti < tiles_i; ti++) {
+			for (int tj = 0; tj < tiles_j; tj++) {
+				TerrainTile &tile = terrain->tiles[ti * tiles_j + tj];
+				int i0 = ti * TERRAIN_TILE_SIZE, i1 = std::min(i0 + TERRAIN_TILE_SIZE, rows - 1);
+				int j0 = tj * TERRAIN_TILE_SIZE, j1 = std::min(j0 + TERRAIN_TILE_SIZE, cols - 1);
+
+				float min_h = INFINITY, max_h = -INFINITY;
+				for (int i = i0; i <= i1; i++) {
+					for (int j = j0; j <= j1; j++) {
+						min_h = std::min(min_h, terrain->heights[i * cols + j]);
+						max_h = std::max(max_h, terrain->heights[i * cols + j]);
+					}
 				}
+				tile.min_corner = glm::vec3(i0 * terrain->spacing, min_h, j0 * terrain->spacing);
+				tile.max_corner = glm::vec3(i1 * terrain->spacing, max_h, j1 * terrain->spacing);
+
+				tile.error[0] = 0;
+				for (int l = 1; l < TERRAIN_LOD_LEVELS; l++) {
+					terrain_samples(samples_i, i0, i1, 1 << l);
+					terrain_samples(samples_j, j0, j1, 1 << l);
+					float error = tile.error[l - 1];
+					for (unsigned int a = 0; a + 1 < samples_i.size(); a++) {
+						for (unsigned int b = 0; b + 1 < samples_j.size(); b++) {
+							int ci0 = samples_i[a], ci1 = samples_i[a + 1];
+							int cj0 = samples_j[b], cj1 = samples_j[b + 1];
+							float h00 = terrain->heights[ci0 * cols + cj0], h01 = terrain->heights[ci0 * cols + cj1];
+							float h10 = terrain->heights[ci1 * cols + cj0], h11 = terrain->heights[ci1 * cols + cj1];
+							for (int i = ci0; i <= ci1; i++) {
+								for (int j = cj0; j <= cj1; j++) {
+									float u = (float)(i - ci0) / (ci1 - ci0);
+									float v = (float)(j - cj0) / (cj1 - cj0);
+									float approx;
+									if (u + v <= 1.0f) {
+										approx = h00 + u * (h10 - h00) + v * (h01 - h00);
+									}
+									else {
+										approx = h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+									}
+									error = std::max(error, std::abs(terrain->heights[i * cols + j] - approx));
+								}
+							}
+						}
+					}
+					tile.error[l] = error;
+				}
+				max_error = std::max(max_error, tile.error[TERRAIN_LOD_LEVELS - 1]);
 			}
 		}
 
-		// now we're going to write all the vertices to buffers
-		//Vertex v;
-		for (int i = 0; i < img.height(); i++) {
-			for (int j = 0; j < img.width(); j++) {
-				v = vertices[i][j];
-				v.vertex_normal = glm::normalize(v.vertex_normal);
+		// Skirts hang below every tile edge deep enough to hide the cracks between
+		// neighbours drawn at different levels
+		const float skirt_depth = max_error + terrain->spacing;
 
-				for (int k = 0; k < 3; k++) {
-					vertex[(i*img.width() + j)*vertex_att + k] = v.vertex_position[k];
-					vertex[(i*img.width() + j)*vertex_att + k + 3] = v.vertex_normal[k];
-					vertex[(i*img.width() + j)*vertex_att + k + 6] = v.vertex_normal[k];
+		// Number of attributes for vertices
+		const int vertex_att = 11; // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
+
+		// One vertex per texel, plus a lowered copy of every texel on a tile border
+		std::vector<GLfloat> &vertex = asset.vertices;
+		std::vector<GLuint> skirt(rows * cols, 0);
+		vertex.reserve(rows * cols * vertex_att * 2);
+		for (int pass = 0; pass < 2; pass++) {
+			for (int i = 0; i < rows; i++) {
+				for (int j = 0; j < cols; j++) {
+					bool border = (i % TERRAIN_TILE_SIZE == 0) || (i == rows - 1) || (j % TERRAIN_TILE_SIZE == 0) || (j == cols - 1);
+					if (pass == 1) {
+						if (!border) {
+							continue;
+						}
+						skirt[i * cols + j] = vertex.size() / vertex_att;
+					}
+
+					glm::vec3 position(i * terrain->spacing, terrain->heights[i * cols + j] - pass * skirt_depth, j * terrain->spacing);
+					glm::vec3 normal = glm::normalize(normals[i * cols + j]);
+					glm::vec2 coord((float)i / rows, (float)j / cols);
+					for (int k = 0; k < 3; k++) {
+						vertex.push_back(position[k]);
+					}
+					for (int k = 0; k < 3; k++) {
+						vertex.push_back(normal[k]);
+					}
+					for (int k = 0; k < 3; k++) {
+						vertex.push_back(normal[k]);
+					}
+					vertex.push_back(coord[0]);
+					vertex.push_back(coord[1]);
 				}
-				vertex[(i*img.width() + j)*vertex_att + 9] = v.vertex_coord[0];
-				vertex[(i*img.width() + j)*vertex_att + 10] = v.vertex_coord[1];
 			}
 		}
 
-		GLuint vbo, ebo;
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
+		// Indices of every tile at every level, each level stored contiguously
+		std::vector<GLuint> &face = asset.indices;
+		for (int ti = 0; ti < tiles_i; ti++) {
+			for (int tj = 0; tj < tiles_j; tj++) {
+				TerrainTile &tile = terrain->tiles[ti * tiles_j + tj];
+				int i0 = ti * TERRAIN_TILE_SIZE, i1 = std::min(i0 + TERRAIN_TILE_SIZE, rows - 1);
+				int j0 = tj * TERRAIN_TILE_SIZE, j1 = std::min(j0 + TERRAIN_TILE_SIZE, cols - 1);
+				tile.min_corner.y -= skirt_depth;
+
+				for (int l = 0; l < TERRAIN_LOD_LEVELS; l++) {
+					terrain_samples(samples_i, i0, i1, 1 << l);
+					terrain_samples(samples_j, j0, j1, 1 << l);
+					tile.first[l] = face.size();
+
+					// Two triangles per quad, same layout as the full heightmap
+					for (unsigned int a = 0; a + 1 < samples_i.size(); a++) {
+						for (unsigned int b = 0; b + 1 < samples_j.size(); b++) {
+							GLuint v00 = samples_i[a] * cols + samples_j[b];
+							GLuint v01 = samples_i[a] * cols + samples_j[b + 1];
+							GLuint v10 = samples_i[a + 1] * cols + samples_j[b];
+							GLuint v11 = samples_i[a + 1] * cols + samples_j[b + 1];
+							face.push_back(v00); face.push_back(v01); face.push_back(v10);
+							face.push_back(v01); face.push_back(v11); face.push_back(v10);
+						}
+					}
 
-		glGenBuffers(1, &ebo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+					// Skirt quads along the four edges of the tile
+					std::vector<GLuint> edges[4];
+					for (unsigned int b = 0; b < samples_j.size(); b++) {
+						edges[0].push_back(i0 * cols + samples_j[b]);
+						edges[1].push_back(i1 * cols + samples_j[b]);
+					}
+					for (unsigned int a = 0; a < samples_i.size(); a++) {
+						edges[2].push_back(samples_i[a] * cols + j0);
+						edges[3].push_back(samples_i[a] * cols + j1);
+					}
+					for (int e = 0; e < 4; e++) {
+						for (unsigned int k = 0; k + 1 < edges[e].size(); k++) {
+							GLuint top0 = edges[e][k], top1 = edges[e][k + 1];
+							face.push_back(top0); face.push_back(top1); face.push_back(skirt[top0]);
+							face.push_back(top1); face.push_back(skirt[top1]); face.push_back(skirt[top0]);
+						}
+					}
 
-		// Free data buffers
-		delete[] vertex;
-		delete[] face;
+					tile.count[l] = face.size() - tile.first[l];
+				}
+			}
+		}
 
-		// Create resource
-		AddResource(Mesh, object_name, vbo, ebo, face_num * face_att, Hitbox());
+		asset.vertex_data = &asset.vertices[0];
+		asset.num_vertex_floats = asset.vertices.size();
+		asset.index_data = &asset.indices[0];
+		asset.num_indices = asset.indices.size();
+		asset.terrain = terrain;
 	}
 
 	void ResourceManager::CreateCylinder(std::string object_name, float cylinder_height, float circle_radius, int num_circle_samples) {
@@ -815,261 +1503,111 @@ namespace game {
 	}
 	
 	void ResourceManager::LoadMesh(const std::string name, const char *filename) {
+		DecodedAsset asset(Mesh, name);
+		DecodeMesh(filename, asset);
+		UploadMesh(asset);
+	}
 
-			// First load model into memory. If that goes well, we transfer the
-			// mesh to an OpenGL buffer
-			TriMesh mesh;
-
-			// Parse file
-			// Open file
-			std::ifstream f;
-			f.open(filename);
-			if (f.fail()) {
-				throw(std::ios_base::failure(std::string("Error opening file ") + std::string(filename)));
-			}
-
-			// Parse lines
-			std::string line;
-			std::string ignore(" \t\r\n");
-			std::string part_separator(" \t");
-			std::string face_separator("/");
-			bool added_normal = false;
-			while (std::getline(f, line)) {
-				// Clean extremities of the string
-				string_trim(line, ignore);
-				// Ignore comments
-				if ((line.size() <= 0) ||
-					(line[0] == '#')) {
-					continue;
-				}
-				// Parse string
-				std::vector<std::string> part = string_split(line, part_separator);
-				// Check commands
-				if (!part[0].compare(std::string("v"))) {
-					if (part.size() >= 4) {
-						glm::vec3 position(str_to_num<float>(part[1].c_str()), str_to_num<float>(part[2].c_str()), str_to_num<float>(part[3].c_str()));
-						mesh.position.push_back(position);
-					}
-					else {
-						throw(std::ios_base::failure(std::string("Error: v command should have exactly 3 parameters")));
-					}
-				}
-				else if (!part[0].compare(std::string("vn"))) {
-					if (part.size() >= 4) {
-						glm::vec3 normal(str_to_num<float>(part[1].c_str()), str_to_num<float>(part[2].c_str()), str_to_num<float>(part[3].c_str()));
-						mesh.normal.push_back(normal);
-						added_normal = true;
-					}
-					else {
-						throw(std::ios_base::failure(std::string("Error: vn command should have exactly 3 parameters")));
-					}
-				}
-				else if (!part[0].compare(std::string("vt"))) {
-					if (part.size() >= 3) {
-						glm::vec2 tex_coord(str_to_num<float>(part[1].c_str()), str_to_num<float>(part[2].c_str()));
-						mesh.tex_coord.push_back(tex_coord);
-					}
-					else {
-						throw(std::ios_base::failure(std::string("Error: vt command should have exactly 2 parameters")));
-					}
-				}
-				else if (!part[0].compare(std::string("f"))) {
-					if (part.size() >= 4) {
-						if (part.size() > 5) {
-							throw(std::ios_base::failure(std::string("Error: f commands with more than 4 vertices not supported")));
-						}
-						else if (part.size() == 5) {
-							// Break a quad into two triangles
-							Quad quad;
-							for (int i = 0; i < 4; i++) {
-								std::vector<std::string> fd = string_split_once(part[i + 1], face_separator);
-								if (fd.size() == 1) {
-									quad.i[i] = str_to_num<float>(fd[0].c_str()) - 1;
-									quad.t[i] = -1;
-									quad.n[i] = -1;
-								}
-								else if (fd.size() == 2) {
-									quad.i[i] = str_to_num<float>(fd[0].c_str()) - 1;
-									quad.t[i] = str_to_num<float>(fd[1].c_str()) - 1;
-									quad.n[i] = -1;
-								}
-								else if (fd.size() == 3) {
-									quad.i[i] = str_to_num<float>(fd[0].c_str()) - 1;
-									if (std::string("").compare(fd[1]) != 0) {
-										quad.t[i] = str_to_num<float>(fd[1].c_str()) - 1;
-									}
-									else {
-										quad.t[i] = -1;
-									}
-									quad.n[i] = str_to_num<float>(fd[2].c_str()) - 1;
-								}
-								else {
-									throw(std::ios_base::failure(std::string("Error: f parameter should have 1 or 3 parameters separated by '/'")));
-								}
-							}
-							Face face1, face2;
-							face1.i[0] = quad.i[0]; face1.i[1] = quad.i[1]; face1.i[2] = quad.i[2];
-							face1.n[0] = quad.n[0]; face1.n[1] = quad.n[1]; face1.n[2] = quad.n[2];
-							face1.t[0] = quad.t[0]; face1.t[1] = quad.t[1]; face1.t[2] = quad.t[2];
-							face2.i[0] = quad.i[0]; face2.i[1] = quad.i[2]; face2.i[2] = quad.i[3];
-							face2.n[0] = quad.n[0]; face2.n[1] = quad.n[2]; face2.n[2] = quad.n[3];
-							face2.t[0] = quad.t[0]; face2.t[1] = quad.t[2]; face2.t[2] = quad.t[3];
-							mesh.face.push_back(face1);
-							mesh.face.push_back(face2);
-						}
-						else if (part.size() == 4) {
-							Face face;
-							for (int i = 0; i < 3; i++) {
-								std::vector<std::string> fd = string_split_once(part[i + 1], face_separator);
-								if (fd.size() == 1) {
-									face.i[i] = str_to_num<float>(fd[0].c_str()) - 1;
-									face.t[i] = -1;
-									face.n[i] = -1;
-								}
-								else if (fd.size() == 2) {
-									face.i[i] = str_to_num<float>(fd[0].c_str()) - 1;
-									face.t[i] = str_to_num<float>(fd[1].c_str()) - 1;
-									face.n[i] = -1;
-								}
-								else if (fd.size() == 3) {
-									face.i[i] = str_to_num<float>(fd[0].c_str()) - 1;
-									if (std::string("").compare(fd[1]) != 0) {
-										face.t[i] = str_to_num<float>(fd[1].c_str()) - 1;
-									}
-									else {
-										face.t[i] = -1;
-									}
-									face.n[i] = str_to_num<float>(fd[2].c_str()) - 1;
-								}
-								else {
-									throw(std::ios_base::failure(std::string("Error: f parameter should have 1, 2, or 3 parameters separated by '/'")));
-								}
-							}
-							mesh.face.push_back(face);
-						}
-					}
-					else {
-						throw(std::ios_base::failure(std::string("Error: f command should have 3 or 4 parameters")));
-					}
-				}
-				// Ignore other commands
-			}
-
-			// Close file
-			f.close();
+	void ResourceManager::DecodeMesh(const char *filename, DecodedAsset &asset) {
+
+		// Use the binary version of the mesh when it was built from the same file,
+		// its arrays are mapped straight from disk into the buffers
+		asset.cache = new MeshCache();
+		if (asset.cache->Open(filename)) {
+			const MeshCacheHeader &header = asset.cache->GetHeader();
+			asset.vertex_data = asset.cache->GetVertices();
+			asset.num_vertex_floats = header.vertex_floats;
+			asset.index_data = asset.cache->GetIndices();
+			asset.num_indices = header.index_count;
+			return;
+		}
+		delete asset.cache;
+		asset.cache = NULL;
+
+		// First load model into memory. If that goes well, we transfer the
+		// mesh to an OpenGL buffer
+		TriMesh mesh;
+
+		// Parse the whole file at once
+		std::vector<char> text;
+		read_file(filename, text);
+		bool added_normal = text.empty() ? false : parse_obj(&text[0], &text[0] + text.size(), mesh);
+
+		// Three vertices per face, in case vertex normals/texture coordinates are not
+		// consistent over the mesh, then merge the ones that are identical
+		std::vector<GLfloat> expanded;
+		expand_obj_mesh(mesh, added_normal, expanded);
+		optimize_mesh(expanded, asset.vertices, asset.indices);
+
+		// Binary version for the next start
+		MeshCache::Write(filename, text, asset.vertices, asset.indices);
+
+		asset.vertex_data = asset.vertices.empty() ? NULL : &asset.vertices[0];
+		asset.num_vertex_floats = asset.vertices.size();
+		asset.index_data = asset.indices.empty() ? NULL : &asset.indices[0];
+		asset.num_indices = asset.indices.size();
+	}
 
-			// Check if vertex references are correct
-			for (unsigned int i = 0; i < mesh.face.size(); i++) {
-				for (int j = 0; j < 3; j++) {
-					if (mesh.face[i].i[j] >= mesh.position.size()) {
-						throw(std::ios_base::failure(std::string("Error: index for triangle ") + num_to_str<int>(mesh.face[i].i[j]) + std::string(" is out of bounds")));
-					}
-				}
-			}
+	void ResourceManager::UploadMesh(DecodedAsset &asset) {
+		// Create OpenGL buffers and copy data
+		GLuint vbo, ebo;
+		UploadMeshBuffers(asset.vertex_data, asset.num_vertex_floats, asset.index_data, asset.num_indices, vbo, ebo);
 
-			// Compute degree of each vertex
-			std::vector<int> degree(mesh.position.size(), 0);
-			for (unsigned int i = 0; i < mesh.face.size(); i++) {
-				for (int j = 0; j < 3; j++) {
-					degree[mesh.face[i].i[j]]++;
-				}
+		// Create resource
+		if (asset.terrain) {
+			AddResource(Mesh, asset.name, vbo, ebo, asset.num_indices, asset.terrain);
+			asset.terrain = NULL;
+		}
+		else {
+			AddResource(Mesh, asset.name, vbo, ebo, asset.num_indices);
+			if (asset.cache) {
+				mesh_cache_hits_++;
 			}
-
-			// Compute vertex normals if no normals were ever added
-			if (!added_normal) {
-				mesh.normal = std::vector<glm::vec3>(mesh.position.size(), glm::vec3(0.0, 0.0, 0.0));
-				for (unsigned int i = 0; i < mesh.face.size(); i++) {
-					// Compute face normal
-					glm::vec3 vec1, vec2;
-					vec1 = mesh.position[mesh.face[i].i[0]] -
-						mesh.position[mesh.face[i].i[1]];
-					vec2 = mesh.position[mesh.face[i].i[0]] -
-						mesh.position[mesh.face[i].i[2]];
-					glm::vec3 norm = glm::cross(vec1, vec2);
-					norm = glm::normalize(norm);
-					// Add face normal to vertices
-					mesh.normal[mesh.face[i].i[0]] += norm;
-					mesh.normal[mesh.face[i].i[1]] += norm;
-					mesh.normal[mesh.face[i].i[2]] += norm;
-				}
-				for (unsigned int i = 0; i < mesh.normal.size(); i++) {
-					if (degree[i] > 0) {
-						mesh.normal[i] /= degree[i];
-					}
-				}
+			else {
+				mesh_cache_misses_++;
 			}
+		}
+		asset.Release();
+	}
 
-			// Debug
-			//print_mesh(mesh);
-
-			// If we got to this point, the file was parsed successfully and the
-			// mesh is in memory
-			// Now, transfer the mesh to OpenGL buffers
-			// Create three new vertices for each face, in case vertex
-			// normals/texture coordinates are not consistent over the mesh
-
-			// Number of attributes for vertices and faces
-			const int vertex_att = 11;
-			const int face_att = 3;
-
-			// Create OpenGL buffers and copy data
-			GLuint vbo, ebo;
-
-			glGenBuffers(1, &vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, vbo);
-			glBufferData(GL_ARRAY_BUFFER, mesh.face.size() * 3 * vertex_att * sizeof(GLuint), 0, GL_STATIC_DRAW);
-
-			glGenBuffers(1, &ebo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.face.size() * face_att * sizeof(GLuint), 0, GL_STATIC_DRAW);
+	void ResourceManager::UploadMeshBuffers(const GLfloat *vertices, size_t num_vertex_floats, const GLuint *indices, size_t num_indices, GLuint &vbo, GLuint &ebo) {
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ebo);
 
-			unsigned int vertex_index = 0;
-			for (unsigned int i = 0; i < mesh.face.size(); i++) {
-				// Add three vertices and their attributes
-				GLfloat att[3 * vertex_att] = { 0 };
-				for (int j = 0; j < 3; j++) {
-					// Position
-					att[j*vertex_att + 0] = mesh.position[mesh.face[i].i[j]][0];
-					att[j*vertex_att + 1] = mesh.position[mesh.face[i].i[j]][1];
-					att[j*vertex_att + 2] = mesh.position[mesh.face[i].i[j]][2];
-					// Normal
-					if (!added_normal) {
-						att[j*vertex_att + 3] = mesh.normal[mesh.face[i].i[j]][0];
-						att[j*vertex_att + 4] = mesh.normal[mesh.face[i].i[j]][1];
-						att[j*vertex_att + 5] = mesh.normal[mesh.face[i].i[j]][2];
-					}
-					else {
-						if (mesh.face[i].n[j] >= 0) {
-							att[j*vertex_att + 3] = mesh.normal[mesh.face[i].n[j]][0];
-							att[j*vertex_att + 4] = mesh.normal[mesh.face[i].n[j]][1];
-							att[j*vertex_att + 5] = mesh.normal[mesh.face[i].n[j]][2];
-						}
-					}
-					// No color in (6, 7, 8)
-					// Texture coordinates
-					if (mesh.face[i].t[j] >= 0) {
-						att[j*vertex_att + 9] = mesh.tex_coord[mesh.face[i].t[j]][0];
-						att[j*vertex_att + 10] = mesh.tex_coord[mesh.face[i].t[j]][1];
-					}
-				}
+		// Inside a batch the arrays go through the shared staging buffer
+		if (upload_batch_) {
+			mesh_staging_.Upload(vbo, vertices, num_vertex_floats * sizeof(GLfloat));
+			mesh_staging_.Upload(ebo, indices, num_indices * sizeof(GLuint));
+			return;
+		}
 
-				// Copy attributes to buffer
-				glBufferSubData(GL_ARRAY_BUFFER, i * 3 * vertex_att * sizeof(GLfloat), 3 * vertex_att * sizeof(GLfloat), att);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, num_vertex_floats * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+		GpuCounters::CountBufferUpload();
+		GpuCounters::CountBufferUpload();
+	}
 
-				// Add triangle
-				GLuint findex[face_att] = { 0 };
-				findex[0] = vertex_index;
-				findex[1] = vertex_index + 1;
-				findex[2] = vertex_index + 2;
-				vertex_index += 3;
+	void ResourceManager::BeginUploadBatch(void) {
+		upload_batch_ = true;
+	}
 
-				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, i * face_att * sizeof(GLuint), face_att * sizeof(GLuint), findex);
-			}
+	void ResourceManager::EndUploadBatch(void) {
+		double start = glfwGetTime();
+		mesh_staging_.Flush();
+		upload_batch_ = false;
+		AssetLoadTime time = { "(staged buffer copies)", (glfwGetTime() - start) * 1000.0 };
+		load_times_.push_back(time);
+	}
 
-			// Create resource
-			AddResource(Mesh, name, vbo, ebo, mesh.face.size() * face_att);
-		}
+	const std::vector<ProgramLoadTime> &ResourceManager::GetProgramTimes(void) const {
+		return program_times_;
+	}
 
+	const std::vector<AssetLoadTime> &ResourceManager::GetLoadTimes(void) const {
+		return load_times_;
+	}
 
 	void ResourceManager::CreateSphereParticles(std::string object_name, int num_particles) {
 
@@ -1214,19 +1752,18 @@ namespace game {
 		AddResource(PointSet, object_name, vbo, 0, num_particles);
 	}
 	
-	void string_trim(std::string str, std::string to_trim) {
-
-			// Trim any character in to_trim from the beginning of the string str
-			while ((str.size() > 0) &&
-				(to_trim.find(str[0]) != std::string::npos)) {
-				str.erase(0);
-			}
+	void string_trim(std::string &str, const std::string &to_trim) {
 
 			// Trim any character in to_trim from the end of the string str
-			while ((str.size() > 0) &&
-				(to_trim.find(str[str.size() - 1]) != std::string::npos)) {
-				str.erase(str.size() - 1);
+			size_t last = str.find_last_not_of(to_trim);
+			if (last == std::string::npos) {
+				str.clear();
+				return;
 			}
+			str.erase(last + 1);
+
+			// Trim any character in to_trim from the beginning of the string str
+			str.erase(0, str.find_first_not_of(to_trim));
 	}
 
 
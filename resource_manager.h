@@ -1,6 +1,9 @@
 #ifndef RESOURCE_MANAGER_H_
 #define RESOURCE_MANAGER_H_
+#include <ostream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -8,13 +11,88 @@
 #include "resource.h"
 #include "CImg-2.1.6_pre110917\CImg.h"
 #include "model_loader.h"
+#include "terrain.h"
+#include "staging_buffer.h"
+#include "mesh_cache.h"
 
 // Default extensions for different shader source files
 #define VERTEX_PROGRAM_EXTENSION "_vp.glsl"
 #define FRAGMENT_PROGRAM_EXTENSION "_fp.glsl"
 #define GEOMETRY_PROGRAM_EXTENSION "_gp.glsl"
 
+// Largest side of the layers of a texture array, larger images are scaled down to it
+#define TEXTURE_ARRAY_LAYER_SIZE 1024
+
 namespace game {
+	// Time spent loading one resource
+	struct AssetLoadTime {
+		std::string name;
+		double milliseconds;
+	};
+
+	// Time spent creating one program, from its cached binary or by compiling it
+	struct ProgramLoadTime {
+		std::string name;
+		bool cached;
+		double milliseconds;
+	};
+
+	// Stable reference to a resource of the manager, resolve the name once and keep the
+	// handle. Handles of names that weren't loaded, or of another type, are invalid, and
+	// handles of unloaded resources resolve to NULL even once their position is reused
+	template <ResourceType kind>
+	struct ResourceHandle {
+		int index; // Position in the manager, -1 if invalid
+		unsigned int generation; // Resources the position held before this one
+
+		ResourceHandle(void) : index(-1), generation(0) {}
+		ResourceHandle(int i, unsigned int g) : index(i), generation(g) {}
+		bool IsValid(void) const { return index >= 0; }
+	};
+	typedef ResourceHandle<Mesh> MeshHandle; // Meshes and point sets
+	typedef ResourceHandle<Material> MaterialHandle;
+	typedef ResourceHandle<Texture> TextureHandle;
+	typedef ResourceHandle<TextureArray> TextureArrayHandle;
+
+	// A resource read and decoded into memory, waiting to be turned into GL objects.
+	// Decoding only reads files and fills this, so it may run on any thread
+	struct DecodedAsset {
+		DecodedAsset(ResourceType type, const std::string name);
+		~DecodedAsset();
+		// Free the decoded data once it was uploaded
+		void Release(void);
+
+		ResourceType type;
+		std::string name;
+		// Material: shader sources, the geometry program is empty if there is none
+		std::string vertex_program;
+		std::string fragment_program;
+		std::string geometry_program;
+		// Binary of the program from an earlier start (empty if there is none), and its key
+		std::string program_prefix;
+		unsigned long long source_hash;
+		std::vector<char> program_binary;
+		// Texture: rows bottom first, as GL expects them
+		unsigned char *pixels;
+		int width, height, channels;
+		// Texture array: layers of width x height RGBA texels one after the other, and the name of each
+		std::vector<unsigned char> layer_pixels;
+		std::vector<std::string> layer_names;
+		// Mesh: arrays point either into vertices/indices or into the mapped binary mesh
+		MeshCache *cache;
+		std::vector<GLfloat> vertices;
+		std::vector<GLuint> indices;
+		const GLfloat *vertex_data;
+		size_t num_vertex_floats;
+		const GLuint *index_data;
+		size_t num_indices;
+		TerrainData *terrain; // Only for terrain meshes, owned by the resource after the upload
+
+	private:
+		DecodedAsset(const DecodedAsset &);
+		DecodedAsset &operator=(const DecodedAsset &);
+	};
+
 	// Class that manages all resources
 	class ResourceManager {
 	public:
@@ -24,32 +102,139 @@ namespace game {
 		// Add a resource that was already loaded and allocated to memory
 		void AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size);
 		void AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size, Hitbox _hb = Hitbox());
+		void AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size, TerrainData *terrain);
+		// Add a texture created elsewhere, drawn with the shared sampler. Textures that are not
+		// owned, e.g. streamed ones, are left to their creator when they are unloaded
+		void AddTexture(const std::string name, GLuint texture, size_t gpu_bytes, bool owned = true);
 		// Load a resource from a file, according to the specified type
 		void LoadResource(ResourceType type, const std::string name, const char *filename);
+		// The two halves of LoadResource: DecodeResource reads and decodes the file on any thread
+		// (it touches no GL or manager state), UploadResource creates the resource on the GL thread
+		static void DecodeResource(const char *filename, DecodedAsset &asset);
+		void UploadResource(DecodedAsset &asset);
+		// CPU half of CreateGround, upload the result with UploadResource
+		static void DecodeGround(DecodedAsset &asset);
+		// Load a vertex-only program whose outputs are captured, interleaved, with transform feedback
+		void LoadTransformFeedbackMaterial(const std::string name, const char *prefix, const char **varyings, int num_varyings);
 		// Get the resource with the specified name
 		Resource *GetResource(const std::string name) const;
+		// Resolve a name into a handle, once after loading
+		MeshHandle GetMeshHandle(const std::string name) const;
+		MaterialHandle GetMaterialHandle(const std::string name) const;
+		TextureHandle GetTextureHandle(const std::string name) const;
+		TextureArrayHandle GetTextureArrayHandle(const std::string name) const;
+		// Get the resource of a handle, NULL if it is invalid
+		Resource *GetResource(MeshHandle handle) const;
+		Resource *GetResource(MaterialHandle handle) const;
+		Resource *GetResource(TextureHandle handle) const;
+		Resource *GetResource(TextureArrayHandle handle) const;
+		// Layer of a texture array holding the image listed as layer, -1 if no array has it
+		int GetTextureLayer(const std::string layer) const;
+
+		// Whether a resource has the specified name, unlike GetResource never flagged in the frame loop
+		bool IsLoaded(const std::string name) const;
+		// Take a reference to the resource with the specified name, NULL if there is none
+		Resource *Acquire(const std::string name);
+		// Unload a resource: its name is free right away, its GL objects are deleted by
+		// Collect once no scene node or resource set holds it
+		void Unload(const std::string name);
+		void Unload(const Resource *res);
+		// Free the unloaded resources nothing holds anymore, cheap when there are none
+		void Collect(void);
+		// Delete every resource, held or not. Call while the GL context still exists
+		void Clear(void);
+
+		// Estimated memory of the loaded resources, the GPU part doesn't include programs
+		size_t GetGpuBytes(void) const;
+		size_t GetCpuBytes(void) const;
+		// Number and memory of the resources of each type, and the ones waiting to be freed
+		void PrintMemory(std::ostream &out) const;
+
+		// While the frame loop runs, every lookup by name is counted and the first one of each name is reported
+		void SetFrameLoop(bool frame_loop);
+		int GetFrameLookups(void) const;
+
+		// Meshes loaded between these calls share one staging buffer and reach the GPU
+		// together at EndUploadBatch, draw them only after it
+		void BeginUploadBatch(void);
+		void EndUploadBatch(void);
+		// Every resource loaded from a file so far, in load order
+		const std::vector<AssetLoadTime> &GetLoadTimes(void) const;
+		// Every program created so far, and whether it came from the program cache
+		const std::vector<ProgramLoadTime> &GetProgramTimes(void) const;
 
 		// Methods to create specific resources
 		void CreateTorus(std::string object_name, float loop_radius = 0.6, float circle_radius = 0.2, int num_loop_samples = 90, int num_circle_samples = 30);
 		void CreateSphere(std::string object_name, float radius = 0.6, int num_samples_theta = 90, int num_samples_phi = 45);
 		void CreateCube(std::string object_name);
-		void CreateGround(std::string object_name); //terrain mesh
+		void CreateGround(std::string object_name); //tiled terrain mesh, draw it with a Terrain node
 		void CreateCylinder(std::string object_name, float cylinder_height = 1, float circle_radius = 1, int num_circle_samples = 90);
 		void CreateSphereParticles(std::string object_name, int num_particles = 20000);
 		void CreateLineParticles(std::string object_name, int num_particles = 20000, float loop_radius = 0.6, float circle_radius = 0.2);
 
 		Hitbox genHitbox(std::vector<glm::vec3> points);
 
+		// Sampler shared by all loaded textures, bind it to unit 0 before drawing the scene
+		GLuint GetTextureSampler(void) const;
+
+		// Meshes loaded from their binary version, and meshes parsed from the OBJ file
+		int GetMeshCacheHits(void) const;
+		int GetMeshCacheMisses(void) const;
+
 	private:
-		// List storing all resources
+		// List storing all resources, NULL where one was freed
 		std::vector<Resource*> resource_;
+		// Times each position was freed, part of the handles to it
+		std::vector<unsigned int> generation_;
+		std::vector<int> free_slots_;
+		// Unloaded resources still held by something
+		std::vector<int> unloading_;
+		// Position of every resource in the list, by name
+		std::unordered_map<std::string, int> index_;
+		bool frame_loop_;
+		mutable int frame_lookups_;
+		mutable std::unordered_set<std::string> flagged_lookups_;
+
+		// Add a resource to the list and the index, returns its position
+		int Insert(Resource *res);
+		// Position of the resource with the specified name, -1 if there is none
+		int Find(const std::string &name) const;
+		// Resource of a handle, NULL if it is invalid or the resource was freed
+		Resource *Resolve(int index, unsigned int generation) const;
+		// Delete the resource at a position and make the position reusable
+		void Free(int index);
+		// Trilinear sampler created with the first texture
+		GLuint texture_sampler_;
+		int mesh_cache_hits_;
+		int mesh_cache_misses_;
+		// Position of the texture array and layer of every image, by the name listed with it
+		std::unordered_map<std::string, std::pair<int, int> > texture_layers_;
+		// Staging buffer for meshes loaded inside a batch
+		StagingBuffer mesh_staging_;
+		bool upload_batch_;
+		std::vector<AssetLoadTime> load_times_;
+		std::vector<ProgramLoadTime> program_times_;
 
 		// Load shaders programs
 		void LoadMaterial(const std::string name, const char *prefix);
 		// Load a text file into memory (could be source code)
-		std::string LoadTextFile(const char *filename);
+		static std::string LoadTextFile(const char *filename);
 		void LoadTexture(const std::string name, const char *filename);
 		void LoadMesh(const std::string name, const char *filename);
+
+		// Decode and upload halves of each loader
+		static void DecodeMaterial(const char *prefix, DecodedAsset &asset);
+		void UploadMaterial(DecodedAsset &asset);
+		// Compile and link the sources of a material, the slow path of UploadMaterial
+		static GLuint CompileMaterial(const DecodedAsset &asset);
+		static void DecodeTexture(const char *filename, DecodedAsset &asset);
+		void UploadTexture(DecodedAsset &asset);
+		static void DecodeTextureArray(const char *filename, DecodedAsset &asset);
+		void UploadTextureArray(DecodedAsset &asset);
+		static void DecodeMesh(const char *filename, DecodedAsset &asset);
+		void UploadMesh(DecodedAsset &asset);
+		// Create and fill the buffers of a mesh, through the staging buffer inside a batch
+		void UploadMeshBuffers(const GLfloat *vertices, size_t num_vertex_floats, const GLuint *indices, size_t num_indices, GLuint &vbo, GLuint &ebo);
 	}; // class ResourceManager
 } // namespace game
 #endif // RESOURCE_MANAGER_H_
@@ -0,0 +1,78 @@
+#include <stdexcept>
+#include "resource_set.h"
+
+namespace game {
+	ResourceSet::ResourceSet(ResourceManager *resman) {
+		resman_ = resman;
+	}
+
+	void ResourceSet::Add(ResourceType type, const std::string name, const std::string filename) {
+		Entry entry = { type, name, filename, false };
+		entries_.push_back(entry);
+	}
+
+	void ResourceSet::AddGround(const std::string name) {
+		Entry entry = { Mesh, name, "", true };
+		entries_.push_back(entry);
+	}
+
+	void ResourceSet::Queue(AssetLoader &loader) const {
+		for (unsigned int i = 0; i < entries_.size(); i++) {
+			const Entry &entry = entries_[i];
+			if (resman_->IsLoaded(entry.name)) {
+				continue;
+			}
+			if (entry.ground) {
+				loader.QueueGround(entry.name);
+			}
+			else {
+				loader.Queue(entry.type, entry.name, entry.filename);
+			}
+		}
+	}
+
+	void ResourceSet::Acquire(void) {
+		// Drop the references taken before without unloading anything
+		for (unsigned int i = 0; i < held_.size(); i++) {
+			held_[i]->Release();
+		}
+		held_.clear();
+
+		for (unsigned int i = 0; i < entries_.size(); i++) {
+			Resource *res = resman_->Acquire(entries_[i].name);
+			if (!res) {
+				throw(std::invalid_argument(std::string("Resource set is missing \"") + entries_[i].name + std::string("\"")));
+			}
+			held_.push_back(res);
+		}
+	}
+
+	void ResourceSet::Load(void) {
+		AssetLoader loader(resman_);
+		Queue(loader);
+		resman_->BeginUploadBatch();
+		loader.Run();
+		resman_->EndUploadBatch();
+		Acquire();
+	}
+
+	void ResourceSet::Release(void) {
+		for (unsigned int i = 0; i < held_.size(); i++) {
+			held_[i]->Release();
+			resman_->Unload(held_[i]);
+		}
+		held_.clear();
+	}
+
+	bool ResourceSet::IsLoaded(void) const {
+		return !held_.empty();
+	}
+
+	size_t ResourceSet::GetGpuBytes(void) const {
+		size_t bytes = 0;
+		for (unsigned int i = 0; i < held_.size(); i++) {
+			bytes += held_[i]->GetGpuBytes();
+		}
+		return bytes;
+	}
+} // namespace game
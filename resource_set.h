@@ -0,0 +1,52 @@
+#ifndef RESOURCE_SET_H_
+#define RESOURCE_SET_H_
+#include <string>
+#include <vector>
+#include "resource_manager.h"
+#include "asset_loader.h"
+
+namespace game {
+	// Resources loaded and released as a unit, e.g. the assets of one level. The set holds
+	// a reference to each of them while it is loaded, so releasing it frees every resource
+	// of the set that no scene node still uses
+	class ResourceSet {
+	public:
+		// Resources still held when the set is destroyed are left to the manager's Clear
+		ResourceSet(ResourceManager *resman);
+
+		// Add a resource loaded from filename, like ResourceManager::LoadResource
+		void Add(ResourceType type, const std::string name, const std::string filename);
+		// Add the terrain mesh, like ResourceManager::CreateGround
+		void AddGround(const std::string name);
+
+		// Queue the resources that aren't loaded yet, then call Acquire once the loader ran.
+		// This lets the set load in the same batch as other resources
+		void Queue(AssetLoader &loader) const;
+		// Take a reference to every resource of the set, throws if one is missing
+		void Acquire(void);
+		// Load the set on its own: queue, run a loader and acquire
+		void Load(void);
+		// Drop the references and unload the resources
+		void Release(void);
+
+		bool IsLoaded(void) const;
+		// Estimated GPU memory of the resources of the set
+		size_t GetGpuBytes(void) const;
+
+	private:
+		struct Entry {
+			ResourceType type;
+			std::string name;
+			std::string filename;
+			bool ground;
+		};
+
+		ResourceManager *resman_;
+		std::vector<Entry> entries_;
+		std::vector<Resource *> held_;
+
+		ResourceSet(const ResourceSet &);
+		ResourceSet &operator=(const ResourceSet &);
+	}; // class ResourceSet
+} // namespace game
+#endif // RESOURCE_SET_H_
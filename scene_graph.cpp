@@ -8,13 +8,31 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "scene_graph.h"
+#include "gpu_counters.h"
 
 namespace game {
 	SceneGraph::SceneGraph(void) {
 		background_color_ = glm::vec3(0.0, 0.0, 0.0);
+		particles_ = NULL;
+		projectiles_ = NULL;
+		gpu_profiler_ = NULL;
+		frame_width_ = 0;
+		frame_height_ = 0;
+		render_scale_ = 1.0;
+		overlay_budget_ = 0.0;
+		batch_steering_ = true;
 	}
 
-	SceneGraph::~SceneGraph() {}
+	SceneGraph::~SceneGraph() {
+		Clear();
+	}
+
+	void SceneGraph::Clear(void) {
+		delete particles_;
+		particles_ = NULL;
+		delete projectiles_;
+		projectiles_ = NULL;
+	}
 
 	void SceneGraph::SetBackgroundColor(glm::vec3 color) {
 		background_color_ = color;
@@ -53,6 +71,9 @@ namespace game {
 			background_color_[2], 0.0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		// Textures on unit 0 are filtered through the shared sampler
+		glBindSampler(0, rm_->GetTextureSampler());
+
 		// Draw all scene nodes
 		// Initialize stack of nodes
 		std::stack<SceneNode *> stck;
@@ -73,9 +94,10 @@ namespace game {
 			// Draw node based on parent transformation
 			glm::mat4 current_transf = current->Draw(camera, parent_transf, true);
 
-			// if the current node has collision, update it's collidables
-			if (current->isCollidable())
-				current->updateCollidable(current_transf);
+			// projectiles move in the frame of the root
+			if (current == root_ && projectiles_) {
+				projectiles_->SetFrame(current_transf);
+			}
 
 			// Push children of the node to the stack
 			for (std::vector<SceneNode *>::const_iterator it = current->children_begin();
@@ -84,12 +106,49 @@ namespace game {
 				transf.push(current_transf);
 			}
 		}
+
+		// All projectiles of a type in one call
+		if (projectiles_) {
+			projectiles_->Draw(camera);
+		}
+
+		// Draw every explosion and tracer at once, after the geometry they blend over
+		if (particles_) {
+			if (gpu_profiler_) {
+				gpu_profiler_->Begin(ParticlePass);
+			}
+			particles_->Draw(camera);
+			if (gpu_profiler_) {
+				gpu_profiler_->End(ParticlePass);
+			}
+		}
 	}
 
 	void SceneGraph::Update(double deltaTime) {
-		// Traverse hierarchy to update all nodes
+		// Sleeping entities are skipped, those settling now are drawn where they stop
+		activation_.Update(root_, deltaTime);
+		const std::vector<SceneNode *> &settling = activation_.GetSettling();
+		for (unsigned int i = 0; i < settling.size(); i++) {
+			std::stack<SceneNode *> stck;
+			stck.push(settling[i]);
+			while (stck.size() > 0) {
+				SceneNode *current = stck.top();
+				stck.pop();
+				current->StoreTransform();
+				for (SceneNode *c : current->children_) {
+					stck.push(c);
+				}
+			}
+		}
+
+		// Traverse hierarchy to update the root and the awake entities
+		root_->StoreTransform();
+		root_->Update(deltaTime);
+		const std::vector<SceneNode *> &awake = activation_.GetAwake();
 		std::stack<SceneNode *> stck;
-		stck.push(root_);
+		for (std::vector<SceneNode *>::const_reverse_iterator it = awake.rbegin(); it != awake.rend(); it++) {
+			stck.push(*it);
+		}
 		while (stck.size() > 0) {
 			SceneNode *current = stck.top();
 			stck.pop();
@@ -99,10 +158,21 @@ namespace game {
 				continue;
 			}
 
-			current->Update(deltaTime);
+			// Drawn between where the node was before this step and where it ends up
+			current->StoreTransform();
+
+			Enemy* e = dynamic_cast<Enemy*>(current);
+			if (e && batch_steering_ && e->getSteeringType() != NoSteering) {
+				// steered with every other enemy of its type once the whole scene is updated
+				e->UpdateAttack(deltaTime);
+				steering_.Add(e);
+			}
+			else {
+				current->Update(deltaTime);
+			}
 
 			// if we're updating an enemy, we wanna see if they can attack
-			if (Enemy* e = dynamic_cast<Enemy*>(current)) {
+			if (e) {
 
 				// if they are attacking, 
 				if (e->isAttacking())
@@ -116,6 +186,68 @@ namespace game {
 				stck.push(*it);
 			}
 		}
+
+		steering_.Run(deltaTime);
+
+		// collision boxes follow the simulation rather than the frames drawn
+		UpdateCollidables();
+
+		// every enemy is where it ends the step, shoot the hitscans queued on the way
+		ResolveHitscans();
+
+		if (projectiles_) {
+			projectiles_->Update(deltaTime);
+		}
+
+		if (particles_) {
+			particles_->Update(deltaTime);
+		}
+	}
+
+	void SceneGraph::UpdateCollidables(void) {
+		glm::mat4 root_transf = root_->GetTransform(glm::mat4(1.0));
+		if (root_->isCollidable()) {
+			root_->updateCollidable(root_transf);
+		}
+		if (projectiles_) {
+			projectiles_->SetFrame(root_transf);
+		}
+
+		// Sleeping entities keep their boxes, the ones settling get them once more
+		const std::vector<SceneNode *> *lists[] = { &activation_.GetAwake(), &activation_.GetSettling() };
+		for (int l = 0; l < 2; l++) {
+			for (unsigned int i = 0; i < lists[l]->size(); i++) {
+				std::stack<SceneNode *> stck;
+				std::stack<glm::mat4> transf;
+				stck.push((*lists[l])[i]);
+				transf.push(root_transf);
+				while (stck.size() > 0) {
+					SceneNode *current = stck.top();
+					stck.pop();
+					glm::mat4 current_transf = current->GetTransform(transf.top());
+					transf.pop();
+					if (current->isCollidable()) {
+						current->updateCollidable(current_transf);
+					}
+					for (SceneNode *c : current->children_) {
+						stck.push(c);
+						transf.push(current_transf);
+					}
+				}
+			}
+		}
+	}
+
+	void SceneGraph::SetBatchSteering(bool batch) {
+		batch_steering_ = batch;
+	}
+
+	void SceneGraph::SetActivationTarget(SceneNode *target) {
+		activation_.SetTarget(target);
+	}
+
+	EnemyActivation &SceneGraph::GetActivation(void) {
+		return activation_;
 	}
 
 	SceneNode* SceneGraph::FindName(std::string node_name) const { //just some cheese used for laser testing
@@ -144,6 +276,20 @@ namespace game {
 				std::vector<SceneNode*>::iterator position = std::find(n->parent_->children_.begin(), n->parent_->children_.end(), n);
 				if (position != n->parent_->children_.end()) {
 					n->parent_->children_.erase(position);
+					n->parent_ = NULL; // Out of the scene, whoever made it can delete it
+					activation_.Invalidate();
+
+					// The subtree is never drawn again, its resources can be unloaded
+					std::stack<SceneNode *> stck;
+					stck.push(n);
+					while (stck.size() > 0) {
+						SceneNode *current = stck.top();
+						stck.pop();
+						current->ReleaseResources();
+						for (SceneNode *c : current->children_) {
+							stck.push(c);
+						}
+					}
 					return;
 				}
 				else {
@@ -161,52 +307,87 @@ namespace game {
 
 	// If an enemy has raised the attack flag, we handle the attack here
 	void SceneGraph::EnemyAttacking(Enemy* e) {
+		// projectiles fly in the projectile system, they can't hit the entity that fired them
+		ProjectileShot shot;
+		if (e->getProjectile(shot)) {
+			if (projectiles_) {
+				projectiles_->Spawn(shot, e->GetEntity()->GetId());
+			}
+			return;
+		}
+
 		// grab their attack 
 		AttackNode* a = e->getAttack();
 
-		// if it's a hitscan attack, run the collision right now
+		// hitscans are queued and resolved together after the update
 		if (Hitscan* hs = dynamic_cast<Hitscan*>(a)) {
-			// we get a list of <Node, Intersection Point> pairs back from CheckRayCollision
-			std::vector <std::pair<SceneNode*, glm::vec2*>> list = CheckRayCollisions(hs->getRay());
+			HitscanRequest request = { hs->getRay(), hs->getDamage(), e->GetEntity()->GetId() };
+			hitscans_.push_back(request);
+		}
+		delete a;
+	}
+
+	void SceneGraph::ResolveHitscans(void) {
+		if (hitscans_.empty()) {
+			return;
+		}
+
+		// every collidable part of every entity, boxed into the grid
+		ray_targets_.clear();
+		ray_grid_.Clear();
+		for (std::vector<SceneNode *>::const_iterator entity = root_->children_begin();
+			entity != root_->children_end(); entity++) {
+			std::stack<SceneNode *> stck;
+			stck.push(*entity);
+			while (stck.size() > 0) {
+				SceneNode *current = stck.top();
+				stck.pop();
+				if (current->isCollidable()) {
+					glm::vec3 half = current->aabb.getScale() * 0.5f;
+					ray_grid_.Insert(current->aabb.getPos() - half, current->aabb.getPos() + half, (int)ray_targets_.size());
+					ray_targets_.push_back(std::make_pair(current, *entity));
+				}
+				for (SceneNode *c : current->children_) {
+					stck.push(c);
+				}
+			}
+		}
+		ray_grid_.Build();
+
+		tracers_.clear();
+		for (unsigned int h = 0; h < hitscans_.size(); h++) {
+			HitscanRequest &request = hitscans_[h];
 
-			// cycle through the pairs and find the closest (non-current) node
+			// the closest part in front of the shot, of any entity but the shooter
+			ray_grid_.QueryRay(request.ray, ray_candidates_);
 			float min = INFINITY;
 			SceneNode* closest = NULL;
-			for (std::pair<SceneNode*, glm::vec2*> n : list) {
-				// don't shoot ourselves
-				if (e->GetName().find(n.first->GetName()) != std::string::npos) continue;
-
-				// if this node is closer than the previous closest
-				if (n.second->x < min && n.second->x > 0) {
-					min = n.second->x;
-					closest = n.first;
+			for (unsigned int c = 0; c < ray_candidates_.size(); c++) {
+				std::pair<SceneNode *, SceneNode *> &target = ray_targets_[ray_candidates_[c]];
+				if (target.second->GetId() == request.owner) continue;
+
+				glm::vec2 PoI;
+				if (CollisionManager::isColliding(target.first, request.ray, PoI) && PoI.x < min && PoI.x > 0) {
+					min = PoI.x;
+					closest = target.second;
 				}
 			}
 
-			// now deal damage to the closest node, if there is one
+			// now deal damage to the closest entity, if there is one
 			if (closest != NULL) {
-				closest->takeDamage(a->getDamage());
+				closest->takeDamage(request.damage);
 				std::cout << closest->GetName() << ": " << closest->GetHealth() << "HP" << std::endl;
 			}
-			
-			Resource *geom = rm_->GetResource("LineParticles");
-			Resource *mat = rm_->GetResource("LineMaterial");
-			Resource *tex = rm_->GetResource("Firework");
-			
-			float ttlr = 3.0 + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (4.5 - 3.0)));
-			float r = 0.9;//static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-			float g = 0.1; //static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-			float b = 0.1;// static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 
-			SceneNode* line = new Bomb("ParticleInstance" + std::to_string(exploCount++), geom, mat, 0.5, glm::vec3(r,g,b), tex); //help
-			root_->AddChild(line);
-			line->SetScale(glm::vec3(0.02, 0.02, 4000.0)); //1000 is ~far away~
-			line->SetPosition(e->GetAbsolutePosition());
-			line->SetOrientation(e->GetOrientation());
+			// red tracer along the shot, up to whatever it hit
+			ParticleTracer tracer = { request.ray.getOrigin(), request.ray.getDirection(), (closest != NULL) ? min : 200.0f };
+			tracers_.push_back(tracer);
 		}
-		else  // if it's not hitscan, we add it to the scene
-		{
-			AddProjectile(a);
+		hitscans_.clear();
+
+		// every tracer of the step in as few bursts as fit
+		if (particles_) {
+			particles_->SpawnTracers(tracers_, glm::vec3(0.9, 0.1, 0.1), 600, 0.5);
 		}
 	}
 
@@ -218,16 +399,6 @@ namespace game {
 		return glm::vec3(x, y, z);
 	}
 
-	void SceneGraph::AddProjectile(SceneNode* p) {
-		if (projectiles == NULL)
-		{
-			projectiles = new SceneNode("Proj_Dummy", NULL, NULL, NULL, false);
-			projectiles->setCollidable(false);
-			root_->AddChild(projectiles);
-		}
-		projectiles->AddChild(p);
-	}
-
 	/*   Cycle through each of the entities in the scene (first children of root).
 	   Run collisions on each pair once, such that in nodes ABCD, comparisons
 	   are AB AC AD BC BD CD. */
@@ -236,18 +407,10 @@ namespace game {
 		for (std::vector<SceneNode *>::const_iterator n1 = root_->children_begin();
 			n1 != root_->children_end() - 1; n1++) {
 
-			if ((*n1) == projectiles) {
-				continue;
-			}
-
 			// start at the node after n1 so we compare the next node (n2) to n1
 			for (std::vector<SceneNode *>::const_iterator n2 = n1 + 1;
 				n2 != root_->children_end(); n2++) {
 
-				if ((*n2) == projectiles) {
-					continue;
-				}
-
 				if (CollisionManager::checkHierarchicalCollision(*n1, *n2)) {
 					(*n1)->onCollide(*n2);
 					(*n2)->onCollide(*n1);
@@ -257,26 +420,42 @@ namespace game {
 		}
 
 		// now compare each entity to projectiles
-		if (projectiles != NULL) {
+		if (projectiles_ != NULL && projectiles_->GetCount() > 0) {
 			for (std::vector<SceneNode *>::const_iterator entity = root_->children_begin();
 				entity != root_->children_end(); entity++) {
 
-				if ((*entity) == projectiles) {
-					continue;
+				// the collidable parts of the entity and the box around all of them
+				collidables_.clear();
+				glm::vec3 min = glm::vec3(INFINITY), max = glm::vec3(-INFINITY);
+				std::stack<SceneNode *> stck;
+				stck.push(*entity);
+				while (stck.size() > 0) {
+					SceneNode *current = stck.top();
+					stck.pop();
+					if (current->isCollidable()) {
+						glm::vec3 half = current->aabb.getScale() * 0.5f;
+						min = glm::min(min, current->aabb.getPos() - half);
+						max = glm::max(max, current->aabb.getPos() + half);
+						collidables_.push_back(current);
+					}
+					for (SceneNode *c : current->children_) {
+						stck.push(c);
+					}
 				}
 
-				for (std::vector<SceneNode *>::const_iterator p_n = projectiles->children_begin();
-					p_n != projectiles->children_end(); p_n++) {
-
-					Projectile* p = dynamic_cast<Projectile*>((*p_n));
-
-					if (p->GetParentName() == (*entity)->GetName() || p->isDestroyed()) continue;
+				// only the projectiles near the entity are tested against each part
+				if (collidables_.empty() || projectiles_->Select(min, max, (*entity)->GetId()) == 0) {
+					continue;
+				}
 
-					if (CollisionManager::checkHierarchicalCollision(*entity, p)) {
-						std::cout << "Proj Collision between " << (*entity)->GetName() << " and " << p->GetName() << std::endl;
-						(*entity)->takeDamage(p->getDamage());
-						p->takeDamage(INFINITY);
-					}
+				float damage = 0.0f;
+				int hits = 0;
+				for (unsigned int i = 0; i < collidables_.size(); i++) {
+					hits += projectiles_->Hit(collidables_[i], damage);
+				}
+				if (hits > 0) {
+					std::cout << "Proj Collision between " << (*entity)->GetName() << " and " << hits << " projectile(s)" << std::endl;
+					(*entity)->takeDamage(damage);
 				}
 			}
 		}
@@ -301,27 +480,61 @@ namespace game {
 		return hit_list;
 	}
 
-	void SceneGraph::SetupDrawToTexture(void) {
+	void SceneGraph::SetupDrawToTexture(int width, int height) {
 
 		// Set up frame buffer
 		glGenFramebuffers(1, &frame_buffer_);
-		glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer_);
 
 		// Set up target texture for rendering
+		// Linear filtering, since a scaled down render is stretched over the window
 		glGenTextures(1, &texture_);
 		glBindTexture(GL_TEXTURE_2D, texture_);
-
-		// Set up an image for the texture
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 		// Set up a depth buffer for rendering
 		glGenRenderbuffers(1, &depth_buffer_);
+
+		// Allocate both at the window size and attach them
+		ResizeDrawToTexture(width, height);
+
+		// Set up quad for drawing to the screen
+		static const GLfloat quad_vertex_data[] = {
+			-1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+			1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+			-1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+			-1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+			1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+			1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+		};
+
+		// Create buffer for quad
+		glGenBuffers(1, &quad_array_buffer_);
+		glBindBuffer(GL_ARRAY_BUFFER, quad_array_buffer_);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertex_data), quad_vertex_data, GL_STATIC_DRAW);
+		GpuCounters::CountBufferUpload();
+	}
+
+	void SceneGraph::ResizeDrawToTexture(int width, int height) {
+		// A minimized window has no size, keep the old target until it comes back
+		if (width <= 0 || height <= 0) {
+			return;
+		}
+		frame_width_ = width;
+		frame_height_ = height;
+
+		// Set up an image for the texture
+		glBindTexture(GL_TEXTURE_2D, texture_);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame_width_, frame_height_, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+		GpuCounters::CountTextureUpload();
+
 		glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, frame_width_, frame_height_);
 
 		// Configure frame buffer (attach rendering buffers)
+		glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer_);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
 		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
 		GLenum DrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
@@ -334,21 +547,14 @@ namespace game {
 
 		// Reset frame buffer
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
 
-		// Set up quad for drawing to the screen
-		static const GLfloat quad_vertex_data[] = {
-			-1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-			1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-			-1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-			-1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-			1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-			1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-		};
+	void SceneGraph::SetRenderScale(float scale) {
+		render_scale_ = glm::clamp(scale, 0.1f, 1.0f);
+	}
 
-		// Create buffer for quad
-		glGenBuffers(1, &quad_array_buffer_);
-		glBindBuffer(GL_ARRAY_BUFFER, quad_array_buffer_);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertex_data), quad_vertex_data, GL_STATIC_DRAW);
+	float SceneGraph::GetRenderScale(void) const {
+		return render_scale_;
 	}
 
 	void SceneGraph::DrawToTexture(Camera *camera, bool sun) {
@@ -359,7 +565,8 @@ namespace game {
 
 		// Enable frame buffer
 		glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer_);
-		glViewport(0, 0, FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT);
+		// Only the lower left corner is used when rendering at a lower scale
+		glViewport(0, 0, (GLsizei)(frame_width_ * render_scale_), (GLsizei)(frame_height_ * render_scale_));
 
 		// Clear background
 		if (sun) {
@@ -374,6 +581,9 @@ namespace game {
 		}
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		// Textures on unit 0 are filtered through the shared sampler
+		glBindSampler(0, rm_->GetTextureSampler());
+
 		// Draw all scene nodes
 		// Initialize stack of nodes
 		std::stack<SceneNode *> stck;
@@ -392,9 +602,9 @@ namespace game {
 			// Draw node based on parent transformation
 			glm::mat4 current_transf = current->Draw(camera, parent_transf, sun);
 
-			// if the current node has collision, update it's collidables
-			if (current->isCollidable())
-				current->updateCollidable(current_transf);
+			if (current == root_ && projectiles_) {
+				projectiles_->SetFrame(current_transf);
+			}
 
 			// Push children of the node to the stack
 			for (std::vector<SceneNode *>::const_iterator it = current->children_begin();
@@ -404,6 +614,20 @@ namespace game {
 			}
 		}
 
+		if (projectiles_) {
+			projectiles_->Draw(camera);
+		}
+
+		if (particles_) {
+			if (gpu_profiler_) {
+				gpu_profiler_->Begin(ParticlePass);
+			}
+			particles_->Draw(camera);
+			if (gpu_profiler_) {
+				gpu_profiler_->End(ParticlePass);
+			}
+		}
+
 		// Reset frame buffer
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -436,17 +660,80 @@ namespace game {
 		GLint hp_var = glGetUniformLocation(program, "hp");
 		glUniform1f(hp_var, hp);
 
-		// Bind texture
+		// Performance graph, if it is shown
+		GLint graph_columns = glGetUniformLocation(program, "graph_columns");
+		glUniform1i(graph_columns, (GLint)overlay_graph_.size());
+		if (!overlay_graph_.empty()) {
+			GLint graph = glGetUniformLocation(program, "graph");
+			glUniform2fv(graph, (GLsizei)overlay_graph_.size(), &overlay_graph_[0].x);
+			GLint graph_budget = glGetUniformLocation(program, "graph_budget");
+			glUniform1f(graph_budget, overlay_budget_);
+		}
+
+		// Part of the texture that was rendered to, stopping half a texel short of its edge
+		// so linear filtering doesn't pick up stale texels
+		GLsizei render_width = (GLsizei)(frame_width_ * render_scale_);
+		GLsizei render_height = (GLsizei)(frame_height_ * render_scale_);
+		GLint uv_scale = glGetUniformLocation(program, "uv_scale");
+		glUniform2f(uv_scale, render_width / (float)frame_width_, render_height / (float)frame_height_);
+		GLint uv_max = glGetUniformLocation(program, "uv_max");
+		glUniform2f(uv_max, (render_width - 0.5f) / frame_width_, (render_height - 0.5f) / frame_height_);
+
+		// Bind texture, with its own nearest filtering rather than the mipmapped scene sampler
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, texture_);
+		glBindSampler(0, 0);
 
 		// Draw geometry
 		glDrawArrays(GL_TRIANGLES, 0, 6); // Quad: 6 coordinates
+		GpuCounters::CountDraw(2);
 
 		// Reset current geometry
 		glEnable(GL_DEPTH_TEST);
 	}
 
+	void SceneGraph::SetOverlayGraph(const std::vector<glm::vec2> &graph, float budget) {
+		overlay_graph_ = graph;
+		overlay_budget_ = budget;
+	}
+
+	void SceneGraph::SetupParticles(int capacity, int max_burst) {
+		Resource *update = rm_->GetResource("ParticleUpdateMaterial");
+		Resource *draw = rm_->GetResource("ParticleSystemMaterial");
+		Resource *tex = rm_->GetResource("Firework");
+		if (!update || !draw || !tex) {
+			throw(std::invalid_argument(std::string("Particle system resources were not loaded")));
+		}
+
+		delete particles_;
+		particles_ = new ParticleSystem(capacity, max_burst);
+		particles_->Init(update->GetResource(), draw->GetResource(), tex->GetResource());
+	}
+
+	ParticleSystem *SceneGraph::GetParticles(void) const {
+		return particles_;
+	}
+
+	void SceneGraph::SetGpuProfiler(GpuProfiler *profiler) {
+		gpu_profiler_ = profiler;
+	}
+
+	void SceneGraph::SetupProjectiles(int capacity) {
+		Resource *mat = rm_->GetResource("ProjectileMaterial");
+		Resource *tex = rm_->GetResource("EnemyTextures");
+		if (!mat || !tex) {
+			throw(std::invalid_argument(std::string("Projectile system resources were not loaded")));
+		}
+
+		delete projectiles_;
+		projectiles_ = new ProjectileSystem(capacity);
+		projectiles_->Init(mat, tex);
+	}
+
+	ProjectileSystem *SceneGraph::GetProjectiles(void) const {
+		return projectiles_;
+	}
+
 	void SceneGraph::SetResourceManager(ResourceManager* rm) {
 		rm_ = rm;
 	}
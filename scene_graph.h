@@ -12,11 +12,14 @@
 #include "camera.h"
 #include "collision_manager.h"
 #include "resource_manager.h"
+#include "particle_system.h"
+#include "projectile_system.h"
+#include "enemy_steering.h"
+#include "enemy_activation.h"
+#include "spatial_grid.h"
+#include "gpu_profiler.h"
 #include <queue>
 
-#define FRAME_BUFFER_WIDTH 1024
-#define FRAME_BUFFER_HEIGHT 768
-
 namespace game {
 	// Class that manages all the objects in a scene
 	class SceneGraph {
@@ -27,11 +30,13 @@ namespace game {
 	public:
 		// Root of the hierarchy
 		SceneNode * root_;
-		SceneNode* projectiles = NULL;
 
 		SceneGraph(void);
 		~SceneGraph();
 
+		// Delete the particle and projectile systems, call while the GL context still exists
+		void Clear(void);
+
 		glm::vec3 world_tr_corner;
 		glm::vec3 world_bl_corner;
 		int exploCount = 0; //helps name our bombs for proper deletion
@@ -42,7 +47,6 @@ namespace game {
 
 		// Set root of the hierarchy
 		void SetRoot(SceneNode *node);
-		void AddProjectile(SceneNode* p);
 		// Find a scene node with a specific name
 		SceneNode *GetNode(std::string node_name) const;
 		SceneNode *FindName(std::string node_name) const;
@@ -52,6 +56,11 @@ namespace game {
 
 		// Update entire scene
 		void Update(double deltaTime);
+		// Steer enemies together with EnemySteering (the default), or one at a time in their Update
+		void SetBatchSteering(bool batch);
+		// Only update enemies near target, see EnemyActivation. Without a target every enemy is updated
+		void SetActivationTarget(SceneNode *target);
+		EnemyActivation &GetActivation(void);
 
 		// run collisions on the children of node (the separate entities)
 		void CheckCollisions();
@@ -62,21 +71,74 @@ namespace game {
 
 		// function for if an enemy has raised an attack flag
 		void EnemyAttacking(Enemy* e);
+		// Resolve every hitscan queued during the update together, against a grid of every collidable part
+		void ResolveHitscans(void);
 
 		void Remove(std::string node_name); //remove a node with a given name
 
 		glm::vec3 GetRandomBoundedPosition();
 
-		void SetupDrawToTexture(void);
+		// Create the render target at the size of the window
+		void SetupDrawToTexture(int width, int height);
+		// Reallocate the render target when the window changes size
+		void ResizeDrawToTexture(int width, int height);
+		// Render into this fraction of the target, clamped to [0.1, 1]
+		void SetRenderScale(float scale);
+		float GetRenderScale(void) const;
 		GLuint frame_buffer_;
 		GLuint quad_array_buffer_;
 		GLuint texture_;
 		GLuint depth_buffer_;
+		int frame_width_; // Size of the render target
+		int frame_height_;
+		float render_scale_;
 		// Draw the scene into a texture
 		void DrawToTexture(Camera *camera, bool sun);
 		// Process and draw the texture on the screen
 		void DisplayTexture(GLuint program, float hp);
+		// Graph drawn over the texture, one column per entry with the frame time in x and the GPU
+		// time in y as a fraction of the graph height, and budget the height of the frame budget line.
+		// An empty graph hides it
+		void SetOverlayGraph(const std::vector<glm::vec2> &graph, float budget);
+		std::vector<glm::vec2> overlay_graph_;
+		float overlay_budget_;
+
+		// Create the particle system shared by all explosions and tracers, from the
+		// "ParticleUpdateMaterial", "ParticleSystemMaterial" and "Firework" resources
+		void SetupParticles(int capacity, int max_burst);
+		ParticleSystem *GetParticles(void) const;
+		ParticleSystem *particles_;
+		// Times the particle draws on the GPU, may be NULL
+		void SetGpuProfiler(GpuProfiler *profiler);
+		GpuProfiler *gpu_profiler_;
+
+		// Create the projectile system of every enemy and player shot, drawn with the
+		// "ProjectileMaterial" program and the "EnemyTextures" texture array
+		void SetupProjectiles(int capacity);
+		ProjectileSystem *GetProjectiles(void) const;
+		ProjectileSystem *projectiles_;
 
+	private:
+		// Bring the collision boxes of the awake and settling entities to where this step left them
+		void UpdateCollidables(void);
+
+		EnemySteering steering_;
+		EnemyActivation activation_;
+		bool batch_steering_;
+		std::vector<SceneNode *> collidables_; // Collidable nodes of one entity, kept to avoid allocating
+
+		// Hitscans fired during the update, resolved once every enemy moved
+		struct HitscanRequest {
+			Ray ray;
+			float damage;
+			int owner; // Id of the entity that fired, it can't be hit
+		};
+		std::vector<HitscanRequest> hitscans_;
+		// Collidable parts of every entity and the grid over them, rebuilt for each batch of hitscans
+		std::vector<std::pair<SceneNode *, SceneNode *> > ray_targets_; // Part, entity
+		SpatialGrid ray_grid_;
+		std::vector<int> ray_candidates_;
+		std::vector<ParticleTracer> tracers_;
 	}; // class SceneGraph
 } // namespace game
 #endif // SCENE_GRAPH_H_
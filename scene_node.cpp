@@ -5,13 +5,31 @@
 #include <iostream>
 #include <time.h>
 #include "scene_node.h"
+#include "texture_streamer.h"
+#include "scene_snapshot.h"
+#include "gpu_counters.h"
 
 namespace game {
 	glm::vec3 SceneNode::default_forward = glm::vec3(0.0, 0.0, 1.0);
+	float SceneNode::interpolation_ = 1.0;
+	int SceneNode::next_id_ = 0;
+	int SceneNode::live_count_ = 0;
 
 	SceneNode::SceneNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *tex, bool collision) {
 		// Set name of scene node
 		name_ = name;
+		id_ = next_id_++;
+		live_count_++;
+
+		// Unloading the resources waits until the node lets go of them
+		resources_[0] = geometry;
+		resources_[1] = material;
+		resources_[2] = tex;
+		for (int i = 0; i < 3; i++) {
+			if (resources_[i]) {
+				resources_[i]->Acquire();
+			}
+		}
 
 		if (geometry) {
 			// Set geometry
@@ -47,13 +65,17 @@ namespace game {
 
 		if (tex) {
 			texture_ = tex->GetResource();
+			texture_target_ = (tex->GetType() == TextureArray) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
 		}
 		else {
 			texture_ = 0;
+			texture_target_ = GL_TEXTURE_2D;
 		}
+		texture_layer_ = 0;
 
 		// Other attributes
 		scale_ = glm::vec3(1.0, 1.0, 1.0);
+		has_previous_ = false;
 
 		// Hierarchy
 		parent_ = NULL;
@@ -61,7 +83,26 @@ namespace game {
 		collidable = collision;
 	}
 
-	SceneNode::~SceneNode() {}
+	SceneNode::~SceneNode() {
+		live_count_--;
+		ReleaseResources();
+	}
+
+	void SceneNode::ReleaseResources(void) {
+		for (int i = 0; i < 3; i++) {
+			if (resources_[i]) {
+				resources_[i]->Release();
+				resources_[i] = NULL;
+			}
+		}
+	}
+
+	const Resource *SceneNode::GetResource(int slot) const {
+		if (slot < 0 || slot > 2) {
+			throw(std::invalid_argument(std::string("Invalid resource slot")));
+		}
+		return resources_[slot];
+	}
 
 	const std::string SceneNode::GetName(void) const {
 		return name_;
@@ -85,6 +126,32 @@ namespace game {
 		return last->GetName();
 	}
 
+	SceneNode *SceneNode::GetEntity(void) {
+		SceneNode *entity = this;
+		while (entity->parent_ != NULL && entity->parent_->parent_ != NULL) {
+			entity = entity->parent_;
+		}
+		return entity;
+	}
+
+	int SceneNode::GetId(void) const {
+		return id_;
+	}
+
+	int SceneNode::GetLiveCount(void) {
+		return live_count_;
+	}
+
+	void SceneNode::DeleteTree(SceneNode *node) {
+		std::vector<SceneNode *> stck(1, node);
+		while (!stck.empty()) {
+			SceneNode *current = stck.back();
+			stck.pop_back();
+			stck.insert(stck.end(), current->children_.begin(), current->children_.end());
+			delete current;
+		}
+	}
+
 	glm::vec3 SceneNode::GetPosition(void) const {
 		return position_;
 	}
@@ -171,6 +238,10 @@ namespace game {
 		}
 	}
 
+	void SceneNode::SetTextureLayer(int layer) {
+		texture_layer_ = layer;
+	}
+
 	void SceneNode::destroy()
 	{
 		destroyed = true;
@@ -216,7 +287,7 @@ namespace game {
 		return material_;
 	}
 
-	glm::mat4 SceneNode::Draw(Camera *camera, glm::mat4 parent_transf, bool sun) {
+	glm::mat4 SceneNode::Draw(Camera *, glm::mat4 parent_transf, bool sun) {
 		glDisable(GL_BLEND);
 		glEnable(GL_DEPTH_TEST);
 		glDepthFunc(GL_LESS);
@@ -233,9 +304,6 @@ namespace game {
 			glBindBuffer(GL_ARRAY_BUFFER, array_buffer_);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_array_buffer_);
 
-			// Set globals for camera
-			camera->SetupShader(material_);
-
 			// Set world matrix and other shader input variables
 			glm::mat4 transf = SetupShader(material_, parent_transf, sun);
 
@@ -246,21 +314,59 @@ namespace game {
 			else {
 				glDrawElements(mode_, size_, GL_UNSIGNED_INT, 0);
 			}
+			GpuCounters::CountDraw(mode_ == GL_TRIANGLES ? size_ / 3 : 0);
 
 			return transf;
 		}
 		else {
-			glm::mat4 rotation = glm::mat4_cast(orientation_);
-			glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
+			glm::mat4 rotation = glm::mat4_cast(GetDrawOrientation());
+			glm::mat4 translation = glm::translate(glm::mat4(1.0), GetDrawPosition());
 			glm::mat4 transf = parent_transf * translation * rotation;
 			return transf;
 		}
 	}
 
+	glm::mat4 SceneNode::GetTransform(glm::mat4 parent_transf) const {
+		if (name_ == "Laser1") { //laser is in front of the helicopter, as drawn
+			parent_transf = glm::mat4(1.0);
+		}
+		glm::mat4 rotation = glm::mat4_cast(orientation_);
+		glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
+		return parent_transf * translation * rotation;
+	}
+
 	void SceneNode::Update(double deltaTime) {
 		// Do nothing for this generic type of scene node
 	}
 
+	void SceneNode::StoreTransform(void) {
+		previous_position_ = position_;
+		previous_orientation_ = orientation_;
+		has_previous_ = true;
+	}
+
+	void SceneNode::SetInterpolation(float alpha) {
+		interpolation_ = alpha;
+	}
+
+	float SceneNode::GetInterpolation(void) {
+		return interpolation_;
+	}
+
+	glm::vec3 SceneNode::GetDrawPosition(void) const {
+		if (!has_previous_) {
+			return position_;
+		}
+		return glm::mix(previous_position_, position_, interpolation_);
+	}
+
+	glm::quat SceneNode::GetDrawOrientation(void) const {
+		if (!has_previous_) {
+			return orientation_;
+		}
+		return glm::slerp(previous_orientation_, orientation_, interpolation_);
+	}
+
 	void SceneNode::onCollide(Collidable* other) {
 		takeDamage(0.1);
 
@@ -274,6 +380,37 @@ namespace game {
 		}
 	}
 
+	void SceneNode::SaveState(SnapshotNode &state) const {
+		state.position[0] = position_.x;
+		state.position[1] = position_.y;
+		state.position[2] = position_.z;
+		state.orientation[0] = orientation_.w;
+		state.orientation[1] = orientation_.x;
+		state.orientation[2] = orientation_.y;
+		state.orientation[3] = orientation_.z;
+		state.scale[0] = scale_.x;
+		state.scale[1] = scale_.y;
+		state.scale[2] = scale_.z;
+		state.health = health;
+		state.time_to_live = time_to_live;
+		state.texture_layer = texture_layer_;
+		state.collidable = collidable;
+		state.destroyed = destroyed;
+	}
+
+	void SceneNode::RestoreState(const SnapshotNode &state) {
+		position_ = glm::vec3(state.position[0], state.position[1], state.position[2]);
+		orientation_ = glm::quat(state.orientation[0], state.orientation[1], state.orientation[2], state.orientation[3]);
+		scale_ = glm::vec3(state.scale[0], state.scale[1], state.scale[2]);
+		health = state.health;
+		time_to_live = state.time_to_live;
+		texture_layer_ = state.texture_layer;
+		collidable = state.collidable != 0;
+		destroyed = state.destroyed != 0;
+		// Drawn where it is until the next step
+		has_previous_ = false;
+	}
+
 	glm::quat SceneNode::VectorToRotation(glm::vec3 v) {
 		// get the rotation around the y axis
 		float angle = asin(v.x / sqrt(pow(v.x, 2) + pow(v.z, 2)));
@@ -291,7 +428,7 @@ namespace game {
 		return hor_rotation * vert_rotation;
 	}
 
-	glm::mat4 SceneNode::SetupShader(GLuint program, glm::mat4 parent_transf, bool sun) {
+	glm::mat4 SceneNode::SetupShader(GLuint program, glm::mat4 parent_transf, bool) {
 		// Set attributes for shaders
 		GLint vertex_att = glGetAttribLocation(program, "vertex");
 		glVertexAttribPointer(vertex_att, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), 0);
@@ -311,8 +448,8 @@ namespace game {
 
 		// World transformation
 		glm::mat4 scaling = glm::scale(glm::mat4(1.0), scale_);
-		glm::mat4 rotation = glm::mat4_cast(orientation_);
-		glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
+		glm::mat4 rotation = glm::mat4_cast(GetDrawOrientation());
+		glm::mat4 translation = glm::translate(glm::mat4(1.0), GetDrawPosition());
 		glm::mat4 transf = parent_transf * translation * rotation;
 		glm::mat4 local_transf = transf * scaling;
 
@@ -329,24 +466,15 @@ namespace game {
 			GLint tex = glGetUniformLocation(program, "texture_map");
 			glUniform1i(tex, 0); // Assign the first texture to the map
 			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture_); // First texture we bind
-													// Define texture interpolation
-			glGenerateMipmap(GL_TEXTURE_2D);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glBindTexture(texture_target_, texture_); // First texture we bind
+			TextureStreamer::MarkUsed(texture_);
+			if (texture_target_ == GL_TEXTURE_2D_ARRAY) {
+				glUniform1f(glGetUniformLocation(program, "texture_layer"), (float)texture_layer_);
+			}
+			// Mipmaps and interpolation are set up once, when the texture is loaded
 		}
 
-		// Timer
-		GLint timer_var = glGetUniformLocation(program, "timer");
-		double current_time = glfwGetTime();
-		glUniform1f(timer_var, (float)current_time);
-
-		// Light
-		GLint light_var = glGetUniformLocation(program, "light");
-		double light;
-		if (sun) { light = 0.9; }
-		else { light = 0.0; }
-		glUniform1f(light_var, (float)light);
+		// Timer and light come from the per-frame uniform block
 
 		// Return transformation of node combined with parent, without scaling
 		return transf;
@@ -13,6 +13,8 @@
 #include "collidable.h"
 
 namespace game {
+	struct SnapshotNode;
+
 	// Class that manages one object in a scene 
 	class SceneNode : public Collidable {
 	public:
@@ -20,11 +22,17 @@ namespace game {
 		SceneNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *tex = NULL, bool collision = false);
 
 		// Destructor
-		~SceneNode();
+		virtual ~SceneNode();
 
 		// Get name of node
 		const std::string GetName(void) const;
 		std::string GetEntityName(void);
+		// Child of the root this node belongs to
+		SceneNode *GetEntity(void);
+		// Unique among all nodes, to refer to a node without its name
+		int GetId(void) const;
+		// Nodes created and not yet deleted
+		static int GetLiveCount(void);
 
 		// Get node attributes
 		glm::vec3 GetPosition(void) const;
@@ -44,6 +52,12 @@ namespace game {
 		void SetScale(float x, float y, float z);
 		void setCollidable(bool c);
 		void takeDamage(float d);
+		// Layer drawn when the texture is a texture array
+		void SetTextureLayer(int layer);
+		// Let go of the geometry, material and texture, once the node is out of the scene for good
+		void ReleaseResources(void);
+		// Geometry (0), material (1) or texture (2) the node holds, NULL if it has none
+		const Resource *GetResource(int slot) const;
 
 		// Perform transformations on node
 		void Translate(glm::vec3 trans);
@@ -54,10 +68,22 @@ namespace game {
 
 		// Draw the node according to scene parameters in 'camera'
 		virtual glm::mat4 Draw(Camera *camera, glm::mat4 parent_transf, bool sun);
+		// Transformation of the node combined with parent_transf, without scaling, where the last
+		// simulation step left it. Draw returns the same between two steps
+		virtual glm::mat4 GetTransform(glm::mat4 parent_transf) const;
 
 		// Update the node
 		virtual void Update(double deltaTime);
+		// Keep the current position and orientation as the previous simulation step, call before every step
+		void StoreTransform(void);
+		// Draw every node this fraction of the way from its previous step to its current one
+		static void SetInterpolation(float alpha);
+		static float GetInterpolation(void);
 		virtual void onCollide(Collidable* other);
+		// Copy the state of the node into a snapshot and back, see SceneSnapshot. The hierarchy,
+		// the resources and links to other nodes are left to the snapshot
+		virtual void SaveState(SnapshotNode &state) const;
+		virtual void RestoreState(const SnapshotNode &state);
 
 		// OpenGL variables
 		GLenum GetMode(void) const;
@@ -71,6 +97,8 @@ namespace game {
 		std::vector<SceneNode *>::const_iterator children_begin() const;
 		std::vector<SceneNode *>::const_iterator children_end() const;
 		std::vector<SceneNode *> children_;
+		// Delete node and everything under it
+		static void DeleteTree(SceneNode *node);
 
 		SceneNode *parent_;
 		double time_to_live = -5000.0;
@@ -82,21 +110,34 @@ namespace game {
 		glm::quat VectorToRotation(glm::vec3 v);
 
 		std::string name_; // Name of the scene node
+		int id_;
+		static int next_id_;
+		static int live_count_;
 		GLuint array_buffer_; // References to geometry: vertex and array buffers
 		GLuint element_array_buffer_;
 		GLenum mode_; // Type of geometry
 		GLsizei size_; // Number of primitives in geometry
 		GLuint material_; // Reference to shader program
 		GLuint texture_; // Reference to texture resource
+		GLenum texture_target_; // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for a texture array
+		int texture_layer_;
+		const Resource *resources_[3]; // Resources the node holds a reference to, NULL once released
 		glm::vec3 position_; // Position of node
 		glm::quat orientation_; // Orientation of node
 		glm::vec3 scale_; // Scale of node
+		glm::vec3 previous_position_; // Position and orientation at the previous simulation step
+		glm::quat previous_orientation_;
+		bool has_previous_; // False until the first step, drawn where it is until then
+		static float interpolation_;
 
 		float health = 20;
 		bool enemy = false;
 		bool collidable = false;
 
 		virtual glm::mat4 SetupShader(GLuint program, glm::mat4 parent_transf, bool sun);
+		// Position and orientation drawn, between the last two simulation steps
+		glm::vec3 GetDrawPosition(void) const;
+		glm::quat GetDrawOrientation(void) const;
 	}; // class SceneNode
 } // namespace game
 #endif // SCENE_NODE_H_
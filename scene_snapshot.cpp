@@ -0,0 +1,385 @@
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include "scene_snapshot.h"
+#include "terrain.h"
+#include "mole.h"
+#include "cat.h"
+#include "doggy.h"
+#include "bomb.h"
+#include "laser.h"
+
+namespace game {
+	// Seconds on a clock shared by all threads
+	static double now(void) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Class node is restored as, most derived first
+	static SnapshotNodeKind node_kind(SceneNode *node) {
+		if (dynamic_cast<Terrain *>(node)) {
+			return TerrainNode;
+		}
+		if (dynamic_cast<Mole *>(node)) {
+			return MoleNode;
+		}
+		if (dynamic_cast<Cat *>(node)) {
+			return CatNode;
+		}
+		if (dynamic_cast<Doggy *>(node)) {
+			return DogNode;
+		}
+		if (dynamic_cast<Bomb *>(node)) {
+			return BombNode;
+		}
+		if (dynamic_cast<Laser *>(node)) {
+			return LaserNode;
+		}
+		return PlainNode;
+	}
+
+	// Offset of s in strings, added the first time. Resource names repeat on every node
+	static unsigned int add_string(std::vector<char> &strings, std::unordered_map<std::string, unsigned int> &offsets, const std::string &s) {
+		std::unordered_map<std::string, unsigned int>::const_iterator it = offsets.find(s);
+		if (it != offsets.end()) {
+			return it->second;
+		}
+		unsigned int offset = (unsigned int)strings.size();
+		strings.insert(strings.end(), s.begin(), s.end());
+		strings.push_back('\0');
+		offsets[s] = offset;
+		return offset;
+	}
+
+	SceneSnapshot::SceneSnapshot(void) {}
+
+	void SceneSnapshot::Capture(SceneNode *root, const ProjectileSystem *projectiles) {
+		nodes_.clear();
+		strings_.clear();
+		projectiles_.clear();
+		if (!root) {
+			throw(std::invalid_argument(std::string("Nothing to capture")));
+		}
+
+		// Depth first so parents come before their children, and children keep their order
+		std::vector<SceneNode *> order;
+		std::unordered_map<const SceneNode *, unsigned int> index;
+		std::unordered_map<int, unsigned int> id_index;
+		std::unordered_map<std::string, unsigned int> offsets;
+		std::vector<std::pair<SceneNode *, unsigned int> > stck(1, std::make_pair(root, SNAPSHOT_NONE));
+		while (!stck.empty()) {
+			SceneNode *node = stck.back().first;
+			unsigned int parent = stck.back().second;
+			stck.pop_back();
+
+			unsigned int i = (unsigned int)nodes_.size();
+			index[node] = i;
+			id_index[node->GetId()] = i;
+			order.push_back(node);
+
+			SnapshotNode state = SnapshotNode();
+			state.kind = node_kind(node);
+			state.parent = parent;
+			state.name = add_string(strings_, offsets, node->GetName());
+			for (int r = 0; r < 3; r++) {
+				const Resource *resource = node->GetResource(r);
+				state.resources[r] = resource ? add_string(strings_, offsets, resource->GetName()) : SNAPSHOT_NONE;
+			}
+			state.target = SNAPSHOT_NONE;
+			state.turret = SNAPSHOT_NONE;
+			node->SaveState(state);
+			nodes_.push_back(state);
+
+			for (std::vector<SceneNode *>::const_reverse_iterator it = node->children_.rbegin(); it != node->children_.rend(); it++) {
+				stck.push_back(std::make_pair(*it, i));
+			}
+		}
+
+		// Links between nodes, by index. Nodes outside the hierarchy are lost
+		for (unsigned int i = 0; i < order.size(); i++) {
+			Enemy *enemy = dynamic_cast<Enemy *>(order[i]);
+			if (!enemy) {
+				continue;
+			}
+			std::unordered_map<const SceneNode *, unsigned int>::const_iterator it = index.find(enemy->getTarget());
+			if (it != index.end()) {
+				nodes_[i].target = it->second;
+			}
+			if (nodes_[i].kind == DogNode) {
+				it = index.find(static_cast<Doggy *>(enemy)->getTurret());
+				if (it != index.end()) {
+					nodes_[i].turret = it->second;
+				}
+			}
+		}
+
+		if (projectiles) {
+			projectiles_.resize(projectiles->GetCount());
+			ProjectileState state;
+			for (int i = 0; i < projectiles->GetCount(); i++) {
+				projectiles->GetState(i, state);
+				SnapshotProjectile &p = projectiles_[i];
+				p.position[0] = state.position.x;
+				p.position[1] = state.position.y;
+				p.position[2] = state.position.z;
+				p.last_position[0] = state.last_position.x;
+				p.last_position[1] = state.last_position.y;
+				p.last_position[2] = state.last_position.z;
+				p.velocity[0] = state.velocity.x;
+				p.velocity[1] = state.velocity.y;
+				p.velocity[2] = state.velocity.z;
+				p.acceleration[0] = state.acceleration.x;
+				p.acceleration[1] = state.acceleration.y;
+				p.acceleration[2] = state.acceleration.z;
+				p.life = state.life;
+				p.damage = state.damage;
+				std::unordered_map<int, unsigned int>::const_iterator it = id_index.find(state.owner);
+				p.owner = (it != id_index.end()) ? it->second : SNAPSHOT_NONE;
+				p.type = state.type;
+			}
+		}
+	}
+
+	SceneNode *SceneSnapshot::Restore(ResourceManager *resman, ProjectileSystem *projectiles) const {
+		if (nodes_.empty()) {
+			throw(std::invalid_argument(std::string("Nothing to restore")));
+		}
+
+		std::vector<SceneNode *> created;
+		created.reserve(nodes_.size());
+		try {
+			for (unsigned int i = 0; i < nodes_.size(); i++) {
+				const SnapshotNode &state = nodes_[i];
+				const Resource *resources[3];
+				for (int r = 0; r < 3; r++) {
+					resources[r] = (resman && state.resources[r] != SNAPSHOT_NONE) ? resman->GetResource(GetString(state.resources[r])) : NULL;
+				}
+				std::string name = GetString(state.name);
+
+				SceneNode *node;
+				switch (state.kind) {
+				case TerrainNode:
+					node = new Terrain(name, resources[0], resources[1]);
+					break;
+				case MoleNode:
+					node = new Mole(name, NULL, resources[0], resources[1], resources[2]);
+					break;
+				case CatNode:
+					node = new Cat(name, NULL, resources[0], resources[1], resources[2]);
+					break;
+				case DogNode:
+					node = new Doggy(name, NULL, resources[0], resources[1], resources[2]);
+					break;
+				case BombNode:
+					node = new Bomb(name, resources[0], resources[1], state.time_to_live, glm::vec3(0.8, 0.8, 0.8), resources[2]);
+					break;
+				case LaserNode:
+					node = new Laser(name, resources[0], resources[1], resources[2]);
+					break;
+				default:
+					node = new SceneNode(name, resources[0], resources[1], resources[2]);
+					break;
+				}
+				created.push_back(node);
+				node->RestoreState(state);
+				if (state.parent != SNAPSHOT_NONE) {
+					created[state.parent]->AddChild(node);
+				}
+			}
+		}
+		catch (...) {
+			for (unsigned int i = 0; i < created.size(); i++) {
+				delete created[i];
+			}
+			throw;
+		}
+
+		for (unsigned int i = 0; i < nodes_.size(); i++) {
+			const SnapshotNode &state = nodes_[i];
+			if (state.kind == MoleNode || state.kind == CatNode || state.kind == DogNode) {
+				static_cast<Enemy *>(created[i])->setTarget(state.target != SNAPSHOT_NONE ? created[state.target] : NULL);
+			}
+			if (state.kind == DogNode) {
+				static_cast<Doggy *>(created[i])->setTurret(state.turret != SNAPSHOT_NONE ? created[state.turret] : NULL);
+			}
+		}
+
+		if (projectiles) {
+			ProjectileState state;
+			for (unsigned int i = 0; i < projectiles_.size(); i++) {
+				const SnapshotProjectile &p = projectiles_[i];
+				state.position = glm::vec3(p.position[0], p.position[1], p.position[2]);
+				state.last_position = glm::vec3(p.last_position[0], p.last_position[1], p.last_position[2]);
+				state.velocity = glm::vec3(p.velocity[0], p.velocity[1], p.velocity[2]);
+				state.acceleration = glm::vec3(p.acceleration[0], p.acceleration[1], p.acceleration[2]);
+				state.life = p.life;
+				state.damage = p.damage;
+				state.owner = (p.owner != SNAPSHOT_NONE) ? created[p.owner]->GetId() : -1;
+				state.type = p.type;
+				if (!projectiles->Restore(state)) {
+					break;
+				}
+			}
+		}
+		return created[0];
+	}
+
+	void SceneSnapshot::Save(const std::string &filename) const {
+		std::ofstream f(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!f) {
+			throw(std::ios_base::failure(std::string("Error opening snapshot ") + filename));
+		}
+		SnapshotHeader header;
+		header.magic = SNAPSHOT_MAGIC;
+		header.version = SNAPSHOT_VERSION;
+		header.node_count = (unsigned int)nodes_.size();
+		header.string_bytes = (unsigned int)strings_.size();
+		header.projectile_count = (unsigned int)projectiles_.size();
+		header.reserved = 0;
+
+		// One write per block, the arrays are stored as they are in memory
+		f.write((const char *)&header, sizeof(header));
+		if (!nodes_.empty()) {
+			f.write((const char *)&nodes_[0], nodes_.size() * sizeof(SnapshotNode));
+		}
+		if (!strings_.empty()) {
+			f.write(&strings_[0], strings_.size());
+		}
+		if (!projectiles_.empty()) {
+			f.write((const char *)&projectiles_[0], projectiles_.size() * sizeof(SnapshotProjectile));
+		}
+		f.close();
+		if (!f) {
+			throw(std::ios_base::failure(std::string("Error writing snapshot ") + filename));
+		}
+	}
+
+	void SceneSnapshot::Load(const std::string &filename) {
+		std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary);
+		if (!f) {
+			throw(std::ios_base::failure(std::string("Error opening snapshot ") + filename));
+		}
+		SnapshotHeader header;
+		if (!f.read((char *)&header, sizeof(header)) || header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) {
+			throw(std::ios_base::failure(std::string("Not a snapshot: ") + filename));
+		}
+
+		std::vector<SnapshotNode> nodes(header.node_count);
+		std::vector<char> strings(header.string_bytes);
+		std::vector<SnapshotProjectile> projectiles(header.projectile_count);
+		bool ok = true;
+		if (!nodes.empty()) {
+			ok = ok && f.read((char *)&nodes[0], nodes.size() * sizeof(SnapshotNode));
+		}
+		if (!strings.empty()) {
+			ok = ok && f.read(&strings[0], strings.size());
+		}
+		if (!projectiles.empty()) {
+			ok = ok && f.read((char *)&projectiles[0], projectiles.size() * sizeof(SnapshotProjectile));
+		}
+
+		// Every index has to point backwards or into the file, so Restore can trust them
+		ok = ok && (strings.empty() || strings.back() == '\0');
+		for (unsigned int i = 0; ok && i < nodes.size(); i++) {
+			const SnapshotNode &n = nodes[i];
+			ok = (i == 0) ? n.parent == SNAPSHOT_NONE : n.parent < i;
+			ok = ok && n.kind <= LaserNode && n.name < strings.size();
+			for (int r = 0; r < 3; r++) {
+				ok = ok && (n.resources[r] == SNAPSHOT_NONE || n.resources[r] < strings.size());
+			}
+			ok = ok && (n.target == SNAPSHOT_NONE || n.target < nodes.size());
+			ok = ok && (n.turret == SNAPSHOT_NONE || n.turret < nodes.size());
+		}
+		for (unsigned int i = 0; ok && i < projectiles.size(); i++) {
+			ok = projectiles[i].owner == SNAPSHOT_NONE || projectiles[i].owner < nodes.size();
+		}
+		if (!ok) {
+			throw(std::ios_base::failure(std::string("Corrupt snapshot ") + filename));
+		}
+
+		nodes_.swap(nodes);
+		strings_.swap(strings);
+		projectiles_.swap(projectiles);
+	}
+
+	int SceneSnapshot::GetNodeCount(void) const {
+		return (int)nodes_.size();
+	}
+
+	int SceneSnapshot::GetProjectileCount(void) const {
+		return (int)projectiles_.size();
+	}
+
+	int SceneSnapshot::GetProjectileTypes(void) const {
+		int types = 0;
+		for (unsigned int i = 0; i < projectiles_.size(); i++) {
+			types = std::max(types, projectiles_[i].type + 1);
+		}
+		return types;
+	}
+
+	size_t SceneSnapshot::GetBytes(void) const {
+		return sizeof(SnapshotHeader) + nodes_.size() * sizeof(SnapshotNode) + strings_.size()
+			+ projectiles_.size() * sizeof(SnapshotProjectile);
+	}
+
+	const char *SceneSnapshot::GetString(unsigned int offset) const {
+		return &strings_[offset];
+	}
+
+	SnapshotWriter::SnapshotWriter(void) : busy_(false) {
+		failed_ = false;
+		last_ms_ = 0.0;
+	}
+
+	SnapshotWriter::~SnapshotWriter() {
+		Wait();
+	}
+
+	bool SnapshotWriter::Write(std::shared_ptr<const SceneSnapshot> snapshot, const std::string &filename) {
+		if (busy_) {
+			return false;
+		}
+		// The last worker is done, joining it doesn't block
+		Wait();
+		failed_ = false;
+		busy_ = true;
+		worker_ = std::thread(&SnapshotWriter::Run, this, snapshot, filename);
+		return true;
+	}
+
+	bool SnapshotWriter::IsBusy(void) const {
+		return busy_;
+	}
+
+	bool SnapshotWriter::Wait(void) {
+		if (worker_.joinable()) {
+			worker_.join();
+			if (failed_) {
+				std::cerr << error_ << std::endl;
+			}
+		}
+		return !failed_;
+	}
+
+	double SnapshotWriter::GetLastTime(void) const {
+		return last_ms_;
+	}
+
+	void SnapshotWriter::Run(std::shared_ptr<const SceneSnapshot> snapshot, std::string filename) {
+		// The snapshot is never changed once captured, nothing else to share
+		double start = now();
+		try {
+			snapshot->Save(filename);
+		}
+		catch (std::exception &e) {
+			error_ = e.what();
+			failed_ = true;
+		}
+		last_ms_ = (now() - start) * 1000.0;
+		busy_ = false;
+	}
+} // namespace game
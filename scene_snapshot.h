@@ -0,0 +1,138 @@
+#ifndef SCENE_SNAPSHOT_H_
+#define SCENE_SNAPSHOT_H_
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include "scene_node.h"
+#include "projectile_system.h"
+#include "resource_manager.h"
+
+#define SNAPSHOT_MAGIC 0x504e5348 // "HSNP"
+#define SNAPSHOT_VERSION 1
+// No node, or no string
+#define SNAPSHOT_NONE 0xffffffffu
+
+namespace game {
+	// Class a snapshot node is restored as
+	enum SnapshotNodeKind { PlainNode, TerrainNode, MoleNode, CatNode, DogNode, BombNode, LaserNode };
+
+	// Start of a snapshot file. It is followed by node_count SnapshotNode, string_bytes of
+	// zero-terminated strings and projectile_count SnapshotProjectile
+	struct SnapshotHeader {
+		unsigned int magic;
+		unsigned int version;
+		unsigned int node_count;
+		unsigned int string_bytes;
+		unsigned int projectile_count;
+		unsigned int reserved;
+	};
+
+	// State of one node. Every node has the same size so all of them are copied as one block;
+	// parents come before their children, and nodes and names are referred to by index and by
+	// offset into the strings
+	struct SnapshotNode {
+		unsigned int kind; // SnapshotNodeKind
+		unsigned int parent; // SNAPSHOT_NONE for the root
+		unsigned int name;
+		unsigned int resources[3]; // Names of the geometry, material and texture, SNAPSHOT_NONE if the node has none
+		float position[3];
+		float orientation[4]; // w, x, y, z
+		float scale[3];
+		float health;
+		double time_to_live;
+		int texture_layer;
+		unsigned char collidable;
+		unsigned char destroyed;
+		unsigned char attack_flag;
+		unsigned char pad;
+		// Enemies
+		unsigned int target; // Node the enemy attacks
+		unsigned int turret; // Dogs only
+		int projectile_type;
+		float rotate_speed;
+		float speed;
+		float threat_range;
+		float firerate;
+		float shot_cooldown;
+		// Color of bombs, direction of lasers
+		float extra[3];
+	};
+
+	// One projectile in flight, owner is the index of the node that fired it
+	struct SnapshotProjectile {
+		float position[3];
+		float last_position[3];
+		float velocity[3];
+		float acceleration[3];
+		float life;
+		float damage;
+		unsigned int owner;
+		int type;
+	};
+
+	// Copy of the scene at one moment. Capturing only copies the state into flat arrays, so it
+	// is quick enough to do between two steps; the copy never changes afterwards and can be
+	// written by another thread while the scene goes on (see SnapshotWriter)
+	class SceneSnapshot {
+	public:
+		SceneSnapshot(void);
+
+		// Copy the hierarchy under root and the projectiles, which may be NULL
+		void Capture(SceneNode *root, const ProjectileSystem *projectiles);
+		// Build the hierarchy again, returns its root. Resources are looked up by name in resman,
+		// which may be NULL to restore nodes without resources, and projectiles are added to
+		// projectiles if it isn't NULL
+		SceneNode *Restore(ResourceManager *resman, ProjectileSystem *projectiles) const;
+
+		// Throw if filename can't be written or read, or isn't a snapshot of this version
+		void Save(const std::string &filename) const;
+		void Load(const std::string &filename);
+
+		int GetNodeCount(void) const;
+		int GetProjectileCount(void) const;
+		// Projectile types a system needs to restore the projectiles
+		int GetProjectileTypes(void) const;
+		// Size of the file Save writes
+		size_t GetBytes(void) const;
+
+	private:
+		std::vector<SnapshotNode> nodes_;
+		std::vector<char> strings_;
+		std::vector<SnapshotProjectile> projectiles_;
+
+		const char *GetString(unsigned int offset) const;
+	}; // class SceneSnapshot
+
+	// Writes snapshots to disk on a thread of its own, one at a time
+	class SnapshotWriter {
+	public:
+		SnapshotWriter(void);
+		~SnapshotWriter();
+
+		// Start writing snapshot to filename, never waits: returns false and writes nothing while the
+		// last write is still in progress
+		bool Write(std::shared_ptr<const SceneSnapshot> snapshot, const std::string &filename);
+		// Whether a write is in progress
+		bool IsBusy(void) const;
+		// Wait for the write in progress, returns false if the last write failed
+		bool Wait(void);
+		// Milliseconds the last write took, after Wait
+		double GetLastTime(void) const;
+
+	private:
+		std::thread worker_;
+		std::atomic<bool> busy_; // Set until the worker is done, the rest is only read once it is
+		bool failed_;
+		double last_ms_;
+		std::string error_;
+
+		// Writing thread
+		void Run(std::shared_ptr<const SceneSnapshot> snapshot, std::string filename);
+
+		SnapshotWriter(const SnapshotWriter &);
+		SnapshotWriter &operator=(const SnapshotWriter &);
+	}; // class SnapshotWriter
+} // namespace game
+#endif // SCENE_SNAPSHOT_H_
@@ -6,14 +6,35 @@ in vec2 uv0;
 // Passed from outside
 uniform float hp;
 uniform sampler2D texture_map;
+uniform vec2 uv_scale; // Part of the texture the scene was rendered to
+uniform vec2 uv_max;
+uniform vec2 graph[128]; // Frame time (x) and GPU time (y) of the last frames, 1 is the top of the graph
+uniform int graph_columns; // 0 hides the graph
+uniform float graph_budget; // Height of the frame budget
 
 void main() 
 {
     vec2 pos = uv0;
 
-    vec4 pixel = texture(texture_map, pos);
+    vec4 pixel = texture(texture_map, min(pos * uv_scale, uv_max));
 	
-	if (pos.y > 0.03333 && pos.y < 0.075 && pos.x > 0.375 && pos.x < (hp / 100.0) * 0.625){
+	if (graph_columns > 0 && pos.x > 0.02 && pos.x < 0.32 && pos.y > 0.8 && pos.y < 0.97){
+		vec2 g = (pos - vec2(0.02, 0.8)) / vec2(0.3, 0.17);
+		vec2 value = graph[min(int(g.x * graph_columns), graph_columns - 1)];
+		if (value.y > 0.0 && abs(g.y - value.y) < 0.015){
+			gl_FragColor = vec4(1.0,0.0,1.0,1.0); //gpu time line
+		}
+		else if (abs(g.y - graph_budget) < 0.005){
+			gl_FragColor = vec4(1.0,0.0,0.0,1.0); //frame budget
+		}
+		else if (g.y < value.x){
+			gl_FragColor = vec4(1.0,0.8,0.0,1.0); //frame time bar
+		}
+		else {
+			gl_FragColor = vec4(pixel.rgb * 0.4, 1.0); //darkened background
+		}
+	}
+	else if (pos.y > 0.03333 && pos.y < 0.075 && pos.x > 0.375 && pos.x < (hp / 100.0) * 0.625){
 		gl_FragColor = vec4(0.0,1.0,0.0,1.0); //green hp bar
 	}
 	else if (pos.y > 0.075 && pos.y < 0.08 && pos.x > 0.37 && pos.x < 0.63){
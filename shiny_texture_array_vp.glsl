@@ -0,0 +1,32 @@
+#version 130
+#extension GL_ARB_uniform_buffer_object : require
+
+// Vertex buffer
+in vec3 vertex;
+in vec3 color;
+in vec2 uv;
+
+// Per-frame uniform block, shared by all programs
+layout(std140) uniform PerFrame {
+    mat4 view_mat;
+    mat4 projection_mat;
+    vec4 camera_position;
+    float timer;
+    float light;
+};
+
+// Uniform (global) buffer
+uniform mat4 world_mat;
+
+// Attributes forwarded to the fragment shader
+out vec4 color_interp;
+out vec2 uv_interp;
+
+void main()
+{
+    gl_Position = projection_mat * view_mat * world_mat * vec4(vertex, 1.0);
+
+    color_interp = vec4(color, 1.0);
+
+    uv_interp = uv;
+}
\ No newline at end of file
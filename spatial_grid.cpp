@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cmath>
+#include "spatial_grid.h"
+
+namespace game {
+	SpatialGrid::SpatialGrid(float cell_size) {
+		base_cell_size_ = cell_size;
+		cell_size_ = cell_size;
+		origin_ = glm::vec2(0.0f);
+		width_ = depth_ = 0;
+		query_ = 0;
+	}
+
+	void SpatialGrid::Clear(void) {
+		boxes_.clear();
+		large_.clear();
+		cell_start_.clear();
+		cell_boxes_.clear();
+		width_ = depth_ = 0;
+	}
+
+	void SpatialGrid::Insert(glm::vec3 min, glm::vec3 max, int value) {
+		Box box = { min, max, value };
+		boxes_.push_back(box);
+	}
+
+	void SpatialGrid::Build(void) {
+		large_.clear();
+		cell_start_.clear();
+		cell_boxes_.clear();
+		stamp_.assign(boxes_.size(), 0);
+		query_ = 0;
+		width_ = depth_ = 0;
+		if (boxes_.empty()) {
+			return;
+		}
+
+		// Just large enough for every box, with cells grown if it would take too many
+		glm::vec2 low = glm::vec2(boxes_[0].min.x, boxes_[0].min.z);
+		glm::vec2 high = glm::vec2(boxes_[0].max.x, boxes_[0].max.z);
+		for (unsigned int i = 1; i < boxes_.size(); i++) {
+			low = glm::min(low, glm::vec2(boxes_[i].min.x, boxes_[i].min.z));
+			high = glm::max(high, glm::vec2(boxes_[i].max.x, boxes_[i].max.z));
+		}
+		glm::vec2 extent = high - low;
+		cell_size_ = std::max(base_cell_size_, std::max(extent.x, extent.y) / SPATIAL_GRID_MAX_CELLS);
+		origin_ = low;
+		width_ = std::max(1, std::min((int)std::ceil(extent.x / cell_size_), SPATIAL_GRID_MAX_CELLS));
+		depth_ = std::max(1, std::min((int)std::ceil(extent.y / cell_size_), SPATIAL_GRID_MAX_CELLS));
+
+		// Count the boxes of each cell, turn the counts into where each cell ends, then fill
+		// every cell from its end back so the ends become the starts
+		int cells = width_ * depth_;
+		cell_start_.assign(cells + 1, 0);
+		for (unsigned int i = 0; i < boxes_.size(); i++) {
+			int x0, z0, x1, z1;
+			CellRange(boxes_[i], x0, z0, x1, z1);
+			if ((x1 - x0 + 1) * (z1 - z0 + 1) > SPATIAL_GRID_LARGE_BOX) {
+				large_.push_back(i);
+				continue;
+			}
+			for (int z = z0; z <= z1; z++) {
+				for (int x = x0; x <= x1; x++) {
+					cell_start_[z * width_ + x]++;
+				}
+			}
+		}
+		for (int c = 1; c < cells; c++) {
+			cell_start_[c] += cell_start_[c - 1];
+		}
+		cell_start_[cells] = cell_start_[cells - 1];
+		cell_boxes_.resize(cell_start_[cells]);
+
+		// large_ is in insertion order, walk it alongside the boxes to skip them
+		unsigned int next_large = 0;
+		for (unsigned int i = 0; i < boxes_.size(); i++) {
+			if (next_large < large_.size() && large_[next_large] == (int)i) {
+				next_large++;
+				continue;
+			}
+			int x0, z0, x1, z1;
+			CellRange(boxes_[i], x0, z0, x1, z1);
+			for (int z = z0; z <= z1; z++) {
+				for (int x = x0; x <= x1; x++) {
+					cell_boxes_[--cell_start_[z * width_ + x]] = i;
+				}
+			}
+		}
+	}
+
+	void SpatialGrid::QueryRay(Ray r, std::vector<int> &values) {
+		values.clear();
+		if (boxes_.empty()) {
+			return;
+		}
+		query_++;
+
+		for (unsigned int i = 0; i < large_.size(); i++) {
+			values.push_back(boxes_[large_[i]].value);
+		}
+
+		// Where the ray enters the grid on the ground plane, if it does
+		glm::vec3 origin = r.getOrigin();
+		glm::vec3 direction = r.getDirection();
+		float o[2] = { origin.x, origin.z };
+		float d[2] = { direction.x, direction.z };
+		float low[2] = { origin_.x, origin_.y };
+		float high[2] = { origin_.x + width_ * cell_size_, origin_.y + depth_ * cell_size_ };
+		float enter = 0.0f, leave = INFINITY;
+		for (int k = 0; k < 2; k++) {
+			if (d[k] == 0.0f) {
+				if (o[k] < low[k] || o[k] > high[k]) {
+					return;
+				}
+				continue;
+			}
+			float t0 = (low[k] - o[k]) / d[k];
+			float t1 = (high[k] - o[k]) / d[k];
+			enter = std::max(enter, std::min(t0, t1));
+			leave = std::min(leave, std::max(t0, t1));
+		}
+		if (enter > leave) {
+			return;
+		}
+
+		// Walk from cell to cell, always crossing the nearest cell boundary next
+		int size[2] = { width_, depth_ };
+		int cell[2], step[2];
+		float next[2], delta[2];
+		for (int k = 0; k < 2; k++) {
+			float p = (o[k] + d[k] * enter - low[k]) / cell_size_;
+			cell[k] = std::max(0, std::min((int)std::floor(p), size[k] - 1));
+			if (d[k] == 0.0f) {
+				step[k] = 0;
+				next[k] = INFINITY;
+				delta[k] = INFINITY;
+			}
+			else {
+				step[k] = (d[k] > 0.0f) ? 1 : -1;
+				float boundary = low[k] + (cell[k] + (step[k] > 0 ? 1 : 0)) * cell_size_;
+				next[k] = (boundary - o[k]) / d[k];
+				delta[k] = cell_size_ / std::fabs(d[k]);
+			}
+		}
+
+		while (true) {
+			Collect(cell[0], cell[1], values);
+			int k = (next[0] < next[1]) ? 0 : 1;
+			// A vertical ray never leaves its cell
+			if (step[k] == 0 || next[k] > leave) {
+				break;
+			}
+			cell[k] += step[k];
+			if (cell[k] < 0 || cell[k] >= size[k]) {
+				break;
+			}
+			next[k] += delta[k];
+		}
+	}
+
+	void SpatialGrid::QueryBox(glm::vec3 min, glm::vec3 max, std::vector<int> &values) {
+		values.clear();
+		if (boxes_.empty()) {
+			return;
+		}
+		query_++;
+
+		for (unsigned int i = 0; i < large_.size(); i++) {
+			values.push_back(boxes_[large_[i]].value);
+		}
+
+		// Clamping would turn a box off the grid into its edge cells
+		if (max.x < origin_.x || max.z < origin_.y ||
+			min.x > origin_.x + width_ * cell_size_ || min.z > origin_.y + depth_ * cell_size_) {
+			return;
+		}
+		Box box = { min, max, 0 };
+		int x0, z0, x1, z1;
+		CellRange(box, x0, z0, x1, z1);
+		for (int z = z0; z <= z1; z++) {
+			for (int x = x0; x <= x1; x++) {
+				Collect(x, z, values);
+			}
+		}
+	}
+
+	int SpatialGrid::GetBoxes(void) const {
+		return (int)boxes_.size();
+	}
+
+	int SpatialGrid::GetCells(void) const {
+		return width_ * depth_;
+	}
+
+	void SpatialGrid::CellRange(const Box &box, int &x0, int &z0, int &x1, int &z1) const {
+		x0 = std::max(0, std::min((int)std::floor((box.min.x - origin_.x) / cell_size_), width_ - 1));
+		z0 = std::max(0, std::min((int)std::floor((box.min.z - origin_.y) / cell_size_), depth_ - 1));
+		x1 = std::max(0, std::min((int)std::floor((box.max.x - origin_.x) / cell_size_), width_ - 1));
+		z1 = std::max(0, std::min((int)std::floor((box.max.z - origin_.y) / cell_size_), depth_ - 1));
+	}
+
+	void SpatialGrid::Collect(int x, int z, std::vector<int> &values) {
+		int c = z * width_ + x;
+		for (int i = cell_start_[c]; i < cell_start_[c + 1]; i++) {
+			int box = cell_boxes_[i];
+			if (stamp_[box] != query_) {
+				stamp_[box] = query_;
+				values.push_back(boxes_[box].value);
+			}
+		}
+	}
+} // namespace game
@@ -0,0 +1,70 @@
+#ifndef SPATIAL_GRID_H_
+#define SPATIAL_GRID_H_
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include "ray.h"
+
+// Width of a cell on the ground plane, in world units
+#define SPATIAL_GRID_CELL_SIZE 25.0f
+// Cells along each axis at most, the cells grow to cover larger worlds
+#define SPATIAL_GRID_MAX_CELLS 128
+// Boxes over more cells than this are kept out of the cells and returned by every query
+#define SPATIAL_GRID_LARGE_BOX 64
+
+namespace game {
+	// Uniform grid over the x-z plane for ray queries against many boxes. Boxes are inserted,
+	// then Build sorts them into the cells they overlap; a ray walks the cells it crosses,
+	// nearest first, and only the boxes of those cells are worth testing
+	class SpatialGrid {
+	public:
+		SpatialGrid(float cell_size = SPATIAL_GRID_CELL_SIZE);
+
+		// Forget every box, the memory is kept for the next build
+		void Clear(void);
+		// Add the box from min to max, queries return value for it
+		void Insert(glm::vec3 min, glm::vec3 max, int value);
+		// Sort the boxes into cells, call after inserting and before querying
+		void Build(void);
+
+		// Values of the boxes in the cells the ray crosses, each once, nearest cells first
+		// after the boxes too large for the cells
+		void QueryRay(Ray r, std::vector<int> &values);
+		// Values of the boxes in the cells the box from min to max overlaps, each once, after the
+		// boxes too large for the cells
+		void QueryBox(glm::vec3 min, glm::vec3 max, std::vector<int> &values);
+
+		int GetBoxes(void) const;
+		int GetCells(void) const;
+
+	private:
+		struct Box {
+			glm::vec3 min;
+			glm::vec3 max;
+			int value;
+		};
+
+		float base_cell_size_;
+		float cell_size_;
+		glm::vec2 origin_; // Corner of the grid with the lowest x and z
+		int width_, depth_; // Cells along x and z
+		std::vector<Box> boxes_;
+		std::vector<int> large_; // Boxes not in the cells
+
+		// Boxes of cell c are cell_boxes_[cell_start_[c]] up to cell_boxes_[cell_start_[c + 1]]
+		std::vector<int> cell_start_;
+		std::vector<int> cell_boxes_;
+
+		// Query each box was last returned by, so boxes over several cells are returned once
+		std::vector<unsigned int> stamp_;
+		unsigned int query_;
+
+		// Cells covered by box, clamped to the grid
+		void CellRange(const Box &box, int &x0, int &z0, int &x1, int &z1) const;
+		// Append the boxes of cell (x, z) that this query didn't return yet
+		void Collect(int x, int z, std::vector<int> &values);
+	}; // class SpatialGrid
+} // namespace game
+#endif // SPATIAL_GRID_H_
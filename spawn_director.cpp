@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include "spawn_director.h"
+
+namespace game {
+	// Random number in [low, high]
+	static float random_between(float low, float high) {
+		return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+	}
+
+	SpawnDirector::SpawnDirector(void) {
+		ground_ = NULL;
+		factory_ = NULL;
+		min_ = glm::vec3(0.0);
+		max_ = glm::vec3(0.0);
+		spawns_per_step_ = SPAWN_DIRECTOR_SPAWNS_PER_STEP;
+		builds_per_step_ = SPAWN_DIRECTOR_BUILDS_PER_STEP;
+		wave_interval_ = SPAWN_DIRECTOR_WAVE_INTERVAL;
+		wave_size_ = SPAWN_DIRECTOR_WAVE_SIZE;
+		since_wave_ = 0.0;
+		queue_head_ = 0;
+		check_ = 0;
+		spawned_ = 0;
+		despawned_ = 0;
+	}
+
+	SpawnDirector::~SpawnDirector() {
+		Clear();
+	}
+
+	void SpawnDirector::Init(Terrain *ground, EnemyFactory *factory) {
+		if (!ground || !factory) {
+			throw(std::invalid_argument(std::string("Spawn director needs a terrain and an enemy factory")));
+		}
+		Clear();
+		ground_ = ground;
+		factory_ = factory;
+		spawned_ = 0;
+		despawned_ = 0;
+		since_wave_ = 0.0;
+
+		for (int kind = MoleSpawn; kind <= DogSpawn; kind++) {
+			while (ready_[kind].size() < SPAWN_DIRECTOR_READY_SIZE) {
+				ready_[kind].push_back(factory_->CreateEnemy((SpawnKind)kind));
+			}
+		}
+	}
+
+	void SpawnDirector::SetBounds(glm::vec3 min, glm::vec3 max) {
+		min_ = min;
+		max_ = max;
+	}
+
+	void SpawnDirector::SetBudget(int spawns_per_step, int builds_per_step) {
+		if (spawns_per_step < 1 || builds_per_step < 1) {
+			throw(std::invalid_argument(std::string("Invalid spawn budget")));
+		}
+		spawns_per_step_ = spawns_per_step;
+		builds_per_step_ = builds_per_step;
+	}
+
+	void SpawnDirector::SetWaves(double interval, int size) {
+		wave_interval_ = interval;
+		wave_size_ = size;
+		since_wave_ = 0.0;
+	}
+
+	void SpawnDirector::Queue(SpawnKind kind, int count) {
+		for (int i = 0; i < count; i++) {
+			queue_.push_back(kind);
+		}
+	}
+
+	void SpawnDirector::QueueRandom(int count) {
+		for (int i = 0; i < count; i++) {
+			queue_.push_back(RandomKind());
+		}
+	}
+
+	void SpawnDirector::Update(double delta_time) {
+		if (!ground_) {
+			return;
+		}
+
+		if (wave_interval_ > 0.0) {
+			since_wave_ += delta_time;
+			if (since_wave_ >= wave_interval_) {
+				QueueRandom(wave_size_);
+				since_wave_ = 0.0;
+			}
+		}
+
+		// Place queued enemies from the ready ones, an enemy of a kind with none ready waits for a build
+		int spawns = 0;
+		while (spawns < spawns_per_step_ && queue_head_ < queue_.size()) {
+			SpawnKind kind = queue_[queue_head_];
+			if (ready_[kind].empty()) {
+				break;
+			}
+			SceneNode *entity = ready_[kind].back();
+			ready_[kind].pop_back();
+			Place(entity, kind);
+			queue_head_++;
+			spawns++;
+		}
+		if (queue_head_ == queue_.size()) {
+			queue_.clear();
+			queue_head_ = 0;
+		}
+
+		// Build enemies ahead of time, the kind needed next first
+		int builds = 0;
+		if (queue_head_ < queue_.size()) {
+			SpawnKind next = queue_[queue_head_];
+			while (builds < builds_per_step_ && ready_[next].size() < SPAWN_DIRECTOR_READY_SIZE) {
+				ready_[next].push_back(factory_->CreateEnemy(next));
+				builds++;
+			}
+		}
+		for (int kind = MoleSpawn; kind <= DogSpawn && builds < builds_per_step_; kind++) {
+			while (builds < builds_per_step_ && ready_[kind].size() < SPAWN_DIRECTOR_READY_SIZE) {
+				ready_[kind].push_back(factory_->CreateEnemy((SpawnKind)kind));
+				builds++;
+			}
+		}
+
+		// The scene removes destroyed enemies, and the laser those it hits. A few are checked each step
+		// to delete those out of the scene
+		for (int i = 0; i < SPAWN_DIRECTOR_CHECKS_PER_STEP && !alive_.empty(); i++) {
+			if (check_ >= alive_.size()) {
+				check_ = 0;
+			}
+			if (alive_[check_]->parent_ == NULL) {
+				SceneNode::DeleteTree(alive_[check_]);
+				alive_[check_] = alive_.back();
+				alive_.pop_back();
+				despawned_++;
+			}
+			else {
+				check_++;
+			}
+		}
+	}
+
+	void SpawnDirector::Clear(void) {
+		for (int kind = MoleSpawn; kind <= DogSpawn; kind++) {
+			for (unsigned int i = 0; i < ready_[kind].size(); i++) {
+				SceneNode::DeleteTree(ready_[kind][i]);
+			}
+			ready_[kind].clear();
+		}
+		// Those still in the scene belong to it
+		for (unsigned int i = 0; i < alive_.size(); i++) {
+			if (alive_[i]->parent_ == NULL) {
+				SceneNode::DeleteTree(alive_[i]);
+			}
+		}
+		alive_.clear();
+		check_ = 0;
+		queue_.clear();
+		queue_head_ = 0;
+	}
+
+	int SpawnDirector::GetAlive(void) const {
+		return (int)alive_.size();
+	}
+
+	long SpawnDirector::GetSpawned(void) const {
+		return spawned_;
+	}
+
+	long SpawnDirector::GetDespawned(void) const {
+		return despawned_;
+	}
+
+	int SpawnDirector::GetQueued(void) const {
+		return (int)(queue_.size() - queue_head_);
+	}
+
+	void SpawnDirector::Place(SceneNode *entity, SpawnKind kind) {
+		float x = random_between(min_.x, max_.x);
+		float z = random_between(min_.z, max_.z);
+		float y = ground_->GetHeight(x, z);
+		if (kind == CatSpawn) {
+			y = random_between(y, std::max(y, max_.y));
+		}
+		entity->SetPosition(x, y, z);
+		ground_->AddChild(entity);
+		alive_.push_back(entity);
+		spawned_++;
+	}
+
+	SpawnKind SpawnDirector::RandomKind(void) const {
+		float v = (double)rand() / (double)RAND_MAX;
+		if (v > 0.6) {
+			return MoleSpawn;
+		}
+		else if (v > 0.3) {
+			return CatSpawn;
+		}
+		return DogSpawn;
+	}
+} // namespace game
@@ -0,0 +1,98 @@
+#ifndef SPAWN_DIRECTOR_H_
+#define SPAWN_DIRECTOR_H_
+#include <vector>
+#include "scene_node.h"
+#include "terrain.h"
+
+// Enemies of each kind kept built and waiting to be placed
+#define SPAWN_DIRECTOR_READY_SIZE 8
+// Enemies placed in the scene per step at most, the rest of a wave waits for the next steps
+#define SPAWN_DIRECTOR_SPAWNS_PER_STEP 2
+// Enemies built ahead of time per step at most
+#define SPAWN_DIRECTOR_BUILDS_PER_STEP 1
+// Spawned enemies checked for being out of the scene per step
+#define SPAWN_DIRECTOR_CHECKS_PER_STEP 256
+// Seconds between two waves, and enemies in a wave
+#define SPAWN_DIRECTOR_WAVE_INTERVAL 20.0
+#define SPAWN_DIRECTOR_WAVE_SIZE 10
+
+namespace game {
+	enum SpawnKind { MoleSpawn, CatSpawn, DogSpawn };
+
+	// Builds the enemies a SpawnDirector spawns
+	class EnemyFactory {
+	public:
+		virtual ~EnemyFactory() {}
+		// A new entity holding one enemy of kind, not yet in the scene
+		virtual SceneNode *CreateEnemy(SpawnKind kind) = 0;
+	};
+
+	// Decides when enemies enter the scene and spreads the work over the steps. A few enemies of each
+	// kind are built ahead of time, and each step places at most a few of the queued ones on the
+	// terrain and builds at most a few to replace them, so a large wave costs the same per step as a
+	// small one, it just takes longer to arrive. Enemies are not reused, those the scene removed
+	// are deleted
+	class SpawnDirector {
+	public:
+		SpawnDirector(void);
+		~SpawnDirector();
+
+		// Spawn into the children of ground, built by factory. Builds the ready enemies of every kind
+		// at once, at load
+		void Init(Terrain *ground, EnemyFactory *factory);
+		// Corners of the area enemies are placed in, relative to the ground. Cats fly anywhere
+		// between the terrain and the top of the area
+		void SetBounds(glm::vec3 min, glm::vec3 max);
+		// Enemies placed and built per step at most
+		void SetBudget(int spawns_per_step, int builds_per_step);
+		// Queue a wave of size enemies every interval seconds, 0 stops the waves
+		void SetWaves(double interval, int size);
+
+		// Spawn count enemies of kind over the next steps
+		void Queue(SpawnKind kind, int count);
+		// Count enemies of random kinds: moles, cats and dogs in the proportions of the first level
+		void QueueRandom(int count);
+
+		// Spend this step's budget on the queue and the ready enemies, and delete the removed ones
+		void Update(double delta_time);
+
+		// Delete the ready enemies and the removed ones and forget the queue, before the resources
+		// they use are
+		void Clear(void);
+
+		// Enemies spawned by the director and not yet deleted, as of the last check
+		int GetAlive(void) const;
+		// Enemies placed in the scene and found destroyed, since Init
+		long GetSpawned(void) const;
+		long GetDespawned(void) const;
+		// Enemies queued and not yet placed
+		int GetQueued(void) const;
+
+	private:
+		Terrain *ground_;
+		EnemyFactory *factory_;
+		glm::vec3 min_, max_;
+		int spawns_per_step_;
+		int builds_per_step_;
+		double wave_interval_;
+		int wave_size_;
+		double since_wave_;
+
+		std::vector<SceneNode *> ready_[DogSpawn + 1]; // Built and not yet placed
+		std::vector<SpawnKind> queue_; // Kinds to spawn, oldest first from queue_head_
+		size_t queue_head_;
+
+		std::vector<SceneNode *> alive_;
+		size_t check_; // Next entity of alive_ to check
+		long spawned_;
+		long despawned_;
+
+		// Place entity of kind somewhere on the terrain and add it to the scene
+		void Place(SceneNode *entity, SpawnKind kind);
+		SpawnKind RandomKind(void) const;
+
+		SpawnDirector(const SpawnDirector &);
+		SpawnDirector &operator=(const SpawnDirector &);
+	}; // class SpawnDirector
+} // namespace game
+#endif // SPAWN_DIRECTOR_H_
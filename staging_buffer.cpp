@@ -0,0 +1,108 @@
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+#include <string>
+#include "staging_buffer.h"
+#include "gpu_counters.h"
+
+namespace game {
+	StagingBuffer::StagingBuffer(size_t capacity) {
+		capacity_ = capacity;
+		buffer_ = 0;
+		mapped_ = NULL;
+		offset_ = 0;
+		uploads_ = 0;
+		flushes_ = 0;
+	}
+
+	StagingBuffer::~StagingBuffer() {
+		Clear();
+	}
+
+	void StagingBuffer::Clear(void) {
+		if (buffer_) {
+			glDeleteBuffers(1, &buffer_);
+			buffer_ = 0;
+		}
+		mapped_ = NULL;
+		offset_ = 0;
+		pending_.clear();
+	}
+
+	void StagingBuffer::Upload(GLuint buffer, const void *data, size_t size) {
+		uploads_++;
+
+		// Too large to stage, upload it directly
+		if (size > capacity_) {
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+			GpuCounters::CountBufferUpload();
+			return;
+		}
+
+		if (offset_ + size > capacity_) {
+			Flush();
+		}
+
+		// Map the whole staging area, dropping what it held before
+		if (!mapped_) {
+			if (!buffer_) {
+				glGenBuffers(1, &buffer_);
+				glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+				glBufferData(GL_COPY_READ_BUFFER, capacity_, NULL, GL_STREAM_DRAW);
+			}
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+			mapped_ = (char *)glMapBufferRange(GL_COPY_READ_BUFFER, 0, capacity_, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (!mapped_) {
+				throw(std::ios_base::failure(std::string("Error mapping the staging buffer")));
+			}
+			offset_ = 0;
+		}
+
+		memcpy(mapped_ + offset_, data, size);
+
+		// Allocate the destination now, it is filled when the staging area is unmapped
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+		PendingCopy copy = { buffer, offset_, size };
+		pending_.push_back(copy);
+
+		// Keep every copy 16-byte aligned
+		offset_ += (size + 15) & ~(size_t)15;
+	}
+
+	void StagingBuffer::Flush(void) {
+		if (!mapped_) {
+			return;
+		}
+
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+		if (glUnmapBuffer(GL_COPY_READ_BUFFER) != GL_TRUE) {
+			// The contents were lost (e.g. the display mode changed), the copies would read garbage
+			mapped_ = NULL;
+			pending_.clear();
+			throw(std::ios_base::failure(std::string("Error unmapping the staging buffer")));
+		}
+		mapped_ = NULL;
+
+		for (unsigned int i = 0; i < pending_.size(); i++) {
+			glBindBuffer(GL_COPY_WRITE_BUFFER, pending_[i].buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, pending_[i].offset, 0, pending_[i].size);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+		GpuCounters::CountBufferUpload();
+		pending_.clear();
+		offset_ = 0;
+		flushes_++;
+	}
+
+	int StagingBuffer::GetUploads(void) const {
+		return uploads_;
+	}
+
+	int StagingBuffer::GetFlushes(void) const {
+		return flushes_;
+	}
+} // namespace game
@@ -0,0 +1,50 @@
+#ifndef STAGING_BUFFER_H_
+#define STAGING_BUFFER_H_
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// Default size of the staging area, in bytes
+#define STAGING_BUFFER_CAPACITY (4 * 1024 * 1024)
+
+namespace game {
+	// Collects the contents of many static buffers in one mapped buffer, then copies them
+	// to their destinations on the GPU at once, instead of one glBufferData per buffer
+	class StagingBuffer {
+	public:
+		StagingBuffer(size_t capacity = STAGING_BUFFER_CAPACITY);
+		~StagingBuffer();
+
+		// Give buffer size bytes of static storage filled with data. The contents only
+		// arrive on Flush, or earlier if the staging area runs out of space
+		void Upload(GLuint buffer, const void *data, size_t size);
+		// Copy every pending upload to its buffer
+		void Flush(void);
+		// Delete the staging area, call while the GL context still exists
+		void Clear(void);
+
+		// Buffers filled and copies issued so far
+		int GetUploads(void) const;
+		int GetFlushes(void) const;
+
+	private:
+		// A copy waiting for the staging area to be unmapped
+		struct PendingCopy {
+			GLuint buffer;
+			size_t offset;
+			size_t size;
+		};
+
+		size_t capacity_;
+		GLuint buffer_;
+		char *mapped_; // Write pointer of the staging area while it is mapped, NULL otherwise
+		size_t offset_;
+		std::vector<PendingCopy> pending_;
+		int uploads_;
+		int flushes_;
+
+		StagingBuffer(const StagingBuffer &);
+		StagingBuffer &operator=(const StagingBuffer &);
+	}; // class StagingBuffer
+} // namespace game
+#endif // STAGING_BUFFER_H_
@@ -0,0 +1,349 @@
+#include <stdexcept>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include "telemetry.h"
+#include "gpu_counters.h"
+#include "scene_node.h"
+
+namespace game {
+	// Counted by the allocation functions below, on whatever thread allocates
+	static std::atomic<long> allocations_g(0);
+	static std::atomic<long> allocated_bytes_g(0);
+
+	// Names of the phases, as CSV columns
+	static const char *phase_names_g[PresentPhase + 1] = { "stream_ms", "update_ms", "draw_ms", "present_ms" };
+
+	Telemetry::Telemetry(void) : frames_(TELEMETRY_FRAMES) {
+		count_ = 0;
+		current_ = TelemetryFrame();
+		for (int p = 0; p <= PresentPhase; p++) {
+			phase_start_[p] = 0.0;
+		}
+		allocations_ = 0;
+		allocated_bytes_ = 0;
+		overlay_ = false;
+		profiler_ = NULL;
+	}
+
+	Telemetry::~Telemetry() {}
+
+	void Telemetry::Init(GpuProfiler *profiler) {
+		profiler_ = profiler;
+	}
+
+	void Telemetry::BeginFrame(void) {
+		current_ = TelemetryFrame();
+		current_.time = glfwGetTime();
+		for (int p = 0; p <= HelicopterPass; p++) {
+			current_.gpu_ms[p] = -1.0;
+		}
+		allocations_ = allocations_g;
+		allocated_bytes_ = allocated_bytes_g;
+		if (profiler_) {
+			profiler_->BeginFrame();
+		}
+	}
+
+	void Telemetry::EndFrame(void) {
+		current_.frame_ms = (float)((glfwGetTime() - current_.time) * 1000.0);
+		GpuDraws draws = GpuCounters::GetLastFrameDraws();
+		current_.draw_calls = draws.draw_calls;
+		current_.triangles = draws.triangles;
+		current_.uploads = GpuCounters::GetLastFrame().Total();
+		current_.nodes = SceneNode::GetLiveCount();
+		current_.allocations = allocations_g - allocations_;
+		current_.allocated_bytes = allocated_bytes_g - allocated_bytes_;
+
+		frames_[count_ % TELEMETRY_FRAMES] = current_;
+		count_++;
+
+		// The GPU times come a few frames late, into the frame they are of if it is still kept
+		if (profiler_) {
+			profiler_->EndFrame();
+			long frame = profiler_->GetMeasuredFrame();
+			if (profiler_->HasNewResults() && frame >= count_ - TELEMETRY_FRAMES) {
+				for (int p = 0; p <= HelicopterPass; p++) {
+					frames_[frame % TELEMETRY_FRAMES].gpu_ms[p] = profiler_->GetTime((GpuPass)p);
+				}
+			}
+		}
+	}
+
+	void Telemetry::BeginPhase(TelemetryPhase phase) {
+		phase_start_[phase] = glfwGetTime();
+	}
+
+	void Telemetry::EndPhase(TelemetryPhase phase) {
+		current_.phase_ms[phase] += (float)((glfwGetTime() - phase_start_[phase]) * 1000.0);
+	}
+
+	long Telemetry::GetFrameCount(void) const {
+		return count_;
+	}
+
+	const TelemetryFrame &Telemetry::GetFrame(int age) const {
+		if (age < 0 || age >= TELEMETRY_FRAMES || age >= count_) {
+			throw(std::invalid_argument(std::string("Frame not recorded")));
+		}
+		return frames_[(count_ - 1 - age) % TELEMETRY_FRAMES];
+	}
+
+	void Telemetry::SetOverlay(bool overlay) {
+		overlay_ = overlay;
+	}
+
+	bool Telemetry::IsOverlay(void) const {
+		return overlay_;
+	}
+
+	void Telemetry::GetGraph(std::vector<glm::vec2> &graph, float max_ms) const {
+		graph.clear();
+		if (!overlay_) {
+			return;
+		}
+		// Frames not yet recorded are empty columns on the left
+		graph.resize(TELEMETRY_GRAPH_COLUMNS, glm::vec2(0.0));
+		for (int age = 0; age < TELEMETRY_GRAPH_COLUMNS && age < count_; age++) {
+			const TelemetryFrame &frame = GetFrame(age);
+			graph[TELEMETRY_GRAPH_COLUMNS - 1 - age] = glm::vec2(frame.frame_ms / max_ms, frame.gpu_ms[FramePass] / max_ms);
+		}
+	}
+
+	void Telemetry::WriteCsv(const std::string &filename) const {
+		std::ofstream f(filename.c_str());
+		if (!f) {
+			throw(std::ios_base::failure(std::string("Error opening telemetry file ") + filename));
+		}
+		f.precision(9);
+		f << "frame,time,frame_ms";
+		for (int p = 0; p <= PresentPhase; p++) {
+			f << "," << phase_names_g[p];
+		}
+		for (int p = 0; p <= HelicopterPass; p++) {
+			f << ",gpu_" << GpuProfiler::GetName((GpuPass)p) << "_ms";
+		}
+		f << ",draw_calls,triangles,uploads,nodes,allocations,allocated_bytes\n";
+
+		long first = (count_ > TELEMETRY_FRAMES) ? count_ - TELEMETRY_FRAMES : 0;
+		for (long i = first; i < count_; i++) {
+			const TelemetryFrame &frame = frames_[i % TELEMETRY_FRAMES];
+			f << i << "," << frame.time << "," << frame.frame_ms;
+			for (int p = 0; p <= PresentPhase; p++) {
+				f << "," << frame.phase_ms[p];
+			}
+			// Left empty when the GPU time never came back
+			for (int p = 0; p <= HelicopterPass; p++) {
+				f << ",";
+				if (frame.gpu_ms[p] >= 0.0) {
+					f << frame.gpu_ms[p];
+				}
+			}
+			f << "," << frame.draw_calls << "," << frame.triangles << "," << frame.uploads << "," << frame.nodes << ","
+				<< frame.allocations << "," << frame.allocated_bytes << "\n";
+		}
+		f.close();
+		if (!f) {
+			throw(std::ios_base::failure(std::string("Error writing telemetry file ") + filename));
+		}
+	}
+
+	void Telemetry::Report(std::ostream &out) const {
+		int frames = (int)std::min(count_, (long)TELEMETRY_FRAMES);
+		if (frames == 0) {
+			return;
+		}
+		float frame_sum = 0.0, frame_max = 0.0;
+		float phase_sum[PresentPhase + 1] = { 0 }, phase_max[PresentPhase + 1] = { 0 };
+		float pass_sum[HelicopterPass + 1] = { 0 }, pass_max[HelicopterPass + 1] = { 0 };
+		int pass_frames[HelicopterPass + 1] = { 0 };
+		int upload_frames = 0, uploads = 0;
+		for (int age = 0; age < frames; age++) {
+			const TelemetryFrame &frame = GetFrame(age);
+			frame_sum += frame.frame_ms;
+			frame_max = std::max(frame_max, frame.frame_ms);
+			for (int p = 0; p <= PresentPhase; p++) {
+				phase_sum[p] += frame.phase_ms[p];
+				phase_max[p] = std::max(phase_max[p], frame.phase_ms[p]);
+			}
+			if (frame.uploads > 0) {
+				upload_frames++;
+				uploads += frame.uploads;
+			}
+			// Only the frames the GPU time came back for
+			for (int p = 0; p <= HelicopterPass; p++) {
+				if (frame.gpu_ms[p] >= 0.0) {
+					pass_sum[p] += frame.gpu_ms[p];
+					pass_max[p] = std::max(pass_max[p], frame.gpu_ms[p]);
+					pass_frames[p]++;
+				}
+			}
+		}
+
+		out << "Last " << frames << " frames: " << frame_sum / frames << " ms on average, slowest " << frame_max << " ms" << std::endl;
+		out << "CPU:";
+		for (int p = 0; p <= PresentPhase; p++) {
+			out << " " << phase_names_g[p] << " " << phase_sum[p] / frames << " (" << phase_max[p] << ")";
+		}
+		out << std::endl << "GPU:";
+		for (int p = 0; p <= HelicopterPass; p++) {
+			out << " " << GpuProfiler::GetName((GpuPass)p) << " ";
+			if (pass_frames[p] > 0) {
+				out << pass_sum[p] / pass_frames[p] << " ms (" << pass_max[p] << ")";
+			}
+			else {
+				out << "unknown";
+			}
+		}
+		out << std::endl;
+		if (upload_frames > 0) {
+			out << upload_frames << " frames uploaded to the GPU, " << uploads << " uploads" << std::endl;
+		}
+	}
+
+	long Telemetry::GetAllocations(void) {
+		return allocations_g;
+	}
+
+	long Telemetry::GetAllocatedBytes(void) {
+		return allocated_bytes_g;
+	}
+} // namespace game
+
+// Every allocation of the program goes through these, to be counted: plain, array, nothrow, sized
+// and over-aligned forms alike, so none falls back to an uncounted library version
+namespace game {
+	// Count an allocation of size bytes and make it, NULL when out of memory
+	static void *counted_alloc(std::size_t size) {
+		allocations_g++;
+		allocated_bytes_g += (long)size;
+		return std::malloc(size ? size : 1);
+	}
+
+	static void *counted_alloc_or_throw(std::size_t size) {
+		void *p = counted_alloc(size);
+		if (!p) {
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+
+#ifdef __cpp_aligned_new
+	// Same for alignments above what malloc guarantees, freed by aligned_free
+	static void *counted_aligned_alloc(std::size_t size, std::align_val_t alignment) {
+		allocations_g++;
+		allocated_bytes_g += (long)size;
+#ifdef _WIN32
+		return _aligned_malloc(size ? size : 1, (std::size_t)alignment);
+#else
+		void *p = NULL;
+		if (posix_memalign(&p, std::max((std::size_t)alignment, sizeof(void *)), size ? size : 1) != 0) {
+			return NULL;
+		}
+		return p;
+#endif
+	}
+
+	static void *counted_aligned_alloc_or_throw(std::size_t size, std::align_val_t alignment) {
+		void *p = counted_aligned_alloc(size, alignment);
+		if (!p) {
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+
+	static void aligned_free(void *p) {
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+#endif
+} // namespace game
+
+void *operator new(std::size_t size) {
+	return game::counted_alloc_or_throw(size);
+}
+
+void *operator new[](std::size_t size) {
+	return game::counted_alloc_or_throw(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+	return game::counted_alloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+	return game::counted_alloc(size);
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+	std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+	std::free(p);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+void *operator new(std::size_t size, std::align_val_t alignment) {
+	return game::counted_aligned_alloc_or_throw(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+	return game::counted_aligned_alloc_or_throw(size, alignment);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	return game::counted_aligned_alloc(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	return game::counted_aligned_alloc(size, alignment);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+	game::aligned_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+	game::aligned_free(p);
+}
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+	game::aligned_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+	game::aligned_free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+	game::aligned_free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+	game::aligned_free(p);
+}
+#endif
@@ -0,0 +1,90 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+#include <string>
+#include <vector>
+#include <ostream>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include "gpu_profiler.h"
+
+// Frames kept, the oldest are overwritten
+#define TELEMETRY_FRAMES 4096
+// Frames shown by the overlay graph, the size of the graph uniform of the screen-space shader
+#define TELEMETRY_GRAPH_COLUMNS 128
+
+namespace game {
+	// Parts of a frame timed on the CPU
+	enum TelemetryPhase { StreamPhase, UpdatePhase, DrawPhase, PresentPhase };
+
+	// What one frame cost
+	struct TelemetryFrame {
+		double time; // Seconds since GLFW started, at the start of the frame
+		float frame_ms;
+		float phase_ms[PresentPhase + 1];
+		float gpu_ms[HelicopterPass + 1]; // GPU time of each pass, -1 until it is known
+		int draw_calls;
+		long triangles;
+		int uploads; // Buffer, texture and mipmap uploads, a frame that only draws makes none
+		int nodes; // Scene nodes alive
+		long allocations; // Allocations made during the frame, on every thread
+		long allocated_bytes;
+	};
+
+	// Records the CPU time of every phase of a frame, the GPU time of every pass, the draw calls and
+	// triangles, the scene nodes alive and the allocations into a ring of the last TELEMETRY_FRAMES
+	// frames, to graph over the game, report and write out as CSV
+	class Telemetry {
+	public:
+		Telemetry(void);
+		~Telemetry();
+
+		// Take the GPU times from profiler, whose frames Telemetry begins and ends. Without it the
+		// GPU times stay unknown
+		void Init(GpuProfiler *profiler);
+
+		// Bracket a frame, EndFrame after the buffers are swapped
+		void BeginFrame(void);
+		void EndFrame(void);
+		// Bracket a phase of the frame, the time of a phase run several times adds up
+		void BeginPhase(TelemetryPhase phase);
+		void EndPhase(TelemetryPhase phase);
+
+		// Frames recorded so far, including those overwritten
+		long GetFrameCount(void) const;
+		// Frame age frames before the last one recorded, age below TELEMETRY_FRAMES and GetFrameCount()
+		const TelemetryFrame &GetFrame(int age) const;
+
+		// Show the overlay graph
+		void SetOverlay(bool overlay);
+		bool IsOverlay(void) const;
+		// Frame time (x) and GPU time (y) of the last TELEMETRY_GRAPH_COLUMNS frames as a fraction of
+		// max_ms, oldest first, empty when the overlay is hidden
+		void GetGraph(std::vector<glm::vec2> &graph, float max_ms) const;
+
+		// Write every frame kept, oldest first, throws if filename can't be written
+		void WriteCsv(const std::string &filename) const;
+		// Print the average and slowest time of every CPU phase and GPU pass over the frames kept, and the
+		// frames among them that uploaded to the GPU
+		void Report(std::ostream &out) const;
+
+		// Allocations made by the program so far, on every thread
+		static long GetAllocations(void);
+		static long GetAllocatedBytes(void);
+
+	private:
+		std::vector<TelemetryFrame> frames_;
+		long count_; // Frames recorded, the next one goes to count_ % TELEMETRY_FRAMES
+		TelemetryFrame current_;
+		double phase_start_[PresentPhase + 1];
+		long allocations_; // Allocation counters at the start of the frame
+		long allocated_bytes_;
+		bool overlay_;
+		GpuProfiler *profiler_;
+
+		Telemetry(const Telemetry &);
+		Telemetry &operator=(const Telemetry &);
+	}; // class Telemetry
+} // namespace game
+#endif // TELEMETRY_H_
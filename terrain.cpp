@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "terrain.h"
+#include "gpu_counters.h"
+
+namespace game {
+	float TerrainData::GetHeight(float x, float z) const {
+		// Position in heightmap samples, kept inside the map
+		float u = glm::clamp(x / spacing, 0.0f, (float)(rows - 1));
+		float v = glm::clamp(z / spacing, 0.0f, (float)(cols - 1));
+		int i = std::min((int)u, rows - 2);
+		int j = std::min((int)v, cols - 2);
+		u -= i;
+		v -= j;
+
+		// Interpolate on the same triangle the terrain mesh uses for this quad
+		float h00 = heights[i * cols + j];
+		float h01 = heights[i * cols + j + 1];
+		float h10 = heights[(i + 1) * cols + j];
+		float h11 = heights[(i + 1) * cols + j + 1];
+		if (u + v <= 1.0f) {
+			return h00 + u * (h10 - h00) + v * (h01 - h00);
+		}
+		return h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+	}
+
+	Terrain::Terrain(const std::string name, const Resource *geometry, const Resource *material)
+		: SceneNode(name, geometry, material) {
+		data_ = geometry ? geometry->GetTerrain() : NULL;
+		max_pixel_error_ = 2.0;
+		tiles_drawn_ = 0;
+		triangles_drawn_ = 0;
+	}
+
+	Terrain::~Terrain() {}
+
+	float Terrain::GetHeight(float x, float z) const {
+		if (!data_) {
+			return 0.0;
+		}
+		return data_->GetHeight(x, z);
+	}
+
+	void Terrain::SetMaxPixelError(float error) {
+		max_pixel_error_ = error;
+	}
+
+	float Terrain::GetMaxPixelError(void) const {
+		return max_pixel_error_;
+	}
+
+	int Terrain::GetTilesDrawn(void) const {
+		return tiles_drawn_;
+	}
+
+	int Terrain::GetTrianglesDrawn(void) const {
+		return triangles_drawn_;
+	}
+
+	glm::mat4 Terrain::Draw(Camera *camera, glm::mat4 parent_transf, bool sun) {
+		if (!data_ || (array_buffer_ == 0) || (material_ == 0)) {
+			return SceneNode::Draw(camera, parent_transf, sun);
+		}
+
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+
+		// Select proper material (shader program)
+		glUseProgram(material_);
+
+		// Set geometry to draw
+		glBindBuffer(GL_ARRAY_BUFFER, array_buffer_);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_array_buffer_);
+
+		// Set world matrix and other shader input variables
+		glm::mat4 transf = SetupShader(material_, parent_transf, sun);
+		glm::mat4 local_transf = transf * glm::scale(glm::mat4(1.0), scale_);
+
+		// Extract the frustum planes in terrain space from the combined matrix
+		// Note that in glm, the reference for matrix entries is of the form: matrix[column][row]
+		glm::mat4 clip = camera->GetProjectionMatrix() * camera->GetViewMatrix() * local_transf;
+		glm::vec4 planes[6];
+		for (int k = 0; k < 3; k++) {
+			for (int c = 0; c < 4; c++) {
+				planes[k * 2][c] = clip[c][3] + clip[c][k];
+				planes[k * 2 + 1][c] = clip[c][3] - clip[c][k];
+			}
+		}
+
+		// Camera position in terrain space, for the distance to each tile
+		glm::vec4 eye = glm::inverse(local_transf) * glm::vec4(camera->GetViewPosition(), 1.0);
+		glm::vec3 eye_pos = glm::vec3(eye.x, eye.y, eye.z);
+		float projection_scale = camera->GetProjectionScale();
+
+		tiles_drawn_ = 0;
+		triangles_drawn_ = 0;
+		for (unsigned int t = 0; t < data_->tiles.size(); t++) {
+			const TerrainTile &tile = data_->tiles[t];
+
+			// Skip the tile if its box is completely outside one of the planes
+			bool visible = true;
+			for (int p = 0; p < 6 && visible; p++) {
+				glm::vec3 corner(planes[p].x >= 0 ? tile.max_corner.x : tile.min_corner.x,
+					planes[p].y >= 0 ? tile.max_corner.y : tile.min_corner.y,
+					planes[p].z >= 0 ? tile.max_corner.z : tile.min_corner.z);
+				if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0) {
+					visible = false;
+				}
+			}
+			if (!visible) {
+				continue;
+			}
+
+			// Distance from the camera to the closest point of the tile
+			glm::vec3 closest = glm::clamp(eye_pos, tile.min_corner, tile.max_corner);
+			float distance = glm::length(closest - eye_pos);
+
+			// Coarsest level whose error covers no more than max_pixel_error_ pixels
+			int lod = 0;
+			if (distance > 0) {
+				for (int l = TERRAIN_LOD_LEVELS - 1; l > 0; l--) {
+					if (tile.error[l] * projection_scale / distance <= max_pixel_error_) {
+						lod = l;
+						break;
+					}
+				}
+			}
+
+			glDrawElements(GL_TRIANGLES, tile.count[lod], GL_UNSIGNED_INT, (void *)(tile.first[lod] * sizeof(GLuint)));
+			tiles_drawn_++;
+			triangles_drawn_ += tile.count[lod] / 3;
+			GpuCounters::CountDraw(tile.count[lod] / 3);
+		}
+
+		return transf;
+	}
+} // namespace game
@@ -0,0 +1,66 @@
+#ifndef TERRAIN_H_
+#define TERRAIN_H_
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include "scene_node.h"
+
+// Number of heightmap quads along each side of a terrain tile
+#define TERRAIN_TILE_SIZE 32
+// Number of detail levels per tile, level l samples every 2^l heightmap texels
+#define TERRAIN_LOD_LEVELS 5
+
+namespace game {
+	// One square patch of the terrain, with an index range for every level of detail
+	struct TerrainTile {
+		glm::vec3 min_corner; // Bounds of the tile (skirts included) in terrain space
+		glm::vec3 max_corner;
+		GLuint first[TERRAIN_LOD_LEVELS]; // Offset of the level in the element buffer, in indices
+		GLsizei count[TERRAIN_LOD_LEVELS]; // Number of indices of the level
+		float error[TERRAIN_LOD_LEVELS]; // Largest height difference between the level and the full heightmap
+	};
+
+	// Heightfield and tile layout shared by all nodes that draw a terrain resource
+	struct TerrainData {
+		int rows; // Heightmap samples along x
+		int cols; // Heightmap samples along z
+		float spacing; // Distance between two samples
+		std::vector<float> heights; // rows * cols heights, row major
+		std::vector<TerrainTile> tiles;
+
+		// Height of the surface at (x, z) in terrain space, clamped to the edges of the map
+		float GetHeight(float x, float z) const;
+	};
+
+	// Scene node that draws a tiled terrain, choosing a level of detail per tile every frame
+	class Terrain : public SceneNode {
+	public:
+		Terrain(const std::string name, const Resource *geometry, const Resource *material);
+		~Terrain();
+
+		// Cull tiles against the view frustum and draw each visible one at the coarsest
+		// level whose projected error stays under the pixel threshold
+		glm::mat4 Draw(Camera *camera, glm::mat4 parent_transf, bool sun);
+
+		// Height of the ground at (x, z), both given relative to this node
+		float GetHeight(float x, float z) const;
+
+		// Largest screen-space error, in pixels, allowed when picking a level of detail
+		void SetMaxPixelError(float error);
+		float GetMaxPixelError(void) const;
+
+		// Statistics of the last draw
+		int GetTilesDrawn(void) const;
+		int GetTrianglesDrawn(void) const;
+
+	private:
+		const TerrainData *data_;
+		float max_pixel_error_;
+		int tiles_drawn_;
+		int triangles_drawn_;
+	}; // class Terrain
+} // namespace game
+#endif // TERRAIN_H_
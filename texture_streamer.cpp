@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <functional>
+#include <ios>
+#include <stdexcept>
+#include <utility>
+#include "texture_streamer.h"
+#include "gpu_counters.h"
+
+namespace game {
+	std::vector<TextureStreamer *> TextureStreamer::streamers_;
+
+	// Texture formats by number of channels
+	static const GLenum formats_g[5] = { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+
+	TextureStreamer::TextureStreamer(void) {
+		resman_ = NULL;
+		budget_ = TEXTURE_STREAMER_BUDGET;
+		resident_bytes_ = 0;
+		evictions_ = 0;
+		frame_ = 0;
+		stop_ = false;
+		streamers_.push_back(this);
+	}
+
+	TextureStreamer::~TextureStreamer() {
+		streamers_.erase(std::find(streamers_.begin(), streamers_.end(), this));
+		Stop();
+		for (unsigned int i = 0; i < textures_.size(); i++) {
+			delete textures_[i];
+		}
+	}
+
+	void TextureStreamer::Stop(void) {
+		if (worker_.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			work_signal_.notify_all();
+			worker_.join();
+		}
+	}
+
+	void TextureStreamer::Clear(void) {
+		Stop();
+		for (unsigned int i = 0; i < textures_.size(); i++) {
+			glDeleteTextures(1, &textures_[i]->texture);
+			delete textures_[i];
+		}
+		textures_.clear();
+		last_used_.clear();
+		requests_.clear();
+		decoded_.clear();
+		resident_bytes_ = 0;
+	}
+
+	void TextureStreamer::Init(ResourceManager *resman) {
+		resman_ = resman;
+		worker_ = std::thread(&TextureStreamer::Work, this);
+	}
+
+	void TextureStreamer::Request(const std::string name, const std::string filename) {
+		StreamedTexture *tex = new StreamedTexture;
+		tex->name = name;
+		tex->filename = filename;
+		tex->channels = 0;
+		tex->base_level = 0;
+		tex->decoded = false;
+
+		// Grey placeholder, drawn until the first mip is uploaded into the same texture
+		static const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+		glGenTextures(1, &tex->texture);
+		glBindTexture(GL_TEXTURE_2D, tex->texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		GpuCounters::CountTextureUpload();
+
+		last_used_[tex->texture] = frame_;
+
+		// The resource is usable right away, nodes keep the texture name it holds. Its memory
+		// is counted here, so the manager neither counts nor deletes it
+		resman_->AddTexture(name, tex->texture, 0, false);
+		textures_.push_back(tex);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			requests_.push_back(tex);
+		}
+		work_signal_.notify_one();
+	}
+
+	void TextureStreamer::Work(void) {
+		while (true) {
+			StreamedTexture *tex;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				while (!stop_ && requests_.empty()) {
+					work_signal_.wait(lock);
+				}
+				if (stop_) {
+					return;
+				}
+				tex = requests_.front();
+				requests_.pop_front();
+			}
+
+			try {
+				DecodedAsset asset(Texture, tex->name);
+				ResourceManager::DecodeResource(tex->filename.c_str(), asset);
+				if (asset.channels < 1 || asset.channels > 4) {
+					throw(std::ios_base::failure(std::string("Error loading texture ") + tex->name + std::string(": unsupported number of channels")));
+				}
+				tex->channels = asset.channels;
+				BuildMipChain(tex, asset.pixels, asset.width, asset.height);
+			}
+			catch (...) {
+				tex->error = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			decoded_.push_back(tex);
+		}
+	}
+
+	void TextureStreamer::BuildMipChain(StreamedTexture *tex, const unsigned char *pixels, int width, int height) {
+		int channels = tex->channels;
+		tex->levels.resize(1);
+		tex->levels[0].width = width;
+		tex->levels[0].height = height;
+		tex->levels[0].pixels.assign(pixels, pixels + (size_t)width * height * channels);
+
+		// Each level averages 2x2 texels of the one above, repeating the last row or column of odd sizes
+		while (tex->levels.back().width > 1 || tex->levels.back().height > 1) {
+			MipLevel level;
+			const MipLevel &src = tex->levels.back();
+			level.width = std::max(1, src.width / 2);
+			level.height = std::max(1, src.height / 2);
+			level.pixels.resize((size_t)level.width * level.height * channels);
+			for (int y = 0; y < level.height; y++) {
+				const unsigned char *row0 = &src.pixels[(size_t)(2 * y) * src.width * channels];
+				const unsigned char *row1 = &src.pixels[(size_t)std::min(2 * y + 1, src.height - 1) * src.width * channels];
+				for (int x = 0; x < level.width; x++) {
+					int x0 = 2 * x * channels;
+					int x1 = std::min(2 * x + 1, src.width - 1) * channels;
+					unsigned char *out = &level.pixels[((size_t)y * level.width + x) * channels];
+					for (int c = 0; c < channels; c++) {
+						out[c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+					}
+				}
+			}
+			tex->levels.push_back(level);
+		}
+	}
+
+	void TextureStreamer::Update(void) {
+		frame_++;
+
+		std::deque<StreamedTexture *> decoded;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			decoded.swap(decoded_);
+		}
+		for (unsigned int i = 0; i < decoded.size(); i++) {
+			if (decoded[i]->error) {
+				std::rethrow_exception(decoded[i]->error);
+			}
+			decoded[i]->decoded = true;
+			decoded[i]->base_level = (int)decoded[i]->levels.size();
+		}
+
+		// A lowered budget takes effect right away
+		while (resident_bytes_ > budget_ && EvictOne(NULL)) {}
+
+		// Textures missing mips, the most recently drawn first
+		std::vector<std::pair<unsigned int, StreamedTexture *> > wanting;
+		for (unsigned int i = 0; i < textures_.size(); i++) {
+			StreamedTexture *tex = textures_[i];
+			if (tex->decoded && tex->base_level > 0) {
+				wanting.push_back(std::make_pair(last_used_.at(tex->texture), tex));
+			}
+		}
+		std::stable_sort(wanting.begin(), wanting.end(), std::greater<std::pair<unsigned int, StreamedTexture *> >());
+
+		size_t uploaded = 0;
+		for (unsigned int i = 0; i < wanting.size(); i++) {
+			StreamedTexture *tex = wanting[i].second;
+			while (tex->base_level > 0) {
+				int level = tex->base_level - 1;
+				size_t bytes = LevelBytes(tex, level);
+				if (uploaded > 0 && uploaded + bytes > TEXTURE_STREAMER_UPLOAD_BYTES) {
+					return;
+				}
+
+				// Every mip makes room for itself in the budget. Small mips are uploaded even when
+				// none can be made, larger ones only for textures in use and within the budget
+				const MipLevel &mip = tex->levels[level];
+				bool small = mip.width <= TEXTURE_STREAMER_RESIDENT_SIZE && mip.height <= TEXTURE_STREAMER_RESIDENT_SIZE;
+				if (!small && IsIdle(tex)) {
+					break;
+				}
+				while (resident_bytes_ + bytes > budget_ && EvictOne(tex)) {}
+				if (!small && resident_bytes_ + bytes > budget_) {
+					break;
+				}
+				UploadLevel(tex, level);
+				uploaded += bytes;
+			}
+		}
+	}
+
+	void TextureStreamer::MarkUsed(GLuint texture) {
+		for (unsigned int i = 0; i < streamers_.size(); i++) {
+			std::unordered_map<GLuint, unsigned int>::iterator it = streamers_[i]->last_used_.find(texture);
+			if (it != streamers_[i]->last_used_.end()) {
+				it->second = streamers_[i]->frame_;
+				return;
+			}
+		}
+	}
+
+	bool TextureStreamer::IsIdle(const StreamedTexture *tex) const {
+		return frame_ - last_used_.at(tex->texture) > TEXTURE_STREAMER_IDLE_FRAMES;
+	}
+
+	size_t TextureStreamer::LevelBytes(const StreamedTexture *tex, int level) const {
+		return tex->levels[level].pixels.size();
+	}
+
+	void TextureStreamer::UploadLevel(StreamedTexture *tex, int level) {
+		const MipLevel &mip = tex->levels[level];
+		glBindTexture(GL_TEXTURE_2D, tex->texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, level, formats_g[tex->channels], mip.width, mip.height, 0, formats_g[tex->channels], GL_UNSIGNED_BYTE, &mip.pixels[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (tex->base_level == (int)tex->levels.size()) {
+			// First mip of the image, the placeholder left in level 0 is outside the levels sampled until it is replaced
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)tex->levels.size() - 1);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		GpuCounters::CountStreamedUpload();
+
+		tex->base_level = level;
+		resident_bytes_ += LevelBytes(tex, level);
+	}
+
+	bool TextureStreamer::EvictOne(const StreamedTexture *keep) {
+		StreamedTexture *victim = NULL;
+		for (unsigned int i = 0; i < textures_.size(); i++) {
+			StreamedTexture *tex = textures_[i];
+			if (tex == keep || !tex->decoded || !IsIdle(tex) || tex->base_level >= (int)tex->levels.size() - 1) {
+				continue;
+			}
+			const MipLevel &mip = tex->levels[tex->base_level];
+			if (mip.width <= TEXTURE_STREAMER_RESIDENT_SIZE && mip.height <= TEXTURE_STREAMER_RESIDENT_SIZE) {
+				continue;
+			}
+			if (!victim || last_used_.at(tex->texture) < last_used_.at(victim->texture)) {
+				victim = tex;
+			}
+		}
+		if (!victim) {
+			return false;
+		}
+
+		// Sample from the next level, then give the storage of the finest one back
+		int level = victim->base_level;
+		GLenum format = formats_g[victim->channels];
+		glBindTexture(GL_TEXTURE_2D, victim->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+		glTexImage2D(GL_TEXTURE_2D, level, format, 0, 0, 0, format, GL_UNSIGNED_BYTE, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		victim->base_level = level + 1;
+		resident_bytes_ -= LevelBytes(victim, level);
+		evictions_++;
+		return true;
+	}
+
+	void TextureStreamer::SetBudget(size_t budget) {
+		budget_ = budget;
+	}
+
+	size_t TextureStreamer::GetBudget(void) const {
+		return budget_;
+	}
+
+	size_t TextureStreamer::GetResidentBytes(void) const {
+		return resident_bytes_;
+	}
+
+	int TextureStreamer::GetPending(void) const {
+		int pending = 0;
+		for (unsigned int i = 0; i < textures_.size(); i++) {
+			if (!textures_[i]->decoded || (textures_[i]->base_level > 0 && !IsIdle(textures_[i]))) {
+				pending++;
+			}
+		}
+		return pending;
+	}
+
+	size_t TextureStreamer::GetCpuBytes(void) const {
+		size_t bytes = 0;
+		for (unsigned int i = 0; i < textures_.size(); i++) {
+			if (!textures_[i]->decoded) {
+				continue; // Still being built by the decoding thread
+			}
+			for (unsigned int j = 0; j < textures_[i]->levels.size(); j++) {
+				bytes += textures_[i]->levels[j].pixels.capacity();
+			}
+		}
+		return bytes;
+	}
+
+	int TextureStreamer::GetEvictions(void) const {
+		return evictions_;
+	}
+} // namespace game
@@ -0,0 +1,118 @@
+#ifndef TEXTURE_STREAMER_H_
+#define TEXTURE_STREAMER_H_
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include "resource_manager.h"
+
+// Default texture memory budget, in bytes
+#define TEXTURE_STREAMER_BUDGET (64 * 1024 * 1024)
+// Bytes uploaded per frame, at least one mip level is always uploaded
+#define TEXTURE_STREAMER_UPLOAD_BYTES (1024 * 1024)
+// Mip levels at most this wide and high are uploaded even past the budget, they still count against it
+#define TEXTURE_STREAMER_RESIDENT_SIZE 64
+// Frames without being drawn before a texture gives its finest mips up
+#define TEXTURE_STREAMER_IDLE_FRAMES 300
+
+namespace game {
+	// Streams textures in: every texture is a 1x1 placeholder until a worker thread has
+	// decoded its image and built the mip chain, then its mips are uploaded over the next
+	// frames, coarsest first. Textures not drawn for a while lose their finest mips when
+	// the resident mips would exceed the memory budget, and get them back when drawn again
+	class TextureStreamer {
+	public:
+		TextureStreamer(void);
+		~TextureStreamer();
+
+		// Start the decoding thread
+		void Init(ResourceManager *resman);
+
+		// Add the texture resource name, a placeholder until filename is streamed in
+		void Request(const std::string name, const std::string filename);
+
+		// Upload and evict mips, call once per frame from the thread owning the GL context.
+		// Images that could not be decoded are thrown here
+		void Update(void);
+
+		// Stop decoding and delete every streamed texture, call while the GL context still exists
+		void Clear(void);
+
+		// Record that texture is drawn this frame, with the streamer it belongs to
+		static void MarkUsed(GLuint texture);
+
+		// Memory the mips of all textures may take, in bytes
+		void SetBudget(size_t budget);
+		size_t GetBudget(void) const;
+		// Estimated memory of all the mips currently uploaded, in bytes
+		size_t GetResidentBytes(void) const;
+		// Textures still streaming in: not decoded yet, or drawn recently and missing mips
+		int GetPending(void) const;
+		// Memory of the decoded mip chains kept to upload mips again
+		size_t GetCpuBytes(void) const;
+		// Mip levels evicted so far
+		int GetEvictions(void) const;
+
+	private:
+		// One level of the mip chain, kept in memory so evicted levels can be uploaded again
+		struct MipLevel {
+			int width;
+			int height;
+			std::vector<unsigned char> pixels;
+		};
+
+		struct StreamedTexture {
+			std::string name;
+			std::string filename;
+			GLuint texture;
+			int channels;
+			std::vector<MipLevel> levels; // Finest first
+			int base_level; // Finest level uploaded, levels.size() while the placeholder is shown
+			bool decoded;
+			std::exception_ptr error;
+		};
+
+		ResourceManager *resman_;
+		std::vector<StreamedTexture *> textures_;
+		size_t budget_;
+		size_t resident_bytes_;
+		int evictions_;
+
+		// Frame each texture of the streamer was last drawn in, by texture handle
+		std::unordered_map<GLuint, unsigned int> last_used_;
+		unsigned int frame_;
+		// Streamers alive, MarkUsed finds the texture in one of them
+		static std::vector<TextureStreamer *> streamers_;
+
+		// Shared with the decoding thread
+		std::thread worker_;
+		std::mutex mutex_;
+		std::condition_variable work_signal_;
+		std::deque<StreamedTexture *> requests_;
+		std::deque<StreamedTexture *> decoded_;
+		bool stop_;
+
+		// Decoding thread: read images and build their mip chains
+		void Work(void);
+		// Join the decoding thread
+		void Stop(void);
+		static void BuildMipChain(StreamedTexture *tex, const unsigned char *pixels, int width, int height);
+
+		bool IsIdle(const StreamedTexture *tex) const;
+		size_t LevelBytes(const StreamedTexture *tex, int level) const;
+		void UploadLevel(StreamedTexture *tex, int level);
+		// Drop the finest mip of the least recently drawn idle texture other than keep,
+		// returns false if no texture has a mip to give up
+		bool EvictOne(const StreamedTexture *keep);
+
+		TextureStreamer(const TextureStreamer &);
+		TextureStreamer &operator=(const TextureStreamer &);
+	}; // class TextureStreamer
+} // namespace game
+#endif // TEXTURE_STREAMER_H_